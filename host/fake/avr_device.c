@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+#include "driver/gpio.h"
+#include "avr_sim.h"
+#include "../avr/avr-poolmon/registers.h"
+
+#include "gpio_fake.h"
+#include "i2c_sim.h"
+#include "avr_device.h"
+
+typedef struct
+{
+    uint8_t pointer;
+    bool pointer_set;       // the first byte written after START is the register pointer
+    bool addressed;         // between START and STOP, so a further START is a repeated START
+    uint32_t resets;
+    uint32_t block_reads;
+    uint32_t block_reads_to_fail;
+    int attention_gpio;
+    avr_device_control_observer_t observer;
+    void * observer_context;
+} avr_device_t;
+
+static avr_device_t _device = { 0 };
+
+static bool _start(void * context, bool read)
+{
+    avr_device_t * device = (avr_device_t *)context;
+    bool block_read = read && device->addressed;
+    device->pointer_set = read;
+    device->addressed = true;
+    if (block_read)
+    {
+        if (device->block_reads_to_fail > 0)
+        {
+            --device->block_reads_to_fail;
+            return false;
+        }
+        ++device->block_reads;
+    }
+    return true;
+}
+
+static void _stop(void * context)
+{
+    ((avr_device_t *)context)->addressed = false;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    avr_device_t * device = (avr_device_t *)context;
+    if (!device->pointer_set)
+    {
+        device->pointer = value;
+        device->pointer_set = true;
+        return avr_sim_send_byte(value) == ESP_OK;
+    }
+
+    uint8_t reg = device->pointer++;
+    if (avr_sim_write_byte(reg, value) != ESP_OK)
+    {
+        return false;
+    }
+    if (reg == AVR_REGISTER_CONTROL && device->observer != NULL)
+    {
+        device->observer(value, device->observer_context);
+    }
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    avr_device_t * device = (avr_device_t *)context;
+    uint8_t value = 0;
+    avr_sim_read_block(device->pointer++, &value, 1);
+    return value;
+}
+
+static const i2c_sim_device_t AVR_DEVICE = { _start, _write, _read, _stop };
+
+static void _reset_line(gpio_num_t gpio_num, uint32_t level, void * context)
+{
+    avr_device_t * device = (avr_device_t *)context;
+    if (level == 0)
+    {
+        ++device->resets;
+        avr_sim_reset();
+    }
+}
+
+void avr_device_attach(i2c_port_t port, uint8_t address, int reset_gpio)
+{
+    _device = (avr_device_t){ 0 };
+    avr_sim_init();
+    i2c_sim_attach(port, address, &AVR_DEVICE, &_device);
+    gpio_fake_observe(reset_gpio, _reset_line, &_device);
+}
+
+static void _attention_line(bool asserted, void * context)
+{
+    const avr_device_t * device = (const avr_device_t *)context;
+    gpio_fake_hold_low(device->attention_gpio, asserted);
+}
+
+void avr_device_attach_attention(int attention_gpio)
+{
+    _device.attention_gpio = attention_gpio;
+    gpio_fake_hold_low(attention_gpio, avr_sim_attention());
+    avr_sim_observe_attention(_attention_line, &_device);
+}
+
+void avr_device_observe_control(avr_device_control_observer_t observer, void * context)
+{
+    _device.observer = observer;
+    _device.observer_context = context;
+}
+
+void avr_device_reset(void)
+{
+    ++_device.resets;
+    avr_sim_reset();
+}
+
+uint32_t avr_device_resets(void)
+{
+    return _device.resets;
+}
+
+uint8_t avr_device_control(void)
+{
+    uint8_t control = 0;
+    avr_sim_read_block(AVR_REGISTER_CONTROL, &control, 1);
+    return control;
+}
+
+void avr_device_fail_block_reads(uint32_t count)
+{
+    _device.block_reads_to_fail = count;
+}
+
+uint32_t avr_device_block_reads(void)
+{
+    return _device.block_reads;
+}
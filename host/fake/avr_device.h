@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file avr_device.h
+ * @brief The AVR co-processor as a device on the simulated I2C bus, with avr_sim providing
+ *        the registers.
+ *
+ * A write sets the register pointer from its first byte and writes any further bytes to
+ * successive registers, NACKing a write to a read-only register. A read returns successive
+ * registers from the pointer, as the firmware's auto-incrementing block read does. Driving the
+ * reset line low resets the registers. With avr_device_attach_attention(), the model holds the
+ * attention line low while avr_sim asserts it, so the falling edge reaches any interrupt handler.
+ */
+
+#ifndef AVR_DEVICE_H
+#define AVR_DEVICE_H
+
+#include <stdint.h>
+
+#include "driver/i2c.h"
+
+typedef void (*avr_device_control_observer_t)(uint8_t control, void * context);
+
+// Reset the registers and attach the AVR at the given address, with its reset line on reset_gpio
+void avr_device_attach(i2c_port_t port, uint8_t address, int reset_gpio);
+
+// Drive the attention line on attention_gpio. Call after avr_device_attach().
+void avr_device_attach_attention(int attention_gpio);
+
+// Called after every completed write of the CONTROL register
+void avr_device_observe_control(avr_device_control_observer_t observer, void * context);
+
+// Reset the AVR without the reset line, as a brown-out or watchdog reset would
+void avr_device_reset(void);
+
+// Number of resets, from the reset line or avr_device_reset()
+uint32_t avr_device_resets(void);
+
+// Current CONTROL register, as the AVR holds it
+uint8_t avr_device_control(void);
+
+// NACK the read address of the next count block reads (a read after a repeated START)
+void avr_device_fail_block_reads(uint32_t count);
+
+// Block reads served
+uint32_t avr_device_block_reads(void);
+
+#endif // AVR_DEVICE_H
@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "avr_fake.h"
+
+static avr_fake_command_t _commands[AVR_FAKE_MAX_COMMANDS];
+static size_t _num_commands = 0;
+static bool _outputs[AVR_FAKE_OUTPUT_EMERGENCY + 1] = { 0 };
+
+static void _record(avr_fake_output_t output, bool on)
+{
+    if (_num_commands == AVR_FAKE_MAX_COMMANDS)
+    {
+        memmove(&_commands[0], &_commands[1], sizeof(_commands) - sizeof(_commands[0]));
+        --_num_commands;
+    }
+    _commands[_num_commands++] = (avr_fake_command_t){ esp_timer_get_time(), output, on };
+    _outputs[output] = on;
+}
+
+void avr_fake_reset(void)
+{
+    _num_commands = 0;
+    memset(_outputs, 0, sizeof(_outputs));
+}
+
+size_t avr_fake_num_commands(void)
+{
+    return _num_commands;
+}
+
+const avr_fake_command_t * avr_fake_command(size_t index)
+{
+    return index < _num_commands ? &_commands[index] : NULL;
+}
+
+bool avr_fake_output(avr_fake_output_t output)
+{
+    return _outputs[output];
+}
+
+bool avr_fake_pp_running(void)
+{
+    return _outputs[AVR_FAKE_OUTPUT_PP] || _outputs[AVR_FAKE_OUTPUT_EMERGENCY];
+}
+
+void avr_support_set_cp_pump(avr_pump_state_t state)
+{
+    _record(AVR_FAKE_OUTPUT_CP, state == AVR_PUMP_STATE_ON);
+}
+
+void avr_support_set_pp_pump(avr_pump_state_t state)
+{
+    _record(AVR_FAKE_OUTPUT_PP, state == AVR_PUMP_STATE_ON);
+}
+
+void avr_support_set_alarm(avr_alarm_state_t state)
+{
+    _record(AVR_FAKE_OUTPUT_ALARM, state == AVR_ALARM_STATE_ON);
+}
+
+void avr_support_set_pp_emergency(bool emergency)
+{
+    _record(AVR_FAKE_OUTPUT_EMERGENCY, emergency);
+}
+
+bool avr_support_get_pp_emergency(void)
+{
+    return _outputs[AVR_FAKE_OUTPUT_EMERGENCY];
+}
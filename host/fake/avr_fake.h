@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file avr_fake.h
+ * @brief Records the output requests that the control loops make of avr_support.
+ */
+
+#ifndef AVR_FAKE_H
+#define AVR_FAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "avr_support.h"
+
+#define AVR_FAKE_MAX_COMMANDS (1024)
+
+typedef enum
+{
+    AVR_FAKE_OUTPUT_CP = 0,
+    AVR_FAKE_OUTPUT_PP,
+    AVR_FAKE_OUTPUT_ALARM,
+    AVR_FAKE_OUTPUT_EMERGENCY,
+} avr_fake_output_t;
+
+typedef struct
+{
+    int64_t time;              ///< virtual microseconds since boot
+    avr_fake_output_t output;
+    bool on;
+} avr_fake_command_t;
+
+void avr_fake_reset(void);
+
+// commands in the order they were made; older commands are dropped once the log is full
+size_t avr_fake_num_commands(void);
+const avr_fake_command_t * avr_fake_command(size_t index);
+
+// most recent request for an output
+bool avr_fake_output(avr_fake_output_t output);
+
+// the purge pump as the AVR task would drive it: on if requested, or if the emergency latch is set
+bool avr_fake_pp_running(void);
+
+#endif // AVR_FAKE_H
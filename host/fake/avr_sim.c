@@ -0,0 +1,266 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "avr_sim.h"
+#include "../avr/avr-poolmon/registers.h"
+
+#define TAG "avr_sim"
+
+typedef struct
+{
+    uint8_t pointer;      // register pointer for receive-byte and block reads
+    uint8_t control;
+    uint8_t scratch;
+    uint8_t switches;     // AVR_SIM_SWITCH_* bits
+    uint8_t status;       // last computed STATUS, for edge counting
+    uint8_t count_cp;
+    uint8_t count_pp;
+    uint8_t count_buzzer;
+    uint8_t count_cp_mode;
+    uint8_t count_cp_man;
+    uint8_t count_pp_mode;
+    uint8_t count_pp_man;
+    bool attention;       // line asserted, until the poll's last register is read
+} avr_sim_t;
+
+// accessed by the AVR task and by scripting callbacks on other tasks
+static avr_sim_t _sim = { 0 };
+static portMUX_TYPE _sim_mux = portMUX_INITIALIZER_UNLOCKED;
+static avr_sim_attention_observer_t _observer = NULL;
+static void * _observer_context = NULL;
+
+// Report a change of the attention line, after _sim_mux is released
+static void _notify(bool before)
+{
+    bool after = _sim.attention;
+    if (after != before && _observer != NULL)
+    {
+        _observer(after, _observer_context);
+    }
+}
+
+static void _count(uint8_t * counter)
+{
+    if (*counter < AVR_SIM_COUNT_MAX)
+    {
+        ++*counter;
+    }
+    _sim.attention = true;
+}
+
+// An SSR follows CONTROL in Auto mode, and its manual switch in Manual mode
+static uint8_t _compute_status(const avr_sim_t * sim)
+{
+    uint8_t status = 0;
+    status |= sim->switches & AVR_SIM_SWITCH_CP_MODE ? AVR_REGISTER_STATUS_SW1 : 0;
+    status |= sim->switches & AVR_SIM_SWITCH_CP_MAN  ? AVR_REGISTER_STATUS_SW2 : 0;
+    status |= sim->switches & AVR_SIM_SWITCH_PP_MODE ? AVR_REGISTER_STATUS_SW3 : 0;
+    status |= sim->switches & AVR_SIM_SWITCH_PP_MAN  ? AVR_REGISTER_STATUS_SW4 : 0;
+
+    bool ssr1 = sim->switches & AVR_SIM_SWITCH_CP_MODE ? sim->switches & AVR_SIM_SWITCH_CP_MAN : sim->control & AVR_REGISTER_CONTROL_SSR1;
+    bool ssr2 = sim->switches & AVR_SIM_SWITCH_PP_MODE ? sim->switches & AVR_SIM_SWITCH_PP_MAN : sim->control & AVR_REGISTER_CONTROL_SSR2;
+    status |= ssr1 ? AVR_REGISTER_STATUS_SSR1 : 0;
+    status |= ssr2 ? AVR_REGISTER_STATUS_SSR2 : 0;
+    return status;
+}
+
+// Recompute outputs after CONTROL or a switch changes, counting SSR activations. Called under _sim_mux.
+static void _update(avr_sim_t * sim)
+{
+    uint8_t status = _compute_status(sim);
+    uint8_t rising = status & ~sim->status;
+    if (rising & AVR_REGISTER_STATUS_SSR1)
+    {
+        _count(&sim->count_cp);
+    }
+    if (rising & AVR_REGISTER_STATUS_SSR2)
+    {
+        _count(&sim->count_pp);
+    }
+    sim->attention = sim->attention || status != sim->status;
+    sim->status = status;
+}
+
+// Counters are cleared when read. Called under _sim_mux.
+static uint8_t _read_and_clear(uint8_t * counter)
+{
+    uint8_t value = *counter;
+    *counter = 0;
+    return value;
+}
+
+static uint8_t _read(avr_sim_t * sim, uint8_t reg)
+{
+    switch (reg)
+    {
+        case AVR_REGISTER_ID:            return AVR_SIM_ID;
+        case AVR_REGISTER_VERSION:       return AVR_SIM_VERSION;
+        case AVR_REGISTER_CONTROL:       return sim->control;
+        case AVR_REGISTER_STATUS:        return sim->status;
+        case AVR_REGISTER_SCRATCH:       return sim->scratch;
+        case AVR_REGISTER_COUNT_CP:      return _read_and_clear(&sim->count_cp);
+        case AVR_REGISTER_COUNT_PP:      return _read_and_clear(&sim->count_pp);
+        case AVR_REGISTER_COUNT_BUZZER:  return _read_and_clear(&sim->count_buzzer);
+        case AVR_REGISTER_COUNT_CP_MODE: return _read_and_clear(&sim->count_cp_mode);
+        case AVR_REGISTER_COUNT_CP_MAN:  return _read_and_clear(&sim->count_cp_man);
+        case AVR_REGISTER_COUNT_PP_MODE: return _read_and_clear(&sim->count_pp_mode);
+        case AVR_REGISTER_COUNT_PP_MAN:
+            sim->attention = false;
+            return _read_and_clear(&sim->count_pp_man);
+        default:
+            return 0;
+    }
+}
+
+void avr_sim_init(void)
+{
+    portENTER_CRITICAL(&_sim_mux);
+    _sim = (avr_sim_t){ 0 };
+    _sim.status = _compute_status(&_sim);
+    portEXIT_CRITICAL(&_sim_mux);
+    _observer = NULL;
+    _observer_context = NULL;
+    ESP_LOGW(TAG, "AVR registers are simulated");
+}
+
+esp_err_t avr_sim_send_byte(uint8_t reg)
+{
+    portENTER_CRITICAL(&_sim_mux);
+    _sim.pointer = reg;
+    portEXIT_CRITICAL(&_sim_mux);
+    return ESP_OK;
+}
+
+esp_err_t avr_sim_receive_byte(uint8_t * value)
+{
+    bool before = _sim.attention;
+    portENTER_CRITICAL(&_sim_mux);
+    *value = _read(&_sim, _sim.pointer);
+    portEXIT_CRITICAL(&_sim_mux);
+    _notify(before);
+    return ESP_OK;
+}
+
+esp_err_t avr_sim_write_byte(uint8_t reg, uint8_t value)
+{
+    esp_err_t err = ESP_OK;
+    bool before = _sim.attention;
+    portENTER_CRITICAL(&_sim_mux);
+    _sim.pointer = reg;
+    switch (reg)
+    {
+        case AVR_REGISTER_CONTROL:
+            if (value & AVR_REGISTER_CONTROL_BUZZER & ~_sim.control)
+            {
+                _count(&_sim.count_buzzer);
+            }
+            _sim.control = value;
+            _update(&_sim);
+            break;
+        case AVR_REGISTER_SCRATCH:
+            _sim.scratch = value;
+            break;
+        default:
+            // read-only register - the firmware NACKs the data byte
+            err = ESP_FAIL;
+            break;
+    }
+    portEXIT_CRITICAL(&_sim_mux);
+    _notify(before);
+    return err;
+}
+
+esp_err_t avr_sim_read_block(uint8_t reg, uint8_t * data, size_t len)
+{
+    bool before = _sim.attention;
+    portENTER_CRITICAL(&_sim_mux);
+    _sim.pointer = reg;
+    for (size_t i = 0; i < len; ++i)
+    {
+        data[i] = _read(&_sim, _sim.pointer++);
+    }
+    portEXIT_CRITICAL(&_sim_mux);
+    _notify(before);
+    return ESP_OK;
+}
+
+bool avr_sim_attention(void)
+{
+    return _sim.attention;
+}
+
+void avr_sim_observe_attention(avr_sim_attention_observer_t observer, void * context)
+{
+    _observer = observer;
+    _observer_context = context;
+}
+
+void avr_sim_set_switches(uint8_t switches)
+{
+    bool before = _sim.attention;
+    portENTER_CRITICAL(&_sim_mux);
+    uint8_t changed = _sim.switches ^ switches;
+    if (changed & AVR_SIM_SWITCH_CP_MODE)
+    {
+        _count(&_sim.count_cp_mode);
+    }
+    if (changed & AVR_SIM_SWITCH_CP_MAN)
+    {
+        _count(&_sim.count_cp_man);
+    }
+    if (changed & AVR_SIM_SWITCH_PP_MODE)
+    {
+        _count(&_sim.count_pp_mode);
+    }
+    if (changed & AVR_SIM_SWITCH_PP_MAN)
+    {
+        _count(&_sim.count_pp_man);
+    }
+    _sim.switches = switches;
+    _update(&_sim);
+    portEXIT_CRITICAL(&_sim_mux);
+    _notify(before);
+    ESP_LOGI(TAG, "Switches 0x%02x", switches);
+}
+
+// STATUS is compared across the reset, so outputs that drop assert the attention line
+void avr_sim_reset(void)
+{
+    bool before = _sim.attention;
+    portENTER_CRITICAL(&_sim_mux);
+    uint8_t switches = _sim.switches;
+    uint8_t status = _sim.status;
+    _sim = (avr_sim_t){ 0 };
+    _sim.switches = switches;
+    _sim.status = _compute_status(&_sim);
+    _sim.attention = _sim.status != status;
+    portEXIT_CRITICAL(&_sim_mux);
+    _notify(before);
+    ESP_LOGW(TAG, "Simulated AVR reset");
+}
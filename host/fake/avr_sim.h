@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AVR_SIM_H
+#define AVR_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+/*
+ * Register-level model of the AVR co-processor for the host build. avr_device puts it on the
+ * simulated I2C bus, so the AVR task runs its real SMBus transactions against it, and the
+ * control loops and pump accounting run unchanged without hardware.
+ *
+ * The model follows the firmware's register map:
+ *  - ID and VERSION are constant;
+ *  - CONTROL drives SSR1, SSR2 and the buzzer, but an SSR follows its manual switch
+ *    when that channel's mode switch is in the Manual position;
+ *  - STATUS reports the four switches and both SSR outputs;
+ *  - SCRATCH holds any written value until the next reset;
+ *  - each COUNT register counts events since it was last read, saturating at 255;
+ *  - the attention line is asserted whenever STATUS changes or a COUNT register counts, and
+ *    released when COUNT_PP_MAN, the last register of every poll, is read.
+ *
+ * Switch positions and resets are scripted with avr_sim_set_switches() and avr_sim_reset()
+ * by the tests.
+ */
+
+// switch bits, in the same order as the STATUS register decode
+#define AVR_SIM_SWITCH_CP_MODE   (1 << 0)   // SW1: 0 = Auto, 1 = Manual
+#define AVR_SIM_SWITCH_CP_MAN    (1 << 1)   // SW2: 0 = Off, 1 = On
+#define AVR_SIM_SWITCH_PP_MODE   (1 << 2)   // SW3: 0 = Auto, 1 = Manual
+#define AVR_SIM_SWITCH_PP_MAN    (1 << 3)   // SW4: 0 = Off, 1 = On
+
+#define AVR_SIM_ID               (0x44)
+#define AVR_SIM_VERSION          (1)
+#define AVR_SIM_COUNT_MAX        (255)
+
+typedef void (*avr_sim_attention_observer_t)(bool asserted, void * context);
+
+// Power-on state: outputs off, switches in Auto/Off, SCRATCH and counters cleared.
+void avr_sim_init(void);
+
+// SMBus equivalents. The register pointer set by send-byte is used by the next receive-byte.
+esp_err_t avr_sim_send_byte(uint8_t reg);
+esp_err_t avr_sim_receive_byte(uint8_t * value);
+esp_err_t avr_sim_write_byte(uint8_t reg, uint8_t value);
+
+// Block read with an auto-incrementing register pointer, as read by the poll.
+esp_err_t avr_sim_read_block(uint8_t reg, uint8_t * data, size_t len);
+
+// Set all four switch positions from AVR_SIM_SWITCH_* bits. Changes are counted.
+void avr_sim_set_switches(uint8_t switches);
+
+// Current state of the attention line, true while asserted
+bool avr_sim_attention(void);
+
+// Call observer whenever the attention line is asserted or released, outside any register access lock
+void avr_sim_observe_attention(avr_sim_attention_observer_t observer, void * context);
+
+// Simulate an AVR reset (e.g. brown-out or reset line): CONTROL, SCRATCH and counters are
+// cleared, and the switches are sampled again.
+void avr_sim_reset(void);
+
+#endif // AVR_SIM_H
@@ -0,0 +1,58 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Stand-ins for the modules that control.c calls but that are not part of the
+ * control logic: temperature sensor configuration and the decision trace.
+ */
+
+#include "resources.h"
+#include "sensor_temp.h"
+#include "control_trace.h"
+
+// as sensor_temp.c: 1.5x the temperature poll period
+datastore_age_t sensor_temp_expiry(const datastore_t * datastore)
+{
+    uint32_t poll_period = 0;
+    datastore_get_uint32(datastore, RESOURCE_ID_TEMP_PERIOD, 0, &poll_period);
+    return (3 * poll_period * 1000) / 2;
+}
+
+int16_t control_trace_fixed(float value)
+{
+    return (int16_t)(value * 100.0f);
+}
+
+uint16_t control_trace_age(uint64_t age)
+{
+    return CONTROL_TRACE_NO_AGE;
+}
+
+void control_trace_add(uint8_t loop, uint32_t prev_state, uint32_t state, const control_outputs_t * outputs, control_trace_record_t * record)
+{
+}
+
+void control_trace_request_dump(void)
+{
+}
@@ -0,0 +1,270 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "esp_timer.h"
+#include "datastore/datastore.h"
+
+#define MAX_CALLBACKS (256)
+
+typedef struct
+{
+    bool set;
+    datastore_type_t type;    // type of the last set
+    int64_t timestamp;        // microseconds, virtual clock
+    union
+    {
+        bool b;
+        uint8_t u8;
+        uint32_t u32;
+        int8_t i8;
+        int32_t i32;
+        float f;
+        double d;
+    } value;
+    char string[DATASTORE_FAKE_STRING_LEN];
+} cell_t;
+
+typedef struct
+{
+    datastore_resource_id_t id;
+    datastore_instance_id_t instance;
+    set_callback callback;
+    void * context;
+} callback_t;
+
+struct datastore_s
+{
+    cell_t cells[DATASTORE_FAKE_MAX_RESOURCES][DATASTORE_FAKE_MAX_INSTANCES];
+    const char * names[DATASTORE_FAKE_MAX_RESOURCES];
+    uint32_t set_counts[DATASTORE_FAKE_MAX_RESOURCES];
+    callback_t callbacks[MAX_CALLBACKS];
+    size_t num_callbacks;
+};
+
+static cell_t * _cell(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance)
+{
+    if (datastore == NULL || id >= DATASTORE_FAKE_MAX_RESOURCES || instance >= DATASTORE_FAKE_MAX_INSTANCES)
+    {
+        return NULL;
+    }
+    return (cell_t *)&datastore->cells[id][instance];
+}
+
+static void _notify(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance)
+{
+    ++((datastore_t *)datastore)->set_counts[id];
+    for (size_t i = 0; i < datastore->num_callbacks; ++i)
+    {
+        const callback_t * cb = &datastore->callbacks[i];
+        if (cb->id == id && cb->instance == instance)
+        {
+            cb->callback(datastore, id, instance, cb->context);
+        }
+    }
+}
+
+static cell_t * _begin_set(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, datastore_type_t type)
+{
+    cell_t * cell = _cell(datastore, id, instance);
+    if (cell != NULL)
+    {
+        cell->set = true;
+        cell->type = type;
+        cell->timestamp = esp_timer_get_time();
+    }
+    return cell;
+}
+
+datastore_t * datastore_create(void)
+{
+    return calloc(1, sizeof(datastore_t));
+}
+
+void datastore_free(datastore_t ** datastore)
+{
+    if (datastore != NULL)
+    {
+        free(*datastore);
+        *datastore = NULL;
+    }
+}
+
+datastore_resource_t datastore_create_resource(datastore_type_t type, size_t num_instances)
+{
+    datastore_resource_t resource = { type, 0, num_instances };
+    return resource;
+}
+
+datastore_resource_t datastore_create_string_resource(size_t size, size_t num_instances)
+{
+    datastore_resource_t resource = { DATASTORE_TYPE_STRING, size, num_instances };
+    return resource;
+}
+
+datastore_status_t datastore_add_resource(const datastore_t * datastore, datastore_resource_id_t id, datastore_resource_t resource)
+{
+    return _cell(datastore, id, 0) != NULL && resource.num_instances <= DATASTORE_FAKE_MAX_INSTANCES ? DATASTORE_STATUS_OK : DATASTORE_STATUS_ERROR_INVALID_ID;
+}
+
+datastore_status_t datastore_set_name(const datastore_t * datastore, datastore_resource_id_t id, const char * name)
+{
+    if (_cell(datastore, id, 0) == NULL)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    ((datastore_t *)datastore)->names[id] = name;
+    return DATASTORE_STATUS_OK;
+}
+
+const char * datastore_get_name(const datastore_t * datastore, datastore_resource_id_t id)
+{
+    return _cell(datastore, id, 0) != NULL && datastore->names[id] != NULL ? datastore->names[id] : "";
+}
+
+#define SET_GET(NAME, TYPE, MEMBER, DS_TYPE) \
+    datastore_status_t datastore_set_##NAME(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, TYPE value) \
+    { \
+        cell_t * cell = _begin_set(datastore, id, instance, DS_TYPE); \
+        if (cell == NULL) \
+        { \
+            return DATASTORE_STATUS_ERROR_INVALID_ID; \
+        } \
+        cell->value.MEMBER = value; \
+        _notify(datastore, id, instance); \
+        return DATASTORE_STATUS_OK; \
+    } \
+    datastore_status_t datastore_get_##NAME(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, TYPE * value) \
+    { \
+        const cell_t * cell = _cell(datastore, id, instance); \
+        if (cell == NULL || value == NULL) \
+        { \
+            return DATASTORE_STATUS_ERROR_INVALID_ID; \
+        } \
+        if (cell->set) \
+        { \
+            *value = cell->value.MEMBER; \
+        } \
+        return DATASTORE_STATUS_OK; \
+    }
+
+SET_GET(bool, bool, b, DATASTORE_TYPE_BOOL)
+SET_GET(uint8, uint8_t, u8, DATASTORE_TYPE_UINT8)
+SET_GET(uint32, uint32_t, u32, DATASTORE_TYPE_UINT32)
+SET_GET(int8, int8_t, i8, DATASTORE_TYPE_INT8)
+SET_GET(int32, int32_t, i32, DATASTORE_TYPE_INT32)
+SET_GET(float, float, f, DATASTORE_TYPE_FLOAT)
+SET_GET(double, double, d, DATASTORE_TYPE_DOUBLE)
+
+datastore_status_t datastore_set_string(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, const char * value)
+{
+    cell_t * cell = _begin_set(datastore, id, instance, DATASTORE_TYPE_STRING);
+    if (cell == NULL || value == NULL)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    strncpy(cell->string, value, sizeof(cell->string) - 1);
+    _notify(datastore, id, instance);
+    return DATASTORE_STATUS_OK;
+}
+
+datastore_status_t datastore_get_string(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, char * value, size_t len)
+{
+    const cell_t * cell = _cell(datastore, id, instance);
+    if (cell == NULL || value == NULL || len == 0)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    strncpy(value, cell->string, len - 1);
+    value[len - 1] = '\0';
+    return DATASTORE_STATUS_OK;
+}
+
+datastore_status_t datastore_increment(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance)
+{
+    return datastore_add(datastore, id, instance, 1);
+}
+
+datastore_status_t datastore_add(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint32_t value)
+{
+    cell_t * cell = _cell(datastore, id, instance);
+    if (cell == NULL)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    uint32_t previous = cell->set ? cell->value.u32 : 0;
+    return datastore_set_uint32(datastore, id, instance, previous + value);
+}
+
+datastore_status_t datastore_get_age(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, datastore_age_t * age)
+{
+    const cell_t * cell = _cell(datastore, id, instance);
+    if (cell == NULL || age == NULL)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    *age = cell->set ? (datastore_age_t)(esp_timer_get_time() - cell->timestamp) : DATASTORE_INVALID_AGE;
+    return DATASTORE_STATUS_OK;
+}
+
+datastore_status_t datastore_add_set_callback(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, set_callback callback, void * context)
+{
+    datastore_t * store = (datastore_t *)datastore;
+    if (_cell(datastore, id, instance) == NULL || callback == NULL || store->num_callbacks >= MAX_CALLBACKS)
+    {
+        return DATASTORE_STATUS_ERROR_INVALID_ID;
+    }
+    store->callbacks[store->num_callbacks++] = (callback_t){ id, instance, callback, context };
+    return DATASTORE_STATUS_OK;
+}
+
+void datastore_dump(const datastore_t * datastore)
+{
+    for (datastore_resource_id_t id = 0; id < DATASTORE_FAKE_MAX_RESOURCES; ++id)
+    {
+        if (datastore->set_counts[id] > 0)
+        {
+            printf("%3" PRIu32 " %-40s sets %" PRIu32 "\n", id, datastore_get_name(datastore, id), datastore->set_counts[id]);
+        }
+    }
+}
+
+size_t datastore_get_ram_usage(const datastore_t * datastore)
+{
+    return sizeof(*datastore);
+}
+
+uint32_t datastore_fake_set_count(const datastore_t * datastore, datastore_resource_id_t id)
+{
+    return _cell(datastore, id, 0) != NULL ? datastore->set_counts[id] : 0;
+}
+
+void datastore_fake_reset_counts(const datastore_t * datastore)
+{
+    memset(((datastore_t *)datastore)->set_counts, 0, sizeof(datastore->set_counts));
+}
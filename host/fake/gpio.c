@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "driver/gpio.h"
+
+#include "gpio_fake.h"
+
+typedef struct
+{
+    bool driven_low;          // by the code under test
+    bool held_low;            // by a simulated device
+    gpio_int_type_t intr_type;
+    gpio_isr_t isr;
+    void * isr_arg;
+    gpio_fake_observer_t observer;
+    void * observer_context;
+    uint32_t interrupts;      // handler calls
+} pin_t;
+
+static pin_t _pins[GPIO_NUM_MAX];
+static bool _fail_isr_service = false;
+
+static bool _valid(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+static int _level(const pin_t * pin)
+{
+    return !pin->driven_low && !pin->held_low;
+}
+
+// Run the interrupt handler if the line level changed in the direction it is waiting for
+static void _edge(pin_t * pin, int before)
+{
+    int after = _level(pin);
+    bool rising = !before && after;
+    bool falling = before && !after;
+    if (pin->isr != NULL
+        && ((rising && (pin->intr_type == GPIO_INTR_POSEDGE || pin->intr_type == GPIO_INTR_ANYEDGE))
+            || (falling && (pin->intr_type == GPIO_INTR_NEGEDGE || pin->intr_type == GPIO_INTR_ANYEDGE))))
+    {
+        ++pin->interrupts;
+        pin->isr(pin->isr_arg);
+    }
+}
+
+void gpio_fake_reset(void)
+{
+    memset(_pins, 0, sizeof(_pins));
+    _fail_isr_service = false;
+}
+
+void gpio_fake_fail_isr_service(bool fail)
+{
+    _fail_isr_service = fail;
+}
+
+uint32_t gpio_fake_interrupts(gpio_num_t gpio_num)
+{
+    return _valid(gpio_num) ? _pins[gpio_num].interrupts : 0;
+}
+
+void gpio_fake_hold_low(gpio_num_t gpio_num, bool low)
+{
+    if (_valid(gpio_num))
+    {
+        pin_t * pin = &_pins[gpio_num];
+        int before = _level(pin);
+        pin->held_low = low;
+        _edge(pin, before);
+    }
+}
+
+uint32_t gpio_fake_driven_level(gpio_num_t gpio_num)
+{
+    return _valid(gpio_num) && !_pins[gpio_num].driven_low;
+}
+
+void gpio_fake_observe(gpio_num_t gpio_num, gpio_fake_observer_t observer, void * context)
+{
+    if (_valid(gpio_num))
+    {
+        _pins[gpio_num].observer = observer;
+        _pins[gpio_num].observer_context = context;
+    }
+}
+
+void gpio_pad_select_gpio(uint8_t gpio_num)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return _valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    return _valid(gpio_num) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!_valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!_valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pin_t * pin = &_pins[gpio_num];
+    int before = _level(pin);
+    pin->driven_low = level == 0;
+    if (pin->observer != NULL)
+    {
+        pin->observer(gpio_num, level ? 1 : 0, pin->observer_context);
+    }
+    _edge(pin, before);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return _valid(gpio_num) ? _level(&_pins[gpio_num]) : 0;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    // as esp_intr_alloc() reports no free interrupt
+    return _fail_isr_service ? ESP_ERR_NOT_FOUND : ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void * args)
+{
+    if (!_valid(gpio_num))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _pins[gpio_num].isr = isr_handler;
+    _pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
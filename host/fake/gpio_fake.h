@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file gpio_fake.h
+ * @brief Pin model behind the host GPIO driver.
+ *
+ * Every pin behaves as an open-drain line with a pull-up: it reads high unless the code under
+ * test drives it low, or a simulated device holds it low. Tests and device models can observe
+ * the levels the code drives, and trigger the edge interrupts it registers.
+ */
+
+#ifndef GPIO_FAKE_H
+#define GPIO_FAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+typedef void (*gpio_fake_observer_t)(gpio_num_t gpio_num, uint32_t level, void * context);
+
+// Release every pin and forget observers and interrupt handlers
+void gpio_fake_reset(void);
+
+// Hold a pin low from outside, or release it
+void gpio_fake_hold_low(gpio_num_t gpio_num, bool low);
+
+// Level last driven by the code under test, regardless of any external hold
+uint32_t gpio_fake_driven_level(gpio_num_t gpio_num);
+
+// Call observer whenever the code under test sets the level of the pin
+void gpio_fake_observe(gpio_num_t gpio_num, gpio_fake_observer_t observer, void * context);
+
+// Make gpio_install_isr_service() fail, as it does when no interrupt is free
+void gpio_fake_fail_isr_service(bool fail);
+
+// Number of times the pin's interrupt handler has run
+uint32_t gpio_fake_interrupts(gpio_num_t gpio_num);
+
+#endif // GPIO_FAKE_H
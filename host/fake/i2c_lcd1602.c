@@ -0,0 +1,200 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The parts of the esp32-i2c-lcd1602 component used by display.c. As in the component, each
+ * nibble is written to the PCF8574 and strobed with E as three separate SMBus send-bytes, each
+ * with its own START, address and STOP, and the strobe, clear, home and reset delays are
+ * busy-waits.
+ */
+
+#include <stdlib.h>
+
+#include "rom/ets_sys.h"
+#include "i2c-lcd1602.h"
+
+#define FLAG_RS                  0x01
+#define FLAG_E                   0x04
+#define FLAG_BACKLIGHT_ON        0x08
+
+#define COMMAND_CLEAR_DISPLAY    0x01
+#define COMMAND_RETURN_HOME      0x02
+#define COMMAND_ENTRY_MODE_SET   0x04
+#define COMMAND_DISPLAY_CONTROL  0x08
+#define COMMAND_FUNCTION_SET     0x20
+#define COMMAND_SET_CGRAM_ADDR   0x40
+#define COMMAND_SET_DDRAM_ADDR   0x80
+
+#define FLAG_ENTRY_MODE_SET_ENTRY_INCREMENT  0x02
+#define FLAG_DISPLAY_CONTROL_DISPLAY_ON      0x04
+#define FLAG_FUNCTION_SET_LINES_2            0x08
+
+// microseconds
+#define DELAY_INIT_1               4500
+#define DELAY_INIT_2               4500
+#define DELAY_INIT_3               120
+#define DELAY_CLEAR_DISPLAY        2000
+#define DELAY_RETURN_HOME          2000
+#define DELAY_ENABLE_PULSE_WIDTH   1
+#define DELAY_ENABLE_PULSE_SETTLE  50
+
+static esp_err_t _write_to_expander(const i2c_lcd1602_info_t * info, uint8_t data)
+{
+    return smbus_send_byte(info->smbus_info, data | info->backlight_flag);
+}
+
+static esp_err_t _strobe_enable(const i2c_lcd1602_info_t * info, uint8_t data)
+{
+    esp_err_t err1 = _write_to_expander(info, data | FLAG_E);
+    ets_delay_us(DELAY_ENABLE_PULSE_WIDTH);
+    esp_err_t err2 = _write_to_expander(info, data & ~FLAG_E);
+    ets_delay_us(DELAY_ENABLE_PULSE_SETTLE);
+    return err1 == ESP_OK ? err2 : err1;
+}
+
+static esp_err_t _write_top_nibble(const i2c_lcd1602_info_t * info, uint8_t data)
+{
+    esp_err_t err1 = _write_to_expander(info, data);
+    esp_err_t err2 = _strobe_enable(info, data);
+    return err1 == ESP_OK ? err2 : err1;
+}
+
+static esp_err_t _write(const i2c_lcd1602_info_t * info, uint8_t value, uint8_t register_select_flag)
+{
+    esp_err_t err1 = _write_top_nibble(info, (value & 0xf0) | register_select_flag);
+    esp_err_t err2 = _write_top_nibble(info, ((value & 0x0f) << 4) | register_select_flag);
+    return err1 == ESP_OK ? err2 : err1;
+}
+
+static esp_err_t _write_command(const i2c_lcd1602_info_t * info, uint8_t command)
+{
+    return _write(info, command, 0);
+}
+
+static esp_err_t _write_data(const i2c_lcd1602_info_t * info, uint8_t data)
+{
+    return _write(info, data, FLAG_RS);
+}
+
+i2c_lcd1602_info_t * i2c_lcd1602_malloc(void)
+{
+    return calloc(1, sizeof(i2c_lcd1602_info_t));
+}
+
+void i2c_lcd1602_free(i2c_lcd1602_info_t ** i2c_lcd1602_info)
+{
+    if (i2c_lcd1602_info != NULL)
+    {
+        free(*i2c_lcd1602_info);
+        *i2c_lcd1602_info = NULL;
+    }
+}
+
+esp_err_t i2c_lcd1602_init(i2c_lcd1602_info_t * i2c_lcd1602_info, smbus_info_t * smbus_info, bool backlight,
+                           uint8_t num_rows, uint8_t num_columns, uint8_t num_visible_columns)
+{
+    i2c_lcd1602_info->smbus_info = smbus_info;
+    i2c_lcd1602_info->backlight_flag = backlight ? FLAG_BACKLIGHT_ON : 0;
+    i2c_lcd1602_info->num_rows = num_rows;
+    i2c_lcd1602_info->num_columns = num_columns;
+    i2c_lcd1602_info->num_visible_columns = num_visible_columns;
+    i2c_lcd1602_info->display_control_flags = FLAG_DISPLAY_CONTROL_DISPLAY_ON;
+    i2c_lcd1602_info->entry_mode_flags = FLAG_ENTRY_MODE_SET_ENTRY_INCREMENT;
+    i2c_lcd1602_info->init = true;
+    return i2c_lcd1602_reset(i2c_lcd1602_info);
+}
+
+// The 8-bit initialisation sequence by instruction, then 4-bit mode, as the component does
+esp_err_t i2c_lcd1602_reset(const i2c_lcd1602_info_t * i2c_lcd1602_info)
+{
+    esp_err_t first_err = _write_to_expander(i2c_lcd1602_info, 0);
+    ets_delay_us(1000);
+
+    const uint32_t delays[] = { DELAY_INIT_1, DELAY_INIT_2, DELAY_INIT_3 };
+    for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); ++i)
+    {
+        esp_err_t err = _write_top_nibble(i2c_lcd1602_info, 0x03 << 4);
+        first_err = first_err == ESP_OK ? err : first_err;
+        ets_delay_us(delays[i]);
+    }
+
+    esp_err_t errs[] = {
+        _write_top_nibble(i2c_lcd1602_info, 0x02 << 4),
+        _write_command(i2c_lcd1602_info, COMMAND_FUNCTION_SET | FLAG_FUNCTION_SET_LINES_2),
+        _write_command(i2c_lcd1602_info, COMMAND_DISPLAY_CONTROL | i2c_lcd1602_info->display_control_flags),
+        i2c_lcd1602_clear(i2c_lcd1602_info),
+        _write_command(i2c_lcd1602_info, COMMAND_ENTRY_MODE_SET | i2c_lcd1602_info->entry_mode_flags),
+        i2c_lcd1602_home(i2c_lcd1602_info),
+    };
+    for (size_t i = 0; i < sizeof(errs) / sizeof(errs[0]); ++i)
+    {
+        first_err = first_err == ESP_OK ? errs[i] : first_err;
+    }
+    return first_err;
+}
+
+esp_err_t i2c_lcd1602_clear(const i2c_lcd1602_info_t * i2c_lcd1602_info)
+{
+    esp_err_t err = _write_command(i2c_lcd1602_info, COMMAND_CLEAR_DISPLAY);
+    ets_delay_us(DELAY_CLEAR_DISPLAY);
+    return err;
+}
+
+esp_err_t i2c_lcd1602_home(const i2c_lcd1602_info_t * i2c_lcd1602_info)
+{
+    esp_err_t err = _write_command(i2c_lcd1602_info, COMMAND_RETURN_HOME);
+    ets_delay_us(DELAY_RETURN_HOME);
+    return err;
+}
+
+esp_err_t i2c_lcd1602_move_cursor(const i2c_lcd1602_info_t * i2c_lcd1602_info, uint8_t col, uint8_t row)
+{
+    const uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+    if (row >= i2c_lcd1602_info->num_rows || row >= sizeof(row_offsets))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return _write_command(i2c_lcd1602_info, COMMAND_SET_DDRAM_ADDR | (col + row_offsets[row]));
+}
+
+esp_err_t i2c_lcd1602_set_backlight(i2c_lcd1602_info_t * i2c_lcd1602_info, bool enable)
+{
+    i2c_lcd1602_info->backlight_flag = enable ? FLAG_BACKLIGHT_ON : 0;
+    return _write_to_expander(i2c_lcd1602_info, 0);
+}
+
+esp_err_t i2c_lcd1602_define_char(const i2c_lcd1602_info_t * i2c_lcd1602_info, i2c_lcd1602_custom_index_t index, const uint8_t pixelmap[])
+{
+    esp_err_t err = _write_command(i2c_lcd1602_info, COMMAND_SET_CGRAM_ADDR | ((index & 0x07) << 3));
+    for (int i = 0; err == ESP_OK && i < 8; ++i)
+    {
+        err = _write_data(i2c_lcd1602_info, pixelmap[i]);
+    }
+    return err;
+}
+
+esp_err_t i2c_lcd1602_write_char(const i2c_lcd1602_info_t * i2c_lcd1602_info, uint8_t chr)
+{
+    return _write_data(i2c_lcd1602_info, chr);
+}
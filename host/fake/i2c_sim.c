@@ -0,0 +1,401 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/i2c.h"
+#include "esp_log.h"
+
+#include "gpio_fake.h"
+#include "rtos_sim.h"
+#include "vclock.h"
+#include "i2c_sim.h"
+
+#define TAG "i2c_sim"
+
+#define MAX_ADDRESSES  (128)
+
+typedef enum
+{
+    STEP_START,
+    STEP_WRITE,          // data bytes from data, or the single byte value
+    STEP_READ,
+    STEP_STOP,
+} step_type_t;
+
+typedef struct step_s
+{
+    step_type_t type;
+    uint8_t value;
+    uint8_t * data;      // referenced, not copied, as by the ESP-IDF driver
+    size_t len;
+    bool ack_check;
+    struct step_s * next;
+} step_t;
+
+typedef struct
+{
+    step_t * head;
+    step_t * tail;
+} link_t;
+
+typedef struct
+{
+    const i2c_sim_device_t * device;
+    void * context;
+} slot_t;
+
+typedef struct
+{
+    bool installed;
+    i2c_config_t config;
+    slot_t slots[MAX_ADDRESSES];
+    uint32_t hold_clocks;          // SCL clocks until a stuck slave releases SDA
+    int64_t busy_until;            // microseconds
+    bool busy;
+    i2c_sim_stats_t stats;
+} port_t;
+
+static port_t _ports[I2C_NUM_MAX];
+static i2c_sim_stats_t _link_stats;    // links are not tied to a port until they run
+
+static port_t * _port(i2c_port_t port)
+{
+    return port >= 0 && port < I2C_NUM_MAX ? &_ports[port] : NULL;
+}
+
+static void _scl_observer(gpio_num_t gpio_num, uint32_t level, void * context)
+{
+    port_t * port = (port_t *)context;
+    if (level && port->hold_clocks > 0 && --port->hold_clocks == 0)
+    {
+        gpio_fake_hold_low(port->config.sda_io_num, false);
+    }
+}
+
+void i2c_sim_reset(void)
+{
+    for (size_t i = 0; i < I2C_NUM_MAX; ++i)
+    {
+        if (_ports[i].hold_clocks > 0)
+        {
+            gpio_fake_hold_low(_ports[i].config.sda_io_num, false);
+        }
+    }
+    memset(_ports, 0, sizeof(_ports));
+    memset(&_link_stats, 0, sizeof(_link_stats));
+}
+
+void i2c_sim_attach(i2c_port_t port, uint8_t address, const i2c_sim_device_t * device, void * context)
+{
+    port_t * p = _port(port);
+    if (p != NULL && address < MAX_ADDRESSES)
+    {
+        p->slots[address].device = device;
+        p->slots[address].context = context;
+    }
+}
+
+void i2c_sim_hold_sda(i2c_port_t port, uint32_t clocks)
+{
+    port_t * p = _port(port);
+    if (p != NULL)
+    {
+        p->hold_clocks = clocks;
+        gpio_fake_hold_low(p->config.sda_io_num, clocks > 0);
+    }
+}
+
+uint32_t i2c_sim_clock(i2c_port_t port)
+{
+    port_t * p = _port(port);
+    return p != NULL ? p->config.master.clk_speed : 0;
+}
+
+const i2c_sim_stats_t * i2c_sim_stats(i2c_port_t port)
+{
+    port_t * p = _port(port);
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    p->stats.links_created = _link_stats.links_created;
+    p->stats.links_deleted = _link_stats.links_deleted;
+    p->stats.link_nodes = _link_stats.link_nodes;
+    return &p->stats;
+}
+
+void i2c_sim_reset_stats(void)
+{
+    for (size_t i = 0; i < I2C_NUM_MAX; ++i)
+    {
+        memset(&_ports[i].stats, 0, sizeof(_ports[i].stats));
+    }
+    memset(&_link_stats, 0, sizeof(_link_stats));
+}
+
+// Driver
+
+esp_err_t i2c_param_config(i2c_port_t i2c_num, const i2c_config_t * i2c_conf)
+{
+    port_t * p = _port(i2c_num);
+    if (p == NULL || i2c_conf == NULL || i2c_conf->master.clk_speed == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    p->config = *i2c_conf;
+    gpio_fake_observe(i2c_conf->scl_io_num, _scl_observer, p);
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags)
+{
+    port_t * p = _port(i2c_num);
+    if (p == NULL || p->installed)
+    {
+        return ESP_FAIL;
+    }
+    p->installed = true;
+    ++p->stats.installs;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t i2c_num)
+{
+    port_t * p = _port(i2c_num);
+    if (p == NULL || !p->installed)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    p->installed = false;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void)
+{
+    ++_link_stats.links_created;
+    return calloc(1, sizeof(link_t));
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd_handle)
+{
+    link_t * link = (link_t *)cmd_handle;
+    if (link != NULL)
+    {
+        ++_link_stats.links_deleted;
+        for (step_t * step = link->head; step != NULL; )
+        {
+            step_t * next = step->next;
+            free(step);
+            step = next;
+        }
+        free(link);
+    }
+}
+
+static esp_err_t _append(i2c_cmd_handle_t cmd_handle, step_t prototype)
+{
+    link_t * link = (link_t *)cmd_handle;
+    if (link == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    step_t * step = malloc(sizeof(*step));
+    if (step == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    ++_link_stats.link_nodes;
+    *step = prototype;
+    step->next = NULL;
+    if (link->tail != NULL)
+    {
+        link->tail->next = step;
+    }
+    else
+    {
+        link->head = step;
+    }
+    link->tail = step;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd_handle)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_START });
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd_handle, uint8_t data, bool ack_en)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_WRITE, .value = data, .len = 1, .ack_check = ack_en });
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd_handle, uint8_t * data, size_t data_len, bool ack_en)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_WRITE, .data = data, .len = data_len, .ack_check = ack_en });
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd_handle, uint8_t * data, i2c_ack_type_t ack)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_READ, .data = data, .len = 1 });
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd_handle, uint8_t * data, size_t data_len, i2c_ack_type_t ack)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_READ, .data = data, .len = data_len });
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd_handle)
+{
+    return _append(cmd_handle, (step_t){ .type = STEP_STOP });
+}
+
+static uint32_t _duration_us(const port_t * p, const link_t * link)
+{
+    uint32_t bits = 0;
+    for (const step_t * step = link->head; step != NULL; step = step->next)
+    {
+        bits += step->type == STEP_START || step->type == STEP_STOP ? 1 : 9 * step->len;
+    }
+    return I2C_SIM_COMMAND_OVERHEAD_US + (uint32_t)(((uint64_t)bits * 1000000 + p->config.master.clk_speed - 1) / p->config.master.clk_speed);
+}
+
+// Run the steps against the devices. A NACK ends the transaction as the driver does.
+static esp_err_t _execute(port_t * p, const link_t * link)
+{
+    const slot_t * slot = NULL;
+    bool address_next = false;
+    bool reading = false;
+    esp_err_t err = ESP_OK;
+
+    for (const step_t * step = link->head; step != NULL && err == ESP_OK; step = step->next)
+    {
+        switch (step->type)
+        {
+        case STEP_START:
+            address_next = true;
+            break;
+        case STEP_WRITE:
+            for (size_t i = 0; i < step->len && err == ESP_OK; ++i)
+            {
+                uint8_t value = step->data ? step->data[i] : step->value;
+                ++p->stats.bytes;
+                bool ack = false;
+                if (address_next)
+                {
+                    address_next = false;
+                    reading = value & 1;
+                    slot = &p->slots[value >> 1];
+                    ack = slot->device != NULL && (slot->device->start == NULL || slot->device->start(slot->context, reading));
+                    if (!ack)
+                    {
+                        slot = NULL;
+                    }
+                }
+                else if (slot != NULL && !reading)
+                {
+                    ack = slot->device->write == NULL || slot->device->write(slot->context, value);
+                }
+                if (!ack && step->ack_check)
+                {
+                    err = ESP_FAIL;
+                }
+            }
+            break;
+        case STEP_READ:
+            for (size_t i = 0; i < step->len; ++i)
+            {
+                ++p->stats.bytes;
+                step->data[i] = slot != NULL && reading && slot->device->read != NULL ? slot->device->read(slot->context) : 0xff;
+            }
+            break;
+        case STEP_STOP:
+            if (slot != NULL && slot->device->stop != NULL)
+            {
+                slot->device->stop(slot->context);
+            }
+            slot = NULL;
+            break;
+        }
+    }
+
+    if (err != ESP_OK)
+    {
+        ++p->stats.nacks;
+        if (slot != NULL && slot->device->stop != NULL)
+        {
+            slot->device->stop(slot->context);
+        }
+    }
+    return err;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t i2c_num, i2c_cmd_handle_t cmd_handle, TickType_t ticks_to_wait)
+{
+    port_t * p = _port(i2c_num);
+    const link_t * link = (const link_t *)cmd_handle;
+    if (p == NULL || link == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!p->installed)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // the driver serialises commands on a port with a mutex
+    if (p->busy)
+    {
+        ++p->stats.overlaps;
+        while (p->busy)
+        {
+            rtos_sim_block_us(p->busy_until > vclock_now() ? p->busy_until - vclock_now() : 1);
+        }
+    }
+
+    ++p->stats.commands;
+    int64_t start = vclock_now();
+    esp_err_t err = ESP_OK;
+    p->busy = true;
+    if (p->hold_clocks > 0)
+    {
+        // the controller cannot generate a START while a slave holds SDA low
+        uint32_t wait = ticks_to_wait == portMAX_DELAY ? 1000000 : ticks_to_wait * portTICK_PERIOD_MS * 1000;
+        p->busy_until = start + wait;
+        rtos_sim_block_us(wait);
+        ++p->stats.timeouts;
+        err = ESP_ERR_TIMEOUT;
+    }
+    else
+    {
+        uint32_t duration = _duration_us(p, link);
+        p->busy_until = start + duration;
+        rtos_sim_block_us(duration);
+        err = _execute(p, link);
+    }
+    p->busy = false;
+    p->stats.busy_us += vclock_now() - start;
+    return err;
+}
@@ -0,0 +1,97 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file i2c_sim.h
+ * @brief Simulated I2C bus behind the host I2C driver.
+ *
+ * i2c_master_cmd_begin() runs a command link against the device models attached to the port.
+ * The calling task blocks for the time the transaction takes on the wire, as it does on the
+ * device while the driver waits for the I2C interrupt, so other tasks run in the meantime:
+ *
+ *     I2C_SIM_COMMAND_OVERHEAD_US + (START/STOP bits + 9 bits per byte) / clk_speed
+ *
+ * The overhead is an estimate of the driver's per-command cost (mutex, command registers,
+ * interrupt handling), not a measurement. Device callbacks run at the end of that time.
+ *
+ * A slave can be made to hold SDA low, as after a reset part-way through a read: every command
+ * then fails with ESP_ERR_TIMEOUT after its ticks_to_wait, and the hold is released once SCL
+ * has been clocked the given number of times with the driver removed.
+ */
+
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/i2c.h"
+
+#define I2C_SIM_COMMAND_OVERHEAD_US  (50)
+
+typedef struct
+{
+    // Addressed by a START or repeated START. Return false to NACK the address.
+    bool (*start)(void * context, bool read);
+
+    // Byte written by the master. Return false to NACK it.
+    bool (*write)(void * context, uint8_t value);
+
+    // Byte read by the master
+    uint8_t (*read)(void * context);
+
+    // STOP, or the end of a failed transaction
+    void (*stop)(void * context);
+} i2c_sim_device_t;
+
+typedef struct
+{
+    uint32_t commands;         // i2c_master_cmd_begin calls
+    uint32_t bytes;            // including address bytes
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t overlaps;         // commands that found another in progress on the port
+    uint64_t busy_us;          // total time spent in commands
+    uint32_t links_created;
+    uint32_t links_deleted;
+    uint32_t link_nodes;       // heap allocations for command steps
+    uint32_t installs;         // driver installs, including reinstalls by bus recovery
+} i2c_sim_stats_t;
+
+// Detach all devices, clear faults and statistics, and uninstall the drivers
+void i2c_sim_reset(void);
+
+// Attach a device model at a 7-bit address. A NULL device detaches the address.
+void i2c_sim_attach(i2c_port_t port, uint8_t address, const i2c_sim_device_t * device, void * context);
+
+// Hold SDA low until SCL is clocked the given number of times (0 releases it)
+void i2c_sim_hold_sda(i2c_port_t port, uint32_t clocks);
+
+// Current bus clock in Hz, as last configured
+uint32_t i2c_sim_clock(i2c_port_t port);
+
+const i2c_sim_stats_t * i2c_sim_stats(i2c_port_t port);
+void i2c_sim_reset_stats(void);
+
+#endif // I2C_SIM_H
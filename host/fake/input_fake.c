@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "button.h"
+#include "rotary_encoder.h"
+
+#include "input_fake.h"
+
+static QueueHandle_t _input_queue = NULL;
+
+void input_fake_reset(void)
+{
+    _input_queue = NULL;
+}
+
+bool input_fake_send(int event)
+{
+    if (_input_queue == NULL)
+    {
+        return false;
+    }
+
+    // the queue holds button_event_t items, and the encoder's events are the same size
+    button_event_t item = (button_event_t)event;
+    return xQueueSendToBack(_input_queue, &item, 0) == pdTRUE;
+}
+
+void button_init(UBaseType_t priority, QueueHandle_t input_queue, gpio_num_t gpio)
+{
+    _input_queue = input_queue;
+}
+
+void button_delete(void)
+{
+}
+
+void rotary_encoder_init(UBaseType_t priority, QueueHandle_t input_queue, gpio_num_t gpio_a, gpio_num_t gpio_b)
+{
+    _input_queue = input_queue;
+}
+
+void rotary_encoder_delete(void)
+{
+}
@@ -0,0 +1,201 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "i2c_sim.h"
+#include "lcd_device.h"
+
+#define PORT_RS            0x01
+#define PORT_E             0x04
+#define PORT_BACKLIGHT     0x08
+
+#define LINE_2_ADDRESS     0x40
+#define CGRAM_SIZE         64
+
+#define CMD_CLEAR          0x01
+#define CMD_HOME           0x02
+#define CMD_ENTRY_MODE     0x04
+#define CMD_SHIFT          0x10
+#define CMD_SHIFT_DISPLAY  0x08
+#define CMD_SHIFT_RIGHT    0x04
+#define CMD_FUNCTION_SET   0x20
+#define CMD_SET_CGRAM      0x40
+#define CMD_SET_DDRAM      0x80
+
+typedef struct
+{
+    uint8_t port;
+    bool high_nibble;          // the next nibble latched is the high one
+    uint8_t nibble;
+    char ddram[2][LCD_DEVICE_LINE_LENGTH];
+    uint8_t cgram[CGRAM_SIZE];
+    uint8_t address;
+    bool cgram_selected;       // data goes to CGRAM rather than DDRAM
+    int shift;                 // display shift, in columns to the left
+    lcd_device_stats_t stats;
+} lcd_device_t;
+
+static lcd_device_t _device = { 0 };
+
+static void _clear(lcd_device_t * device)
+{
+    memset(device->ddram, ' ', sizeof(device->ddram));
+    device->address = 0;
+    device->cgram_selected = false;
+    device->shift = 0;
+}
+
+// The highest set bit selects the command. Function set, display control and entry mode are
+// not modelled: the controller is taken to be in 4-bit mode, display on, incrementing.
+static void _command(lcd_device_t * device, uint8_t value)
+{
+    if (value >= CMD_SET_DDRAM)
+    {
+        device->address = value & 0x7f;
+        device->cgram_selected = false;
+    }
+    else if (value >= CMD_SET_CGRAM)
+    {
+        device->address = value & 0x3f;
+        device->cgram_selected = true;
+    }
+    else if (value >= CMD_FUNCTION_SET)
+    {
+        // not modelled
+    }
+    else if (value >= CMD_SHIFT)
+    {
+        if (value & CMD_SHIFT_DISPLAY)
+        {
+            device->shift = (device->shift + (value & CMD_SHIFT_RIGHT ? LCD_DEVICE_LINE_LENGTH - 1 : 1)) % LCD_DEVICE_LINE_LENGTH;
+        }
+    }
+    else if (value >= CMD_ENTRY_MODE)
+    {
+        // display control and entry mode, not modelled
+    }
+    else if (value >= CMD_HOME)
+    {
+        device->address = 0;
+        device->cgram_selected = false;
+        device->shift = 0;
+    }
+    else if (value == CMD_CLEAR)
+    {
+        _clear(device);
+    }
+}
+
+static void _data(lcd_device_t * device, uint8_t value)
+{
+    if (device->cgram_selected)
+    {
+        device->cgram[device->address] = value;
+        device->address = (device->address + 1) % CGRAM_SIZE;
+        return;
+    }
+
+    int line = device->address >= LINE_2_ADDRESS ? 1 : 0;
+    int offset = (device->address - line * LINE_2_ADDRESS) % LCD_DEVICE_LINE_LENGTH;
+    device->ddram[line][offset] = value;
+    device->address = line * LINE_2_ADDRESS + (offset + 1) % LCD_DEVICE_LINE_LENGTH;
+}
+
+static bool _start(void * context, bool read)
+{
+    lcd_device_t * device = (lcd_device_t *)context;
+    ++device->stats.transactions;
+    return true;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    lcd_device_t * device = (lcd_device_t *)context;
+    ++device->stats.port_writes;
+    device->stats.backlight_off += value & PORT_BACKLIGHT ? 0 : 1;
+
+    // latch on the falling edge of E
+    bool falling = (device->port & PORT_E) && !(value & PORT_E);
+    device->port = value;
+    if (falling)
+    {
+        if (device->high_nibble)
+        {
+            device->nibble = value & 0xf0;
+        }
+        else
+        {
+            uint8_t byte = device->nibble | (value >> 4);
+            ++device->stats.bytes;
+            if (value & PORT_RS)
+            {
+                _data(device, byte);
+            }
+            else
+            {
+                _command(device, byte);
+            }
+        }
+        device->high_nibble = !device->high_nibble;
+    }
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    return ((lcd_device_t *)context)->port;
+}
+
+static const i2c_sim_device_t LCD_DEVICE = { _start, _write, _read, NULL };
+
+void lcd_device_attach(i2c_port_t port, uint8_t address)
+{
+    _device = (lcd_device_t){ 0 };
+    _device.high_nibble = true;
+    _clear(&_device);
+    i2c_sim_attach(port, address, &LCD_DEVICE, &_device);
+}
+
+void lcd_device_row(uint8_t row, char out[LCD_DEVICE_COLUMNS + 1])
+{
+    int line = row % 2;
+    int origin = row < 2 ? 0 : LCD_DEVICE_COLUMNS;
+    for (int col = 0; col < LCD_DEVICE_COLUMNS; ++col)
+    {
+        out[col] = _device.ddram[line][(origin + col + _device.shift) % LCD_DEVICE_LINE_LENGTH];
+    }
+    out[LCD_DEVICE_COLUMNS] = '\0';
+}
+
+const uint8_t * lcd_device_cgram(uint8_t index)
+{
+    return &_device.cgram[(index & 0x07) * 8];
+}
+
+const lcd_device_stats_t * lcd_device_stats(void)
+{
+    return &_device.stats;
+}
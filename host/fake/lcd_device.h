@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file lcd_device.h
+ * @brief HD44780 LCD controller behind a PCF8574 I2C backpack, on the simulated I2C bus.
+ *
+ * Every byte written to the PCF8574 sets its port: P0 = RS, P1 = RW, P2 = E, P3 = backlight,
+ * P4-P7 = D4-D7. The controller is in 4-bit mode and latches D4-D7 as E falls, high nibble
+ * first. Commands set the DDRAM or CGRAM address, clear, return home and shift the display;
+ * data is written at the address, which then increments. DDRAM is two 40-character lines, and
+ * the 20x4 window shows line 1 on rows 0 and 2 and line 2 on rows 1 and 3.
+ */
+
+#ifndef LCD_DEVICE_H
+#define LCD_DEVICE_H
+
+#include <stdint.h>
+
+#include "driver/i2c.h"
+
+#define LCD_DEVICE_ROWS     (4)
+#define LCD_DEVICE_COLUMNS  (20)
+#define LCD_DEVICE_LINE_LENGTH  (40)   // DDRAM characters per line, shifted through the rows
+
+typedef struct
+{
+    uint32_t transactions;     // I2C writes addressed to the backpack
+    uint32_t port_writes;
+    uint32_t bytes;            // command and data bytes latched by the controller
+    uint32_t backlight_off;    // port writes with the backlight bit clear
+} lcd_device_stats_t;
+
+// Clear the display and statistics, and attach the backpack at the given address
+void lcd_device_attach(i2c_port_t port, uint8_t address);
+
+// The visible characters of a row, through the current display shift, as a string
+void lcd_device_row(uint8_t row, char out[LCD_DEVICE_COLUMNS + 1]);
+
+// The eight pixel rows of a CGRAM character
+const uint8_t * lcd_device_cgram(uint8_t index);
+
+const lcd_device_stats_t * lcd_device_stats(void);
+
+#endif // LCD_DEVICE_H
@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+static const char LEVEL_CHARS[] = "-EWIDV";
+
+static uint32_t _counts[ESP_LOG_VERBOSE + 1] = { 0 };
+static int _enabled = -1;   // highest level printed, or -1 before HOST_LOG is read
+
+#define MAX_TAGS (8)
+
+static struct
+{
+    const char * tag;
+    esp_log_level_t level;
+} _tags[MAX_TAGS] = { { 0 } };
+
+static bool _tag_enabled(const char * tag, esp_log_level_t level)
+{
+    for (size_t i = 0; i < MAX_TAGS && _tags[i].tag != NULL; ++i)
+    {
+        if (strcmp(_tags[i].tag, tag) == 0)
+        {
+            return level <= _tags[i].level;
+        }
+    }
+    return false;
+}
+
+void host_log(esp_log_level_t level, const char * tag, const char * format, ...)
+{
+    ++_counts[level];
+
+    if (_enabled < 0)
+    {
+        const char * env = getenv("HOST_LOG");
+        _enabled = ESP_LOG_NONE;
+        for (int i = ESP_LOG_ERROR; env != NULL && i <= ESP_LOG_VERBOSE; ++i)
+        {
+            if (env[0] == LEVEL_CHARS[i])
+            {
+                _enabled = i;
+            }
+        }
+    }
+
+    if ((int)level <= _enabled || _tag_enabled(tag, level))
+    {
+        va_list args;
+        va_start(args, format);
+        printf("%c (%s) ", LEVEL_CHARS[level], tag);
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+    }
+}
+
+uint32_t host_log_count(esp_log_level_t level)
+{
+    return _counts[level];
+}
+
+void host_log_reset(void)
+{
+    for (int i = 0; i <= ESP_LOG_VERBOSE; ++i)
+    {
+        _counts[i] = 0;
+    }
+}
+
+void esp_log_level_set(const char * tag, esp_log_level_t level)
+{
+    if (strcmp(tag, "*") == 0)
+    {
+        return;
+    }
+    for (size_t i = 0; i < MAX_TAGS; ++i)
+    {
+        if (_tags[i].tag == NULL || strcmp(_tags[i].tag, tag) == 0)
+        {
+            _tags[i].tag = tag;
+            _tags[i].level = level;
+            return;
+        }
+    }
+}
@@ -0,0 +1,680 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "rom/ets_sys.h"
+#include "esp_log.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+
+#define TAG "rtos_sim"
+
+#define MAX_TASKS        (32)
+#define MAX_NAME_LEN     (16)
+#define HOST_STACK_SIZE  (256 * 1024)    // host code, printf in particular, needs far more than the device
+#define TICK_US          ((int64_t)portTICK_PERIOD_MS * 1000)
+#define NO_DEADLINE      INT64_MAX
+#define STACK_FILL       (0xa5)          // untouched host stack, for rtos_sim_task_stack()
+
+typedef enum
+{
+    TASK_UNUSED = 0,
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DELETED,     // waiting for the scheduler to release its stack
+} task_state_t;
+
+typedef enum
+{
+    WAIT_NONE = 0,
+    WAIT_DELAY,
+    WAIT_RECEIVE,
+    WAIT_SEND,
+    WAIT_NOTIFY,
+} wait_t;
+
+typedef struct queue_s
+{
+    uint8_t * storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    struct queue_s * next;
+} queue_t;
+
+typedef struct
+{
+    task_state_t state;
+    char name[MAX_NAME_LEN];
+    UBaseType_t priority;
+    uint32_t stack_depth;      // bytes, as requested
+    TaskFunction_t function;
+    void * parameters;
+    ucontext_t context;
+    void * stack;
+
+    wait_t wait;
+    const queue_t * wait_queue;
+    int64_t deadline;          // microseconds, NO_DEADLINE to wait forever
+    bool timed_out;
+    uint64_t order;            // when the task last became ready or blocked, for FIFO order
+    uint32_t notify;
+    uint64_t cpu_ns;           // host CPU time spent running the task
+} task_t;
+
+static task_t _tasks[MAX_TASKS];
+static task_t * _current = NULL;
+static ucontext_t _scheduler;
+static uint64_t _order = 0;
+static const task_t * _last_run = NULL;
+static uint32_t _switches = 0;
+static queue_t * _queues = NULL;
+
+static int64_t _deadline(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? NO_DEADLINE : ((int64_t)xTaskGetTickCount() + ticks) * TICK_US;
+}
+
+static uint64_t _host_cpu_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void _release(task_t * task)
+{
+    if (task == _last_run)
+    {
+        _last_run = NULL;
+    }
+    free(task->stack);
+    memset(task, 0, sizeof(*task));
+}
+
+static void _switch_to_scheduler(void)
+{
+    task_t * task = _current;
+    swapcontext(&task->context, &_scheduler);
+}
+
+// Let the scheduler pick again. The caller stays ready, behind others of the same priority.
+static void _yield_current(void)
+{
+    _current->order = ++_order;
+    _switch_to_scheduler();
+}
+
+static task_t * _highest_ready(void)
+{
+    task_t * best = NULL;
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        task_t * task = &_tasks[i];
+        if (task->state == TASK_READY
+            && (best == NULL || task->priority > best->priority || (task->priority == best->priority && task->order < best->order)))
+        {
+            best = task;
+        }
+    }
+    return best;
+}
+
+static bool _preempted(void)
+{
+    task_t * next = _highest_ready();
+    return _current != NULL && next != NULL && next != _current && next->priority > _current->priority;
+}
+
+static void _make_ready(task_t * task)
+{
+    task->state = TASK_READY;
+    task->wait = WAIT_NONE;
+    task->wait_queue = NULL;
+    task->order = ++_order;
+    if (_current != NULL && task != _current && task->priority > _current->priority)
+    {
+        _yield_current();
+    }
+}
+
+// Block the current task. Returns false if the deadline passed first.
+static bool _block(wait_t wait, const queue_t * queue, int64_t deadline)
+{
+    task_t * task = _current;
+    task->state = TASK_BLOCKED;
+    task->wait = wait;
+    task->wait_queue = queue;
+    task->deadline = deadline;
+    task->timed_out = false;
+    task->order = ++_order;
+    _switch_to_scheduler();
+    return !task->timed_out;
+}
+
+static void _wake_expired(void)
+{
+    int64_t now = vclock_now();
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        task_t * task = &_tasks[i];
+        if (task->state == TASK_BLOCKED && task->deadline <= now)
+        {
+            task->timed_out = true;
+            task->state = TASK_READY;
+            task->wait = WAIT_NONE;
+            task->wait_queue = NULL;
+            task->order = ++_order;
+        }
+    }
+}
+
+static int64_t _earliest_deadline(void)
+{
+    int64_t earliest = NO_DEADLINE;
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        if (_tasks[i].state == TASK_BLOCKED && _tasks[i].deadline < earliest)
+        {
+            earliest = _tasks[i].deadline;
+        }
+    }
+    return earliest;
+}
+
+static void _entry(void)
+{
+    task_t * task = _current;
+    task->function(task->parameters);
+    ESP_LOGE(TAG, "task %s returned", task->name);
+    vTaskDelete(NULL);
+}
+
+void rtos_sim_reset(void)
+{
+    assert(_current == NULL);
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        _release(&_tasks[i]);
+    }
+    while (_queues != NULL)
+    {
+        queue_t * next = _queues->next;
+        free(_queues->storage);
+        free(_queues);
+        _queues = next;
+    }
+    _order = 0;
+    _last_run = NULL;
+    _switches = 0;
+}
+
+void rtos_sim_run_until(int64_t end_us)
+{
+    assert(_current == NULL);
+    while (vclock_now() <= end_us)
+    {
+        _wake_expired();
+        task_t * next = _highest_ready();
+        if (next != NULL)
+        {
+            if (next != _last_run)
+            {
+                ++_switches;
+                _last_run = next;
+            }
+            _current = next;
+            uint64_t start = _host_cpu_ns();
+            swapcontext(&_scheduler, &next->context);
+            next->cpu_ns += _host_cpu_ns() - start;
+            _current = NULL;
+            for (size_t i = 0; i < MAX_TASKS; ++i)
+            {
+                if (_tasks[i].state == TASK_DELETED)
+                {
+                    _release(&_tasks[i]);
+                }
+            }
+            continue;
+        }
+
+        int64_t deadline = _earliest_deadline();
+        if (deadline > end_us)
+        {
+            vclock_advance(end_us - vclock_now());
+            break;
+        }
+        vclock_advance(deadline - vclock_now());
+    }
+}
+
+void rtos_sim_run_for(int64_t duration_us)
+{
+    rtos_sim_run_until(vclock_now() + duration_us);
+}
+
+void rtos_sim_block_us(uint32_t duration_us)
+{
+    if (_current == NULL)
+    {
+        vclock_advance(duration_us);
+        return;
+    }
+    _block(WAIT_DELAY, NULL, vclock_now() + duration_us);
+}
+
+void rtos_sim_busy_us(uint32_t duration_us)
+{
+    int64_t remaining = duration_us;
+    while (remaining > 0)
+    {
+        int64_t step = remaining;
+        int64_t deadline = _earliest_deadline();
+        if (_current != NULL && deadline - vclock_now() < step)
+        {
+            step = deadline > vclock_now() ? deadline - vclock_now() : 0;
+        }
+        vclock_advance(step);
+        remaining -= step;
+        _wake_expired();
+        if (_preempted())
+        {
+            _yield_current();
+        }
+    }
+}
+
+uint32_t rtos_sim_stack_bytes(void)
+{
+    uint32_t total = 0;
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        if (_tasks[i].state == TASK_READY || _tasks[i].state == TASK_BLOCKED)
+        {
+            total += _tasks[i].stack_depth;
+        }
+    }
+    return total;
+}
+
+bool rtos_sim_task_stack(const char * name, uint32_t * requested, uint32_t * host_used)
+{
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        const task_t * task = &_tasks[i];
+        if ((task->state == TASK_READY || task->state == TASK_BLOCKED) && strncmp(task->name, name, MAX_NAME_LEN - 1) == 0)
+        {
+            // the stack grows down from the top of the allocation
+            const uint8_t * stack = task->stack;
+            size_t untouched = 0;
+            while (untouched < HOST_STACK_SIZE && stack[untouched] == STACK_FILL)
+            {
+                ++untouched;
+            }
+            *requested = task->stack_depth;
+            *host_used = HOST_STACK_SIZE - untouched;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool rtos_sim_task_cpu(const char * name, uint64_t * host_ns)
+{
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        const task_t * task = &_tasks[i];
+        if ((task->state == TASK_READY || task->state == TASK_BLOCKED) && strncmp(task->name, name, MAX_NAME_LEN - 1) == 0)
+        {
+            *host_ns = task->cpu_ns;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t rtos_sim_context_switches(void)
+{
+    return _switches;
+}
+
+const char * rtos_sim_current_name(void)
+{
+    return _current ? _current->name : NULL;
+}
+
+// Tasks
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char * name, uint32_t stack_depth, void * parameters,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core_id)
+{
+    task_t * task = NULL;
+    for (size_t i = 0; task == NULL && i < MAX_TASKS; ++i)
+    {
+        task = _tasks[i].state == TASK_UNUSED ? &_tasks[i] : NULL;
+    }
+    if (task == NULL)
+    {
+        ESP_LOGE(TAG, "no room for task %s", name);
+        return pdFAIL;
+    }
+
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->priority = priority;
+    task->stack_depth = stack_depth;
+    task->function = function;
+    task->parameters = parameters;
+    task->stack = malloc(HOST_STACK_SIZE);
+    memset(task->stack, STACK_FILL, HOST_STACK_SIZE);
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = HOST_STACK_SIZE;
+    task->context.uc_link = NULL;
+    makecontext(&task->context, _entry, 0);
+
+    if (handle != NULL)
+    {
+        *handle = task;
+    }
+    _make_ready(task);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char * name, uint32_t stack_depth, void * parameters,
+                       UBaseType_t priority, TaskHandle_t * handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, parameters, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    task_t * task = handle != NULL ? (task_t *)handle : _current;
+    assert(task != NULL);
+    if (task == _current)
+    {
+        task->state = TASK_DELETED;
+        _switch_to_scheduler();
+        abort();   // a deleted task is never resumed
+    }
+    _release(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (_current == NULL)
+    {
+        vclock_advance(ticks * TICK_US);
+    }
+    else if (ticks == 0)
+    {
+        taskYIELD();
+    }
+    else
+    {
+        _block(WAIT_DELAY, NULL, _deadline(ticks));
+    }
+}
+
+void vTaskDelayUntil(TickType_t * previous_wake_time, TickType_t increment)
+{
+    TickType_t next = *previous_wake_time + increment;
+    *previous_wake_time = next;
+    if ((int32_t)(next - xTaskGetTickCount()) > 0)
+    {
+        if (_current == NULL)
+        {
+            vclock_advance(next * TICK_US - vclock_now());
+        }
+        else
+        {
+            _block(WAIT_DELAY, NULL, (int64_t)next * TICK_US);
+        }
+    }
+}
+
+void taskYIELD(void)
+{
+    if (_current != NULL)
+    {
+        _yield_current();
+    }
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    UBaseType_t count = 0;
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        count += _tasks[i].state == TASK_READY || _tasks[i].state == TASK_BLOCKED ? 1 : 0;
+    }
+    return count;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+    // stack usage on the host says nothing about the device, so report the whole stack as free
+    task_t * task = handle != NULL ? (task_t *)handle : _current;
+    return task != NULL ? task->stack_depth : 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return _current;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    task_t * task = _current;
+    assert(task != NULL);
+    if (task->notify == 0 && ticks_to_wait > 0)
+    {
+        _block(WAIT_NOTIFY, NULL, _deadline(ticks_to_wait));
+    }
+    uint32_t value = task->notify;
+    if (value > 0)
+    {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    task_t * task = (task_t *)handle;
+    ++task->notify;
+    if (task->state == TASK_BLOCKED && task->wait == WAIT_NOTIFY)
+    {
+        _make_ready(task);
+    }
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t * higher_priority_task_woken)
+{
+    // the ISR is modelled as running in the interrupted task, which is pre-empted on return
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    xTaskNotifyGive(handle);
+}
+
+// Queues and semaphores
+
+static task_t * _waiter(const queue_t * queue, wait_t wait)
+{
+    task_t * best = NULL;
+    for (size_t i = 0; i < MAX_TASKS; ++i)
+    {
+        task_t * task = &_tasks[i];
+        if (task->state == TASK_BLOCKED && task->wait == wait && task->wait_queue == queue
+            && (best == NULL || task->priority > best->priority || (task->priority == best->priority && task->order < best->order)))
+        {
+            best = task;
+        }
+    }
+    return best;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    queue_t * queue = calloc(1, sizeof(*queue));
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->storage = item_size > 0 ? calloc(length, item_size) : NULL;
+    queue->next = _queues;
+    _queues = queue;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t handle)
+{
+    for (queue_t ** link = &_queues; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == handle)
+        {
+            queue_t * queue = *link;
+            *link = queue->next;
+            free(queue->storage);
+            free(queue);
+            return;
+        }
+    }
+}
+
+static bool _put(queue_t * queue, const void * item)
+{
+    if (queue->count >= queue->length)
+    {
+        return false;
+    }
+    if (queue->item_size > 0)
+    {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+    }
+    ++queue->count;
+    return true;
+}
+
+static bool _get(queue_t * queue, void * item)
+{
+    if (queue->count == 0)
+    {
+        return false;
+    }
+    if (queue->item_size > 0)
+    {
+        memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    --queue->count;
+    return true;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t handle, const void * item, TickType_t ticks_to_wait)
+{
+    queue_t * queue = (queue_t *)handle;
+    int64_t deadline = _deadline(ticks_to_wait);
+    while (!_put(queue, item))
+    {
+        if (ticks_to_wait == 0 || _current == NULL || !_block(WAIT_SEND, queue, deadline))
+        {
+            return pdFALSE;
+        }
+    }
+    task_t * receiver = _waiter(queue, WAIT_RECEIVE);
+    if (receiver != NULL)
+    {
+        _make_ready(receiver);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xQueueSendToBackFromISR(QueueHandle_t handle, const void * item, BaseType_t * higher_priority_task_woken)
+{
+    if (higher_priority_task_woken != NULL)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+    return xQueueSendToBack(handle, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void * item, TickType_t ticks_to_wait)
+{
+    queue_t * queue = (queue_t *)handle;
+    int64_t deadline = _deadline(ticks_to_wait);
+    while (!_get(queue, item))
+    {
+        if (ticks_to_wait == 0 || _current == NULL || !_block(WAIT_RECEIVE, queue, deadline))
+        {
+            return pdFALSE;
+        }
+    }
+    task_t * sender = _waiter(queue, WAIT_SEND);
+    if (sender != NULL)
+    {
+        _make_ready(sender);
+    }
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle)
+{
+    return ((const queue_t *)handle)->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t mutex = xQueueCreate(1, 0);
+    xSemaphoreGive(mutex);
+    return mutex;
+}
+
+void ets_delay_us(uint32_t us)
+{
+    rtos_sim_busy_us(us);
+}
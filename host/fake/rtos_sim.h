@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file rtos_sim.h
+ * @brief Virtual-time scheduler behind the host FreeRTOS task, queue and semaphore API.
+ *
+ * Each task runs on its own stack on the host thread and switches only when it blocks, is
+ * pre-empted by a higher-priority task that it readied, or is deleted. Running code takes no
+ * virtual time; time moves when every task is blocked (to the next wake-up) or when a task
+ * models work with rtos_sim_block_us() (waiting on a peripheral, as i2c_master_cmd_begin does)
+ * or rtos_sim_busy_us() (busy-waiting on the CPU, as ets_delay_us does).
+ *
+ * This is a single-core model: tasks pinned to the second core of the ESP32 compete for the
+ * same CPU here. As no code takes CPU time unless it says so, that only matters for busy waits.
+ */
+
+#ifndef RTOS_SIM_H
+#define RTOS_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Delete all tasks and queues. The virtual clock is left alone.
+void rtos_sim_reset(void);
+
+// Run tasks until the virtual clock reaches end_us, or until no task can ever run again
+void rtos_sim_run_until(int64_t end_us);
+
+// Run tasks for the given number of virtual microseconds
+void rtos_sim_run_for(int64_t duration_us);
+
+// Block the calling task for a number of microseconds, letting other tasks run.
+// Outside a task the clock is simply advanced.
+void rtos_sim_block_us(uint32_t duration_us);
+
+// Hold the CPU for a number of microseconds. Higher-priority tasks that wake in the meantime
+// pre-empt the caller, which then finishes its remaining time once it runs again.
+void rtos_sim_busy_us(uint32_t duration_us);
+
+// Stack bytes requested by the tasks currently alive, as allocated on the device
+uint32_t rtos_sim_stack_bytes(void);
+
+// Stack bytes requested for the named live task (matched on the stored, truncated name), as allocated on the device, and the peak host
+// stack it has used so far. The host figure is x86-64 code with host libraries, so it compares
+// tasks with each other, not with the device. Returns false if there is no such task.
+bool rtos_sim_task_stack(const char * name, uint32_t * requested, uint32_t * host_used);
+
+// Host CPU time the named live task has spent running, in nanoseconds. This includes the host
+// models it calls into, such as the bus and device models, and is not a device figure.
+// Returns false if there is no such task.
+bool rtos_sim_task_cpu(const char * name, uint64_t * host_ns);
+
+// Number of times a different task has been switched in since the last reset
+uint32_t rtos_sim_context_switches(void);
+
+// Name of the task that is running, or NULL outside any task
+const char * rtos_sim_current_name(void);
+
+#endif // RTOS_SIM_H
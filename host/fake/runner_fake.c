@@ -0,0 +1,82 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "runner_fake.h"
+
+typedef struct
+{
+    coroutine_func_t func;
+    void * context;
+    coroutine_t co;
+} slot_t;
+
+static slot_t _slots[COROUTINE_RUNNER_MAX];
+static size_t _num_slots = 0;
+
+void runner_fake_reset(void)
+{
+    _num_slots = 0;
+}
+
+void runner_fake_run(void)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    for (size_t i = 0; i < _num_slots; ++i)
+    {
+        slot_t * slot = &_slots[i];
+        while (!CO_IS_DONE(&slot->co) && slot->func(&slot->co, slot->context, now) == CO_YIELDED)
+        {
+            // a yielded coroutine is ready to run again immediately
+        }
+    }
+}
+
+void coroutine_runner_init(UBaseType_t priority)
+{
+}
+
+void coroutine_runner_delete(void)
+{
+    _num_slots = 0;
+}
+
+bool coroutine_runner_start(const char * name, coroutine_func_t func, void * context)
+{
+    if (_num_slots >= COROUTINE_RUNNER_MAX)
+    {
+        return false;
+    }
+    slot_t * slot = &_slots[_num_slots++];
+    slot->func = func;
+    slot->context = context;
+    CO_INIT(&slot->co);
+    return true;
+}
+
+void coroutine_runner_wake(void)
+{
+}
@@ -0,0 +1,220 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The SMBus protocols used by the application, built from I2C command links in the same way
+ * as the esp32-smbus component, so that they run on the simulated bus with the same framing.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/i2c.h"
+#include "smbus.h"
+
+#define WRITE_BIT  I2C_MASTER_WRITE
+#define READ_BIT   I2C_MASTER_READ
+#define ACK_CHECK  true
+
+static bool _valid(const smbus_info_t * smbus_info)
+{
+    return smbus_info != NULL && smbus_info->init;
+}
+
+static esp_err_t _run(const smbus_info_t * smbus_info, i2c_cmd_handle_t cmd)
+{
+    esp_err_t err = i2c_master_cmd_begin(smbus_info->i2c_port, cmd, smbus_info->timeout);
+    i2c_cmd_link_delete(cmd);
+    return err;
+}
+
+smbus_info_t * smbus_malloc(void)
+{
+    return calloc(1, sizeof(smbus_info_t));
+}
+
+void smbus_free(smbus_info_t ** smbus_info)
+{
+    if (smbus_info != NULL)
+    {
+        free(*smbus_info);
+        *smbus_info = NULL;
+    }
+}
+
+esp_err_t smbus_init(smbus_info_t * smbus_info, i2c_port_t i2c_port, i2c_address_t address)
+{
+    if (smbus_info == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    smbus_info->i2c_port = i2c_port;
+    smbus_info->address = address;
+    smbus_info->timeout = 1000 / portTICK_RATE_MS;
+    smbus_info->init = true;
+    return ESP_OK;
+}
+
+esp_err_t smbus_set_timeout(smbus_info_t * smbus_info, uint32_t timeout)
+{
+    if (!_valid(smbus_info))
+    {
+        return ESP_FAIL;
+    }
+    smbus_info->timeout = timeout;
+    return ESP_OK;
+}
+
+esp_err_t smbus_send_byte(const smbus_info_t * smbus_info, uint8_t data)
+{
+    if (!_valid(smbus_info))
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, data, ACK_CHECK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_receive_byte(const smbus_info_t * smbus_info, uint8_t * data)
+{
+    if (!_valid(smbus_info) || data == NULL)
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | READ_BIT, ACK_CHECK);
+    i2c_master_read_byte(cmd, data, I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_write_byte(const smbus_info_t * smbus_info, uint8_t command, uint8_t data)
+{
+    if (!_valid(smbus_info))
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_write_byte(cmd, data, ACK_CHECK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_write_word(const smbus_info_t * smbus_info, uint8_t command, uint16_t data)
+{
+    if (!_valid(smbus_info))
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_write_byte(cmd, data & 0xff, ACK_CHECK);
+    i2c_master_write_byte(cmd, data >> 8, ACK_CHECK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_read_byte(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data)
+{
+    if (!_valid(smbus_info) || data == NULL)
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | READ_BIT, ACK_CHECK);
+    i2c_master_read_byte(cmd, data, I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_read_word(const smbus_info_t * smbus_info, uint8_t command, uint16_t * data)
+{
+    if (!_valid(smbus_info) || data == NULL)
+    {
+        return ESP_FAIL;
+    }
+    uint8_t bytes[2] = { 0 };
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | READ_BIT, ACK_CHECK);
+    i2c_master_read_byte(cmd, &bytes[0], I2C_MASTER_ACK);
+    i2c_master_read_byte(cmd, &bytes[1], I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    esp_err_t err = _run(smbus_info, cmd);
+    *data = bytes[0] | bytes[1] << 8;
+    return err;
+}
+
+esp_err_t smbus_i2c_write_block(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data, size_t len)
+{
+    if (!_valid(smbus_info) || data == NULL)
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_write(cmd, data, len, ACK_CHECK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
+
+esp_err_t smbus_i2c_read_block(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data, size_t len)
+{
+    if (!_valid(smbus_info) || data == NULL || len == 0)
+    {
+        return ESP_FAIL;
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | WRITE_BIT, ACK_CHECK);
+    i2c_master_write_byte(cmd, command, ACK_CHECK);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, smbus_info->address << 1 | READ_BIT, ACK_CHECK);
+    if (len > 1)
+    {
+        i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK);
+    }
+    i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    return _run(smbus_info, cmd);
+}
@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The parts of the esp32-tsl2561 component used by sensor_light.c. As in the component,
+ * tsl2561_read() powers the device up, blocks the calling task for one integration period and
+ * then reads both channels, so whatever lock the caller holds is held for the whole period.
+ */
+
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tsl2561.h"
+
+#define COMMAND_CMD       0x80
+#define COMMAND_WORD      0x20
+#define REG_CONTROL       0x00
+#define REG_TIMING        0x01
+#define REG_ID            0x0a
+#define REG_DATA0LOW      0x0c
+#define REG_DATA1LOW      0x0e
+#define CONTROL_POWER_ON  0x03
+#define CONTROL_POWER_OFF 0x00
+
+// integration period plus margin, in milliseconds, by integration time
+static uint32_t _integration_ms(tsl2561_integration_time_t integration_time)
+{
+    switch (integration_time)
+    {
+    case TSL2561_INTEGRATION_TIME_13MS:  return 15;
+    case TSL2561_INTEGRATION_TIME_101MS: return 102;
+    default:                             return 403;
+    }
+}
+
+tsl2561_info_t * tsl2561_malloc(void)
+{
+    return calloc(1, sizeof(tsl2561_info_t));
+}
+
+void tsl2561_free(tsl2561_info_t ** tsl2561_info)
+{
+    if (tsl2561_info != NULL)
+    {
+        free(*tsl2561_info);
+        *tsl2561_info = NULL;
+    }
+}
+
+esp_err_t tsl2561_init(tsl2561_info_t * tsl2561_info, smbus_info_t * smbus_info)
+{
+    if (tsl2561_info == NULL || smbus_info == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tsl2561_info->smbus_info = smbus_info;
+
+    uint8_t id = 0;
+    esp_err_t err = smbus_read_byte(smbus_info, COMMAND_CMD | REG_ID, &id);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    tsl2561_info->device_type = id >> 4;
+    tsl2561_info->revision = id & 0x0f;
+    if (tsl2561_info->device_type != TSL2561_DEVICE_TYPE_TSL2561T_FN_CL && tsl2561_info->device_type != TSL2561_DEVICE_TYPE_TSL2561CS)
+    {
+        return ESP_FAIL;
+    }
+
+    err = smbus_write_byte(smbus_info, COMMAND_CMD | REG_CONTROL, CONTROL_POWER_OFF);
+    tsl2561_info->init = err == ESP_OK;
+    return err;
+}
+
+esp_err_t tsl2561_set_integration_time_and_gain(tsl2561_info_t * tsl2561_info, tsl2561_integration_time_t integration_time, tsl2561_gain_t gain)
+{
+    if (tsl2561_info == NULL || !tsl2561_info->init)
+    {
+        return ESP_FAIL;
+    }
+    esp_err_t err = smbus_write_byte(tsl2561_info->smbus_info, COMMAND_CMD | REG_TIMING, integration_time | gain);
+    if (err == ESP_OK)
+    {
+        tsl2561_info->integration_time = integration_time;
+        tsl2561_info->gain = gain;
+    }
+    return err;
+}
+
+esp_err_t tsl2561_read(const tsl2561_info_t * tsl2561_info, tsl2561_visible_t * visible, tsl2561_infrared_t * infrared)
+{
+    if (tsl2561_info == NULL || !tsl2561_info->init || visible == NULL || infrared == NULL)
+    {
+        return ESP_FAIL;
+    }
+    const smbus_info_t * smbus_info = tsl2561_info->smbus_info;
+    esp_err_t err = smbus_write_byte(smbus_info, COMMAND_CMD | REG_CONTROL, CONTROL_POWER_ON);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    // rounded up to whole ticks, so that the integration has always completed
+    vTaskDelay((_integration_ms(tsl2561_info->integration_time) + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+
+    uint16_t ch0 = 0;
+    uint16_t ch1 = 0;
+    err = smbus_read_word(smbus_info, COMMAND_CMD | COMMAND_WORD | REG_DATA0LOW, &ch0);
+    if (err == ESP_OK)
+    {
+        err = smbus_read_word(smbus_info, COMMAND_CMD | COMMAND_WORD | REG_DATA1LOW, &ch1);
+    }
+    smbus_write_byte(smbus_info, COMMAND_CMD | REG_CONTROL, CONTROL_POWER_OFF);
+
+    *visible = ch0 > ch1 ? ch0 - ch1 : 0;
+    *infrared = ch1;
+    return err;
+}
+
+// Lux from the TSL2561 datasheet's integer approximation, for the T, FN and CL packages
+uint32_t tsl2561_compute_lux(const tsl2561_info_t * tsl2561_info, tsl2561_visible_t visible, tsl2561_infrared_t infrared)
+{
+    uint32_t ch0 = visible + infrared;
+    uint32_t ch1 = infrared;
+
+    // scale to the 402 ms, 16x reference
+    uint32_t scale = tsl2561_info->integration_time == TSL2561_INTEGRATION_TIME_13MS ? 0x7517
+                   : tsl2561_info->integration_time == TSL2561_INTEGRATION_TIME_101MS ? 0x0fe7 : (1 << 10);
+    if (tsl2561_info->gain == TSL2561_GAIN_1X)
+    {
+        scale <<= 4;
+    }
+    ch0 = (ch0 * scale) >> 10;
+    ch1 = (ch1 * scale) >> 10;
+
+    uint32_t ratio = ch0 != 0 ? ((ch1 << 10) / ch0 + 1) >> 1 : 0;
+    uint32_t b = 0;
+    uint32_t m = 0;
+    if (ratio <= 0x0040)      { b = 0x01f2; m = 0x01be; }
+    else if (ratio <= 0x0080) { b = 0x0214; m = 0x02d1; }
+    else if (ratio <= 0x00c0) { b = 0x023f; m = 0x037b; }
+    else if (ratio <= 0x0100) { b = 0x0270; m = 0x03fe; }
+    else if (ratio <= 0x0138) { b = 0x016f; m = 0x01fc; }
+    else if (ratio <= 0x019a) { b = 0x00d2; m = 0x00fb; }
+    else if (ratio <= 0x029a) { b = 0x0018; m = 0x0012; }
+
+    uint32_t a = ch0 * b;
+    uint32_t c = ch1 * m;
+    uint32_t lux = a > c ? a - c : 0;
+    return (lux + (1 << 13)) >> 14;
+}
@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+
+#include "vclock.h"
+#include "i2c_sim.h"
+#include "tsl2561_device.h"
+
+#define COMMAND_CMD       0x80
+#define COMMAND_WORD      0x20
+#define COMMAND_ADDRESS   0x0f
+
+#define REG_CONTROL       0x00
+#define REG_TIMING        0x01
+#define REG_ID            0x0a
+#define REG_DATA0LOW      0x0c
+#define REG_DATA0HIGH     0x0d
+#define REG_DATA1LOW      0x0e
+#define REG_DATA1HIGH     0x0f
+
+#define CONTROL_POWER_ON  0x03
+#define TIMING_INTEG      0x03
+
+// nominal integration times in microseconds, by TIMING INTEG
+static const int64_t INTEGRATION_US[] = { 13700, 101000, 402000, 0 };
+
+typedef struct
+{
+    uint8_t command;
+    bool command_set;
+    uint8_t control;
+    uint8_t timing;
+    int64_t power_up_time;     // microseconds
+    uint16_t ch0;
+    uint16_t ch1;
+    tsl2561_device_stats_t stats;
+} tsl2561_device_t;
+
+static tsl2561_device_t _device = { 0 };
+
+static bool _integrated(const tsl2561_device_t * device)
+{
+    int64_t integration = INTEGRATION_US[device->timing & TIMING_INTEG];
+    return (device->control & CONTROL_POWER_ON) == CONTROL_POWER_ON && integration > 0
+           && vclock_now() - device->power_up_time >= integration;
+}
+
+static bool _start(void * context, bool read)
+{
+    tsl2561_device_t * device = (tsl2561_device_t *)context;
+    device->command_set = read;
+    return true;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    tsl2561_device_t * device = (tsl2561_device_t *)context;
+    if (!device->command_set)
+    {
+        device->command = value;
+        device->command_set = true;
+        return (value & COMMAND_CMD) != 0;
+    }
+
+    uint8_t reg = device->command & COMMAND_ADDRESS;
+    switch (reg)
+    {
+    case REG_CONTROL:
+        if ((value & CONTROL_POWER_ON) == CONTROL_POWER_ON && (device->control & CONTROL_POWER_ON) != CONTROL_POWER_ON)
+        {
+            device->power_up_time = vclock_now();
+            ++device->stats.power_ups;
+        }
+        device->control = value & CONTROL_POWER_ON;
+        break;
+    case REG_TIMING:
+        device->timing = value;
+        break;
+    default:
+        break;
+    }
+    if (device->command & COMMAND_WORD)
+    {
+        device->command = (device->command & ~COMMAND_ADDRESS) | ((reg + 1) & COMMAND_ADDRESS);
+    }
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    tsl2561_device_t * device = (tsl2561_device_t *)context;
+    uint8_t reg = device->command & COMMAND_ADDRESS;
+    if (device->command & COMMAND_WORD)
+    {
+        device->command = (device->command & ~COMMAND_ADDRESS) | ((reg + 1) & COMMAND_ADDRESS);
+    }
+
+    bool integrated = _integrated(device);
+    if (reg == REG_DATA0LOW || reg == REG_DATA1LOW)
+    {
+        integrated ? ++device->stats.samples : ++device->stats.early_reads;
+    }
+
+    switch (reg)
+    {
+    case REG_CONTROL:   return device->control;
+    case REG_TIMING:    return device->timing;
+    case REG_ID:        return TSL2561_DEVICE_ID;
+    case REG_DATA0LOW:  return integrated ? device->ch0 & 0xff : 0;
+    case REG_DATA0HIGH: return integrated ? device->ch0 >> 8 : 0;
+    case REG_DATA1LOW:  return integrated ? device->ch1 & 0xff : 0;
+    case REG_DATA1HIGH: return integrated ? device->ch1 >> 8 : 0;
+    default:            return 0;
+    }
+}
+
+static const i2c_sim_device_t TSL2561_DEVICE = { _start, _write, _read, NULL };
+
+void tsl2561_device_attach(i2c_port_t port, uint8_t address)
+{
+    uint16_t ch0 = _device.ch0;
+    uint16_t ch1 = _device.ch1;
+    _device = (tsl2561_device_t){ .timing = 0x02, .ch0 = ch0, .ch1 = ch1 };
+    i2c_sim_attach(port, address, &TSL2561_DEVICE, &_device);
+}
+
+void tsl2561_device_set_counts(uint16_t ch0, uint16_t ch1)
+{
+    _device.ch0 = ch0;
+    _device.ch1 = ch1;
+}
+
+const tsl2561_device_stats_t * tsl2561_device_stats(void)
+{
+    return &_device.stats;
+}
@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file tsl2561_device.h
+ * @brief Register model of the TSL2561 light sensor on the simulated I2C bus.
+ *
+ * The first byte of a write is the COMMAND byte (CMD bit set, WORD bit for two-byte
+ * accesses, register address in the low nibble). CONTROL powers the ADCs up and down, TIMING
+ * selects the integration time, and ID reads the part number. DATA0 and DATA1 hold the last
+ * completed integration of each channel: they read zero until one integration period has
+ * passed since power-up, as on the device.
+ */
+
+#ifndef TSL2561_DEVICE_H
+#define TSL2561_DEVICE_H
+
+#include <stdint.h>
+
+#include "driver/i2c.h"
+
+#define TSL2561_DEVICE_ID  (0x50)    // TSL2561T/FN/CL, revision 0
+
+typedef struct
+{
+    uint32_t power_ups;
+    uint32_t samples;          // data reads that returned a completed integration
+    uint32_t early_reads;      // data reads before any integration had completed
+} tsl2561_device_stats_t;
+
+void tsl2561_device_attach(i2c_port_t port, uint8_t address);
+
+// ADC counts returned by each completed integration: channel 0 (visible and infrared) and
+// channel 1 (infrared)
+void tsl2561_device_set_counts(uint16_t ch0, uint16_t ch1);
+
+const tsl2561_device_stats_t * tsl2561_device_stats(void);
+
+#endif // TSL2561_DEVICE_H
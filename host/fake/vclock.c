@@ -0,0 +1,74 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "vclock.h"
+
+static int64_t _uptime = 0;        // microseconds
+static int64_t _wall_offset = 0;   // seconds
+
+void vclock_reset(time_t wall_at_boot)
+{
+    _uptime = 0;
+    _wall_offset = wall_at_boot;
+}
+
+int64_t vclock_now(void)
+{
+    return _uptime;
+}
+
+void vclock_advance(int64_t microseconds)
+{
+    _uptime += microseconds;
+}
+
+void vclock_step_wall(int64_t seconds)
+{
+    _wall_offset += seconds;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return _uptime;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(_uptime / (1000 * portTICK_PERIOD_MS));
+}
+
+// replaces the C library time() for code linked into the harness
+time_t time(time_t * t)
+{
+    time_t now = (time_t)(_wall_offset + _uptime / 1000000);
+    if (t != NULL)
+    {
+        *t = now;
+    }
+    return now;
+}
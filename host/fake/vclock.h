@@ -0,0 +1,52 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file vclock.h
+ * @brief Virtual clock for the host harness.
+ *
+ * Uptime starts at zero and only moves when a test advances it, so any amount of simulated
+ * time runs as fast as the code under test allows. esp_timer_get_time(), xTaskGetTickCount()
+ * and time() all follow this clock. The wall clock is uptime plus an offset, which a test may
+ * step to model SNTP corrections.
+ */
+
+#ifndef VCLOCK_H
+#define VCLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Restart uptime from zero with the wall clock reading wall_at_boot
+void vclock_reset(time_t wall_at_boot);
+
+// Microseconds since boot
+int64_t vclock_now(void);
+
+void vclock_advance(int64_t microseconds);
+
+// Step the wall clock by the given number of seconds without changing uptime
+void vclock_step_wall(int64_t seconds);
+
+#endif // VCLOCK_H
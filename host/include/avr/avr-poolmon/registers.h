@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file registers.h
+ * @brief Stand-in for the register map in the avr-poolmon submodule, used only when the
+ *        submodule is not checked out (the application includes the real file first).
+ *
+ * The names are those used by avr_support.c and avr_sim.c. The numbering is not the
+ * firmware's: it only keeps CONTROL..COUNT_PP_MAN contiguous, as the block read requires.
+ */
+
+#ifndef AVR_POOLMON_REGISTERS_H
+#define AVR_POOLMON_REGISTERS_H
+
+#define AVR_REGISTER_CONTROL        0x00
+#define AVR_REGISTER_STATUS         0x01
+#define AVR_REGISTER_SCRATCH        0x02
+#define AVR_REGISTER_COUNT_CP       0x03
+#define AVR_REGISTER_COUNT_PP       0x04
+#define AVR_REGISTER_COUNT_BUZZER   0x05
+#define AVR_REGISTER_COUNT_CP_MODE  0x06
+#define AVR_REGISTER_COUNT_CP_MAN   0x07
+#define AVR_REGISTER_COUNT_PP_MODE  0x08
+#define AVR_REGISTER_COUNT_PP_MAN   0x09
+#define AVR_REGISTER_ID             0x0a
+#define AVR_REGISTER_VERSION        0x0b
+
+// CONTROL
+#define AVR_REGISTER_CONTROL_SSR1    (1 << 0)
+#define AVR_REGISTER_CONTROL_SSR2    (1 << 1)
+#define AVR_REGISTER_CONTROL_BUZZER  (1 << 2)
+
+// STATUS
+#define AVR_REGISTER_STATUS_SW1      (1 << 0)
+#define AVR_REGISTER_STATUS_SW2      (1 << 1)
+#define AVR_REGISTER_STATUS_SW3      (1 << 2)
+#define AVR_REGISTER_STATUS_SW4      (1 << 3)
+#define AVR_REGISTER_STATUS_SSR1     (1 << 4)
+#define AVR_REGISTER_STATUS_SSR2     (1 << 5)
+
+#endif // AVR_POOLMON_REGISTERS_H
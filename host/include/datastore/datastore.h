@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file datastore.h
+ * @brief Host stand-in for the datastore component.
+ *
+ * Implements the datastore API used by the application with a fixed in-memory table.
+ * Every value is timestamped with the virtual clock, so ages and expiries behave as they
+ * do on the device, and set callbacks are invoked synchronously by the setting caller.
+ * Resources need not be added before use. The host-only functions at the end let tests
+ * inspect how often each resource was set.
+ */
+
+#ifndef DATASTORE_H
+#define DATASTORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define DATASTORE_FAKE_MAX_RESOURCES  (256)
+#define DATASTORE_FAKE_MAX_INSTANCES  (32)
+#define DATASTORE_FAKE_STRING_LEN     (256)
+
+#define DATASTORE_INVALID_AGE  (UINT64_MAX)
+
+typedef struct datastore_s datastore_t;
+typedef uint32_t datastore_resource_id_t;
+typedef uint32_t datastore_instance_id_t;
+typedef uint64_t datastore_age_t;   // microseconds
+
+typedef enum
+{
+    DATASTORE_STATUS_UNKNOWN = -1,
+    DATASTORE_STATUS_OK = 0,
+    DATASTORE_STATUS_ERROR_NULL_POINTER,
+    DATASTORE_STATUS_ERROR_INVALID_ID,
+    DATASTORE_STATUS_ERROR_INVALID_INSTANCE,
+    DATASTORE_STATUS_ERROR_INVALID_TYPE,
+} datastore_status_t;
+
+typedef enum
+{
+    DATASTORE_TYPE_INVALID = 0,
+    DATASTORE_TYPE_BOOL,
+    DATASTORE_TYPE_UINT8,
+    DATASTORE_TYPE_UINT32,
+    DATASTORE_TYPE_INT8,
+    DATASTORE_TYPE_INT32,
+    DATASTORE_TYPE_FLOAT,
+    DATASTORE_TYPE_DOUBLE,
+    DATASTORE_TYPE_STRING,
+} datastore_type_t;
+
+typedef struct
+{
+    datastore_type_t type;
+    size_t size;
+    size_t num_instances;
+} datastore_resource_t;
+
+typedef void (*set_callback)(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * context);
+
+datastore_t * datastore_create(void);
+void datastore_free(datastore_t ** datastore);
+
+datastore_resource_t datastore_create_resource(datastore_type_t type, size_t num_instances);
+datastore_resource_t datastore_create_string_resource(size_t size, size_t num_instances);
+datastore_status_t datastore_add_resource(const datastore_t * datastore, datastore_resource_id_t id, datastore_resource_t resource);
+datastore_status_t datastore_set_name(const datastore_t * datastore, datastore_resource_id_t id, const char * name);
+const char * datastore_get_name(const datastore_t * datastore, datastore_resource_id_t id);
+
+datastore_status_t datastore_set_bool(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, bool value);
+datastore_status_t datastore_set_uint8(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint8_t value);
+datastore_status_t datastore_set_uint32(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint32_t value);
+datastore_status_t datastore_set_int8(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, int8_t value);
+datastore_status_t datastore_set_int32(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, int32_t value);
+datastore_status_t datastore_set_float(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, float value);
+datastore_status_t datastore_set_double(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, double value);
+datastore_status_t datastore_set_string(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, const char * value);
+
+datastore_status_t datastore_get_bool(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, bool * value);
+datastore_status_t datastore_get_uint8(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint8_t * value);
+datastore_status_t datastore_get_uint32(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint32_t * value);
+datastore_status_t datastore_get_int8(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, int8_t * value);
+datastore_status_t datastore_get_int32(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, int32_t * value);
+datastore_status_t datastore_get_float(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, float * value);
+datastore_status_t datastore_get_double(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, double * value);
+datastore_status_t datastore_get_string(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, char * value, size_t len);
+
+datastore_status_t datastore_increment(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance);
+datastore_status_t datastore_add(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, uint32_t value);
+
+datastore_status_t datastore_get_age(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, datastore_age_t * age);
+datastore_status_t datastore_add_set_callback(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, set_callback callback, void * context);
+
+void datastore_dump(const datastore_t * datastore);
+size_t datastore_get_ram_usage(const datastore_t * datastore);
+
+// Host only: number of sets (including increments and adds) of any instance of a resource
+uint32_t datastore_fake_set_count(const datastore_t * datastore, datastore_resource_id_t id);
+void datastore_fake_reset_counts(const datastore_t * datastore);
+
+#endif // DATASTORE_H
@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file esp_log.h
+ * @brief Host stand-in for the ESP-IDF logging macros.
+ *
+ * Messages are counted by level, and printed if the level is enabled with the
+ * HOST_LOG environment variable (one of E, W, I, D, V), or for their tag with
+ * esp_log_level_set(). The default prints nothing.
+ */
+
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include <stdint.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+void host_log(esp_log_level_t level, const char * tag, const char * format, ...) __attribute__((format(printf, 3, 4)));
+
+// number of messages logged at the given level since the last reset
+uint32_t host_log_count(esp_log_level_t level);
+void host_log_reset(void);
+
+#define ESP_LOGE(tag, format, ...)  host_log(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  host_log(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  host_log(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  host_log(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  host_log(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+// Print messages from tag up to the given level, as well as those HOST_LOG enables.
+// Only the level of individual tags can be raised; "*" is ignored.
+void esp_log_level_set(const char * tag, esp_log_level_t level);
+
+#endif // ESP_LOG_H
@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS types and port macros. The host harness is single
+ *        threaded - simulated tasks only switch in blocking calls (see rtos_sim.h) - so
+ *        critical sections need no locking. The tick count follows the virtual clock.
+ */
+
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS  10                          // CONFIG_FREERTOS_HZ=100
+#define portTICK_RATE_MS    portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms) / portTICK_PERIOD_MS)
+#define tskIDLE_PRIORITY    0
+
+typedef struct
+{
+    int count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  { 0 }
+#define portENTER_CRITICAL(mux)       ((void)(mux))
+#define portEXIT_CRITICAL(mux)        ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)   ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)    ((void)(mux))
+#define portYIELD_FROM_ISR()
+
+#define IRAM_ATTR
+
+#endif // FREERTOS_H
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file task.h
+ * @brief Host stand-in for the FreeRTOS task API.
+ *
+ * Tasks are implemented by the virtual-time scheduler in rtos_sim.c. The control harness
+ * does not link it and uses only xTaskGetTickCount(), which follows the virtual clock.
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void * TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY  0x7fffffff
+
+TickType_t xTaskGetTickCount(void);
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char * name, uint32_t stack_depth, void * parameters,
+                       UBaseType_t priority, TaskHandle_t * handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char * name, uint32_t stack_depth, void * parameters,
+                                   UBaseType_t priority, TaskHandle_t * handle, BaseType_t core_id);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t * previous_wake_time, TickType_t increment);
+void taskYIELD(void);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+BaseType_t xPortGetCoreID(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t * higher_priority_task_woken);
+
+#endif // TASK_H
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file i2c-lcd1602.h
+ * @brief Host stand-in for the esp32-i2c-lcd1602 component, implemented by fake/i2c_lcd1602.c
+ *        over the host SMBus. As in the component, every PCF8574 port write is its own SMBus
+ *        send-byte, and the strobe and command delays hold the CPU.
+ */
+
+#ifndef I2C_LCD1602_H
+#define I2C_LCD1602_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "smbus.h"
+
+typedef struct
+{
+    bool init;
+    smbus_info_t * smbus_info;
+    uint8_t backlight_flag;
+    uint8_t num_rows;
+    uint8_t num_columns;
+    uint8_t num_visible_columns;
+    uint8_t display_control_flags;
+    uint8_t entry_mode_flags;
+} i2c_lcd1602_info_t;
+
+typedef enum
+{
+    I2C_LCD1602_INDEX_CUSTOM_0 = 0,
+    I2C_LCD1602_INDEX_CUSTOM_1,
+    I2C_LCD1602_INDEX_CUSTOM_2,
+    I2C_LCD1602_INDEX_CUSTOM_3,
+    I2C_LCD1602_INDEX_CUSTOM_4,
+    I2C_LCD1602_INDEX_CUSTOM_5,
+    I2C_LCD1602_INDEX_CUSTOM_6,
+    I2C_LCD1602_INDEX_CUSTOM_7,
+} i2c_lcd1602_custom_index_t;
+
+// CGRAM characters are also shown at codes 8-15, so they can appear in strings
+#define I2C_LCD1602_CHARACTER_CUSTOM_0  0x08
+#define I2C_LCD1602_CHARACTER_CUSTOM_1  0x09
+#define I2C_LCD1602_CHARACTER_CUSTOM_2  0x0a
+#define I2C_LCD1602_CHARACTER_CUSTOM_3  0x0b
+#define I2C_LCD1602_CHARACTER_CUSTOM_4  0x0c
+#define I2C_LCD1602_CHARACTER_CUSTOM_5  0x0d
+#define I2C_LCD1602_CHARACTER_CUSTOM_6  0x0e
+#define I2C_LCD1602_CHARACTER_CUSTOM_7  0x0f
+
+#define I2C_LCD1602_ERROR_CHECK(x) do {                                               \
+        esp_err_t rc = (x);                                                           \
+        if (rc != ESP_OK)                                                             \
+        {                                                                             \
+            ESP_LOGW(TAG, "I2C error %d at %s:%d", rc, __FILE__, __LINE__);           \
+        }                                                                             \
+    } while(0);
+
+i2c_lcd1602_info_t * i2c_lcd1602_malloc(void);
+void i2c_lcd1602_free(i2c_lcd1602_info_t ** i2c_lcd1602_info);
+esp_err_t i2c_lcd1602_init(i2c_lcd1602_info_t * i2c_lcd1602_info, smbus_info_t * smbus_info, bool backlight,
+                           uint8_t num_rows, uint8_t num_columns, uint8_t num_visible_columns);
+esp_err_t i2c_lcd1602_reset(const i2c_lcd1602_info_t * i2c_lcd1602_info);
+esp_err_t i2c_lcd1602_clear(const i2c_lcd1602_info_t * i2c_lcd1602_info);
+esp_err_t i2c_lcd1602_home(const i2c_lcd1602_info_t * i2c_lcd1602_info);
+esp_err_t i2c_lcd1602_move_cursor(const i2c_lcd1602_info_t * i2c_lcd1602_info, uint8_t col, uint8_t row);
+esp_err_t i2c_lcd1602_set_backlight(i2c_lcd1602_info_t * i2c_lcd1602_info, bool enable);
+esp_err_t i2c_lcd1602_define_char(const i2c_lcd1602_info_t * i2c_lcd1602_info, i2c_lcd1602_custom_index_t index, const uint8_t pixelmap[]);
+esp_err_t i2c_lcd1602_write_char(const i2c_lcd1602_info_t * i2c_lcd1602_info, uint8_t chr);
+
+#endif // I2C_LCD1602_H
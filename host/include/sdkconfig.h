@@ -0,0 +1,50 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the configuration generated by menuconfig, with the defaults
+ *        from main/Kconfig.projbuild.
+ */
+
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+#define CONFIG_I2C_MASTER_SCL_GPIO       19
+#define CONFIG_I2C_MASTER_SDA_GPIO       18
+#define CONFIG_AVR_I2C_ADDRESS           0x44
+#define CONFIG_LCD1602_I2C_ADDRESS       0x27
+#define CONFIG_LIGHT_SENSOR_I2C_ADDRESS  0x39
+#define CONFIG_AVR_RESET_GPIO            21
+
+#define CONFIG_DISPLAY_BUTTON_GPIO            32
+#define CONFIG_DISPLAY_ROTARY_ENCODER_A_GPIO  25
+#define CONFIG_DISPLAY_ROTARY_ENCODER_B_GPIO  33
+
+// CONFIG_AVR_ATTENTION is off by default: the attention line builds define it in the Makefile
+#if defined(CONFIG_AVR_ATTENTION)
+#define CONFIG_AVR_ATTENTION_GPIO        34
+#endif
+
+#endif // SDKCONFIG_H
@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file smbus.h
+ * @brief Host stand-in for the esp32-smbus component. fake/smbus.c builds the same I2C
+ *        command links as the component, so every access runs on the simulated bus.
+ */
+
+#ifndef SMBUS_H
+#define SMBUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "driver/i2c.h"
+
+typedef uint16_t i2c_address_t;
+
+typedef struct
+{
+    bool init;
+    i2c_port_t i2c_port;
+    i2c_address_t address;
+    uint32_t timeout;         // ticks
+} smbus_info_t;
+
+smbus_info_t * smbus_malloc(void);
+void smbus_free(smbus_info_t ** smbus_info);
+esp_err_t smbus_init(smbus_info_t * smbus_info, i2c_port_t i2c_port, i2c_address_t address);
+esp_err_t smbus_set_timeout(smbus_info_t * smbus_info, uint32_t timeout);
+esp_err_t smbus_send_byte(const smbus_info_t * smbus_info, uint8_t data);
+esp_err_t smbus_receive_byte(const smbus_info_t * smbus_info, uint8_t * data);
+esp_err_t smbus_write_byte(const smbus_info_t * smbus_info, uint8_t command, uint8_t data);
+esp_err_t smbus_write_word(const smbus_info_t * smbus_info, uint8_t command, uint16_t data);
+esp_err_t smbus_read_byte(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data);
+esp_err_t smbus_read_word(const smbus_info_t * smbus_info, uint8_t command, uint16_t * data);
+esp_err_t smbus_i2c_write_block(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data, size_t len);
+esp_err_t smbus_i2c_read_block(const smbus_info_t * smbus_info, uint8_t command, uint8_t * data, size_t len);
+
+#endif // SMBUS_H
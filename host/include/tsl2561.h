@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file tsl2561.h
+ * @brief Host stand-in for the esp32-tsl2561 component, implemented by fake/tsl2561.c over the
+ *        host SMBus, so that its register accesses and its wait for the integration time run on
+ *        the simulated bus.
+ */
+
+#ifndef TSL2561_H
+#define TSL2561_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "smbus.h"
+
+typedef uint16_t tsl2561_visible_t;
+typedef uint16_t tsl2561_infrared_t;
+
+typedef enum
+{
+    TSL2561_INTEGRATION_TIME_13MS  = 0x00,
+    TSL2561_INTEGRATION_TIME_101MS = 0x01,
+    TSL2561_INTEGRATION_TIME_402MS = 0x02,
+} tsl2561_integration_time_t;
+
+typedef enum
+{
+    TSL2561_GAIN_1X  = 0x00,
+    TSL2561_GAIN_16X = 0x10,
+} tsl2561_gain_t;
+
+typedef enum
+{
+    TSL2561_DEVICE_TYPE_INVALID        = 0xff,
+    TSL2561_DEVICE_TYPE_TSL2560CS      = 0b0000,
+    TSL2561_DEVICE_TYPE_TSL2561CS      = 0b0001,
+    TSL2561_DEVICE_TYPE_TSL2560T_FN_CL = 0b0100,
+    TSL2561_DEVICE_TYPE_TSL2561T_FN_CL = 0b0101,
+} tsl2561_device_type_t;
+
+typedef uint8_t tsl2561_revision_t;
+
+typedef struct
+{
+    bool init;
+    tsl2561_device_type_t device_type;
+    tsl2561_revision_t revision;
+    smbus_info_t * smbus_info;
+    tsl2561_integration_time_t integration_time;
+    tsl2561_gain_t gain;
+} tsl2561_info_t;
+
+tsl2561_info_t * tsl2561_malloc(void);
+void tsl2561_free(tsl2561_info_t ** tsl2561_info);
+esp_err_t tsl2561_init(tsl2561_info_t * tsl2561_info, smbus_info_t * smbus_info);
+esp_err_t tsl2561_set_integration_time_and_gain(tsl2561_info_t * tsl2561_info, tsl2561_integration_time_t integration_time, tsl2561_gain_t gain);
+
+// Power up, wait for one integration period, read both channels and power down
+esp_err_t tsl2561_read(const tsl2561_info_t * tsl2561_info, tsl2561_visible_t * visible, tsl2561_infrared_t * infrared);
+
+uint32_t tsl2561_compute_lux(const tsl2561_info_t * tsl2561_info, tsl2561_visible_t visible, tsl2561_infrared_t infrared);
+
+#endif // TSL2561_H
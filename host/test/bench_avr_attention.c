@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares the AVR task's 250 ms register poll with the attention line and its 5 s safety
+ * poll, over one simulated hour with a switch change at a random point in every minute.
+ * Built with CONFIG_AVR_ATTENTION defined; the 250 ms case is the fallback the task takes
+ * when the GPIO interrupt service cannot be installed.
+ *
+ * Reported per mode, in virtual time on the host simulation (system_harness.h), not on a
+ * device: bus transactions and bus time per hour, register polls per hour (of which
+ * triggered by the attention line), and the latency from the switch change to its value in
+ * the datastore. The control loops and display are not run, so every transaction is the
+ * AVR task's.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "resources.h"
+#include "sdkconfig.h"
+
+#include "vclock.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "avr_sim.h"
+#include "system_harness.h"
+
+#define EVENTS        (60)               // one per simulated minute
+#define EVENT_PERIOD  (60 * 1000)        // milliseconds
+#define TIMEOUT       (10 * 1000)        // milliseconds
+
+typedef struct
+{
+    const char * name;
+    bool attention_line;
+    bool isr_service;
+} poll_mode_t;
+
+static const poll_mode_t MODES[] = {
+    { "250 ms poll",                true,  false },
+    { "attention + 5 s poll",       true,  true  },
+    { "5 s poll, edges lost",       false, true  },
+};
+
+static uint32_t _expected = 0;
+
+static uint32_t _get(const system_harness_t * harness, datastore_resource_id_t id)
+{
+    uint32_t value = 0;
+    datastore_get_uint32(harness->datastore, id, 0, &value);
+    return value;
+}
+
+static bool _switch_seen(const system_harness_t * harness)
+{
+    return _get(harness, RESOURCE_ID_SWITCHES_CP_MODE_VALUE) == _expected;
+}
+
+static int _compare(const void * a, const void * b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int _run_mode(const poll_mode_t * mode)
+{
+    static int64_t latency[EVENTS];
+
+    system_harness_t harness;
+    system_harness_config_t config = { .attention_line = mode->attention_line, .seed = 1 };
+    system_harness_init(&harness, &config);
+    gpio_fake_fail_isr_service(!mode->isr_service);
+
+    // past the first stats publish, so the published counts give the hour's difference
+    system_harness_run(&harness, EVENT_PERIOD);
+    uint32_t polls = _get(&harness, RESOURCE_ID_AVR_COUNT_POLL);
+    uint32_t attentions = _get(&harness, RESOURCE_ID_AVR_COUNT_ATTENTION);
+    uint32_t commands = i2c_sim_stats(0)->commands;
+    uint64_t busy_us = i2c_sim_stats(0)->busy_us;
+
+    srand(1);
+    for (size_t i = 0; i < EVENTS; ++i)
+    {
+        int64_t start = vclock_now();
+        system_harness_run(&harness, rand() % (EVENT_PERIOD - TIMEOUT));
+
+        _expected = !_expected;
+        int64_t changed = vclock_now();
+        avr_sim_set_switches(_expected ? AVR_SIM_SWITCH_CP_MODE : 0);
+        if (!system_harness_run_until(&harness, _switch_seen, TIMEOUT))
+        {
+            fprintf(stderr, "%s: event %zu: switch change not seen\n", mode->name, i);
+            return 1;
+        }
+        latency[i] = vclock_now() - changed;
+        system_harness_run(&harness, EVENT_PERIOD - (vclock_now() - start) / 1000);
+    }
+
+    polls = _get(&harness, RESOURCE_ID_AVR_COUNT_POLL) - polls;
+    attentions = _get(&harness, RESOURCE_ID_AVR_COUNT_ATTENTION) - attentions;
+    commands = i2c_sim_stats(0)->commands - commands;
+    busy_us = i2c_sim_stats(0)->busy_us - busy_us;
+
+    qsort(latency, EVENTS, sizeof(latency[0]), _compare);
+    printf("  %-22s %8u %8.2f %8u %8u %9.2f %9.2f %9.2f\n", mode->name,
+           commands, busy_us / 1000000.0, polls, attentions,
+           latency[EVENTS / 2] / 1000.0, latency[EVENTS * 99 / 100] / 1000.0, latency[EVENTS - 1] / 1000.0);
+    return 0;
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time: bus and task structure only, CPU time not modelled\n");
+    printf("Per hour, %d switch changes (bus s; latency ms: median, p99, max)\n", EVENTS);
+    printf("  %-22s %8s %8s %8s %8s %9s %9s %9s\n", "mode", "txns", "bus s", "polls", "attn", "median", "p99", "max");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(MODES) / sizeof(MODES[0]); ++i)
+    {
+        // the modules under test keep static state, so each mode runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int result = _run_mode(&MODES[i]);
+            fflush(NULL);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
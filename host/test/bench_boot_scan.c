@@ -0,0 +1,233 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the boot-time I2C scan that app_main waits for before bringing up the display.
+ * It compares the full serial sweep the scan used to be (126 addresses, a 1000 ms timeout each,
+ * with the bus held throughout) with i2c_master_scan() of the three known addresses.
+ *
+ * Each bus runs with the AVR, LCD backpack and TSL2561 present, then with the LCD missing, then
+ * with a slave holding SDA low. Reported per bus, in virtual time on the host I2C stand-in
+ * (i2c_sim.h), not on a device:
+ *   duration      how long app_main waits, for the full sweep and for the known addresses, and
+ *                 how long the optional background sweep (CONFIG_I2C_MASTER_FULL_SCAN) runs
+ *   AVR wait      the longest an AVR poll, every tick meanwhile, waits for the bus
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "resources.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+
+#define OLD_SCAN_TIMEOUT    (1000)   // milliseconds per address, as the full sweep was
+#define POLL_PERIOD         (10)     // milliseconds, AVR poll every tick, faster than the firmware to catch every hold
+#define SWEEP_PRIORITY      (1)      // tskIDLE_PRIORITY + 1, as app_main
+#define AVR_PRIORITY        (5)
+
+typedef struct
+{
+    const char * name;
+    bool lcd;
+    bool stuck;
+} bus_t;
+
+static const bus_t BUSES[] = {
+    { "all present",    true,  false },
+    { "LCD missing",    false, false },
+    { "SDA held low",   true,  true  },
+};
+
+static const uint8_t KNOWN_DEVICES[] = { CONFIG_AVR_I2C_ADDRESS, CONFIG_LCD1602_I2C_ADDRESS, CONFIG_LIGHT_SENSOR_I2C_ADDRESS };
+
+static const datastore_t * _datastore = NULL;
+static i2c_master_info_t * _info = NULL;
+static int64_t _scan_time = 0;           // microseconds
+static int _detected = 0;
+static uint32_t _poll_wait_max = 0;      // microseconds
+static bool _done = false;
+
+static bool _start(void * context, bool read)
+{
+    return true;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    return 0;
+}
+
+static const i2c_sim_device_t DEVICE = { _start, _write, _read, NULL };
+
+// The boot scan before it took a list of addresses
+static int _full_serial_scan(const i2c_master_info_t * info)
+{
+    int num_detected = 0;
+    i2c_master_lock(info, I2C_MASTER_CLIENT_OTHER, portMAX_DELAY);
+    for (int address = 1; address < 0x7f; ++address)
+    {
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, address << 1, true /*ACK_CHECK*/);
+        i2c_master_stop(cmd);
+        esp_err_t err = i2c_master_cmd_begin(info->port, cmd, OLD_SCAN_TIMEOUT / portTICK_RATE_MS);
+        num_detected += err == ESP_OK ? 1 : 0;
+        i2c_cmd_link_delete(cmd);
+    }
+    i2c_master_unlock(info);
+    return num_detected;
+}
+
+typedef enum
+{
+    SCAN_FULL = 0,
+    SCAN_KNOWN,
+    SCAN_BACKGROUND,
+    SCAN_LAST,
+} scan_t;
+
+static const char * SCAN_NAMES[SCAN_LAST] = { "full sweep", "known addresses", "background sweep" };
+
+static void _boot_task(void * pvParameter)
+{
+    scan_t scan = (scan_t)(intptr_t)pvParameter;
+    int64_t start = vclock_now();
+    if (scan == SCAN_BACKGROUND)
+    {
+        // app_main carries on straight away; time the sweep task, to the tick, until it exits
+        UBaseType_t tasks = uxTaskGetNumberOfTasks();
+        i2c_master_scan_background(_info, SWEEP_PRIORITY);
+        while (uxTaskGetNumberOfTasks() > tasks)
+        {
+            vTaskDelay(1);
+        }
+        uint8_t count = 0;
+        datastore_get_uint8(_datastore, RESOURCE_ID_I2C_MASTER_DEVICE_COUNT, 0, &count);
+        _detected = count;
+    }
+    else
+    {
+        _detected = scan == SCAN_FULL ? _full_serial_scan(_info) : i2c_master_scan(_info, KNOWN_DEVICES, sizeof(KNOWN_DEVICES));
+    }
+    _scan_time = vclock_now() - start;
+    _done = true;
+    vTaskDelete(NULL);
+}
+
+static void _poll_task(void * pvParameter)
+{
+    TickType_t last_wake_time = xTaskGetTickCount();
+    while (1)
+    {
+        vTaskDelayUntil(&last_wake_time, POLL_PERIOD / portTICK_RATE_MS);
+        uint64_t start = microseconds_since_boot();
+        i2c_master_lock(_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+        uint32_t wait = microseconds_since_boot() - start;
+        _poll_wait_max = wait > _poll_wait_max ? wait : _poll_wait_max;
+        i2c_master_unlock(_info);
+    }
+}
+
+static void _setup(const bus_t * bus)
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_AVR_I2C_ADDRESS, &DEVICE, NULL);
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_LIGHT_SENSOR_I2C_ADDRESS, &DEVICE, NULL);
+    if (bus->lcd)
+    {
+        i2c_sim_attach(I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS, &DEVICE, NULL);
+    }
+
+    _datastore = datastore_create();
+    timer_wheel_init(1);
+    _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, _datastore);
+    esp_log_level_set("i2c", ESP_LOG_ERROR);
+    if (bus->stuck)
+    {
+        i2c_sim_hold_sda(I2C_MASTER_NUM, UINT32_MAX);
+    }
+}
+
+// Time one scan with the AVR polling meanwhile, in its own process as the I2C master keeps
+// static state
+static int _run(const bus_t * bus, scan_t scan)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        _setup(bus);
+        xTaskCreate(_poll_task, "avr", 4096, NULL, AVR_PRIORITY, NULL);
+        xTaskCreate(_boot_task, "main", 4096, (void *)(intptr_t)scan, 1, NULL);
+        while (!_done)
+        {
+            rtos_sim_run_for(1000);
+        }
+        printf("  %-18s %12.2f %8d %12.2f\n", SCAN_NAMES[scan], _scan_time / 1000.0, _detected, _poll_wait_max / 1000.0);
+        fflush(NULL);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time: bus time and waits only, CPU time not modelled\n");
+    printf("  %-18s %12s %8s %12s\n", "scan", "duration ms", "detected", "AVR wait ms");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(BUSES) / sizeof(BUSES[0]); ++i)
+    {
+        printf("%s\n", BUSES[i].name);
+        for (scan_t scan = SCAN_FULL; scan < SCAN_LAST; ++scan)
+        {
+            failures += _run(&BUSES[i], scan);
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
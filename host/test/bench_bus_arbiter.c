@@ -0,0 +1,303 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares the I2C bus as a single mutex, as it was, with the client-priority arbiter, for
+ * pump commands issued while the display refreshes. The same three clients run for 30 minutes
+ * of virtual time under each structure:
+ *   avr      a CONTROL write at a random time, at the AVR task's priority
+ *   sensor   a two-byte register read every 20-100 ms
+ *   display  a render every 500 ms after the last: usually a few characters, sometimes a new
+ *            page with up to four CGRAM glyph loads and all four rows
+ *
+ * With the mutex, the display holds the bus for a whole render. With the arbiter, it yields
+ * before each glyph load and row, as _render_page_buffer does, and a waiting AVR command is
+ * granted the bus ahead of the sensor and the display.
+ *
+ * Reported per structure: the AVR command latency from the request to the write completing,
+ * and the longest sensor wait and display render. Host simulation (i2c_sim.h): bus time and
+ * waits only, with the device models acknowledging every byte, not a device measurement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+
+#define DURATION              (30 * 60 * 1000)   // milliseconds
+#define MAX_COMMANDS          (20000)
+
+// as app_main
+#define DISPLAY_PRIORITY      (4)
+#define SENSOR_PRIORITY       (4)
+#define AVR_PRIORITY          (5)
+
+#define AVR_COMMAND_MAX_GAP   (250)    // milliseconds
+#define SENSOR_MIN_GAP        (20)     // milliseconds
+#define SENSOR_MAX_GAP        (100)    // milliseconds
+
+// display.c
+#define DISPLAY_PERIOD        (500)    // milliseconds between renders
+#define LCD_ROWS              (4)
+#define LCD_COLUMNS           (20)
+#define PORT_WRITES_PER_BYTE  (6)      // two nibbles, each written with E low, high, low
+#define GLYPH_HEIGHT          (8)
+#define GLYPH_SLOTS           (4)
+
+typedef enum
+{
+    STRUCTURE_MUTEX = 0,
+    STRUCTURE_ARBITER,
+} structure_t;
+
+static const char * STRUCTURE_NAMES[] = { "single mutex", "priority arbiter" };
+
+static structure_t _structure = STRUCTURE_MUTEX;
+static i2c_master_info_t * _info = NULL;
+static SemaphoreHandle_t _mutex = NULL;
+
+static int64_t _latency[MAX_COMMANDS];
+static size_t _commands = 0;
+static uint32_t _sensor_wait_max = 0;     // microseconds
+static uint32_t _render_max = 0;          // microseconds
+
+static uint32_t _random(uint32_t * seed, uint32_t range)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) % range;
+}
+
+static void _lock(i2c_master_client_t client)
+{
+    if (_structure == STRUCTURE_MUTEX)
+    {
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+    }
+    else
+    {
+        i2c_master_lock(_info, client, portMAX_DELAY);
+    }
+}
+
+static void _unlock(void)
+{
+    if (_structure == STRUCTURE_MUTEX)
+    {
+        xSemaphoreGive(_mutex);
+    }
+    else
+    {
+        i2c_master_unlock(_info);
+    }
+}
+
+// Between chunks of a render. A mutex has no equivalent, so the render holds it throughout.
+static void _yield(i2c_master_client_t client)
+{
+    if (_structure == STRUCTURE_ARBITER)
+    {
+        i2c_master_yield(_info, client);
+    }
+}
+
+// Every device acknowledges and reads as 0xff
+static bool _ack_start(void * context, bool read)
+{
+    return true;
+}
+
+static bool _ack_write(void * context, uint8_t value)
+{
+    return true;
+}
+
+static uint8_t _ack_read(void * context)
+{
+    return 0xff;
+}
+
+static const i2c_sim_device_t ACK_DEVICE = { _ack_start, _ack_write, _ack_read, NULL };
+
+static void _avr_task(void * pvParameter)
+{
+    uint32_t seed = 1;
+    uint8_t control[2] = { 0 };
+    i2c_cmd_handle_t link = i2c_master_build_write(CONFIG_AVR_I2C_ADDRESS, control, sizeof(control));
+    while (1)
+    {
+        vTaskDelay((1 + _random(&seed, AVR_COMMAND_MAX_GAP)) / portTICK_RATE_MS);
+        uint64_t request = microseconds_since_boot();
+        _lock(I2C_MASTER_CLIENT_AVR);
+        control[1] ^= 0x01;
+        i2c_master_run(_info, link, 1000 / portTICK_RATE_MS);
+        _unlock();
+        if (_commands < MAX_COMMANDS)
+        {
+            _latency[_commands++] = microseconds_since_boot() - request;
+        }
+    }
+}
+
+static void _sensor_task(void * pvParameter)
+{
+    uint32_t seed = 2;
+    uint8_t data[2] = { 0 };
+    i2c_cmd_handle_t link = i2c_master_build_read(CONFIG_LIGHT_SENSOR_I2C_ADDRESS, 0xac, data, sizeof(data));
+    while (1)
+    {
+        vTaskDelay((SENSOR_MIN_GAP + _random(&seed, SENSOR_MAX_GAP - SENSOR_MIN_GAP)) / portTICK_RATE_MS);
+        uint64_t request = microseconds_since_boot();
+        _lock(I2C_MASTER_CLIENT_SENSOR);
+        uint32_t wait = microseconds_since_boot() - request;
+        _sensor_wait_max = wait > _sensor_wait_max ? wait : _sensor_wait_max;
+        i2c_master_run(_info, link, 1000 / portTICK_RATE_MS);
+        _unlock();
+    }
+}
+
+// i2c_lcd1602_define_char: the CGRAM address and each glyph row, one port write per transaction
+static void _define_glyph(smbus_info_t * smbus_info)
+{
+    for (size_t i = 0; i < (1 + GLYPH_HEIGHT) * PORT_WRITES_PER_BYTE; ++i)
+    {
+        smbus_send_byte(smbus_info, 0);
+    }
+}
+
+// A row as _write_run sends it: the cursor move and the characters in one transaction
+static void _write_row(size_t characters)
+{
+    static uint8_t burst[(LCD_COLUMNS + 1) * PORT_WRITES_PER_BYTE] = { 0 };
+    i2c_cmd_handle_t cmd = i2c_master_build_write(CONFIG_LCD1602_I2C_ADDRESS, burst, (1 + characters) * PORT_WRITES_PER_BYTE);
+    i2c_master_run(_info, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+}
+
+static void _display_task(void * pvParameter)
+{
+    uint32_t seed = 3;
+    smbus_info_t * smbus_info = smbus_malloc();
+    smbus_init(smbus_info, _info->port, CONFIG_LCD1602_I2C_ADDRESS);
+    vTaskDelay(_random(&seed, DISPLAY_PERIOD) / portTICK_RATE_MS);
+    while (1)
+    {
+        vTaskDelay(DISPLAY_PERIOD / portTICK_RATE_MS);
+        bool new_page = _random(&seed, 10) == 0;
+        size_t glyphs = new_page ? _random(&seed, GLYPH_SLOTS + 1) : 0;
+
+        uint64_t start = microseconds_since_boot();
+        _lock(I2C_MASTER_CLIENT_DISPLAY);
+        for (size_t i = 0; i < glyphs; ++i)
+        {
+            _yield(I2C_MASTER_CLIENT_DISPLAY);
+            _define_glyph(smbus_info);
+        }
+        for (int row = 0; row < LCD_ROWS; ++row)
+        {
+            _yield(I2C_MASTER_CLIENT_DISPLAY);
+            size_t run = new_page ? LCD_COLUMNS : (_random(&seed, 2) ? 1 + _random(&seed, 4) : 0);
+            if (run > 0)
+            {
+                _write_row(run);
+            }
+        }
+        _unlock();
+        uint32_t render = microseconds_since_boot() - start;
+        _render_max = render > _render_max ? render : _render_max;
+    }
+}
+
+static int _compare(const void * a, const void * b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void _run(structure_t structure)
+{
+    _structure = structure;
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    timer_wheel_init(DISPLAY_PRIORITY);
+
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_AVR_I2C_ADDRESS, &ACK_DEVICE, NULL);
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_LIGHT_SENSOR_I2C_ADDRESS, &ACK_DEVICE, NULL);
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS, &ACK_DEVICE, NULL);
+    _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, datastore_create());
+    _mutex = xSemaphoreCreateMutex();
+
+    xTaskCreate(_display_task, "display_task", 4096, NULL, DISPLAY_PRIORITY, NULL);
+    xTaskCreate(_sensor_task, "sensor_task", 4096, NULL, SENSOR_PRIORITY, NULL);
+    xTaskCreate(_avr_task, "avr_task", 4096, NULL, AVR_PRIORITY, NULL);
+    rtos_sim_run_for((int64_t)DURATION * 1000);
+
+    qsort(_latency, _commands, sizeof(_latency[0]), _compare);
+    printf("%s, %zu AVR commands\n", STRUCTURE_NAMES[structure], _commands);
+    printf("  AVR command latency (ms: min, median, p99, p99.9, max) %7.2f %7.2f %7.2f %7.2f %7.2f\n",
+           _latency[0] / 1000.0, _latency[_commands / 2] / 1000.0, _latency[_commands * 99 / 100] / 1000.0,
+           _latency[_commands * 999 / 1000] / 1000.0, _latency[_commands - 1] / 1000.0);
+    printf("  sensor wait max %.2f ms, display render max %.2f ms\n", _sensor_wait_max / 1000.0, _render_max / 1000.0);
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time, %d minutes: bus time and waits only, CPU time not modelled\n", DURATION / 60000);
+
+    int failures = 0;
+    for (structure_t structure = STRUCTURE_MUTEX; structure <= STRUCTURE_ARBITER; ++structure)
+    {
+        // the I2C master and timer wheel keep static state, so each structure runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            _run(structure);
+            fflush(NULL);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures bus throughput and recovery from stuck-low faults on the I2C master. A client
+ * runs the AVR poll's block read back to back, with the firmware's 1000 ms SMBus timeout, for
+ * ten minutes of virtual time per scenario:
+ *   clean           no faults
+ *   stuck SDA       a slave holds SDA low at random intervals, releasing it after 1-9 SCL
+ *                   clocks, as after an AVR reset part-way through a read
+ *   NACK noise      a 15% NACK rate for the first two minutes, then clean - NACKs are not
+ *                   bus errors, so the clock should stay at its maximum
+ *
+ * Reported per scenario: completed reads and bytes per second, failed reads, recoveries, the
+ * time from a fault to the next read started after it completing (the 1000 ms timeout, then
+ * the clock-out and reinstall), the longest clock-out and reinstall, and the lowest and final
+ * bus clock. Host simulation (i2c_sim.h): bus time only, with the driver overhead per command
+ * estimated, not a device measurement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "resources.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+
+#define DURATION         (10 * 60 * 1000)   // milliseconds
+#define SMBUS_TIMEOUT    (1000)             // milliseconds, as avr_support.c
+#define POLL_LENGTH      (10)               // bytes, as the AVR block read
+#define NOISE_DURATION   (2 * 60 * 1000)    // milliseconds
+#define NOISE_NACK_EVERY (7)                // about 15% of reads
+
+typedef struct
+{
+    const char * name;
+    uint32_t fault_gap;       // milliseconds, mean time between stuck-SDA faults, 0 for none
+    bool noise;
+} scenario_t;
+
+static const scenario_t SCENARIOS[] = {
+    { "clean",                 0,          false },
+    { "stuck SDA every ~60 s", 60 * 1000,  false },
+    { "stuck SDA every ~10 s", 10 * 1000,  false },
+    { "NACK noise, 2 min",     0,          true  },
+};
+
+static const scenario_t * _scenario = NULL;
+static i2c_master_info_t * _info = NULL;
+static uint32_t _seed = 1;
+
+static uint32_t _reads = 0;
+static uint32_t _failures = 0;
+static uint32_t _faults = 0;
+static int64_t _fault_time = -1;       // microseconds, of a fault not yet recovered from
+static uint32_t _clock_min = 0;        // Hz
+static uint64_t _recovery_total = 0;   // microseconds, fault to the next read after it completing
+static uint32_t _recovery_max = 0;
+static uint32_t _recovered = 0;
+
+static uint32_t _random(uint32_t range)
+{
+    _seed = _seed * 1103515245u + 12345u;
+    return (_seed >> 16) % range;
+}
+
+// The AVR: acknowledges everything, except every NOISE_NACK_EVERY'th address during the noise
+static uint32_t _starts = 0;
+
+static bool _start(void * context, bool read)
+{
+    ++_starts;
+    return !(_scenario->noise && vclock_now() < (int64_t)NOISE_DURATION * 1000 && _starts % NOISE_NACK_EVERY == 0);
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    return 0;
+}
+
+static const i2c_sim_device_t DEVICE = { _start, _write, _read, NULL };
+
+static void _client_task(void * pvParameter)
+{
+    smbus_info_t * smbus_info = smbus_malloc();
+    smbus_init(smbus_info, _info->port, CONFIG_AVR_I2C_ADDRESS);
+    static uint8_t data[POLL_LENGTH];
+    i2c_cmd_handle_t link = i2c_master_build_read(CONFIG_AVR_I2C_ADDRESS, 0, data, sizeof(data));
+    while (1)
+    {
+        i2c_master_lock(_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+        int64_t start = microseconds_since_boot();
+        esp_err_t err = i2c_master_record(smbus_info, i2c_master_run(_info, link, SMBUS_TIMEOUT / portTICK_RATE_MS), start, 0);
+        i2c_master_unlock(_info);
+
+        if (err == ESP_OK)
+        {
+            ++_reads;
+
+            // a read already on the wire when the fault started does not count
+            if (_fault_time >= 0 && start >= _fault_time)
+            {
+                uint32_t recovery = vclock_now() - _fault_time;
+                _recovery_total += recovery;
+                _recovery_max = recovery > _recovery_max ? recovery : _recovery_max;
+                ++_recovered;
+                _fault_time = -1;
+            }
+        }
+        else
+        {
+            ++_failures;
+        }
+        uint32_t clock = i2c_sim_clock(_info->port);
+        _clock_min = clock < _clock_min ? clock : _clock_min;
+
+        // the next poll is due straight away: as much traffic as the bus will carry
+        taskYIELD();
+    }
+}
+
+static void _fault_task(void * pvParameter)
+{
+    while (1)
+    {
+        vTaskDelay((1 + _random(2 * _scenario->fault_gap)) / portTICK_RATE_MS);
+        if (_fault_time < 0)
+        {
+            _fault_time = vclock_now();
+            ++_faults;
+            i2c_sim_hold_sda(_info->port, 1 + _random(9));
+        }
+    }
+}
+
+static void _run(const scenario_t * scenario)
+{
+    _scenario = scenario;
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_AVR_I2C_ADDRESS, &DEVICE, NULL);
+
+    const datastore_t * datastore = datastore_create();
+    timer_wheel_init(1);
+    _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, datastore);
+    _clock_min = I2C_MASTER_FREQ_HZ;
+    esp_log_level_set("i2c", ESP_LOG_ERROR);
+
+    xTaskCreate(_client_task, "client", 4096, NULL, 5, NULL);
+    if (scenario->fault_gap > 0)
+    {
+        xTaskCreate(_fault_task, "fault", 2048, NULL, 6, NULL);
+    }
+    rtos_sim_run_for((int64_t)DURATION * 1000 + 1);
+
+    uint32_t recoveries = 0;
+    uint32_t recovery_time_max = 0;
+    uint32_t clk_speed = 0;
+    datastore_get_uint32(datastore, RESOURCE_ID_I2C_RECOVERY_COUNT, 0, &recoveries);
+    datastore_get_uint32(datastore, RESOURCE_ID_I2C_RECOVERY_TIME_MAX, 0, &recovery_time_max);
+    datastore_get_uint32(datastore, RESOURCE_ID_I2C_CLOCK_SPEED, 0, &clk_speed);
+
+    double seconds = DURATION / 1000.0;
+    printf("%-22s %8" PRIu32 " %8.1f %8.0f %8" PRIu32 " %6" PRIu32 " %10" PRIu32 " %9.1f %9.1f %8" PRIu32 "us %8" PRIu32 " %8" PRIu32 "\n",
+           scenario->name, _reads, _reads / seconds, _reads * POLL_LENGTH / seconds, _failures, _faults, recoveries,
+           _recovered ? _recovery_total / _recovered / 1000.0 : 0.0, _recovery_max / 1000.0, recovery_time_max,
+           _clock_min, clk_speed);
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time, %d minutes per scenario: bus time only, CPU time not modelled\n", DURATION / 60000);
+    printf("%-22s %8s %8s %8s %8s %6s %10s %9s %9s %10s %8s %8s\n", "scenario", "reads", "reads/s", "bytes/s",
+           "failed", "faults", "recoveries", "rec avg", "rec max", "clock-out", "clock", "clock");
+    printf("%-22s %8s %8s %8s %8s %6s %10s %9s %9s %10s %8s %8s\n", "", "", "", "", "", "", "", "ms", "ms", "max", "min Hz", "end Hz");
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); ++i)
+    {
+        // the I2C master and timer wheel keep static state, so each scenario runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            _run(&SCENARIOS[i]);
+            fflush(NULL);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs a week of the control loops against the plant model, with the daily purge enabled
+ * and the collector following the time-of-day sun, and reports how much faster than real
+ * time the simulation runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "resources.h"
+
+#include "avr_fake.h"
+#include "control_harness.h"
+
+#define SIMULATED_DAYS (7)
+
+static double _wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t days = argc > 1 ? atoi(argv[1]) : SIMULATED_DAYS;
+
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 0, 0));
+    datastore_set_bool(harness.datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, true);
+
+    double start = _wall_seconds();
+    harness_run(&harness, days * 24 * 3600);
+    double elapsed = _wall_seconds() - start;
+
+    double hours = days * 24.0;
+    printf("simulated %.0f hours (%u control ticks) in %.3f s\n", hours, harness.ticks, elapsed);
+    printf("%.0f simulated hours per second, %.0fx real time\n", hours / elapsed, hours * 3600.0 / elapsed);
+    printf("CP starts %u, CP running %.1f h, pool gain %.2f C\n",
+           harness.plant.cp_starts, harness.plant.cp_run_time / 3600.0, harness.plant.pool_gain);
+    harness_delete(&harness);
+    return 0;
+}
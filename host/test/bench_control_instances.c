@@ -0,0 +1,98 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost of one circulation pump control step per instance as the number of
+ * instances grows. Per-instance cost should stay flat: instances share no state, so a
+ * control loop iteration is linear in the number of circuits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "control_logic.h"
+
+#define MAX_INSTANCES  (64)
+#define STEPS          (2000000)
+#define REPEATS        (3)         // best of
+
+static double _wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _ns_per_instance_step(uint32_t instances)
+{
+    static control_cp_t cp[MAX_INSTANCES];
+    static control_cp_inputs_t inputs[MAX_INSTANCES];
+    for (uint32_t n = 0; n < instances; ++n)
+    {
+        control_cp_logic_init(&cp[n]);
+        inputs[n] = (control_cp_inputs_t){ .temps_valid = true, .t_low = 20.0f, .t_high = 20.0f, .on_delta = 7.0f, .off_delta = 5.0f, .predict_horizon = 60 };
+    }
+
+    uint32_t steps = STEPS / instances;
+    uint32_t events = 0;
+    double start = _wall_seconds();
+    for (uint32_t step = 0; step < steps; ++step)
+    {
+        for (uint32_t n = 0; n < instances; ++n)
+        {
+            // each circuit sweeps the delta through both thresholds, out of phase with the others
+            inputs[n].t_high = 20.0f + (float)((step + n * 37) % 240) / 20.0f;
+            control_outputs_t outputs;
+            control_cp_step(&cp[n], &inputs[n], step, &outputs);
+            events += outputs.num_events;
+        }
+    }
+    double elapsed = _wall_seconds() - start;
+    if (events == 0)
+    {
+        printf("no transitions\n");
+    }
+    return elapsed * 1e9 / ((double)steps * instances);
+}
+
+int main(void)
+{
+    printf("%10s %20s\n", "instances", "ns / instance step");
+    double min = 0.0, max = 0.0;
+    for (uint32_t instances = 1; instances <= MAX_INSTANCES; instances *= 2)
+    {
+        double ns = _ns_per_instance_step(instances);
+        for (int r = 1; r < REPEATS; ++r)
+        {
+            double again = _ns_per_instance_step(instances);
+            ns = again < ns ? again : ns;
+        }
+        min = instances == 1 || ns < min ? ns : min;
+        max = ns > max ? ns : max;
+        printf("%10u %20.1f\n", instances, ns);
+    }
+    printf("max / min per-instance cost: %.2f\n", max / min);
+    return 0;
+}
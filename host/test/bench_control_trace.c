@@ -0,0 +1,188 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the cost of tracing a control loop iteration with control_trace_add() against the
+ * control loop budget. Each loop period (one second, as control.c) the CP loop traces one
+ * record per instance and the PP loop one record, so the traced work per period is
+ * (CONTROL_CP_INSTANCES + 1) calls. Reported, in host CPU time on a PC, not on a device:
+ *   trace add       per call, best of REPEATS
+ *   control steps   control_cp_step() per instance plus control_pp_step(), the decision the record describes
+ *   trace/steps     the trace cost relative to the steps, which carries over to the device better than absolute time
+ *   of period       the trace cost per period as a share of the loop period, against the 1% budget
+ *
+ * A dump is then run through the host scheduler to check the header the decoder relies on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "control_trace.h"
+#include "control.h"
+#include "mqtt.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+
+#define LOOP_PERIOD    (1000)      // milliseconds, as control.c
+#define BUDGET         (1.0)       // percent of the loop period
+#define CALLS          (2000000)
+#define REPEATS        (3)         // best of
+
+static uint32_t _lines = 0;
+static char _header[64] = "";
+
+bool mqtt_publish(const char * topic, const uint8_t * payload, size_t len, int qos, bool retained)
+{
+    if (_lines++ == 0)
+    {
+        snprintf(_header, sizeof(_header), "%.*s", (int)len, (const char *)payload);
+    }
+    return true;
+}
+
+static double _wall_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _ns_per_trace(void)
+{
+    control_outputs_t outputs = { 0 };
+    double best = 0.0;
+    for (int repeat = 0; repeat < REPEATS; ++repeat)
+    {
+        double start = _wall_seconds();
+        for (uint32_t i = 0; i < CALLS; ++i)
+        {
+            // as _pp_iterate fills it in
+            control_trace_record_t record = {
+                .flags = CONTROL_TRACE_FLAG_TEMPS_VALID | CONTROL_TRACE_FLAG_FLOW_VALID | CONTROL_TRACE_FLAG_AUTO_MODE,
+                .cycle = i & 0xff,
+                .t_high = control_trace_fixed(20.0f + (i & 0x3ff) / 100.0f),
+                .flow = control_trace_fixed(12.5f),
+                .t_high_age = control_trace_age(1500000),
+                .t_low_age = CONTROL_TRACE_NO_AGE,
+                .flow_age = control_trace_age(4000000),
+            };
+            outputs.num_events = (i & 0x3ff) == 0 ? 1 : 0;
+            control_trace_add(CONTROL_TRACE_LOOP_PP, CONTROL_PP_STATE_OFF, CONTROL_PP_STATE_OFF, &outputs, &record);
+        }
+        double ns = (_wall_seconds() - start) * 1e9 / CALLS;
+        best = repeat == 0 || ns < best ? ns : best;
+    }
+    return best;
+}
+
+// control steps of one loop period: every CP instance and the PP
+static double _ns_per_steps(void)
+{
+    control_cp_t cp[CONTROL_CP_INSTANCES];
+    control_cp_inputs_t cp_inputs = { .temps_valid = true, .t_low = 20.0f, .on_delta = 7.0f, .off_delta = 5.0f, .predict_horizon = 60 };
+    control_pp_t pp;
+    control_pp_inputs_t pp_inputs = { .t_high_valid = true, .safe_temp_high = 70.0f, .safe_temp_low = 60.0f, .auto_mode = true,
+                                      .flow_valid = true, .flow_rate = 12.5f, .flow_threshold = 5.0f, .cycle_count = 3,
+                                      .on_duration = 300, .pause_duration = 60 };
+    for (size_t n = 0; n < CONTROL_CP_INSTANCES; ++n)
+    {
+        control_cp_logic_init(&cp[n]);
+    }
+    control_pp_logic_init(&pp);
+
+    double best = 0.0;
+    uint32_t events = 0;
+    for (int repeat = 0; repeat < REPEATS; ++repeat)
+    {
+        double start = _wall_seconds();
+        for (uint32_t i = 0; i < CALLS; ++i)
+        {
+            control_outputs_t outputs;
+            cp_inputs.t_high = 20.0f + (float)(i % 240) / 20.0f;
+            for (size_t n = 0; n < CONTROL_CP_INSTANCES; ++n)
+            {
+                control_cp_step(&cp[n], &cp_inputs, i, &outputs);
+                events += outputs.num_events;
+            }
+            pp_inputs.t_high = cp_inputs.t_high;
+            pp_inputs.daily_trigger = i % 3600 == 0;
+            control_pp_step(&pp, &pp_inputs, i, &outputs);
+            events += outputs.num_events;
+        }
+        double ns = (_wall_seconds() - start) * 1e9 / CALLS;
+        best = repeat == 0 || ns < best ? ns : best;
+    }
+    if (events == 0)
+    {
+        printf("no transitions\n");
+    }
+    return best;
+}
+
+// dump the ring through the host scheduler and check the header the decoder reads
+static int _check_dump(void)
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    control_trace_request_dump();
+    rtos_sim_run_for(1000 * 1000);
+
+    unsigned count = 0, size = 0;
+    if (sscanf(_header, "H %u %u", &count, &size) != 2 || size != sizeof(control_trace_record_t) || count != CONTROL_TRACE_RECORDS)
+    {
+        printf("dump header \"%s\" does not match %d records of %zu bytes\n", _header, CONTROL_TRACE_RECORDS, sizeof(control_trace_record_t));
+        return 1;
+    }
+    printf("dump: %u records of %u bytes in %u messages\n", count, size, _lines);
+    return 0;
+}
+
+int main(void)
+{
+    double trace_ns = _ns_per_trace();
+    double steps_ns = _ns_per_steps();
+    double period_ns = (CONTROL_CP_INSTANCES + 1) * trace_ns;
+    double share = period_ns / (LOOP_PERIOD * 1e6) * 100.0;
+
+    printf("Host CPU time on a PC, not a device: %d CP instance(s) and the PP per %d ms loop period\n", CONTROL_CP_INSTANCES, LOOP_PERIOD);
+    printf("record size          %zu bytes, ring %zu bytes\n", sizeof(control_trace_record_t), sizeof(control_trace_record_t) * CONTROL_TRACE_RECORDS);
+    printf("trace add            %8.1f ns per call, %8.1f ns per period\n", trace_ns, period_ns);
+    printf("control steps        %8.1f ns per period\n", steps_ns);
+    printf("trace/steps          %8.2f\n", period_ns / steps_ns);
+    printf("of period            %8.6f %% (budget %.0f %%)\n", share, BUDGET);
+
+    int failures = _check_dump();
+    if (share >= BUDGET)
+    {
+        printf("over budget\n");
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the stack RAM of the control loops on the coroutine runner. The system harness
+ * runs the tasks for an hour of virtual time with the CP and PP loops, including the purge
+ * cycle, on the one runner task, and the array overheats once so that the emergency path runs.
+ *
+ * Reported per task: the stack allocated on the device (as requested in xTaskCreate), and the
+ * peak host stack the task used (x86-64 with host libraries, so only for comparing tasks). The
+ * control loops' allocation is then compared with the two 4096 byte tasks, control_cp_task and
+ * control_pp_task, that ran them before the runner.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "system_harness.h"
+
+#define RUN_TIME        (3600 * 1000)     // milliseconds
+#define OVERHEAT_AT     (600 * 1000)
+#define OVERHEAT_FOR    (120 * 1000)
+#define TASK_STACK      (4096)            // bytes, each of the control loop tasks before the runner
+
+static const char * TASKS[] = { "coroutine_task", "avr_support_task", "sensor_task", "timer_wheel_task" };
+
+int main(void)
+{
+    system_harness_t harness;
+    system_harness_config_t config = { .light_sensor = true, .control_loops = true };
+    system_harness_init(&harness, &config);
+    uint32_t allocated = rtos_sim_stack_bytes();
+
+    system_harness_run(&harness, OVERHEAT_AT);
+    harness.t_array = 85.0f;
+    system_harness_run(&harness, OVERHEAT_FOR);
+    harness.t_array = 40.0f;
+    system_harness_run(&harness, RUN_TIME - OVERHEAT_AT - OVERHEAT_FOR);
+
+    printf("Host simulation, %d s virtual time\n", RUN_TIME / 1000);
+    printf("%-18s %14s %14s\n", "task", "device stack", "host peak");
+    uint32_t runner = 0;
+    for (size_t i = 0; i < sizeof(TASKS) / sizeof(TASKS[0]); ++i)
+    {
+        uint32_t requested = 0;
+        uint32_t host_used = 0;
+        if (rtos_sim_task_stack(TASKS[i], &requested, &host_used))
+        {
+            printf("%-18s %14u %14u\n", TASKS[i], requested, host_used);
+            runner = i == 0 ? requested : runner;
+        }
+    }
+
+    printf("device stack allocated, all tasks:  %u bytes\n", allocated);
+    printf("control loops on the runner:        %u bytes (CP loop, PP loop and purge cycle)\n", runner);
+    printf("control loops as separate tasks:    %u bytes (control_cp_task, control_pp_task)\n", 2 * TASK_STACK);
+    printf("saved:                              %d bytes\n", 2 * TASK_STACK - (int)runner);
+    return runner > 0 ? 0 : 1;
+}
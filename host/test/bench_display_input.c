@@ -0,0 +1,156 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures input-to-pixel latency: a scripted stream of knob turns is posted to the display's
+ * input queue (display_harness.h), and the HD44780 model is watched for the resulting page.
+ * Each turn is a burst of clockwise steps 40 ms apart, as from a quick flick of the knob, at a
+ * random point in a 5 s slot so that it lands anywhere in the display's update cycle. A turn
+ * that would end on the scrolling Log page takes one more step, back to Main.
+ *
+ * Reported on the host simulation in virtual time, not on a device, from the last step of
+ * each turn: until the first row of the final page is on the LCD, and until the page is
+ * complete - its last LCD transaction before the bus is quiet for 50 ms. Also the pages
+ * switched to per turn; a single jump is one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resources.h"
+#include "rotary_encoder.h"
+
+#include "vclock.h"
+#include "lcd_device.h"
+#include "display_harness.h"
+
+#define TURNS         (120)
+#define SLOT          (5000)            // milliseconds per turn
+#define STEP_TIME     (40)              // milliseconds between the steps of a turn
+#define QUIET_TIME    (50)              // milliseconds without LCD traffic once a page is complete
+#define TIMEOUT       (2000)            // milliseconds
+
+// the first row of each page on the clockwise ring from Main, and the ring's length with Log
+static const char * FIRST_ROW[] = {
+    "PoolMon v", "T1 ", "Light Full", "Flow Rate", "Power Calc", "CP Swi", "CP Status",
+    "CP Control", "PP Control", "ALARM", "WiFi", "MQTT", "MEM Free", "AVR Version", "I2C ",
+};
+#define RING  (sizeof(FIRST_ROW) / sizeof(FIRST_ROW[0]) + 1)
+#define LOG   (RING - 1)
+
+static const int STEPS[] = { 1, 1, 1, 1, 2, 3, 4, 6 };
+
+static int64_t _first[TURNS];
+static int64_t _complete[TURNS];
+
+static bool _row_starts(uint8_t row, const char * prefix)
+{
+    char text[LCD_DEVICE_COLUMNS + 1];
+    lcd_device_row(row, text);
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+static int _compare(const void * a, const void * b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void _report(const char * name, int64_t * latency)
+{
+    qsort(latency, TURNS, sizeof(latency[0]), _compare);
+    printf("  %-16s %9.1f %9.1f %9.1f\n", name,
+           latency[TURNS / 2] / 1000.0, latency[TURNS * 99 / 100] / 1000.0, latency[TURNS - 1] / 1000.0);
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time: bus and task structure only, CPU time not modelled\n");
+
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, SLOT);
+
+    srand(1);
+    size_t page = 0;
+    uint32_t jumps = 0;
+    uint32_t steps = 0;
+    for (size_t i = 0; i < TURNS; ++i)
+    {
+        int64_t start = vclock_now();
+        display_harness_run(&harness, rand() % (SLOT - TIMEOUT - 500));
+
+        int count = STEPS[rand() % (sizeof(STEPS) / sizeof(STEPS[0]))];
+        count += (page + count) % RING == LOG;
+        page = (page + count) % RING;
+        steps += count;
+
+        uint32_t pages = datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_PAGE);
+        for (int step = 0; step < count; ++step)
+        {
+            if (step > 0)
+            {
+                display_harness_run(&harness, STEP_TIME);
+            }
+            display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE);
+        }
+        int64_t input = vclock_now();
+
+        while (!_row_starts(0, FIRST_ROW[page]))
+        {
+            if (vclock_now() - input > TIMEOUT * 1000)
+            {
+                fprintf(stderr, "turn %zu: page \"%s\" not shown\n", i, FIRST_ROW[page]);
+                return 1;
+            }
+            display_harness_run(&harness, 1);
+        }
+        _first[i] = vclock_now() - input;
+
+        int64_t last = vclock_now();
+        uint32_t transactions = lcd_device_stats()->transactions;
+        while (vclock_now() - last < QUIET_TIME * 1000)
+        {
+            display_harness_run(&harness, 1);
+            if (lcd_device_stats()->transactions != transactions)
+            {
+                transactions = lcd_device_stats()->transactions;
+                last = vclock_now();
+            }
+        }
+        _complete[i] = last - input;
+        jumps += datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_PAGE) - pages;
+
+        display_harness_run(&harness, SLOT - (vclock_now() - start) / 1000);
+    }
+
+    printf("%d knob turns, %u steps, %u page changes (latency ms from the last step: median, p99, max)\n",
+           TURNS, steps, jumps);
+    printf("  %-16s %9s %9s %9s\n", "until", "median", "p99", "max");
+    _report("first row", _first);
+    _report("page complete", _complete);
+    return 0;
+}
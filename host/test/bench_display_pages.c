@@ -0,0 +1,161 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures what keeping each display page on the LCD costs over one simulated hour: page
+ * handler invocations, the display task's CPU time, LCD traffic, and the datastore writes made
+ * to publish the handler statistics. The page is selected with knob steps and button presses
+ * through the input queue, and left showing with the sensor task publishing at the
+ * application's periods (display_harness.h).
+ *
+ * Reported per page, on the host simulation, not on a device: invocations come from the
+ * published DISPLAY_HANDLER_COUNT and the LCD bytes from DISPLAY_LCD_BYTES, both in virtual
+ * time. The CPU figure is the host thread's CPU time while the display task was switched in,
+ * including the LCD and bus models, so it ranks pages against each other and is not an ESP32
+ * figure.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "resources.h"
+#include "button.h"
+#include "rotary_encoder.h"
+
+#include "rtos_sim.h"
+#include "lcd_device.h"
+#include "display_harness.h"
+
+#define HOUR          (60 * 60 * 1000)   // milliseconds
+#define STATS_PERIOD  (60 * 1000)        // milliseconds, as display.c publishes
+#define STEP_TIME     (200)              // milliseconds between navigation inputs
+
+typedef struct
+{
+    const char * name;
+    display_page_id_t page;
+    int clockwise;        // knob steps from Main at boot
+    bool press;           // then a short press
+} page_t;
+
+static const page_t PAGES[] = {
+    { "Main",          DISPLAY_PAGE_MAIN,            16, false },   // round the ring, as DISPLAY_PAGE is unset at boot
+    { "Temp",          DISPLAY_PAGE_SENSORS_TEMP,     1, false },
+    { "Temp 2",        DISPLAY_PAGE_SENSORS_TEMP_2,   1, true  },
+    { "Light",         DISPLAY_PAGE_SENSORS_LIGHT,    2, false },
+    { "Flow",          DISPLAY_PAGE_SENSORS_FLOW,     3, false },
+    { "Power",         DISPLAY_PAGE_POWER,            4, false },
+    { "Switches",      DISPLAY_PAGE_SWITCHES,         5, false },
+    { "Pump status",   DISPLAY_PAGE_PUMP_STATUS,      6, false },
+    { "CP control",    DISPLAY_PAGE_CP_CONTROL,       7, false },
+    { "PP control",    DISPLAY_PAGE_PP_CONTROL,       8, false },
+    { "Alarm",         DISPLAY_PAGE_ALARM,            9, false },
+    { "WiFi",          DISPLAY_PAGE_WIFI_STATUS,     10, false },
+    { "MQTT",          DISPLAY_PAGE_MQTT_STATUS,     11, false },
+    { "Resources",     DISPLAY_PAGE_RESOURCE_STATUS, 12, false },
+    { "AVR",           DISPLAY_PAGE_AVR_STATUS,      13, false },
+    { "I2C",           DISPLAY_PAGE_I2C_STATUS,      14, false },
+    { "Log",           DISPLAY_PAGE_LOG,             15, false },
+};
+
+static uint32_t _get(const display_harness_t * harness, datastore_resource_id_t id, datastore_instance_id_t instance)
+{
+    uint32_t value = 0;
+    datastore_get_uint32(harness->datastore, id, instance, &value);
+    return value;
+}
+
+static uint64_t _cpu_ns(void)
+{
+    uint64_t ns = 0;
+    rtos_sim_task_cpu("display_task", &ns);
+    return ns;
+}
+
+static int _run_page(const page_t * spec)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, STEP_TIME);
+    for (int i = 0; i < spec->clockwise; ++i)
+    {
+        display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE);
+        display_harness_run(&harness, STEP_TIME);
+    }
+    if (spec->press)
+    {
+        display_harness_input(&harness, BUTTON_EVENT_SHORT);
+        display_harness_run(&harness, STEP_TIME);
+    }
+    if (display_harness_page(&harness) != spec->page)
+    {
+        fprintf(stderr, "%s: reached page %d\n", spec->name, display_harness_page(&harness));
+        return 1;
+    }
+
+    // past the first stats publish, so the published figures give the hour's difference
+    display_harness_run(&harness, STATS_PERIOD + STEP_TIME);
+    uint32_t count = _get(&harness, RESOURCE_ID_DISPLAY_HANDLER_COUNT, spec->page);
+    uint32_t bytes = _get(&harness, RESOURCE_ID_DISPLAY_LCD_BYTES, 0);
+    uint32_t transactions = lcd_device_stats()->transactions;
+    uint64_t cpu_ns = _cpu_ns();
+    datastore_fake_reset_counts(harness.datastore);
+
+    display_harness_run(&harness, HOUR);
+
+    count = _get(&harness, RESOURCE_ID_DISPLAY_HANDLER_COUNT, spec->page) - count;
+    bytes = _get(&harness, RESOURCE_ID_DISPLAY_LCD_BYTES, 0) - bytes;
+    transactions = lcd_device_stats()->transactions - transactions;
+    cpu_ns = _cpu_ns() - cpu_ns;
+    uint32_t sets = datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT)
+                  + datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_TIME);
+
+    printf("  %-12s %8u %10.2f %10u %8u %8u\n", spec->name, count, cpu_ns / 1000000.0, bytes, transactions, sets);
+    return 0;
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time: bus and task structure only, CPU time is the host's\n");
+    printf("Per hour on one page (handler calls; display task host CPU ms; LCD bytes and I2C transactions; handler stat writes)\n");
+    printf("  %-12s %8s %10s %10s %8s %8s\n", "page", "calls", "cpu ms", "lcd bytes", "txns", "writes");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(PAGES) / sizeof(PAGES[0]); ++i)
+    {
+        // display_init runs once per process, so each page runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int result = _run_page(&PAGES[i]);
+            fflush(NULL);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
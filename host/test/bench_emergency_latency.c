@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Simulates the overheat emergency path end to end: the temperature driver publishes an
+ * overheated array sample from the sensor task, the datastore callback latches the emergency,
+ * and the AVR task writes SSR2 over the shared bus. The array overheats at a random phase of
+ * the temperature sampling, under three bus loads: the AVR alone, with the display, and with
+ * the display and the light sensor.
+ *
+ * Reported per load, in virtual time on the host simulation (system_harness.h), not on a
+ * device:
+ *   sample -> SSR2    from publishing the overheated sample to the CONTROL write completing
+ *   reported          AVR_EMERGENCY_LATENCY, from the latch request to the CONTROL write
+ *   crossing -> SSR2  from the array crossing the threshold, including the sampling phase
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "resources.h"
+#include "avr_support.h"
+#include "../avr/avr-poolmon/registers.h"
+
+#include "vclock.h"
+#include "avr_device.h"
+#include "harness_defaults.h"
+#include "system_harness.h"
+
+#define EVENTS          (200)
+#define OVERHEAT_TEMP   (85.0f)
+#define SAFE_TEMP       (40.0f)
+#define TIMEOUT         (20 * 1000)    // milliseconds
+
+typedef struct
+{
+    const char * name;
+    bool display_load;
+    bool light_sensor;
+} load_t;
+
+static const load_t LOADS[] = {
+    { "AVR only",                false, false },
+    { "AVR + display",           true,  false },
+    { "AVR + display + light",   true,  true  },
+};
+
+static uint8_t _control = 0;
+static int64_t _ssr2_time = -1;
+
+static void _control_written(uint8_t control, void * context)
+{
+    if ((control & AVR_REGISTER_CONTROL_SSR2) && !(_control & AVR_REGISTER_CONTROL_SSR2))
+    {
+        _ssr2_time = vclock_now();
+    }
+    _control = control;
+}
+
+static bool _ssr2_on(const system_harness_t * harness)
+{
+    return (_control & AVR_REGISTER_CONTROL_SSR2) != 0;
+}
+
+static bool _idle(const system_harness_t * harness)
+{
+    return !avr_support_get_pp_emergency() && !(_control & AVR_REGISTER_CONTROL_SSR2);
+}
+
+static int _compare(const void * a, const void * b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void _report(const char * name, int64_t * samples, size_t count)
+{
+    qsort(samples, count, sizeof(samples[0]), _compare);
+    printf("  %-18s %9.2f %9.2f %9.2f %9.2f\n", name,
+           samples[0] / 1000.0, samples[count / 2] / 1000.0, samples[count * 99 / 100] / 1000.0, samples[count - 1] / 1000.0);
+}
+
+static int _run_load(const load_t * load)
+{
+    static int64_t sample_to_ssr2[EVENTS];
+    static int64_t reported[EVENTS];
+    static int64_t crossing_to_ssr2[EVENTS];
+
+    system_harness_t harness;
+    system_harness_config_t config = { .light_sensor = load->light_sensor, .display_load = load->display_load, .control_loops = true, .seed = 1 };
+    system_harness_init(&harness, &config);
+    avr_device_observe_control(_control_written, NULL);
+    system_harness_run(&harness, 20 * 1000);
+
+    srand(1);
+    for (size_t i = 0; i < EVENTS; ++i)
+    {
+        // cross the threshold at a random point in the sampling period
+        system_harness_run(&harness, rand() % HARNESS_TEMP_PERIOD);
+        int64_t crossing = vclock_now();
+        _ssr2_time = -1;
+        harness.t_array = OVERHEAT_TEMP;
+        if (!system_harness_run_until(&harness, _ssr2_on, TIMEOUT))
+        {
+            fprintf(stderr, "%s: event %zu: SSR2 not switched on\n", load->name, i);
+            return 1;
+        }
+
+        uint32_t latency = 0;
+        datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_EMERGENCY_LATENCY, 0, &latency);
+        sample_to_ssr2[i] = _ssr2_time - harness.t_array_published;
+        reported[i] = latency;
+        crossing_to_ssr2[i] = _ssr2_time - crossing;
+
+        harness.t_array = SAFE_TEMP;
+        if (!system_harness_run_until(&harness, _idle, TIMEOUT))
+        {
+            fprintf(stderr, "%s: event %zu: emergency not released\n", load->name, i);
+            return 1;
+        }
+    }
+
+    printf("%s, %d events (ms: min, median, p99, max)\n", load->name, EVENTS);
+    _report("sample -> SSR2", sample_to_ssr2, EVENTS);
+    _report("reported", reported, EVENTS);
+    _report("crossing -> SSR2", crossing_to_ssr2, EVENTS);
+    return 0;
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time: bus and task structure only, CPU time not modelled\n");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(LOADS) / sizeof(LOADS[0]); ++i)
+    {
+        // the modules under test keep static state, so each load runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int result = _run_load(&LOADS[i]);
+            fflush(NULL);
+            _exit(result);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures the heap churn that prebuilt command links remove from the AVR task's repeated
+ * transactions. Each transaction shape runs RUNS times, once through the SMBus helper that
+ * builds and deletes a link per call, as before, and once through a link built at startup with
+ * i2c_master_build_read() or i2c_master_build_write() and run with i2c_master_run():
+ *   poll read       the block read of the polled registers, every AVR poll
+ *   CONTROL write   the CONTROL register write, every reconcile
+ *
+ * Reported per shape and path: links created, heap allocations (a link plus one per command
+ * step, as the ESP-IDF driver allocates them) in total and per transaction, and the bus time per
+ * transaction, from the host I2C stand-in (i2c_sim.h) in virtual time. The host CPU time to build
+ * and delete each link shape is given for reference; it is host malloc on a PC, not a device
+ * measurement.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+
+#define RUNS             (10000)
+#define BUILD_RUNS       (1000000)
+#define SMBUS_TIMEOUT    (1000)      // milliseconds, as avr_support.c
+#define POLL_REGISTER    (0x00)
+#define POLL_LENGTH      (10)        // bytes, as the AVR block read
+#define CONTROL_REGISTER (0x04)
+
+typedef enum
+{
+    SHAPE_POLL_READ = 0,
+    SHAPE_CONTROL_WRITE,
+    SHAPE_LAST,
+} shape_t;
+
+static const char * SHAPE_NAMES[SHAPE_LAST] = { "poll read", "CONTROL write" };
+
+static i2c_master_info_t * _info = NULL;
+static shape_t _shape = SHAPE_POLL_READ;
+static bool _prebuilt = false;
+static uint32_t _failures = 0;
+static int64_t _bus_time = 0;          // microseconds
+static bool _done = false;
+
+static bool _start(void * context, bool read)
+{
+    return true;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    return true;
+}
+
+static uint8_t _read(void * context)
+{
+    return 0;
+}
+
+static const i2c_sim_device_t DEVICE = { _start, _write, _read, NULL };
+
+static void _client_task(void * pvParameter)
+{
+    smbus_info_t * smbus_info = smbus_malloc();
+    smbus_init(smbus_info, _info->port, CONFIG_AVR_I2C_ADDRESS);
+    smbus_set_timeout(smbus_info, SMBUS_TIMEOUT / portTICK_RATE_MS);
+
+    static uint8_t poll_buffer[POLL_LENGTH];
+    static uint8_t control_buffer[2] = { CONTROL_REGISTER, 0 };
+    i2c_cmd_handle_t link = NULL;
+    if (_prebuilt)
+    {
+        link = _shape == SHAPE_POLL_READ
+             ? i2c_master_build_read(CONFIG_AVR_I2C_ADDRESS, POLL_REGISTER, poll_buffer, sizeof(poll_buffer))
+             : i2c_master_build_write(CONFIG_AVR_I2C_ADDRESS, control_buffer, sizeof(control_buffer));
+    }
+
+    int64_t start = vclock_now();
+    for (uint32_t i = 0; i < RUNS; ++i)
+    {
+        uint8_t value = i & 0xff;
+        esp_err_t err = ESP_OK;
+        i2c_master_lock(_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+        if (_prebuilt)
+        {
+            control_buffer[1] = value;
+            err = i2c_master_run(_info, link, SMBUS_TIMEOUT / portTICK_RATE_MS);
+        }
+        else if (_shape == SHAPE_POLL_READ)
+        {
+            err = smbus_i2c_read_block(smbus_info, POLL_REGISTER, poll_buffer, sizeof(poll_buffer));
+        }
+        else
+        {
+            err = smbus_write_byte(smbus_info, CONTROL_REGISTER, value);
+        }
+        i2c_master_unlock(_info);
+        _failures += err == ESP_OK ? 0 : 1;
+    }
+    _bus_time = vclock_now() - start;
+    _done = true;
+    vTaskDelete(NULL);
+}
+
+// Run one shape on one path, in its own process as the I2C master keeps static state
+static int _run(shape_t shape, bool prebuilt)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        _shape = shape;
+        _prebuilt = prebuilt;
+        vclock_reset(0);
+        rtos_sim_reset();
+        gpio_fake_reset();
+        i2c_sim_reset();
+        i2c_sim_attach(I2C_MASTER_NUM, CONFIG_AVR_I2C_ADDRESS, &DEVICE, NULL);
+        timer_wheel_init(1);
+        _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, datastore_create());
+
+        // only the transactions under test: the counters are cumulative
+        const i2c_sim_stats_t * stats = i2c_sim_stats(I2C_MASTER_NUM);
+        uint32_t links_before = stats->links_created;
+        uint32_t nodes_before = stats->link_nodes;
+
+        xTaskCreate(_client_task, "client", 4096, NULL, 5, NULL);
+        while (!_done)
+        {
+            rtos_sim_run_for(1000 * 1000);
+        }
+
+        stats = i2c_sim_stats(I2C_MASTER_NUM);
+        uint32_t links = stats->links_created - links_before;
+        uint32_t allocations = links + stats->link_nodes - nodes_before;
+        printf("%-14s %-9s %8" PRIu32 " %10" PRIu32 " %10.2f %8" PRIu32 " %12.1f\n", SHAPE_NAMES[shape],
+               prebuilt ? "prebuilt" : "SMBus", links, allocations, (double)allocations / RUNS, _failures,
+               (double)_bus_time / RUNS);
+        fflush(NULL);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+}
+
+// Host CPU time to build and delete one link of each shape, outside the simulated bus
+static void _build_cost(void)
+{
+    static uint8_t poll_buffer[POLL_LENGTH];
+    static uint8_t control_buffer[2] = { CONTROL_REGISTER, 0 };
+    for (shape_t shape = SHAPE_POLL_READ; shape < SHAPE_LAST; ++shape)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t i = 0; i < BUILD_RUNS; ++i)
+        {
+            i2c_cmd_handle_t link = shape == SHAPE_POLL_READ
+                                  ? i2c_master_build_read(CONFIG_AVR_I2C_ADDRESS, POLL_REGISTER, poll_buffer, sizeof(poll_buffer))
+                                  : i2c_master_build_write(CONFIG_AVR_I2C_ADDRESS, control_buffer, sizeof(control_buffer));
+            i2c_cmd_link_delete(link);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+        printf("%-14s link build and delete: %.0f ns host CPU\n", SHAPE_NAMES[shape], ns / BUILD_RUNS);
+    }
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time, %d transactions per row: bus time only, CPU time not modelled\n", RUNS);
+    printf("%-14s %-9s %8s %10s %10s %8s %12s\n", "transaction", "path", "links", "heap", "heap", "failed", "bus time");
+    printf("%-14s %-9s %8s %10s %10s %8s %12s\n", "", "", "created", "allocs", "per txn", "", "per txn us");
+
+    int failures = 0;
+    for (shape_t shape = SHAPE_POLL_READ; shape < SHAPE_LAST; ++shape)
+    {
+        failures += _run(shape, false);
+        failures += _run(shape, true);
+    }
+    _build_cost();
+    return failures == 0 ? 0 : 1;
+}
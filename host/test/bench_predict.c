@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares predictive circulation pump control against the reactive thresholds on the plant
+ * model. Each horizon is run over the same week of weather - clear, then with passing cloud -
+ * and the pump starts, running time, pump energy and heat delivered to the pool are reported
+ * relative to reactive control (horizon 0).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "resources.h"
+#include "control.h"
+
+#include "control_harness.h"
+
+#define SIMULATED_DAYS  (7)
+#define CLOUD_PERIOD    (600)     // seconds between cloud changes
+#define PUMP_POWER      (100.0)   // circulation pump, watts
+
+static const uint32_t HORIZONS[] = { 0, 30, 60, 120, 300 };
+
+typedef struct
+{
+    uint32_t starts;
+    double run_hours;
+    double energy;       // kWh
+    double pool_gain;    // degrees C
+} result_t;
+
+static result_t _run(uint32_t horizon, bool cloudy)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 0, 0));
+    for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+    {
+        datastore_set_uint32(harness.datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, i, horizon);
+    }
+
+    // the same weather for every horizon
+    srand(1);
+    for (uint32_t t = 0; t < SIMULATED_DAYS * 24 * 3600; t += CLOUD_PERIOD)
+    {
+        harness.plant.cloud = cloudy ? (rand() % 100) / 125.0 : 0.0;
+        harness_run(&harness, CLOUD_PERIOD);
+    }
+
+    result_t result = {
+        .starts = harness.plant.cp_starts,
+        .run_hours = harness.plant.cp_run_time / 3600.0,
+        .energy = harness.plant.cp_run_time / 3600.0 * PUMP_POWER / 1000.0,
+        .pool_gain = harness.plant.pool_gain,
+    };
+    harness_delete(&harness);
+    return result;
+}
+
+int main(void)
+{
+    for (int cloudy = 0; cloudy <= 1; ++cloudy)
+    {
+        printf("%d days, %s\n", SIMULATED_DAYS, cloudy ? "passing cloud" : "clear sky");
+        printf("%8s %8s %10s %10s %10s %12s %12s\n", "horizon", "starts", "run (h)", "kWh", "gain (C)", "extra kWh", "extra starts");
+        result_t reactive = { 0 };
+        for (size_t i = 0; i < sizeof(HORIZONS) / sizeof(HORIZONS[0]); ++i)
+        {
+            result_t r = _run(HORIZONS[i], cloudy);
+            if (HORIZONS[i] == 0)
+            {
+                reactive = r;
+            }
+            printf("%8u %8u %10.2f %10.3f %10.3f %+12.3f %+12d\n", HORIZONS[i], r.starts, r.run_hours, r.energy, r.pool_gain,
+                   r.energy - reactive.energy, (int)r.starts - (int)reactive.starts);
+        }
+        printf("\n");
+    }
+    return 0;
+}
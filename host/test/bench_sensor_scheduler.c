@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs the sensor scheduler with the temperature, flow and light drivers and the display bus
+ * load for ten minutes of virtual time, then logs the scheduler's per-driver table and the I2C
+ * master's per-client lock table: how late each sample started, how many scheduler passes a
+ * sample took, and how long each client held and waited for the bus.
+ *
+ * Host simulation (system_harness.h): bus time and waits only. CPU time is not modelled, so
+ * the scheduler's per-pass overhead here is the time spent waiting for the bus lock.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "esp_log.h"
+#include "sensor_scheduler.h"
+#include "i2c_master.h"
+
+#include "rtos_sim.h"
+#include "tsl2561_device.h"
+#include "system_harness.h"
+
+#define DURATION (10 * 60 * 1000)   // milliseconds
+
+int main(void)
+{
+    printf("Host simulation, virtual time, %d minutes\n", DURATION / 60000);
+
+    system_harness_t harness;
+    system_harness_config_t config = { .light_sensor = true, .display_load = true, .control_loops = true, .seed = 1 };
+    system_harness_init(&harness, &config);
+    system_harness_run(&harness, DURATION);
+
+    printf("task stacks %" PRIu32 " bytes, %" PRIu32 " context switches, %" PRIu32 " light data reads, %" PRIu32 " early\n",
+           rtos_sim_stack_bytes(), rtos_sim_context_switches(), tsl2561_device_stats()->samples, tsl2561_device_stats()->early_reads);
+    fflush(stdout);
+    esp_log_level_set("sensor_scheduler", ESP_LOG_INFO);
+    esp_log_level_set("i2c", ESP_LOG_INFO);
+    sensor_scheduler_log_stats();
+    i2c_master_log_stats(harness.i2c_master_info);
+    return 0;
+}
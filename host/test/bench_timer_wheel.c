@@ -0,0 +1,227 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compares the periodic housekeeping as one task per job, as it was, with the same jobs on the
+ * timer wheel. Both run for an hour of virtual time against the same CPU load: an MQTT-like
+ * task above the housekeeping priority and a sensor-like task at it, each waking at random
+ * and holding the CPU for a random burst.
+ *
+ * Reported per structure: stack bytes of the housekeeping tasks, context switches, and the
+ * per-job lateness and jitter table. For the timer wheel the table is timer_wheel_log_stats()
+ * itself. Job periods and the old stack sizes are the firmware's; job run times and the load
+ * are assumptions, and this is the host simulation (system_harness.h), not a device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "timer_wheel.h"
+#include "utils.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+
+#define DURATION               (60 * 60 * 1000)   // milliseconds
+#define HOUSEKEEPING_PRIORITY  (4)
+#define LOAD_STACK_SIZE        (2048)
+
+typedef struct
+{
+    const char * name;
+    uint32_t period;        // milliseconds
+    uint32_t stack_size;    // bytes, of the task the job used to have
+    uint32_t run_time;      // microseconds, assumed
+} job_spec_t;
+
+static const job_spec_t JOBS[] = {
+    { "power",   10 * 1000, 4096,  200 },    // power_calculation_task
+    { "system",  60 * 1000, 4096,  500 },    // system_task
+    { "wifi",         1000, 4096,   50 },    // wifi_monitor_task
+    { "sntp",     5 * 1000, 4096,   50 },    // sntp_rtc_task
+    { "ota",          1000, 8192,   20 },    // ota_task
+    { "network",      1000, 3584,  100 },    // app_main loop, default CONFIG_MAIN_TASK_STACK_SIZE
+};
+
+#define NUM_JOBS (sizeof(JOBS) / sizeof(JOBS[0]))
+
+typedef struct
+{
+    UBaseType_t priority;
+    uint32_t max_sleep;     // milliseconds
+    uint32_t max_busy;      // microseconds
+    uint32_t seed;
+} load_spec_t;
+
+static const load_spec_t LOADS[] = {
+    { HOUSEKEEPING_PRIORITY + 1, 50, 2000, 1 },   // MQTT and publish
+    { HOUSEKEEPING_PRIORITY,     20, 3000, 2 },   // sensors, display, control
+};
+
+static uint32_t _random(uint32_t * seed, uint32_t range)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) % range;
+}
+
+static void _load_task(void * pvParameter)
+{
+    const load_spec_t * spec = (const load_spec_t *)pvParameter;
+    uint32_t seed = spec->seed;
+    while (1)
+    {
+        vTaskDelay((1 + _random(&seed, spec->max_sleep)) / portTICK_RATE_MS);
+        rtos_sim_busy_us(_random(&seed, spec->max_busy));
+    }
+}
+
+static void _start_load(void)
+{
+    for (size_t i = 0; i < sizeof(LOADS) / sizeof(LOADS[0]); ++i)
+    {
+        xTaskCreate(_load_task, "load", LOAD_STACK_SIZE, (void *)&LOADS[i], LOADS[i].priority, NULL);
+    }
+}
+
+static void _job(void * context)
+{
+    const job_spec_t * spec = (const job_spec_t *)context;
+    rtos_sim_busy_us(spec->run_time);
+}
+
+// One task per job, as before: vTaskDelayUntil, then the job. Lateness is measured against
+// the ideal deadline, as the timer wheel does.
+typedef struct
+{
+    uint32_t runs;
+    uint64_t late_total;
+    uint32_t late_max;
+    uint32_t late_last;
+    uint32_t jitter_max;
+    uint32_t duration_max;
+} task_stats_t;
+
+static task_stats_t _task_stats[NUM_JOBS];
+
+static void _job_task(void * pvParameter)
+{
+    size_t i = (const job_spec_t *)pvParameter - JOBS;
+    task_stats_t * stats = &_task_stats[i];
+    TickType_t last_wake_time = xTaskGetTickCount();
+    uint64_t due = (uint64_t)last_wake_time * portTICK_PERIOD_MS * 1000;
+    while (1)
+    {
+        uint64_t start = microseconds_since_boot();
+        uint32_t late = start - due;
+        _job((void *)&JOBS[i]);
+        uint32_t duration = microseconds_since_boot() - start;
+
+        uint32_t jitter = late > stats->late_last ? late - stats->late_last : stats->late_last - late;
+        if (stats->runs > 0 && jitter > stats->jitter_max)
+            stats->jitter_max = jitter;
+        if (late > stats->late_max)
+            stats->late_max = late;
+        if (duration > stats->duration_max)
+            stats->duration_max = duration;
+        stats->late_last = late;
+        stats->late_total += late;
+        ++stats->runs;
+
+        vTaskDelayUntil(&last_wake_time, JOBS[i].period / portTICK_RATE_MS);
+        due += (uint64_t)JOBS[i].period * 1000;
+    }
+}
+
+static void _run_tasks(void)
+{
+    for (size_t i = 0; i < NUM_JOBS; ++i)
+    {
+        xTaskCreate(_job_task, JOBS[i].name, JOBS[i].stack_size, (void *)&JOBS[i], HOUSEKEEPING_PRIORITY, NULL);
+    }
+    uint32_t stack = rtos_sim_stack_bytes();
+    _start_load();
+    rtos_sim_run_for((int64_t)DURATION * 1000);
+
+    printf("task per job: %" PRIu32 " stack bytes in %zu tasks, %" PRIu32 " context switches\n",
+           stack, NUM_JOBS, rtos_sim_context_switches());
+    printf("%-10s %8s %8s %10s %10s %10s %10s\n", "job", "runs", "overrun", "late avg", "late max", "jitter max", "run max");
+    for (size_t i = 0; i < NUM_JOBS; ++i)
+    {
+        const task_stats_t * stats = &_task_stats[i];
+        printf("%-10s %8" PRIu32 " %8s %8" PRIu64 "us %8" PRIu32 "us %8" PRIu32 "us %8" PRIu32 "us\n",
+               JOBS[i].name, stats->runs, "-", stats->runs ? stats->late_total / stats->runs : 0,
+               stats->late_max, stats->jitter_max, stats->duration_max);
+    }
+}
+
+static void _run_wheel(void)
+{
+    timer_wheel_init(HOUSEKEEPING_PRIORITY);
+    for (size_t i = 0; i < NUM_JOBS; ++i)
+    {
+        timer_wheel_add(JOBS[i].name, JOBS[i].period, _job, (void *)&JOBS[i]);
+    }
+    uint32_t stack = rtos_sim_stack_bytes();
+    _start_load();
+    rtos_sim_run_for((int64_t)DURATION * 1000);
+
+    printf("timer wheel: %" PRIu32 " stack bytes in 1 task, %" PRIu32 " context switches\n",
+           stack, rtos_sim_context_switches());
+    fflush(stdout);
+    esp_log_level_set("timer_wheel", ESP_LOG_INFO);
+    timer_wheel_log_stats();
+}
+
+int main(void)
+{
+    printf("Host simulation, virtual time, %d minutes; job run times and CPU load are assumed\n", DURATION / 60000);
+
+    void (*runs[])(void) = { _run_tasks, _run_wheel };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i)
+    {
+        // the timer wheel keeps static state, so each structure runs in its own process
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            vclock_reset(0);
+            rtos_sim_reset();
+            runs[i]();
+            fflush(NULL);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        failures += (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file check.h
+ * @brief Minimal assertions for the host tests. A failed check is reported and counted, and
+ *        the test program exits non-zero if any check failed.
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int check_failures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { ++check_failures; fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { long long _a = (long long)(actual), _e = (long long)(expected); \
+         if (_a != _e) { ++check_failures; fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #actual, #expected, _a, _e); } } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { double _a = (actual), _e = (expected); \
+         if (fabs(_a - _e) > (tolerance)) { ++check_failures; fprintf(stderr, "%s:%d: check failed: %s near %s (%g != %g)\n", __FILE__, __LINE__, #actual, #expected, _a, _e); } } while (0)
+
+#define RUN_TEST(test) \
+    do { int _before = check_failures; test(); printf("%-48s %s\n", #test, check_failures == _before ? "ok" : "FAILED"); } while (0)
+
+// Run a test in a child process, so that it starts with fresh static state in the modules under test
+#define RUN_TEST_ISOLATED(test) \
+    do { int _before = check_failures; fflush(stdout); pid_t _pid = fork(); \
+         if (_pid == 0) { test(); fflush(NULL); _exit(check_failures == _before ? 0 : 1); } \
+         int _status = 0; waitpid(_pid, &_status, 0); bool _ok = WIFEXITED(_status) && WEXITSTATUS(_status) == 0; \
+         check_failures += _ok ? 0 : 1; printf("%-48s %s\n", #test, _ok ? "ok" : "FAILED"); } while (0)
+
+#define CHECK_EXIT() (check_failures == 0 ? 0 : 1)
+
+#endif // CHECK_H
@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resources.h"
+#include "control.h"
+#include "avr_support.h"
+
+#include "vclock.h"
+#include "avr_fake.h"
+#include "runner_fake.h"
+#include "control_harness.h"
+#include "harness_defaults.h"
+
+#define TIME_ZONE          "NZST-12NZDT,M9.5.0,M4.1.0/3"
+#define PLANT_PERIOD       (1000)     // milliseconds
+
+#define ARRAY_LOSS         (0.002)    // collector loss to ambient, per second
+#define ARRAY_EXCHANGE     (0.01)     // collector to circulating water, per second
+#define POOL_EXCHANGE      (0.0001)   // circulating water to pool, per second
+#define POOL_LOSS          (0.00001)  // pool loss to ambient, per second
+#define FLOW_RATE          (12.0f)    // litres per minute with CP running
+#define FLOW_RATE_RESTRICTED (2.0f)
+
+time_t harness_local_time(int year, int month, int day, int hour, int minute)
+{
+    struct tm tm = {
+        .tm_year = year - 1900,
+        .tm_mon = month - 1,
+        .tm_mday = day,
+        .tm_hour = hour,
+        .tm_min = minute,
+        .tm_isdst = -1,
+    };
+    return mktime(&tm);
+}
+
+void harness_init(harness_t * harness, time_t wall_at_boot)
+{
+    setenv("TZ", TIME_ZONE, 1);
+    tzset();
+
+    memset(harness, 0, sizeof(*harness));
+    vclock_reset(wall_at_boot);
+    avr_fake_reset();
+    runner_fake_reset();
+
+    harness->datastore = datastore_create();
+    harness_set_defaults(harness->datastore);
+
+    plant_t * plant = &harness->plant;
+    plant->t_ambient = 20.0;
+    plant->t_pool = 22.0;
+    plant->t_array = 22.0;
+    plant->sun_gain = 0.02;
+    plant->sensors_ok = true;
+    plant->flow_ok = true;
+
+    control_init(harness->datastore);
+}
+
+void harness_delete(harness_t * harness)
+{
+    datastore_free((datastore_t **)&harness->datastore);
+}
+
+static double _sun(const plant_t * plant)
+{
+    if (plant->sun_override)
+    {
+        return plant->sun;
+    }
+
+    // daylight from 06:00 to 20:00 local time, peaking early afternoon
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    double hour = local.tm_hour + local.tm_min / 60.0 + local.tm_sec / 3600.0;
+    double sun = sin(M_PI * (hour - 6.0) / 14.0);
+    return hour > 6.0 && hour < 20.0 && sun > 0.0 ? sun * (1.0 - plant->cloud) : 0.0;
+}
+
+static void _plant_step(harness_t * harness)
+{
+    plant_t * plant = &harness->plant;
+    const datastore_t * datastore = harness->datastore;
+    bool cp_on = avr_fake_output(AVR_FAKE_OUTPUT_CP);
+
+    double exchange = cp_on ? ARRAY_EXCHANGE * (plant->t_array - plant->t_pool) : 0.0;
+    plant->t_array += plant->sun_gain * _sun(plant) - ARRAY_LOSS * (plant->t_array - plant->t_ambient) - exchange;
+    double gain = cp_on ? POOL_EXCHANGE * (plant->t_array - plant->t_pool) : 0.0;
+    plant->t_pool += gain - POOL_LOSS * (plant->t_pool - plant->t_ambient);
+    plant->pool_gain += gain;
+    plant->cp_run_time += cp_on ? 1.0 : 0.0;
+
+    // the AVR task publishes the pump state when it changes
+    if (cp_on != harness->cp_on)
+    {
+        harness->cp_on = cp_on;
+        plant->cp_starts += cp_on ? 1 : 0;
+        datastore_set_uint32(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, cp_on ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
+    }
+
+    if (plant->flow_ok)
+    {
+        float flow = cp_on ? (plant->flow_restricted ? FLOW_RATE_RESTRICTED : FLOW_RATE) : 0.0f;
+        datastore_set_float(datastore, RESOURCE_ID_FLOW_RATE, 0, flow);
+    }
+}
+
+// DS18B20 12-bit resolution
+static float _quantise(double t)
+{
+    return (float)(floor(t * 16.0 + 0.5) / 16.0);
+}
+
+static void _publish_temps(harness_t * harness)
+{
+    if (harness->plant.sensors_ok)
+    {
+        datastore_set_float(harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, _quantise(harness->plant.t_pool));
+        datastore_set_float(harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, _quantise(harness->plant.t_array));
+    }
+}
+
+static void _tick(harness_t * harness)
+{
+    vclock_advance(HARNESS_TICK_MS * 1000);
+    ++harness->ticks;
+    uint32_t elapsed_ms = harness->ticks * HARNESS_TICK_MS;
+    if (elapsed_ms % PLANT_PERIOD == 0)
+    {
+        _plant_step(harness);
+    }
+    if (elapsed_ms % HARNESS_TEMP_PERIOD == 0)
+    {
+        _publish_temps(harness);
+    }
+    runner_fake_run();
+}
+
+void harness_run(harness_t * harness, uint32_t seconds)
+{
+    for (uint32_t i = 0; i < seconds * (1000 / HARNESS_TICK_MS); ++i)
+    {
+        _tick(harness);
+    }
+}
+
+bool harness_run_until(harness_t * harness, bool (*predicate)(const harness_t *), uint32_t timeout_seconds)
+{
+    for (uint32_t i = 0; i < timeout_seconds * (1000 / HARNESS_TICK_MS); ++i)
+    {
+        if (predicate(harness))
+        {
+            return true;
+        }
+        _tick(harness);
+    }
+    return predicate(harness);
+}
@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file control_harness.h
+ * @brief Runs control.c against a simple thermal model of the pool, collector and pumps,
+ *        in virtual time.
+ *
+ * Every harness tick advances the virtual clock by HARNESS_TICK_MS and runs the control
+ * coroutines, as the coroutine runner does on the device. Once per second the plant is
+ * integrated and the flow rate published; the temperatures are published every temperature
+ * poll period at the DS18B20's 1/16 degree resolution, like the sensor task. The pump outputs requested by the control loops are read
+ * back from the AVR fake, and the CP state is published when it changes, like the AVR task.
+ */
+
+#ifndef CONTROL_HARNESS_H
+#define CONTROL_HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "datastore/datastore.h"
+#include "coroutine_runner.h"
+
+#define HARNESS_TICK_MS  (COROUTINE_RUNNER_POLL_PERIOD)
+
+typedef struct
+{
+    double t_pool;            ///< degrees C
+    double t_array;           ///< degrees C
+    double t_ambient;         ///< degrees C
+    double sun_gain;          ///< collector heating at full sun, degrees C per second
+    bool sun_override;        ///< use sun instead of the time-of-day model
+    double sun;               ///< 0 (night) to 1 (full sun), if sun_override
+    double cloud;             ///< fraction of the time-of-day sun blocked by cloud
+    bool sensors_ok;          ///< publish temperature measurements
+    bool flow_ok;             ///< publish flow rate measurements
+    bool flow_restricted;     ///< flow stays below the purge threshold while CP runs (air in the line)
+    double cp_run_time;       ///< circulation pump running time, seconds
+    uint32_t cp_starts;       ///< number of circulation pump starts
+    double pool_gain;         ///< pool temperature rise delivered by the collector, degrees C
+} plant_t;
+
+typedef struct
+{
+    const datastore_t * datastore;
+    plant_t plant;
+    bool cp_on;               ///< circulation pump state as last published
+    uint32_t ticks;
+} harness_t;
+
+// Create a datastore with the application defaults, start the control loops and place the
+// plant at night with the collector at pool temperature. The wall clock starts at wall_at_boot,
+// interpreted in New Zealand local time.
+void harness_init(harness_t * harness, time_t wall_at_boot);
+void harness_delete(harness_t * harness);
+
+// Run for the given number of virtual seconds
+void harness_run(harness_t * harness, uint32_t seconds);
+
+// Run until the predicate is true or the timeout expires. Returns true if the predicate was met.
+bool harness_run_until(harness_t * harness, bool (*predicate)(const harness_t *), uint32_t timeout_seconds);
+
+// Wall clock time for a local date and time, in the harness time zone
+time_t harness_local_time(int year, int month, int day, int hour, int minute);
+
+#endif // CONTROL_HARNESS_H
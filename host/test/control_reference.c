@@ -0,0 +1,182 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * As control_logic.c at the introduction of the pure step functions, before the fsm engine.
+ */
+
+#include <string.h>
+
+#include "control_reference.h"
+
+#define PP_HOLD_OFF (30 * 1000000)
+
+static void _add_event(control_outputs_t * outputs, uint32_t state, bool pump_on, control_reason_t reason, uint32_t cycle)
+{
+    if (outputs->num_events < CONTROL_MAX_EVENTS)
+    {
+        control_event_t * event = &outputs->events[outputs->num_events++];
+        event->state = state;
+        event->pump_on = pump_on;
+        event->reason = reason;
+        event->cycle = cycle;
+    }
+}
+
+static void _pp_transition(reference_pp_t * pp, control_pp_state_t state, bool pump_on, control_reason_t reason, control_outputs_t * outputs)
+{
+    pp->state = state;
+    _add_event(outputs, state, pump_on, reason, pp->n);
+}
+
+void reference_cp_init(reference_cp_t * cp)
+{
+    memset(cp, 0, sizeof(*cp));
+    cp->state = CONTROL_CP_STATE_OFF;
+}
+
+void reference_cp_step(reference_cp_t * cp, const control_cp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs)
+{
+    outputs->num_events = 0;
+
+    if (inputs->temps_valid)
+    {
+        float delta = inputs->t_high - inputs->t_low;
+        if (cp->state == CONTROL_CP_STATE_OFF)
+        {
+            if (delta >= inputs->on_delta)
+            {
+                cp->state = CONTROL_CP_STATE_ON;
+                _add_event(outputs, cp->state, true, CONTROL_REASON_CP_DELTA_ON, 0);
+            }
+        }
+        else
+        {
+            if (delta <= inputs->off_delta)
+            {
+                cp->state = CONTROL_CP_STATE_OFF;
+                _add_event(outputs, cp->state, false, CONTROL_REASON_CP_DELTA_OFF, 0);
+            }
+        }
+    }
+
+    // a state change already drives the output, so only refresh if there wasn't one
+    if (inputs->refresh && outputs->num_events == 0)
+    {
+        _add_event(outputs, cp->state, cp->state == CONTROL_CP_STATE_ON, CONTROL_REASON_CP_REFRESH, 0);
+    }
+}
+
+void reference_pp_init(reference_pp_t * pp)
+{
+    memset(pp, 0, sizeof(*pp));
+    pp->state = CONTROL_PP_STATE_OFF;
+}
+
+void reference_pp_step(reference_pp_t * pp, const control_pp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs)
+{
+    outputs->num_events = 0;
+
+    // If the array temperature exceeds the safe threshold, immediately run the
+    // purge pump until the temperature returns to a safe level
+    if (inputs->t_high_valid)
+    {
+        if (pp->state == CONTROL_PP_STATE_EMERGENCY)
+        {
+            if (inputs->t_high < inputs->safe_temp_low)
+            {
+                _pp_transition(pp, CONTROL_PP_STATE_OFF, false, CONTROL_REASON_PP_SAFE_RESTORED, outputs);
+            }
+            else
+            {
+                // keep the PP running
+                // TODO: in the case of emergency, do we cycle the PP?
+                // TODO: sound alarm?
+                // TODO: what to do if the temperature isn't dropping?
+            }
+        }
+        else
+        {
+            if (inputs->t_high >= inputs->safe_temp_high)
+            {
+                _pp_transition(pp, CONTROL_PP_STATE_EMERGENCY, true, CONTROL_REASON_PP_EMERGENCY, outputs);
+            }
+        }
+    }
+
+    switch (pp->state)
+    {
+        case CONTROL_PP_STATE_OFF:
+            if (inputs->auto_mode && inputs->flow_valid)
+            {
+                bool low_flow = inputs->cp_pump_on
+                                && (inputs->flow_rate <= inputs->flow_threshold)
+                                && (inputs->cp_state_age > PP_HOLD_OFF);
+                if (inputs->daily_trigger || low_flow)
+                {
+                    pp->n = inputs->cycle_count;
+                    pp->cycle_start_time = now;
+                    _pp_transition(pp, CONTROL_PP_STATE_ON, true,
+                                   inputs->daily_trigger ? CONTROL_REASON_PP_TIME_OF_DAY : CONTROL_REASON_PP_LOW_FLOW, outputs);
+                    --pp->n;
+                }
+            }
+            break;
+
+        case CONTROL_PP_STATE_ON:
+            if (now >= pp->cycle_start_time + inputs->on_duration)
+            {
+                pp->cycle_start_time = now;
+                _pp_transition(pp, CONTROL_PP_STATE_PAUSE, false, CONTROL_REASON_PP_CYCLE_PAUSE, outputs);
+            }
+            break;
+
+        case CONTROL_PP_STATE_PAUSE:
+            if (now >= pp->cycle_start_time + inputs->pause_duration)
+            {
+                if (pp->n > 0)
+                {
+                    pp->cycle_start_time = now;
+                    _pp_transition(pp, CONTROL_PP_STATE_ON, true, CONTROL_REASON_PP_CYCLE_ON, outputs);
+                    --pp->n;
+                }
+                else
+                {
+                    _pp_transition(pp, CONTROL_PP_STATE_OFF, false, CONTROL_REASON_PP_CYCLE_DONE, outputs);
+                }
+            }
+            break;
+
+        case CONTROL_PP_STATE_EMERGENCY:
+        default:
+            // no-op
+            break;
+    }
+
+    // if PP in manual mode, drop out of cycle
+    if ((pp->state == CONTROL_PP_STATE_ON || pp->state == CONTROL_PP_STATE_PAUSE) && !inputs->auto_mode)
+    {
+        _pp_transition(pp, CONTROL_PP_STATE_OFF, false, CONTROL_REASON_PP_MANUAL, outputs);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file control_reference.h
+ * @brief The hand-written CP and PP step functions that preceded the table-driven state
+ *        machines in control_logic.c, kept as a reference for differential testing.
+ *
+ * Inputs and outputs are the current control_logic.h types; prediction is not part of the
+ * reference, so it must be compared with predict_horizon set to 0.
+ */
+
+#ifndef CONTROL_REFERENCE_H
+#define CONTROL_REFERENCE_H
+
+#include "control_logic.h"
+
+typedef struct
+{
+    control_cp_state_t state;
+} reference_cp_t;
+
+typedef struct
+{
+    control_pp_state_t state;
+    uint32_t cycle_start_time;   ///< start of the current ON or PAUSE period, in seconds
+    uint32_t n;                  ///< remaining ON periods in the current purge cycle
+} reference_pp_t;
+
+void reference_cp_init(reference_cp_t * cp);
+void reference_cp_step(reference_cp_t * cp, const control_cp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs);
+
+void reference_pp_init(reference_pp_t * pp);
+void reference_pp_step(reference_pp_t * pp, const control_pp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs);
+
+#endif // CONTROL_REFERENCE_H
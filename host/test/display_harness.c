@@ -0,0 +1,197 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+
+#include "resources.h"
+#include "constants.h"
+#include "timer_wheel.h"
+#include "i2c_master.h"
+#include "sensor_temp.h"
+#include "wifi_support.h"
+#include "mqtt.h"
+#include "trend.h"
+#include "led.h"
+#include "display.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "lcd_device.h"
+#include "input_fake.h"
+#include "harness_defaults.h"
+#include "display_harness.h"
+
+// as app_main, with CONFIG_ESP_MQTT_TASK_STACK_PRIORITY 5
+#define PUBLISH_PRIORITY       5
+#define DISPLAY_PRIORITY       (PUBLISH_PRIORITY - 1)
+#define SENSOR_PRIORITY        (PUBLISH_PRIORITY - 1)
+#define HOUSEKEEPING_PRIORITY  SENSOR_PRIORITY
+
+#define FLOW_PERIOD            (1000)   // milliseconds
+#define LIGHT_PERIOD           (5000)   // milliseconds, sensor_light.c
+
+static const datastore_t * _datastore = NULL;
+
+// Sensor values: temperatures and power every temperature period, flow every second and light
+// every light period, each varying a little from sample to sample
+static void _sensor_task(void * pvParameter)
+{
+    TickType_t last_wake_time = xTaskGetTickCount();
+    for (uint32_t second = 0; ; ++second)
+    {
+        float wobble = (second % 7) * 0.1f;
+        datastore_set_float(_datastore, RESOURCE_ID_FLOW_FREQUENCY, 0, 40.0f + wobble);
+        datastore_set_float(_datastore, RESOURCE_ID_FLOW_RATE, 0, 12.0f + wobble);
+        if (second % (HARNESS_TEMP_PERIOD / FLOW_PERIOD) == 0)
+        {
+            for (datastore_instance_id_t i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
+            {
+                datastore_set_float(_datastore, RESOURCE_ID_TEMP_VALUE, i, 20.0f + 5.0f * i + wobble);
+            }
+            datastore_set_float(_datastore, RESOURCE_ID_POWER_TEMP_DELTA, 0, 1.5f + wobble);
+            datastore_set_float(_datastore, RESOURCE_ID_POWER_VALUE, 0, 1250.0f + 10.0f * wobble);
+        }
+        if (second % (LIGHT_PERIOD / FLOW_PERIOD) == 0)
+        {
+            datastore_set_uint32(_datastore, RESOURCE_ID_LIGHT_FULL, 0, 1200 + second % 7);
+            datastore_set_uint32(_datastore, RESOURCE_ID_LIGHT_VISIBLE, 0, 900 + second % 7);
+            datastore_set_uint32(_datastore, RESOURCE_ID_LIGHT_INFRARED, 0, 300);
+            datastore_set_uint32(_datastore, RESOURCE_ID_LIGHT_ILLUMINANCE, 0, 250 + second % 7);
+        }
+        vTaskDelayUntil(&last_wake_time, FLOW_PERIOD / portTICK_RATE_MS);
+    }
+}
+
+// Values set once at boot by app_main, the network tasks and the AVR task
+static void _set_boot_values(const datastore_t * datastore)
+{
+    harness_set_defaults(datastore);
+    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_VERSION, 0, "1.2");
+    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_BUILD_DATE_TIME, 0, "2026-10-17 09:30");
+    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_BUILD_GIT_COMMIT, 0, "0123456789abcdef0123");
+    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, DISPLAY_HARNESS_LOG);
+    datastore_set_uint32(datastore, RESOURCE_ID_DISPLAY_BACKLIGHT_TIMEOUT, 0, 0);   // stays on
+    datastore_set_bool(datastore, RESOURCE_ID_LIGHT_DETECTED, 0, true);
+    for (datastore_instance_id_t i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
+    {
+        const char * labels[SENSOR_TEMP_INSTANCES] = { "Pool", "Array", "Roof", "Air", "Spare" };
+        datastore_set_string(datastore, RESOURCE_ID_TEMP_LABEL, i, labels[i]);
+    }
+    datastore_set_uint32(datastore, RESOURCE_ID_WIFI_STATUS, 0, WIFI_STATUS_GOT_ADDRESS);
+    datastore_set_string(datastore, RESOURCE_ID_WIFI_SSID, 0, "poolshed");
+    datastore_set_uint32(datastore, RESOURCE_ID_WIFI_ADDRESS, 0, 0x2a01a8c0);   // 192.168.1.42
+    datastore_set_uint32(datastore, RESOURCE_ID_MQTT_STATUS, 0, MQTT_STATUS_CONNECTED);
+    datastore_set_string(datastore, RESOURCE_ID_MQTT_BROKER_ADDRESS, 0, "broker.lan");
+    datastore_set_uint32(datastore, RESOURCE_ID_MQTT_BROKER_PORT, 0, 1883);
+    datastore_set_uint8(datastore, RESOURCE_ID_AVR_VERSION, 0, 1);
+    datastore_set_uint32(datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, 1);
+}
+
+void display_harness_init(display_harness_t * harness)
+{
+    memset(harness, 0, sizeof(*harness));
+
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    input_fake_reset();
+
+    harness->datastore = datastore_create();
+    _datastore = harness->datastore;
+    _set_boot_values(harness->datastore);
+
+    timer_wheel_init(HOUSEKEEPING_PRIORITY);
+    lcd_device_attach(I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS);
+    harness->i2c_master_info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, harness->datastore);
+    trend_init(harness->datastore);
+    xTaskCreate(_sensor_task, "sensor_task", 4096, NULL, SENSOR_PRIORITY, NULL);
+    display_init(harness->i2c_master_info, DISPLAY_PRIORITY, harness->datastore);
+}
+
+void display_harness_run(display_harness_t * harness, uint32_t milliseconds)
+{
+    rtos_sim_run_for((int64_t)milliseconds * 1000);
+}
+
+bool display_harness_run_until(display_harness_t * harness, bool (*predicate)(const display_harness_t *), uint32_t timeout_ms)
+{
+    for (uint32_t i = 0; i < timeout_ms; ++i)
+    {
+        if (predicate(harness))
+        {
+            return true;
+        }
+        rtos_sim_run_for(1000);
+    }
+    return predicate(harness);
+}
+
+bool display_harness_input(display_harness_t * harness, int event)
+{
+    return input_fake_send(event);
+}
+
+display_page_id_t display_harness_page(const display_harness_t * harness)
+{
+    int32_t page = DISPLAY_PAGE_IGNORE;
+    datastore_get_int32(harness->datastore, RESOURCE_ID_DISPLAY_PAGE, 0, &page);
+    return (display_page_id_t)page;
+}
+
+// Stand-ins for the LED and the heap queries used by the page handlers
+
+void led_init(uint8_t gpio)
+{
+}
+
+void led_on(void)
+{
+}
+
+void led_off(void)
+{
+}
+
+void led_flash(int on_ms, int off_ms, int num)
+{
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return 120 * 1024;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 60 * 1024;
+}
@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file display_harness.h
+ * @brief Runs the display task on the simulated scheduler and I2C bus, in virtual time.
+ *
+ * display.c runs unchanged at its app_main priority, driving the i2c-lcd1602 stand-in and its
+ * own bursts into the HD44780 model (lcd_device.h), so the rows the model shows are what the
+ * LCD would show. Button and knob events are posted to the display's input queue through the
+ * driver stand-ins (input_fake.h). A sensor task publishes temperatures, light, flow and power
+ * at the application's sampling periods, and the timer wheel runs the trend sampling and the
+ * I2C statistics job, so pages are re-rendered by the same datastore changes as on the device.
+ *
+ * Only bus transactions, delays and busy-waits take virtual time; CPU time is not modelled.
+ */
+
+#ifndef DISPLAY_HARNESS_H
+#define DISPLAY_HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "datastore/datastore.h"
+#include "i2c_master.h"
+#include "display.h"
+
+#define DISPLAY_HARNESS_LOG  "AVR reset detected at boot - CONTROL restored"
+
+typedef struct
+{
+    const datastore_t * datastore;
+    i2c_master_info_t * i2c_master_info;
+} display_harness_t;
+
+// Reset the simulation and start the tasks. display_init() runs once per process, so run each
+// scenario in its own process.
+void display_harness_init(display_harness_t * harness);
+
+// Run all tasks for the given number of virtual milliseconds
+void display_harness_run(display_harness_t * harness, uint32_t milliseconds);
+
+// Run until the predicate is true, checking every millisecond. Returns true if it was met.
+bool display_harness_run_until(display_harness_t * harness, bool (*predicate)(const display_harness_t *), uint32_t timeout_ms);
+
+// Post a button or knob event to the display task
+bool display_harness_input(display_harness_t * harness, int event);
+
+// Page the display task last switched to, as published in DISPLAY_PAGE
+display_page_id_t display_harness_page(const display_harness_t * harness);
+
+#endif // DISPLAY_HARNESS_H
@@ -0,0 +1,62 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "resources.h"
+#include "control.h"
+#include "avr_support.h"
+
+#include "harness_defaults.h"
+
+void harness_set_defaults(const datastore_t * datastore)
+{
+    // as nvs_support.c
+    datastore_set_uint32(datastore, RESOURCE_ID_TEMP_PERIOD, 0, HARNESS_TEMP_PERIOD);
+    for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+    {
+        datastore_set_float(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, i, 7.0f);
+        datastore_set_float(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, i, 5.0f);
+        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, i, 0);
+    }
+    datastore_set_float(datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 0, 8.0f);
+    datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, 0, 9);
+    datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0, 0);
+    datastore_set_uint8(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, 0, 127);
+    for (size_t i = 1; i < CONTROL_PP_DAILY_INSTANCES; ++i)
+    {
+        datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, i, -1);
+        datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, i, -1);
+        datastore_set_uint8(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, i, 127);
+    }
+    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT, 0, 5);
+    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION, 0, 30);
+    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_PAUSE_DURATION, 0, 60);
+    datastore_set_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH, 0, 80.0f);
+    datastore_set_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_LOW, 0, 60.0f);
+    datastore_set_bool(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, false);
+
+    // as the AVR task and SNTP would report once running
+    datastore_set_uint32(datastore, RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 0, AVR_SWITCH_MODE_AUTO);
+    datastore_set_uint32(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, AVR_PUMP_STATE_OFF);
+    datastore_set_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, true);
+}
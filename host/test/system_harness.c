@@ -0,0 +1,294 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "resources.h"
+#include "timer_wheel.h"
+#include "coroutine_runner.h"
+#include "i2c_master.h"
+#include "avr_support.h"
+#include "sensor_scheduler.h"
+#include "sensor_light.h"
+#include "control.h"
+#include "led.h"
+#include "display.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "avr_device.h"
+#include "tsl2561_device.h"
+#include "harness_defaults.h"
+#include "system_harness.h"
+
+// as app_main, with CONFIG_ESP_MQTT_TASK_STACK_PRIORITY 5
+#define PUBLISH_PRIORITY       5
+#define DISPLAY_PRIORITY       (PUBLISH_PRIORITY - 1)
+#define SENSOR_PRIORITY        (PUBLISH_PRIORITY - 1)
+#define AVR_PRIORITY           (SENSOR_PRIORITY + 1)
+#define CONTROL_PRIORITY       SENSOR_PRIORITY
+#define HOUSEKEEPING_PRIORITY  SENSOR_PRIORITY
+
+#define TEMP_CONVERSION        (750)    // milliseconds, DS18B20 12-bit
+#define FLOW_PERIOD            (1000)   // milliseconds
+#define FLOW_RATE              (12.0f)  // litres per minute with CP running
+
+// display.c
+#define DISPLAY_PERIOD         (500)    // milliseconds between renders
+#define LCD_ROWS               (4)
+#define LCD_COLUMNS            (20)
+#define PORT_WRITES_PER_BYTE   (6)      // two nibbles, each written with E low, high, low
+#define GLYPH_HEIGHT           (8)
+#define GLYPH_SLOTS            (4)
+
+static system_harness_t * _harness = NULL;
+
+// Temperature and flow, published from the sensor task like the one-wire and PCNT drivers
+
+static bool _temp_collect(sensor_driver_t * driver)
+{
+    return _harness->sensors_ok;
+}
+
+static void _temp_publish(sensor_driver_t * driver, bool ok)
+{
+    if (ok)
+    {
+        datastore_set_float(_harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, _harness->t_pool);
+        _harness->t_array_published = vclock_now();
+        datastore_set_float(_harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, _harness->t_array);
+    }
+}
+
+static sensor_driver_t _temp_driver = {
+    .name = "temp",
+    .bus = SENSOR_BUS_ONE_WIRE,
+    .period = HARNESS_TEMP_PERIOD,
+    .delay = TEMP_CONVERSION,
+    .collect = _temp_collect,
+    .publish = _temp_publish,
+};
+
+static bool _flow_collect(sensor_driver_t * driver)
+{
+    return true;
+}
+
+static void _flow_publish(sensor_driver_t * driver, bool ok)
+{
+    uint32_t cp_state = AVR_PUMP_STATE_OFF;
+    datastore_get_uint32(_harness->datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, &cp_state);
+    datastore_set_float(_harness->datastore, RESOURCE_ID_FLOW_RATE, 0, cp_state == AVR_PUMP_STATE_ON ? FLOW_RATE : 0.0f);
+}
+
+static sensor_driver_t _flow_driver = {
+    .name = "flow",
+    .bus = SENSOR_BUS_PCNT,
+    .period = FLOW_PERIOD,
+    .collect = _flow_collect,
+    .publish = _flow_publish,
+};
+
+// LCD backpack: a PCF8574 port expander acknowledges every write
+
+static bool _lcd_start(void * context, bool read)
+{
+    return true;
+}
+
+static bool _lcd_write(void * context, uint8_t value)
+{
+    return true;
+}
+
+static uint8_t _lcd_read(void * context)
+{
+    return 0xff;
+}
+
+static const i2c_sim_device_t LCD_DEVICE = { _lcd_start, _lcd_write, _lcd_read, NULL };
+
+// Display bus load, yielding before each glyph load and each row as _render_page_buffer does
+
+static uint32_t _seed = 1;
+
+static uint32_t _random(uint32_t range)
+{
+    _seed = _seed * 1103515245u + 12345u;
+    return (_seed >> 16) % range;
+}
+
+static void _lcd_burst(const i2c_master_info_t * info, smbus_info_t * smbus_info, size_t bytes)
+{
+    static uint8_t burst[(LCD_COLUMNS + 1) * PORT_WRITES_PER_BYTE] = { 0 };
+    i2c_cmd_handle_t cmd = i2c_master_build_write(CONFIG_LCD1602_I2C_ADDRESS, burst, bytes * PORT_WRITES_PER_BYTE);
+    i2c_master_run(info, cmd, 1000 / portTICK_RATE_MS);
+    i2c_cmd_link_delete(cmd);
+}
+
+// i2c_lcd1602_define_char: the CGRAM address and each glyph row, one port write per transaction
+static void _define_glyph(smbus_info_t * smbus_info)
+{
+    for (size_t i = 0; i < (1 + GLYPH_HEIGHT) * PORT_WRITES_PER_BYTE; ++i)
+    {
+        smbus_send_byte(smbus_info, 0);
+    }
+}
+
+static void _display_load_task(void * pvParameter)
+{
+    const i2c_master_info_t * info = (const i2c_master_info_t *)pvParameter;
+    smbus_info_t * smbus_info = smbus_malloc();
+    smbus_init(smbus_info, info->port, CONFIG_LCD1602_I2C_ADDRESS);
+
+    // like the display task, wait a period after each render rather than rendering at a
+    // fixed rate, so the renders drift against the sensor schedule
+    vTaskDelay(_random(DISPLAY_PERIOD) / portTICK_RATE_MS);
+    while (1)
+    {
+        vTaskDelay(DISPLAY_PERIOD / portTICK_RATE_MS);
+
+        // usually a clock or value update, sometimes a new page with its glyphs
+        bool new_page = _random(10) == 0;
+        size_t glyphs = new_page ? _random(GLYPH_SLOTS + 1) : 0;
+
+        i2c_master_lock(info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
+        for (size_t i = 0; i < glyphs; ++i)
+        {
+            i2c_master_yield(info, I2C_MASTER_CLIENT_DISPLAY);
+            _define_glyph(smbus_info);
+        }
+        for (int row = 0; row < LCD_ROWS; ++row)
+        {
+            i2c_master_yield(info, I2C_MASTER_CLIENT_DISPLAY);
+            size_t run = new_page ? LCD_COLUMNS : (_random(2) ? 1 + _random(4) : 0);
+            if (run > 0)
+            {
+                // cursor move and characters
+                _lcd_burst(info, smbus_info, 1 + run);
+            }
+        }
+        i2c_master_unlock(info);
+    }
+}
+
+void system_harness_init(system_harness_t * harness, const system_harness_config_t * config)
+{
+    memset(harness, 0, sizeof(*harness));
+    _harness = harness;
+    _seed = config->seed ? config->seed : 1;
+
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+
+    harness->t_pool = 25.0f;
+    harness->t_array = 30.0f;
+    harness->sensors_ok = true;
+
+    harness->datastore = datastore_create();
+    harness_set_defaults(harness->datastore);
+    datastore_set_uint8(harness->datastore, RESOURCE_ID_LIGHT_I2C_ADDRESS, 0, CONFIG_LIGHT_SENSOR_I2C_ADDRESS);
+
+    timer_wheel_init(HOUSEKEEPING_PRIORITY);
+    coroutine_runner_init(CONTROL_PRIORITY);
+
+    avr_device_attach(I2C_MASTER_NUM, CONFIG_AVR_I2C_ADDRESS, CONFIG_AVR_RESET_GPIO);
+#if defined(CONFIG_AVR_ATTENTION)
+    if (config->attention_line)
+    {
+        avr_device_attach_attention(CONFIG_AVR_ATTENTION_GPIO);
+    }
+#endif
+    tsl2561_device_attach(I2C_MASTER_NUM, CONFIG_LIGHT_SENSOR_I2C_ADDRESS);
+    tsl2561_device_set_counts(1200, 300);
+    i2c_sim_attach(I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS, &LCD_DEVICE, NULL);
+
+    harness->i2c_master_info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, harness->datastore);
+    if (config->display_load)
+    {
+        xTaskCreate(_display_load_task, "display_task", 4096, harness->i2c_master_info, DISPLAY_PRIORITY, NULL);
+    }
+    sensor_scheduler_init(harness->i2c_master_info, SENSOR_PRIORITY, harness->datastore);
+    sensor_scheduler_add(&_temp_driver);
+    sensor_scheduler_add(&_flow_driver);
+    avr_support_init(harness->i2c_master_info, AVR_PRIORITY, harness->datastore);
+    if (config->light_sensor)
+    {
+        sensor_light_init(harness->i2c_master_info, harness->datastore);
+    }
+    if (config->control_loops)
+    {
+        control_init(harness->datastore);
+    }
+}
+
+void system_harness_run(system_harness_t * harness, uint32_t milliseconds)
+{
+    rtos_sim_run_for((int64_t)milliseconds * 1000);
+}
+
+bool system_harness_run_until(system_harness_t * harness, bool (*predicate)(const system_harness_t *), uint32_t timeout_ms)
+{
+    for (uint32_t i = 0; i < timeout_ms; ++i)
+    {
+        if (predicate(harness))
+        {
+            return true;
+        }
+        rtos_sim_run_for(1000);
+    }
+    return predicate(harness);
+}
+
+// Stand-ins for the LED and the display page query used by the sensor scheduler
+
+void led_init(uint8_t gpio)
+{
+}
+
+void led_on(void)
+{
+}
+
+void led_off(void)
+{
+}
+
+void led_flash(int on_ms, int off_ms, int num)
+{
+}
+
+bool display_is_currently(const datastore_t * datastore, display_page_id_t page)
+{
+    return false;
+}
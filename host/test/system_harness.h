@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file system_harness.h
+ * @brief Runs the application's tasks on the simulated scheduler and I2C bus, in virtual time.
+ *
+ * The timer wheel, coroutine runner, I2C master, AVR task, sensor scheduler with the light
+ * sensor driver, and the control loops run unchanged, at their app_main priorities. The AVR
+ * (avr_sim behind the bus), the TSL2561 and the LCD backpack are device models on the bus.
+ * Without the control loops, a test drives the pump outputs through avr_support directly.
+ * The display task is replaced by a bus load with the shape of its render: every update,
+ * under one display lock, any glyph loads and then the changed rows as one transaction each,
+ * yielding before each glyph load and row. The temperature and flow drivers publish the plant
+ * values below from the sensor task, as the real drivers do, without the one-wire and PCNT
+ * hardware.
+ *
+ * Only bus transactions, delays and waits take virtual time; CPU time is not modelled, so
+ * every figure is a lower bound set by the bus and the task structure, not a measurement.
+ */
+
+#ifndef SYSTEM_HARNESS_H
+#define SYSTEM_HARNESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "datastore/datastore.h"
+#include "i2c_master.h"
+
+typedef struct
+{
+    bool light_sensor;          // register the light sensor driver
+    bool display_load;          // run the display bus load
+    bool control_loops;         // run the CP and PP control loops
+    bool attention_line;        // the AVR drives its attention line (builds with CONFIG_AVR_ATTENTION)
+    uint32_t seed;              // for the display load
+} system_harness_config_t;
+
+typedef struct
+{
+    const datastore_t * datastore;
+    i2c_master_info_t * i2c_master_info;
+
+    // plant values published by the temperature and flow drivers
+    float t_pool;
+    float t_array;
+    bool sensors_ok;
+
+    int64_t t_array_published;  // microseconds, when t_array was last published
+} system_harness_t;
+
+// Reset the simulation and start the tasks. Only one harness may exist in a process, as the
+// modules under test keep static state - run each scenario in its own process.
+void system_harness_init(system_harness_t * harness, const system_harness_config_t * config);
+
+// Run all tasks for the given number of virtual milliseconds
+void system_harness_run(system_harness_t * harness, uint32_t milliseconds);
+
+// Run until the predicate is true, checking every millisecond. Returns true if it was met.
+bool system_harness_run_until(system_harness_t * harness, bool (*predicate)(const system_harness_t *), uint32_t timeout_ms);
+
+#endif // SYSTEM_HARNESS_H
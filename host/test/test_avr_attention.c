@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The AVR task with CONFIG_AVR_ATTENTION: the AVR model drives its attention line through the
+ * GPIO fake, and the task polls on its falling edge and otherwise only every 5 s. Built with
+ * CONFIG_AVR_ATTENTION defined (see the Makefile). Each test runs in its own process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "resources.h"
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+
+#include "vclock.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "avr_sim.h"
+#include "system_harness.h"
+#include "check.h"
+
+#define STATS_WAIT  (65 * 1000)    // milliseconds, past the first one-minute stats publish
+
+static void _init(system_harness_t * harness, bool attention_line)
+{
+    system_harness_config_t config = { .attention_line = attention_line, .seed = 1 };
+    system_harness_init(harness, &config);
+}
+
+static uint32_t _get(const system_harness_t * harness, datastore_resource_id_t id)
+{
+    uint32_t value = 0;
+    datastore_get_uint32(harness->datastore, id, 0, &value);
+    return value;
+}
+
+static bool _switch_seen(const system_harness_t * harness)
+{
+    return _get(harness, RESOURCE_ID_SWITCHES_CP_MODE_VALUE) != 0;
+}
+
+// Nothing changes: only the safety poll reads the registers, twelve times a minute
+static void test_idle_safety_poll(void)
+{
+    system_harness_t harness;
+    _init(&harness, true);
+    system_harness_run(&harness, STATS_WAIT);
+
+    uint32_t polls = _get(&harness, RESOURCE_ID_AVR_COUNT_POLL);
+    CHECK(polls >= 11 && polls <= 14);
+    CHECK_EQ(_get(&harness, RESOURCE_ID_AVR_COUNT_ATTENTION), 0);
+    CHECK_EQ(gpio_fake_interrupts(CONFIG_AVR_ATTENTION_GPIO), 0);
+    CHECK_EQ(gpio_get_level(CONFIG_AVR_ATTENTION_GPIO), 1);
+}
+
+// A switch change asserts the line, and the poll it triggers reads the change and releases it
+static void test_switch_attention(void)
+{
+    system_harness_t harness;
+    _init(&harness, true);
+    system_harness_run(&harness, 7 * 1000 + 500);
+
+    int64_t changed = vclock_now();
+    avr_sim_set_switches(AVR_SIM_SWITCH_CP_MODE);
+    CHECK(avr_sim_attention());
+    CHECK_EQ(gpio_get_level(CONFIG_AVR_ATTENTION_GPIO), 0);
+    CHECK(system_harness_run_until(&harness, _switch_seen, 1000));
+    CHECK(vclock_now() - changed < 10 * 1000);
+
+    CHECK(!avr_sim_attention());
+    CHECK_EQ(gpio_get_level(CONFIG_AVR_ATTENTION_GPIO), 1);
+    CHECK_EQ(gpio_fake_interrupts(CONFIG_AVR_ATTENTION_GPIO), 1);
+
+    system_harness_run(&harness, STATS_WAIT);
+    CHECK_EQ(_get(&harness, RESOURCE_ID_AVR_COUNT_ATTENTION), 1);
+}
+
+// An edge that never arrives is covered by the safety poll
+static void test_missed_edge(void)
+{
+    system_harness_t harness;
+    _init(&harness, false);
+    system_harness_run(&harness, 7 * 1000 + 500);
+
+    avr_sim_set_switches(AVR_SIM_SWITCH_CP_MODE);
+    CHECK_EQ(gpio_get_level(CONFIG_AVR_ATTENTION_GPIO), 1);
+    CHECK(!system_harness_run_until(&harness, _switch_seen, 250));
+    CHECK(system_harness_run_until(&harness, _switch_seen, 5 * 1000));
+}
+
+// Without the interrupt service the task falls back to the 250 ms poll
+static void test_isr_service_unavailable(void)
+{
+    system_harness_t harness;
+    _init(&harness, true);
+    gpio_fake_fail_isr_service(true);    // before the AVR task first runs
+    system_harness_run(&harness, STATS_WAIT);
+
+    uint32_t polls = _get(&harness, RESOURCE_ID_AVR_COUNT_POLL);
+    CHECK(polls >= 60 * 4 - 4 && polls <= 60 * 4 + 4);
+    CHECK_EQ(gpio_fake_interrupts(CONFIG_AVR_ATTENTION_GPIO), 0);
+}
+
+int main(void)
+{
+    RUN_TEST_ISOLATED(test_idle_safety_poll);
+    RUN_TEST_ISOLATED(test_switch_attention);
+    RUN_TEST_ISOLATED(test_missed_edge);
+    RUN_TEST_ISOLATED(test_isr_service_unavailable);
+    return CHECK_EXIT();
+}
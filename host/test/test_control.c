@@ -0,0 +1,351 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Scripted scenarios for the CP and PP control loops, run through control.c against the
+ * plant model in virtual time. Each scenario checks the sequence and timing of the pump
+ * commands the loops send to the AVR.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "resources.h"
+#include "control.h"
+#include "esp_log.h"
+
+#include "vclock.h"
+#include "avr_fake.h"
+#include "check.h"
+#include "control_harness.h"
+
+#define US_PER_S (1000000LL)
+
+typedef struct
+{
+    size_t count;
+    bool on[AVR_FAKE_MAX_COMMANDS];
+    int64_t time[AVR_FAKE_MAX_COMMANDS];   // seconds since boot
+} sequence_t;
+
+// commands sent to one output, starting from the given command index
+static void _sequence(avr_fake_output_t output, size_t from, sequence_t * seq)
+{
+    seq->count = 0;
+    for (size_t i = from; i < avr_fake_num_commands(); ++i)
+    {
+        const avr_fake_command_t * command = avr_fake_command(i);
+        if (command->output == output)
+        {
+            seq->on[seq->count] = command->on;
+            seq->time[seq->count] = command->time / US_PER_S;
+            ++seq->count;
+        }
+    }
+}
+
+static bool _cp_on(const harness_t * harness)
+{
+    return avr_fake_output(AVR_FAKE_OUTPUT_CP);
+}
+
+static bool _cp_off(const harness_t * harness)
+{
+    return !avr_fake_output(AVR_FAKE_OUTPUT_CP);
+}
+
+static bool _pp_on(const harness_t * harness)
+{
+    return avr_fake_output(AVR_FAKE_OUTPUT_PP);
+}
+
+static bool _emergency(const harness_t * harness)
+{
+    return avr_fake_output(AVR_FAKE_OUTPUT_EMERGENCY);
+}
+
+static bool _emergency_released(const harness_t * harness)
+{
+    return !avr_fake_output(AVR_FAKE_OUTPUT_EMERGENCY);
+}
+
+static void test_cp_waits_for_sensors(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sensors_ok = false;
+    harness.plant.sun_override = true;
+    harness.plant.sun = 1.0;
+    harness.plant.t_array = 40.0;
+
+    // the pump is driven off at startup, then nothing happens until both sensors report
+    harness_run(&harness, 60);
+    sequence_t cp;
+    _sequence(AVR_FAKE_OUTPUT_CP, 0, &cp);
+    CHECK_EQ(cp.count, 1);
+    CHECK(!cp.on[0]);
+
+    harness.plant.sensors_ok = true;
+    CHECK(harness_run_until(&harness, _cp_on, 10));
+    CHECK(vclock_now() <= 66 * US_PER_S);
+    harness_delete(&harness);
+}
+
+static float _delta(const harness_t * harness)
+{
+    float t_high = 0.0f, t_low = 0.0f;
+    datastore_get_float(harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    datastore_get_float(harness->datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, &t_low);
+    return t_high - t_low;
+}
+
+static void test_cp_hysteresis(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 1.0;
+
+    // in full sun the running pump cools the collector faster than the sun heats it, so the
+    // pump cycles between the thresholds
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(harness_run_until(&harness, _cp_on, 3600));
+        CHECK(_delta(&harness) >= 7.0f);
+        CHECK(harness_run_until(&harness, _cp_off, 3600));
+        CHECK(_delta(&harness) <= 5.0f);
+    }
+
+    sequence_t cp;
+    _sequence(AVR_FAKE_OUTPUT_CP, 0, &cp);
+    CHECK_EQ(cp.count, 7);
+    for (size_t i = 0; i < cp.count; ++i)
+    {
+        CHECK_EQ(cp.on[i], i % 2 == 1);
+    }
+
+    // no sun, no pumping
+    harness.plant.sun = 0.0;
+    size_t from = avr_fake_num_commands();
+    harness_run(&harness, 3600);
+    _sequence(AVR_FAKE_OUTPUT_CP, from, &cp);
+    CHECK_EQ(cp.count, 0);
+    harness_delete(&harness);
+}
+
+static void test_cp_holds_state_without_measurements(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 1.0;
+    CHECK(harness_run_until(&harness, _cp_on, 3600));
+
+    // an expired measurement neither starts nor stops the pump
+    host_log_reset();
+    harness.plant.sensors_ok = false;
+    harness.plant.sun = 0.0;
+    size_t from = avr_fake_num_commands();
+    harness_run(&harness, 600);
+    sequence_t cp;
+    _sequence(AVR_FAKE_OUTPUT_CP, from, &cp);
+    CHECK_EQ(cp.count, 0);
+    CHECK(avr_fake_output(AVR_FAKE_OUTPUT_CP));
+    CHECK(host_log_count(ESP_LOG_WARN) > 0);
+
+    harness.plant.sensors_ok = true;
+    CHECK(harness_run_until(&harness, _cp_off, 10));
+    harness_delete(&harness);
+}
+
+static void test_pp_low_flow_purge_cycle(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 1.0;
+    harness.plant.flow_restricted = true;
+
+    CHECK(harness_run_until(&harness, _cp_on, 3600));
+    int64_t cp_on_time = vclock_now() / US_PER_S;
+    size_t from = avr_fake_num_commands();
+
+    // purge starts once CP has been running for the hold-off period with low flow
+    CHECK(harness_run_until(&harness, _pp_on, 60));
+    harness.plant.flow_restricted = false;
+    harness_run(&harness, 600);
+
+    sequence_t pp;
+    _sequence(AVR_FAKE_OUTPUT_PP, from, &pp);
+
+    // five 30 s ON periods separated by 60 s PAUSE periods: PAUSE and OFF both turn the pump off
+    static const bool EXPECTED_ON[] = { true, false, true, false, true, false, true, false, true, false, false };
+    static const int64_t EXPECTED_OFFSET[] = { 0, 30, 90, 120, 180, 210, 270, 300, 360, 390, 450 };
+    CHECK_EQ(pp.count, sizeof(EXPECTED_ON) / sizeof(EXPECTED_ON[0]));
+    for (size_t i = 0; i < pp.count && i < sizeof(EXPECTED_ON) / sizeof(EXPECTED_ON[0]); ++i)
+    {
+        CHECK_EQ(pp.on[i], EXPECTED_ON[i]);
+        CHECK_NEAR(pp.time[i] - pp.time[0], EXPECTED_OFFSET[i], 1);
+    }
+    CHECK(pp.count > 0 && pp.time[0] - cp_on_time >= 30 && pp.time[0] - cp_on_time <= 32);
+
+    uint32_t state = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, &state);
+    CHECK_EQ(state, CONTROL_PP_STATE_OFF);
+    harness_delete(&harness);
+}
+
+static void test_pp_daily_trigger(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 0.0;
+    datastore_set_bool(harness.datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, true);
+
+    // default schedule is 09:00 every day
+    CHECK(harness_run_until(&harness, _pp_on, 4 * 3600));
+    CHECK_NEAR(time(NULL), harness_local_time(2018, 1, 15, 9, 0), 1);
+
+    harness_run(&harness, 3600);
+    CHECK(!avr_fake_output(AVR_FAKE_OUTPUT_PP));
+    CHECK(harness_run_until(&harness, _pp_on, 24 * 3600));
+    CHECK_NEAR(time(NULL), harness_local_time(2018, 1, 16, 9, 0), 1);
+    harness_delete(&harness);
+}
+
+static void test_pp_daily_trigger_clock_step(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 8, 55));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 0.0;
+    datastore_set_bool(harness.datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, true);
+    harness_run(&harness, 60);
+    CHECK(!avr_fake_output(AVR_FAKE_OUTPUT_PP));
+
+    // SNTP steps the clock ten minutes forward, across the 09:00 purge: it runs late
+    host_log_reset();
+    vclock_step_wall(600);
+    CHECK(harness_run_until(&harness, _pp_on, 2));
+    CHECK(host_log_count(ESP_LOG_WARN) > 0);
+    harness_delete(&harness);
+}
+
+static void test_pp_manual_abandons_cycle(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 8, 59));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 0.0;
+    datastore_set_bool(harness.datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, true);
+    CHECK(harness_run_until(&harness, _pp_on, 120));
+
+    datastore_set_uint32(harness.datastore, RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 0, AVR_SWITCH_MODE_MANUAL);
+    harness_run(&harness, 2);
+    CHECK(!avr_fake_output(AVR_FAKE_OUTPUT_PP));
+
+    uint32_t state = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, &state);
+    CHECK_EQ(state, CONTROL_PP_STATE_OFF);
+
+    // no further cycle is started while the switch is out of AUTO
+    size_t from = avr_fake_num_commands();
+    harness_run(&harness, 600);
+    sequence_t pp;
+    _sequence(AVR_FAKE_OUTPUT_PP, from, &pp);
+    CHECK_EQ(pp.count, 0);
+    harness_delete(&harness);
+}
+
+static void test_pp_emergency(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 6, 0));
+    harness.plant.sun_override = true;
+    harness.plant.sun = 1.0;
+    harness.plant.sun_gain = 1.0;
+
+    CHECK(harness_run_until(&harness, _emergency, 3600));
+    float t_high = 0.0f;
+    datastore_get_float(harness.datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    CHECK(t_high >= 80.0f);
+    CHECK(harness_run_until(&harness, _pp_on, 2));
+
+    // the latch is released once the collector cools below the safe temperature
+    harness.plant.sun = 0.0;
+    CHECK(harness_run_until(&harness, _emergency_released, 3600));
+    datastore_get_float(harness.datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    CHECK(t_high < 60.0f);
+    CHECK(!avr_fake_output(AVR_FAKE_OUTPUT_PP));
+    harness_delete(&harness);
+}
+
+// An overheated sample followed by a sensor failure holds the latch and the purge pump on, with
+// an alarm, until a current sample shows the array has cooled below the safe temperature
+static void test_pp_emergency_stale_sample(void)
+{
+    harness_t harness;
+    harness_init(&harness, harness_local_time(2018, 1, 15, 0, 0));
+    harness_run(&harness, 60);
+
+    harness.plant.sensors_ok = false;
+    datastore_set_float(harness.datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, 85.0f);
+    CHECK(avr_fake_output(AVR_FAKE_OUTPUT_EMERGENCY));
+    CHECK(harness_run_until(&harness, _pp_on, 2));
+
+    // long past expiry
+    host_log_reset();
+    harness_run(&harness, 600);
+    CHECK(avr_fake_output(AVR_FAKE_OUTPUT_EMERGENCY));
+    CHECK(avr_fake_output(AVR_FAKE_OUTPUT_PP));
+    uint32_t state = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, &state);
+    CHECK_EQ(state, CONTROL_PP_STATE_EMERGENCY);
+    CHECK_EQ(host_log_count(ESP_LOG_ERROR), 1);
+    char entry[64] = "";
+    datastore_get_string(harness.datastore, RESOURCE_ID_SYSTEM_LOG, 0, entry, sizeof(entry));
+    CHECK(strcmp(entry, "Array temperature lost - purge pump held on") == 0);
+
+    // the cold night-time array reports again
+    harness.plant.sensors_ok = true;
+    CHECK(harness_run_until(&harness, _emergency_released, 60));
+    harness_run(&harness, 2);
+    CHECK(!avr_fake_output(AVR_FAKE_OUTPUT_PP));
+    harness_delete(&harness);
+}
+
+int main(void)
+{
+    RUN_TEST(test_cp_waits_for_sensors);
+    RUN_TEST(test_cp_hysteresis);
+    RUN_TEST(test_cp_holds_state_without_measurements);
+    RUN_TEST(test_pp_low_flow_purge_cycle);
+    RUN_TEST(test_pp_daily_trigger);
+    RUN_TEST(test_pp_daily_trigger_clock_step);
+    RUN_TEST(test_pp_manual_abandons_cycle);
+    RUN_TEST(test_pp_emergency);
+    RUN_TEST(test_pp_emergency_stale_sample);
+    return CHECK_EXIT();
+}
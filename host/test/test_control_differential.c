@@ -0,0 +1,213 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Differential test of the table-driven CP and PP controllers against the hand-written
+ * reference step functions. Both are stepped in lockstep with the same randomised inputs,
+ * and every step must produce the same events and leave both in the same state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control_logic.h"
+
+#include "check.h"
+#include "control_reference.h"
+
+#define SEEDS  (200)
+#define STEPS  (5000)
+
+static uint32_t _random(uint32_t * seed, uint32_t n)
+{
+    return rand_r(seed) % n;
+}
+
+static bool _events_equal(const control_outputs_t * a, const control_outputs_t * b)
+{
+    if (a->num_events != b->num_events)
+        return false;
+    for (uint8_t i = 0; i < a->num_events; ++i)
+    {
+        const control_event_t * x = &a->events[i];
+        const control_event_t * y = &b->events[i];
+        if (x->state != y->state || x->pump_on != y->pump_on || x->reason != y->reason || x->cycle != y->cycle)
+            return false;
+    }
+    return true;
+}
+
+static void _report(const char * name, uint32_t seed, uint32_t step, const control_outputs_t * actual, const control_outputs_t * expected)
+{
+    fprintf(stderr, "%s: seed %u step %u: %u events, reference %u\n", name, seed, step, actual->num_events, expected->num_events);
+    for (uint8_t i = 0; i < CONTROL_MAX_EVENTS; ++i)
+    {
+        if (i < actual->num_events || i < expected->num_events)
+        {
+            fprintf(stderr, "  [%u] state %u/%u reason %u/%u cycle %u/%u\n", i,
+                    actual->events[i].state, expected->events[i].state,
+                    actual->events[i].reason, expected->events[i].reason,
+                    actual->events[i].cycle, expected->events[i].cycle);
+        }
+    }
+}
+
+static void test_cp_differential(void)
+{
+    uint32_t mismatches = 0;
+    uint32_t transitions = 0;
+    for (uint32_t s = 0; s < SEEDS && mismatches == 0; ++s)
+    {
+        uint32_t seed = s;
+        control_cp_t cp;
+        reference_cp_t ref;
+        control_cp_logic_init(&cp);
+        reference_cp_init(&ref);
+
+        float delta = 0.0f;
+        uint32_t now = _random(&seed, 100000);
+        for (uint32_t step = 0; step < STEPS; ++step)
+        {
+            // a random walk through both thresholds, sometimes landing on them exactly
+            delta += (float)((int)_random(&seed, 9) - 4) * 0.5f;
+            delta = delta < -4.0f ? -4.0f : delta > 14.0f ? 14.0f : delta;
+
+            control_cp_inputs_t inputs = {
+                .temps_valid = _random(&seed, 20) != 0,
+                .t_high = 20.0f + delta,
+                .t_low = 20.0f,
+                .on_delta = 7.0f,
+                .off_delta = 5.0f,
+                .predict_horizon = 0,
+                .refresh = _random(&seed, 30) == 0,
+            };
+            now += 1 + (_random(&seed, 10) == 0 ? _random(&seed, 60) : 0);
+
+            control_outputs_t actual, expected;
+            control_cp_step(&cp, &inputs, now, &actual);
+            reference_cp_step(&ref, &inputs, now, &expected);
+            transitions += expected.num_events;
+            if (!_events_equal(&actual, &expected) || cp.fsm.state != ref.state)
+            {
+                _report("CP", s, step, &actual, &expected);
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+    CHECK(transitions > SEEDS * 100);
+}
+
+static void test_pp_differential(void)
+{
+    uint32_t mismatches = 0;
+    uint32_t reasons[CONTROL_REASON_LAST] = { 0 };
+    for (uint32_t s = 0; s < SEEDS && mismatches == 0; ++s)
+    {
+        uint32_t seed = s;
+        control_pp_t pp;
+        reference_pp_t ref;
+        control_pp_logic_init(&pp);
+        reference_pp_init(&ref);
+
+        float t_high = 40.0f;
+        bool auto_mode = true;
+        bool cp_pump_on = false;
+        uint64_t cp_state_age = 0;
+        uint32_t on_duration = 1 + _random(&seed, 5);
+        uint32_t pause_duration = 1 + _random(&seed, 5);
+        uint32_t cycle_count = _random(&seed, 50) == 0 ? 0 : 1 + _random(&seed, 4);
+        uint32_t now = _random(&seed, 100000);
+
+        for (uint32_t step = 0; step < STEPS; ++step)
+        {
+            // the array temperature wanders up into the emergency band and back
+            t_high += (float)((int)_random(&seed, 9) - 4) * 1.0f;
+            t_high = t_high < 30.0f ? 30.0f : t_high > 95.0f ? 95.0f : t_high;
+
+            if (_random(&seed, 200) == 0)
+                auto_mode = !auto_mode;
+            if (_random(&seed, 40) == 0)
+            {
+                cp_pump_on = !cp_pump_on;
+                cp_state_age = 0;
+            }
+
+            uint32_t elapsed = 1 + (_random(&seed, 20) == 0 ? _random(&seed, 40) : 0);
+            now += elapsed;
+            cp_state_age += (uint64_t)elapsed * 1000000;
+
+            control_pp_inputs_t inputs = {
+                .daily_trigger = _random(&seed, 100) == 0,
+                .t_high_valid = _random(&seed, 20) != 0,
+                .t_high = t_high,
+                .safe_temp_high = 80.0f,
+                .safe_temp_low = 60.0f,
+                .auto_mode = auto_mode,
+                .flow_valid = _random(&seed, 20) != 0,
+                .flow_rate = (float)_random(&seed, 16),
+                .flow_threshold = 8.0f,
+                .cp_pump_on = cp_pump_on,
+                .cp_state_age = cp_state_age,
+                .cycle_count = cycle_count,
+                .on_duration = on_duration,
+                .pause_duration = pause_duration,
+            };
+
+            control_outputs_t actual, expected;
+            control_pp_step(&pp, &inputs, now, &actual);
+            reference_pp_step(&ref, &inputs, now, &expected);
+            for (uint8_t i = 0; i < expected.num_events; ++i)
+            {
+                ++reasons[expected.events[i].reason];
+            }
+            if (!_events_equal(&actual, &expected) || pp.fsm.state != ref.state || pp.n != ref.n)
+            {
+                _report("PP", s, step, &actual, &expected);
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    // every PP transition must have been exercised
+    for (control_reason_t reason = CONTROL_REASON_PP_SAFE_RESTORED; reason <= CONTROL_REASON_PP_MANUAL; ++reason)
+    {
+        if (reasons[reason] == 0)
+        {
+            fprintf(stderr, "reason %d not exercised\n", reason);
+        }
+        CHECK(reasons[reason] > 0);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_cp_differential);
+    RUN_TEST(test_pp_differential);
+    return CHECK_EXIT();
+}
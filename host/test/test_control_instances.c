@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Checks that circulation pump controller instances are independent: stepping several
+ * instances side by side gives each one exactly the outputs and state it has when stepped
+ * alone with the same inputs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control_logic.h"
+
+#include "check.h"
+
+#define INSTANCES  (4)
+#define STEPS      (20000)    // one step per second
+
+typedef struct
+{
+    uint32_t seed;
+    float t_low;
+    float t_high;
+} input_source_t;
+
+// a wandering temperature delta, with occasional measurement gaps and refreshes
+static void _next_inputs(input_source_t * source, uint32_t step, control_cp_inputs_t * inputs)
+{
+    source->t_high += ((int)(rand_r(&source->seed) % 201) - 100) / 200.0f;
+    if (source->t_high < source->t_low - 5.0f)
+        source->t_high = source->t_low - 5.0f;
+    if (source->t_high > source->t_low + 15.0f)
+        source->t_high = source->t_low + 15.0f;
+
+    memset(inputs, 0, sizeof(*inputs));
+    inputs->temps_valid = rand_r(&source->seed) % 50 != 0;
+    inputs->t_high = source->t_high;
+    inputs->t_low = source->t_low;
+    inputs->on_delta = 7.0f;
+    inputs->off_delta = 5.0f;
+    inputs->predict_horizon = (step / 5000) % 2 ? 60 : 0;
+    inputs->refresh = rand_r(&source->seed) % 500 == 0;
+}
+
+static void _source_init(input_source_t * source, uint32_t instance)
+{
+    source->seed = 1000 + instance;
+    source->t_low = 20.0f + instance;
+    source->t_high = source->t_low;
+}
+
+static bool _outputs_equal(const control_outputs_t * a, const control_outputs_t * b)
+{
+    if (a->num_events != b->num_events)
+        return false;
+    for (uint8_t i = 0; i < a->num_events; ++i)
+    {
+        if (a->events[i].state != b->events[i].state
+            || a->events[i].pump_on != b->events[i].pump_on
+            || a->events[i].reason != b->events[i].reason)
+            return false;
+    }
+    return true;
+}
+
+static void test_instances_match_solo_runs(void)
+{
+    // reference: each instance stepped on its own
+    static control_outputs_t solo[INSTANCES][STEPS];
+    control_cp_t solo_final[INSTANCES];
+    uint32_t transitions[INSTANCES] = { 0 };
+    for (uint32_t n = 0; n < INSTANCES; ++n)
+    {
+        input_source_t source;
+        _source_init(&source, n);
+        control_cp_logic_init(&solo_final[n]);
+        for (uint32_t step = 0; step < STEPS; ++step)
+        {
+            control_cp_inputs_t inputs;
+            _next_inputs(&source, step, &inputs);
+            control_cp_step(&solo_final[n], &inputs, step, &solo[n][step]);
+            transitions[n] += solo[n][step].num_events;
+        }
+    }
+
+    // all instances stepped in lockstep, as _cp_iterate does
+    control_cp_t cp[INSTANCES];
+    input_source_t sources[INSTANCES];
+    for (uint32_t n = 0; n < INSTANCES; ++n)
+    {
+        _source_init(&sources[n], n);
+        control_cp_logic_init(&cp[n]);
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t step = 0; step < STEPS; ++step)
+    {
+        for (uint32_t n = 0; n < INSTANCES; ++n)
+        {
+            control_cp_inputs_t inputs;
+            control_outputs_t outputs;
+            _next_inputs(&sources[n], step, &inputs);
+            control_cp_step(&cp[n], &inputs, step, &outputs);
+            mismatches += _outputs_equal(&outputs, &solo[n][step]) ? 0 : 1;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+
+    for (uint32_t n = 0; n < INSTANCES; ++n)
+    {
+        CHECK(memcmp(&cp[n], &solo_final[n], sizeof(cp[n])) == 0);
+        // the inputs must actually exercise the controller
+        CHECK(transitions[n] > 10);
+    }
+}
+
+static void test_instance_isolation(void)
+{
+    control_cp_t cp[2];
+    control_cp_logic_init(&cp[0]);
+    control_cp_logic_init(&cp[1]);
+
+    control_cp_t snapshot = cp[1];
+    control_cp_inputs_t hot = { .temps_valid = true, .t_high = 40.0f, .t_low = 20.0f, .on_delta = 7.0f, .off_delta = 5.0f, .predict_horizon = 60 };
+    control_outputs_t outputs;
+    for (uint32_t t = 0; t < 600; t += 5)
+    {
+        hot.t_high += 0.1f;
+        control_cp_step(&cp[0], &hot, t, &outputs);
+    }
+    CHECK_EQ(cp[0].fsm.state, CONTROL_CP_STATE_ON);
+    CHECK(cp[0].trend_count > 0);
+
+    // the other instance is untouched
+    CHECK(memcmp(&cp[1], &snapshot, sizeof(snapshot)) == 0);
+    CHECK_EQ(cp[1].fsm.state, CONTROL_CP_STATE_OFF);
+    CHECK_EQ(cp[1].trend_count, 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_instances_match_solo_runs);
+    RUN_TEST(test_instance_isolation);
+    return CHECK_EXIT();
+}
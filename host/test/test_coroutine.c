@@ -0,0 +1,338 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the stackless coroutines in coroutine.h, stepped by hand with a supplied clock,
+ * and for coroutine_runner.c on the simulated scheduler: slot release, the runner's choice of
+ * when to wake next, wraparound of its millisecond clock, and coroutine_runner_wake().
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "coroutine.h"
+#include "coroutine_runner.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "check.h"
+
+#define RUNNER_PRIORITY  (5)
+#define MAX_CALLS        (16)
+#define WRAP_US          (4294967296000LL)   // the runner's uint32_t millisecond clock wraps here
+
+typedef struct
+{
+    uint32_t duration;         // milliseconds per delay
+    uint32_t delays;
+    uint32_t resumes;
+    int64_t resume_times[MAX_CALLS];   // microseconds
+    int64_t call_times[MAX_CALLS];
+    uint32_t calls;
+    bool exit_early;
+    volatile bool flag;
+} context_t;
+
+static void _record(int64_t * times, uint32_t * count)
+{
+    if (*count < MAX_CALLS)
+    {
+        times[*count] = vclock_now();
+    }
+    ++*count;
+}
+
+// Delays, delays times, then ends
+static coroutine_status_t _delay_co(coroutine_t * co, void * context, uint32_t now)
+{
+    context_t * c = context;
+    _record(c->call_times, &c->calls);
+
+    CO_BEGIN(co);
+    while (c->resumes < c->delays)
+    {
+        CO_DELAY(co, now, c->duration);
+        _record(c->resume_times, &c->resumes);
+    }
+    CO_END(co);
+}
+
+// Yields once, then exits early or waits for the flag
+static coroutine_status_t _flag_co(coroutine_t * co, void * context, uint32_t now)
+{
+    context_t * c = context;
+    _record(c->call_times, &c->calls);
+
+    CO_BEGIN(co);
+    CO_YIELD(co);
+    if (c->exit_early)
+    {
+        CO_EXIT(co);
+    }
+    CO_WAIT_UNTIL(co, c->flag);
+    _record(c->resume_times, &c->resumes);
+    CO_END(co);
+}
+
+static void test_delay(void)
+{
+    coroutine_t co;
+    CO_INIT(&co);
+    context_t c = { .duration = 100, .delays = 1 };
+
+    CHECK_EQ(_delay_co(&co, &c, 1000), CO_WAITING);
+    CHECK(co.timed);
+    CHECK_EQ(co.deadline, 1100);
+    CHECK_EQ(_delay_co(&co, &c, 1099), CO_WAITING);
+    CHECK_EQ(c.resumes, 0);
+    CHECK_EQ(_delay_co(&co, &c, 1100), CO_DONE);
+    CHECK_EQ(c.resumes, 1);
+    CHECK(CO_IS_DONE(&co));
+    CHECK(!co.timed);
+
+    // a finished coroutine stays finished
+    CHECK_EQ(_delay_co(&co, &c, 5000), CO_DONE);
+    CHECK_EQ(c.resumes, 1);
+}
+
+// A deadline past the uint32_t wrap completes after the wrap, not immediately
+static void test_delay_wraparound(void)
+{
+    coroutine_t co;
+    CO_INIT(&co);
+    context_t c = { .duration = 100, .delays = 1 };
+
+    CHECK_EQ(_delay_co(&co, &c, UINT32_MAX - 49), CO_WAITING);
+    CHECK_EQ(co.deadline, 50);
+    CHECK_EQ(_delay_co(&co, &c, UINT32_MAX), CO_WAITING);
+    CHECK_EQ(_delay_co(&co, &c, 0), CO_WAITING);
+    CHECK_EQ(_delay_co(&co, &c, 49), CO_WAITING);
+    CHECK_EQ(_delay_co(&co, &c, 50), CO_DONE);
+    CHECK_EQ(c.resumes, 1);
+}
+
+// CO_WAIT_UNTIL_TIME with a time already passed, across the wrap, does not wait
+static coroutine_status_t _until_co(coroutine_t * co, void * context, uint32_t now)
+{
+    const uint32_t * t = context;
+    CO_BEGIN(co);
+    CO_WAIT_UNTIL_TIME(co, now, *t);
+    CO_END(co);
+}
+
+static void test_wait_until_time_wraparound(void)
+{
+    coroutine_t co;
+    uint32_t t = UINT32_MAX - 5;
+    CO_INIT(&co);
+    CHECK_EQ(_until_co(&co, &t, 10), CO_DONE);
+
+    // and one just ahead, across the wrap, does
+    t = 10;
+    CO_INIT(&co);
+    CHECK_EQ(_until_co(&co, &t, UINT32_MAX - 5), CO_WAITING);
+    CHECK_EQ(_until_co(&co, &t, 9), CO_WAITING);
+    CHECK_EQ(_until_co(&co, &t, 10), CO_DONE);
+}
+
+static void test_exit_and_wait_until(void)
+{
+    coroutine_t co;
+    CO_INIT(&co);
+    context_t c = { .exit_early = true };
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_YIELDED);
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_DONE);
+    CHECK(CO_IS_DONE(&co));
+    CHECK_EQ(c.resumes, 0);
+
+    CO_INIT(&co);
+    c = (context_t){ .exit_early = false };
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_YIELDED);
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_WAITING);
+    CHECK(!co.timed);
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_WAITING);
+    c.flag = true;
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_DONE);
+    CHECK_EQ(c.resumes, 1);
+
+    // CO_INIT restarts from the beginning
+    CO_INIT(&co);
+    CHECK_EQ(_flag_co(&co, &c, 0), CO_YIELDED);
+}
+
+static void _setup(int64_t start_us)
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    vclock_advance(start_us);
+    coroutine_runner_init(RUNNER_PRIORITY);
+}
+
+// A finished coroutine's slot is released and can be reused
+static void test_runner_slot_release(void)
+{
+    _setup(0);
+    static context_t c[COROUTINE_RUNNER_MAX + 1];
+    for (size_t i = 0; i < COROUTINE_RUNNER_MAX; ++i)
+    {
+        CHECK(coroutine_runner_start("hold", _flag_co, &c[i]));
+    }
+    CHECK(!coroutine_runner_start("extra", _flag_co, &c[COROUTINE_RUNNER_MAX]));
+    rtos_sim_run_for(200 * 1000);
+
+    c[1].flag = true;
+    coroutine_runner_wake();
+    rtos_sim_run_for(10 * 1000);
+    CHECK_EQ(c[1].resumes, 1);
+    CHECK_EQ(c[0].resumes, 0);
+
+    // the finished coroutine is never called again
+    uint32_t calls = c[1].calls;
+    CHECK(coroutine_runner_start("extra", _flag_co, &c[COROUTINE_RUNNER_MAX]));
+    rtos_sim_run_for(200 * 1000);
+    CHECK_EQ(c[1].calls, calls);
+    CHECK(c[COROUTINE_RUNNER_MAX].calls > 0);
+    CHECK(!coroutine_runner_start("full", _flag_co, &c[1]));
+}
+
+// With only timed waits the runner wakes at each deadline and not in between
+static void test_runner_next_wake(void)
+{
+    _setup(0);
+    static context_t a = { .duration = 30, .delays = 2 };
+    static context_t b = { .duration = 370, .delays = 1 };
+    CHECK(coroutine_runner_start("a", _delay_co, &a));
+    CHECK(coroutine_runner_start("b", _delay_co, &b));
+    rtos_sim_run_for(1000 * 1000);
+
+    CHECK_EQ(a.resumes, 2);
+    CHECK_EQ(a.resume_times[0], 30 * 1000);
+    CHECK_EQ(a.resume_times[1], 60 * 1000);
+    CHECK_EQ(b.resumes, 1);
+    CHECK_EQ(b.resume_times[0], 370 * 1000);
+
+    // b is called at start (twice, as each start wakes the runner), then only at a's deadlines and its own
+    CHECK_EQ(b.calls, 5);
+    CHECK_EQ(b.call_times[1], 0);
+    CHECK_EQ(b.call_times[2], 30 * 1000);
+    CHECK_EQ(b.call_times[3], 60 * 1000);
+    CHECK_EQ(b.call_times[4], 370 * 1000);
+}
+
+// A coroutine waiting on a condition is polled every COROUTINE_RUNNER_POLL_PERIOD, alongside
+// timed waits
+static void test_runner_poll_period(void)
+{
+    _setup(0);
+    static context_t a = { .duration = 350, .delays = 1 };
+    static context_t f = { 0 };
+    CHECK(coroutine_runner_start("a", _delay_co, &a));
+    CHECK(coroutine_runner_start("f", _flag_co, &f));
+    rtos_sim_run_for(1000 * 1000);
+
+    CHECK_EQ(a.resume_times[0], 350 * 1000);
+    for (uint32_t i = 1; i < a.calls && i < MAX_CALLS; ++i)
+    {
+        CHECK(a.call_times[i] - a.call_times[i - 1] <= COROUTINE_RUNNER_POLL_PERIOD * 1000);
+    }
+    CHECK(f.calls >= 1000 / COROUTINE_RUNNER_POLL_PERIOD);
+}
+
+// The runner's millisecond clock wraps after 49.7 days; a delay across the wrap lasts as long as any other
+static void test_runner_wraparound(void)
+{
+    // 200 ms before the wrap, on a tick
+    int64_t start = (WRAP_US / (portTICK_PERIOD_MS * 1000) - 20) * (portTICK_PERIOD_MS * 1000);
+    _setup(start);
+    static context_t a = { .duration = 500, .delays = 2 };
+    CHECK(coroutine_runner_start("a", _delay_co, &a));
+    rtos_sim_run_for(2000 * 1000);
+
+    CHECK_EQ(a.resumes, 2);
+    CHECK_EQ(a.resume_times[0] - start, 500 * 1000);
+    CHECK_EQ(a.resume_times[1] - start, 1000 * 1000);
+    CHECK(a.resume_times[0] > WRAP_US);
+}
+
+static volatile bool * _flag = NULL;
+static bool _wake = false;
+static int64_t _set_time = 0;
+
+static void _setter_task(void * pvParameter)
+{
+    vTaskDelay(30 / portTICK_PERIOD_MS);
+    *_flag = true;
+    _set_time = vclock_now();
+    if (_wake)
+    {
+        coroutine_runner_wake();
+    }
+    vTaskDelete(NULL);
+}
+
+static int64_t _flag_latency(bool wake)
+{
+    _setup(0);
+    static context_t f = { 0 };
+    CHECK(coroutine_runner_start("f", _flag_co, &f));
+    rtos_sim_run_for(5 * 1000);
+
+    _flag = &f.flag;
+    _wake = wake;
+    xTaskCreate(_setter_task, "setter", 2048, NULL, RUNNER_PRIORITY + 1, NULL);
+    rtos_sim_run_for(500 * 1000);
+    CHECK_EQ(f.resumes, 1);
+    return f.resume_times[0] - _set_time;
+}
+
+// coroutine_runner_wake() resumes a condition wait at once instead of at the next poll
+static void test_runner_wake(void)
+{
+    CHECK_EQ(_flag_latency(true), 0);
+}
+
+static void test_runner_no_wake(void)
+{
+    int64_t latency = _flag_latency(false);
+    CHECK(latency > 0);
+    CHECK(latency <= COROUTINE_RUNNER_POLL_PERIOD * 1000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_delay);
+    RUN_TEST(test_delay_wraparound);
+    RUN_TEST(test_wait_until_time_wraparound);
+    RUN_TEST(test_exit_and_wait_until);
+    RUN_TEST_ISOLATED(test_runner_slot_release);
+    RUN_TEST_ISOLATED(test_runner_next_wake);
+    RUN_TEST_ISOLATED(test_runner_poll_period);
+    RUN_TEST_ISOLATED(test_runner_wraparound);
+    RUN_TEST_ISOLATED(test_runner_wake);
+    RUN_TEST_ISOLATED(test_runner_no_wake);
+    return CHECK_EXIT();
+}
@@ -0,0 +1,218 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The display task on the simulated bus (display_harness.h), checked through what the HD44780
+ * model shows and what the task publishes. Each test runs in its own process.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "resources.h"
+#include "button.h"
+#include "rotary_encoder.h"
+
+#include "lcd_device.h"
+#include "display_harness.h"
+#include "check.h"
+
+#define STATS_PERIOD  (60 * 1000)   // milliseconds, as display.c publishes
+#define SCROLL_STEP   (400)         // milliseconds, as display.c scrolls the Log page
+
+static uint32_t _get(const display_harness_t * harness, datastore_resource_id_t id, datastore_instance_id_t instance)
+{
+    uint32_t value = 0;
+    datastore_get_uint32(harness->datastore, id, instance, &value);
+    return value;
+}
+
+static bool _row_starts(uint8_t row, const char * prefix)
+{
+    char text[LCD_DEVICE_COLUMNS + 1];
+    lcd_device_row(row, text);
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+// The Main page is rendered at boot
+static void test_boot_renders_main(void)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, 1000);
+
+    CHECK(_row_starts(0, "PoolMon v1.2"));
+    CHECK(_row_starts(2, "0123456789abcdef0123"));
+}
+
+// Handler invocations and time are counted in the task and published once a minute, one
+// write per resource for each page shown since the last publish
+static void test_handler_stats_published_once_a_minute(void)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, STATS_PERIOD - 1000);
+
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT), 0);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_TIME), 0);
+    CHECK_EQ(_get(&harness, RESOURCE_ID_DISPLAY_HANDLER_COUNT, DISPLAY_PAGE_MAIN), 0);
+
+    display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE);
+    display_harness_run(&harness, 2000);
+
+    // Main blinks every 500 ms
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT), 2);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_TIME), 2);
+    CHECK_NEAR(_get(&harness, RESOURCE_ID_DISPLAY_HANDLER_COUNT, DISPLAY_PAGE_MAIN), 2 * STATS_PERIOD / 1000, 2);
+    CHECK(_get(&harness, RESOURCE_ID_DISPLAY_HANDLER_COUNT, DISPLAY_PAGE_SENSORS_TEMP) > 0);
+
+    // and nothing more until the next minute
+    display_harness_run(&harness, STATS_PERIOD - 5000);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT), 2);
+}
+
+// Knob steps queued together are applied before rendering, as one jump to the last page
+static void test_encoder_steps_coalesce(void)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, 1000);
+    datastore_fake_reset_counts(harness.datastore);
+    uint32_t transactions = lcd_device_stats()->transactions;
+
+    // Main -> Temp -> Light -> Flow
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK(display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE));
+    }
+    display_harness_run(&harness, 200);
+
+    CHECK_EQ(display_harness_page(&harness), DISPLAY_PAGE_SENSORS_FLOW);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_DISPLAY_PAGE), 1);
+    CHECK(_row_starts(0, "Flow Rate"));
+    CHECK(lcd_device_stats()->transactions > transactions);
+    CHECK(_get(&harness, RESOURCE_ID_DISPLAY_INPUT_LATENCY, 0) > 0);
+}
+
+static bool _temp_row_0(const display_harness_t * harness)
+{
+    return _row_starts(0, "T1 ");
+}
+
+// Input arriving during a render stops it before the next row, and the new page is rendered
+static void test_render_aborted_on_input(void)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, 1000);
+
+    CHECK(display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE));
+    CHECK(display_harness_run_until(&harness, _temp_row_0, 100));
+    CHECK(display_harness_input(&harness, ROTARY_ENCODER_EVENT_CLOCKWISE));
+
+    // the Temp page's last row is never written
+    bool temp_row_3 = false;
+    for (int i = 0; i < 100 && !_row_starts(0, "Light Full"); ++i)
+    {
+        display_harness_run(&harness, 1);
+        temp_row_3 |= _row_starts(3, "T4 ");
+    }
+    CHECK(!temp_row_3);
+    CHECK(_row_starts(0, "Light Full"));
+
+    // and the Light page is completed
+    display_harness_run(&harness, 100);
+    CHECK_EQ(display_harness_page(&harness), DISPLAY_PAGE_SENSORS_LIGHT);
+    CHECK(_row_starts(3, "      Visible"));
+}
+
+// The rows the LCD shows for two 40-column DDRAM lines after the given number of left shifts:
+// rows 0 and 1 show lines 1 and 2 from column 0, rows 2 and 3 from column 20
+static void _window(const char lines[2][LCD_DEVICE_LINE_LENGTH + 1], int shift, uint8_t row, char out[LCD_DEVICE_COLUMNS + 1])
+{
+    for (int i = 0; i < LCD_DEVICE_COLUMNS; ++i)
+    {
+        out[i] = lines[row % 2][((row / 2) * LCD_DEVICE_COLUMNS + shift + i) % LCD_DEVICE_LINE_LENGTH];
+    }
+    out[LCD_DEVICE_COLUMNS] = '\0';
+}
+
+static bool _frame_is(const char lines[2][LCD_DEVICE_LINE_LENGTH + 1], int shift)
+{
+    for (uint8_t row = 0; row < LCD_DEVICE_ROWS; ++row)
+    {
+        char expected[LCD_DEVICE_COLUMNS + 1];
+        char actual[LCD_DEVICE_COLUMNS + 1];
+        _window(lines, shift, row, expected);
+        lcd_device_row(row, actual);
+        if (strcmp(expected, actual) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The Log page writes its two wide lines once and then scrolls them through the window with
+// the display shift, one command per step, wrapping each line through its two rows
+static void test_log_page_scrolls(void)
+{
+    display_harness_t harness;
+    display_harness_init(&harness);
+    display_harness_run(&harness, 1000);
+
+    // as _set_wide_line lays them out, with the network values the harness sets
+    char lines[2][LCD_DEVICE_LINE_LENGTH + 1];
+    snprintf(lines[0], sizeof(lines[0]), "%-*.*s", LCD_DEVICE_LINE_LENGTH, LCD_DEVICE_LINE_LENGTH - 2, DISPLAY_HARNESS_LOG);
+    snprintf(lines[1], sizeof(lines[1]), "%-*.*s", LCD_DEVICE_LINE_LENGTH, LCD_DEVICE_LINE_LENGTH - 2, "poolshed 192.168.1.42 broker.lan:1883");
+
+    CHECK(display_harness_input(&harness, ROTARY_ENCODER_EVENT_COUNTER_CLOCKWISE));
+    display_harness_run(&harness, 100);
+    CHECK_EQ(display_harness_page(&harness), DISPLAY_PAGE_LOG);
+    CHECK(_frame_is(lines, 0));
+
+    // every frame of a full turn of both lines, and back to the start
+    uint32_t bytes = lcd_device_stats()->bytes;
+    for (int shift = 1; shift <= LCD_DEVICE_LINE_LENGTH + 1; ++shift)
+    {
+        display_harness_run(&harness, SCROLL_STEP);
+        if (!_frame_is(lines, shift))
+        {
+            printf("frame %d not shown\n", shift);
+            CHECK(false);
+            break;
+        }
+    }
+    CHECK_EQ(lcd_device_stats()->bytes - bytes, LCD_DEVICE_LINE_LENGTH + 1);
+}
+
+int main(void)
+{
+    RUN_TEST_ISOLATED(test_boot_renders_main);
+    RUN_TEST_ISOLATED(test_handler_stats_published_once_a_minute);
+    RUN_TEST_ISOLATED(test_encoder_steps_coalesce);
+    RUN_TEST_ISOLATED(test_render_aborted_on_input);
+    RUN_TEST_ISOLATED(test_log_page_scrolls);
+    return CHECK_EXIT();
+}
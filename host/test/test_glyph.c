@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the run-time glyph allocator and the sparklines drawn with it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "glyph.h"
+#include "check.h"
+
+#define FIRST_CODE   0x0c
+
+// Height of each pixel column of a glyph, in pixels filled from the bottom
+static void _heights(const uint8_t bitmap[GLYPH_HEIGHT], int heights[GLYPH_WIDTH])
+{
+    for (int col = 0; col < GLYPH_WIDTH; ++col)
+    {
+        heights[col] = 0;
+        for (int row = 0; row < GLYPH_HEIGHT; ++row)
+        {
+            heights[col] += bitmap[row] & (1 << (GLYPH_WIDTH - 1 - col)) ? 1 : 0;
+        }
+    }
+}
+
+static const uint8_t * _bitmap(const glyph_cache_t * cache, char code)
+{
+    return cache->slots[(uint8_t)code - FIRST_CODE].bitmap;
+}
+
+// The lowest sample is one pixel, the highest fills the column, others are scaled between
+static void test_sparkline_scaled(void)
+{
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, FIRST_CODE);
+    const float samples[] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f };
+    char out[2];
+    glyph_sparkline(&cache, out, samples, 1, 0.5f);
+
+    CHECK_EQ(out[0], FIRST_CODE);
+    CHECK_EQ(out[1], '\0');
+    int heights[GLYPH_WIDTH];
+    _heights(_bitmap(&cache, out[0]), heights);
+    CHECK_EQ(heights[0], 1);
+    CHECK_EQ(heights[1], 3);
+    CHECK_EQ(heights[2], 5);
+    CHECK_EQ(heights[3], 6);
+    CHECK_EQ(heights[4], 8);
+}
+
+// A range narrower than the minimum span is centred, so a flat series is a level mid-height line
+static void test_sparkline_flat(void)
+{
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, FIRST_CODE);
+    const float samples[] = { 24.5f, 24.5f, 24.5f, 24.5f, 24.5f };
+    char out[2];
+    glyph_sparkline(&cache, out, samples, 1, 0.5f);
+
+    int heights[GLYPH_WIDTH];
+    _heights(_bitmap(&cache, out[0]), heights);
+    for (int col = 0; col < GLYPH_WIDTH; ++col)
+    {
+        CHECK_EQ(heights[col], 5);
+    }
+}
+
+// Missing samples leave their columns empty, and a cell with none is a space using no slot
+static void test_sparkline_missing(void)
+{
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, FIRST_CODE);
+    float samples[2 * GLYPH_SPARK_SAMPLES_PER_CELL];
+    for (int i = 0; i < 2 * GLYPH_SPARK_SAMPLES_PER_CELL; ++i)
+    {
+        samples[i] = NAN;
+    }
+    samples[7] = 10.0f;
+    char out[3];
+    glyph_sparkline(&cache, out, samples, 2, 1.0f);
+
+    CHECK_EQ(out[0], ' ');
+    CHECK_EQ(out[1], FIRST_CODE);
+    int heights[GLYPH_WIDTH];
+    _heights(_bitmap(&cache, out[1]), heights);
+    CHECK_EQ(heights[0], 0);
+    CHECK_EQ(heights[2], 5);
+    CHECK_EQ(heights[4], 0);
+
+    // no valid samples at all
+    samples[7] = NAN;
+    glyph_cache_init(&cache, FIRST_CODE);
+    glyph_sparkline(&cache, out, samples, 2, 1.0f);
+    CHECK(strcmp(out, "  ") == 0);
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        CHECK(!cache.slots[i].valid);
+    }
+}
+
+// Identical bitmaps share a slot
+static void test_glyphs_shared(void)
+{
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, FIRST_CODE);
+    const float samples[] = { 1, 2, 3, 4, 5,  1, 2, 3, 4, 5,  5, 4, 3, 2, 1 };
+    char out[4];
+    glyph_sparkline(&cache, out, samples, 3, 0.5f);
+
+    CHECK_EQ(out[0], FIRST_CODE);
+    CHECK_EQ(out[1], FIRST_CODE);
+    CHECK_EQ(out[2], FIRST_CODE + 1);
+    CHECK(!cache.slots[2].valid);
+}
+
+// A render never replaces its own glyphs: past the last slot it falls back. The next render
+// replaces the least recently used slot, and the slot must be loaded again.
+static void test_glyphs_replaced(void)
+{
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, FIRST_CODE);
+    uint8_t bitmaps[GLYPH_NUM_SLOTS + 2][GLYPH_HEIGHT] = { { 0 } };
+    for (int i = 0; i < GLYPH_NUM_SLOTS + 2; ++i)
+    {
+        bitmaps[i][0] = i + 1;
+    }
+
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        CHECK_EQ(glyph_allocate(&cache, bitmaps[i]), FIRST_CODE + i);
+        cache.slots[i].defined = true;
+    }
+    CHECK_EQ(glyph_allocate(&cache, bitmaps[GLYPH_NUM_SLOTS]), GLYPH_FALLBACK);
+
+    // the next render uses slots 0 and 2 again, so slot 1 is the least recently used
+    glyph_cache_next_render(&cache);
+    CHECK_EQ(glyph_allocate(&cache, bitmaps[0]), FIRST_CODE);
+    CHECK_EQ(glyph_allocate(&cache, bitmaps[2]), FIRST_CODE + 2);
+    glyph_cache_next_render(&cache);
+    CHECK_EQ(glyph_allocate(&cache, bitmaps[GLYPH_NUM_SLOTS]), FIRST_CODE + 1);
+    CHECK(!cache.slots[1].defined);
+    CHECK(cache.slots[0].defined);
+    CHECK_EQ(glyph_allocate(&cache, bitmaps[GLYPH_NUM_SLOTS + 1]), FIRST_CODE + 3);
+
+    glyph_cache_undefine(&cache);
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        CHECK(cache.slots[i].valid && !cache.slots[i].defined);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_sparkline_scaled);
+    RUN_TEST(test_sparkline_flat);
+    RUN_TEST(test_sparkline_missing);
+    RUN_TEST(test_glyphs_shared);
+    RUN_TEST(test_glyphs_replaced);
+    return CHECK_EXIT();
+}
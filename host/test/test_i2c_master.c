@@ -0,0 +1,248 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the I2C master on the simulated bus: stuck-bus recovery and the adaptive bus clock.
+ * Each test runs in its own process, as the I2C master keeps static state.
+ */
+
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "resources.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "check.h"
+
+#define ADDRESS        CONFIG_AVR_I2C_ADDRESS
+#define WINDOW         (64)    // transactions per error-rate window, as i2c_master.c
+#define CLEAN_WINDOWS  (16)
+
+// Acknowledges every byte, except that every nack_every'th write is NACKed if nack_every > 0
+typedef struct
+{
+    uint32_t nack_every;
+    uint32_t writes;
+} device_t;
+
+static device_t _device = { 0 };
+
+static bool _start(void * context, bool read)
+{
+    return true;
+}
+
+static bool _write(void * context, uint8_t value)
+{
+    device_t * device = (device_t *)context;
+    ++device->writes;
+    return device->nack_every == 0 || device->writes % device->nack_every != 0;
+}
+
+static uint8_t _read(void * context)
+{
+    return 0xff;
+}
+
+static const i2c_sim_device_t DEVICE = { _start, _write, _read, NULL };
+
+static const datastore_t * _datastore = NULL;
+static i2c_master_info_t * _info = NULL;
+static smbus_info_t * _smbus = NULL;
+
+static void _setup(void)
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    _device = (device_t){ 0 };
+    i2c_sim_attach(I2C_MASTER_NUM, ADDRESS, &DEVICE, &_device);
+
+    _datastore = datastore_create();
+    timer_wheel_init(1);
+    _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, _datastore);
+    _smbus = smbus_malloc();
+    smbus_init(_smbus, I2C_MASTER_NUM, ADDRESS);
+    smbus_set_timeout(_smbus, 50 / portTICK_RATE_MS);
+}
+
+// One recorded register write with the bus locked, as the drivers make them
+static esp_err_t _transaction(void)
+{
+    i2c_master_lock(_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+    uint64_t start = microseconds_since_boot();
+    esp_err_t err = i2c_master_record(_smbus, smbus_write_byte(_smbus, 0x04, 0x55), start, 0);
+    i2c_master_unlock(_info);
+    return err;
+}
+
+static esp_err_t _results[4];
+
+static void _stuck_task(void * pvParameter)
+{
+    _results[0] = _transaction();
+    _results[1] = _transaction();
+    vTaskDelete(NULL);
+}
+
+// A slave holding SDA low times the transaction out. The master clocks SCL until SDA is
+// released, reinstalls the driver, and the next transaction succeeds.
+static void test_stuck_sda_recovered(void)
+{
+    _setup();
+    i2c_sim_hold_sda(I2C_MASTER_NUM, 5);
+    xTaskCreate(_stuck_task, "stuck", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(1000 * 1000);
+
+    CHECK_EQ(_results[0], ESP_ERR_TIMEOUT);
+    CHECK_EQ(_results[1], ESP_OK);
+    CHECK_EQ(gpio_get_level(CONFIG_I2C_MASTER_SDA_GPIO), 1);
+    CHECK_EQ(gpio_get_level(CONFIG_I2C_MASTER_SCL_GPIO), 1);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->installs, 2);
+
+    // published by the statistics job
+    rtos_sim_run_for(60 * 1000 * 1000);
+    uint32_t recoveries = 0;
+    uint32_t recovery_time = 0;
+    datastore_get_uint32(_datastore, RESOURCE_ID_I2C_RECOVERY_COUNT, 0, &recoveries);
+    datastore_get_uint32(_datastore, RESOURCE_ID_I2C_RECOVERY_TIME_MAX, 0, &recovery_time);
+    CHECK_EQ(recoveries, 1);
+    CHECK(recovery_time > 0 && recovery_time < 1000);
+}
+
+// A slave that never releases SDA is reported as still held, and the bus is tried again on
+// the next timeout rather than given up
+static void test_stuck_sda_not_released(void)
+{
+    _setup();
+    i2c_sim_hold_sda(I2C_MASTER_NUM, 100);
+    xTaskCreate(_stuck_task, "stuck", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(1000 * 1000);
+
+    // 9 clocks per recovery: the second recovery still leaves SDA held
+    CHECK_EQ(_results[0], ESP_ERR_TIMEOUT);
+    CHECK_EQ(_results[1], ESP_ERR_TIMEOUT);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->installs, 3);
+    CHECK_EQ(gpio_get_level(CONFIG_I2C_MASTER_SDA_GPIO), 0);
+}
+
+static uint32_t _clock_after[8];
+static uint32_t _timeouts = 0;
+
+// A transaction that times out on a slave holding SDA, or is NACKed, every fifth time
+static void _faulty_transaction(int i, bool nack)
+{
+    if (i % 5 == 4 && !nack)
+    {
+        i2c_sim_hold_sda(I2C_MASTER_NUM, 1);
+    }
+    _timeouts += _transaction() == ESP_ERR_TIMEOUT ? 1 : 0;
+}
+
+static void _clock_task(void * pvParameter)
+{
+    // three windows at a 20% timeout rate
+    for (int w = 0; w < 3; ++w)
+    {
+        for (int i = 0; i < WINDOW; ++i)
+        {
+            _faulty_transaction(w * WINDOW + i, false);
+        }
+        _clock_after[w] = i2c_sim_clock(I2C_MASTER_NUM);
+    }
+
+    // then error-free, one clean run of windows per step back up
+    for (int step = 0; step < 3; ++step)
+    {
+        for (int i = 0; i < CLEAN_WINDOWS * WINDOW; ++i)
+        {
+            _transaction();
+        }
+        _clock_after[3 + step] = i2c_sim_clock(I2C_MASTER_NUM);
+    }
+    vTaskDelete(NULL);
+}
+
+// A high bus error rate halves the clock down to the minimum. A run of clean windows doubles
+// it again, never beyond the configured clock.
+static void test_adaptive_clock(void)
+{
+    _setup();
+    CHECK_EQ(i2c_sim_clock(I2C_MASTER_NUM), I2C_MASTER_FREQ_HZ);
+    xTaskCreate(_clock_task, "clock", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(60 * 1000 * 1000);
+
+    CHECK_EQ(_clock_after[0], I2C_MASTER_FREQ_HZ / 2);
+    CHECK_EQ(_clock_after[1], I2C_MASTER_FREQ_HZ / 4);
+    CHECK_EQ(_clock_after[2], I2C_MASTER_MIN_FREQ_HZ);
+    CHECK_EQ(_clock_after[3], I2C_MASTER_FREQ_HZ / 2);
+    CHECK_EQ(_clock_after[4], I2C_MASTER_FREQ_HZ);
+    CHECK_EQ(_clock_after[5], I2C_MASTER_FREQ_HZ);
+    CHECK_EQ(_timeouts, 3 * WINDOW / 5);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->installs, 1 + _timeouts);
+}
+
+static void _nack_task(void * pvParameter)
+{
+    _device.nack_every = 5;
+    for (int i = 0; i < 3 * WINDOW; ++i)
+    {
+        _faulty_transaction(i, true);
+    }
+    vTaskDelete(NULL);
+}
+
+// NACKs are answers from a device on a working bus, such as a busy or absent slave - they
+// are counted against the device but never slow the clock down
+static void test_nacks_keep_clock(void)
+{
+    _setup();
+    xTaskCreate(_nack_task, "nack", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(10 * 1000 * 1000);
+
+    CHECK(i2c_sim_stats(I2C_MASTER_NUM)->nacks >= 3 * WINDOW / 5);
+    CHECK_EQ(i2c_sim_clock(I2C_MASTER_NUM), I2C_MASTER_FREQ_HZ);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->installs, 1);
+}
+
+int main(void)
+{
+    RUN_TEST_ISOLATED(test_stuck_sda_recovered);
+    RUN_TEST_ISOLATED(test_stuck_sda_not_released);
+    RUN_TEST_ISOLATED(test_adaptive_clock);
+    RUN_TEST_ISOLATED(test_nacks_keep_clock);
+    return CHECK_EXIT();
+}
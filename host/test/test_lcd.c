@@ -0,0 +1,271 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the LCD burst encoding used by the display, decoded by a PCF8574/HD44780 model on
+ * the simulated I2C bus, and the cost of a full repaint against the i2c-lcd1602 component's
+ * transaction per port write.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#include "i2c_master.h"
+#include "lcd_burst.h"
+#include "timer_wheel.h"
+#include "smbus.h"
+#include "datastore/datastore.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "lcd_device.h"
+#include "check.h"
+
+#define BACKLIGHT      0x08
+
+// Bus time of a transaction on the simulated bus (i2c_sim.h) at 100 kHz: the per-command
+// overhead, then START and STOP and 9 clocks per byte including the address
+#define TRANSACTION_US(bytes)  (I2C_SIM_COMMAND_OVERHEAD_US + (2 + 9 * (bytes)) * 1000000 / I2C_MASTER_FREQ_HZ)
+#define BURST_SIZE     ((LCD_DEVICE_COLUMNS + 1) * LCD_BURST_PORT_WRITES_PER_BYTE)
+
+static i2c_master_info_t * _info = NULL;
+static void (*_body)(void) = NULL;
+
+static void _task(void * pvParameter)
+{
+    _body();
+    vTaskDelete(NULL);
+}
+
+// Run body in a task against a fresh bus with the LCD backpack attached
+static void _run(void (*body)(void))
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    lcd_device_attach(I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS);
+    timer_wheel_init(1);
+    _info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, datastore_create());
+
+    _body = body;
+    xTaskCreate(_task, "lcd", 4096, NULL, 1, NULL);
+    rtos_sim_run_for(10 * 1000 * 1000);
+}
+
+static void _send(uint8_t * burst, size_t len)
+{
+    i2c_cmd_handle_t cmd = i2c_master_build_write(CONFIG_LCD1602_I2C_ADDRESS, burst, len);
+    i2c_master_lock(_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
+    CHECK_EQ(i2c_master_run(_info, cmd, portMAX_DELAY), ESP_OK);
+    i2c_master_unlock(_info);
+    i2c_cmd_link_delete(cmd);
+}
+
+static void _write_run(uint8_t col, uint8_t row, const char * string)
+{
+    uint8_t burst[BURST_SIZE];
+    _send(burst, lcd_burst_run(burst, sizeof(burst), col, row, string, BACKLIGHT));
+}
+
+static void _check_row(uint8_t row, const char * expected)
+{
+    char actual[LCD_DEVICE_COLUMNS + 1];
+    lcd_device_row(row, actual);
+    CHECK(strcmp(actual, expected) == 0);
+    if (strcmp(actual, expected) != 0)
+    {
+        fprintf(stderr, "  row %d: \"%s\", expected \"%s\"\n", row, actual, expected);
+    }
+}
+
+// A byte is two nibbles, high first, each set up, strobed with E and released
+static void test_append_encoding(void)
+{
+    uint8_t burst[2 * LCD_BURST_PORT_WRITES_PER_BYTE];
+    size_t len = lcd_burst_append(burst, 0, 0x80, BACKLIGHT);
+    len = lcd_burst_append(burst, len, 'A', BACKLIGHT | LCD_BURST_RS);
+
+    const uint8_t expected[] = { 0x88, 0x8c, 0x88, 0x08, 0x0c, 0x08,
+                                 0x49, 0x4d, 0x49, 0x19, 0x1d, 0x19 };
+    CHECK_EQ(len, sizeof(expected));
+    CHECK(memcmp(burst, expected, sizeof(expected)) == 0);
+}
+
+static void _runs_body(void)
+{
+    _write_run(0, 0, "Pool 25.3");
+    _write_run(5, 1, "Flow 12");
+    _write_run(0, 2, "row two");
+    _write_run(19, 3, "X");
+}
+
+// Each run is one transaction that the controller decodes to the characters at the position,
+// with the backlight kept on throughout
+static void test_runs_decoded(void)
+{
+    _run(_runs_body);
+    _check_row(0, "Pool 25.3           ");
+    _check_row(1, "     Flow 12        ");
+    _check_row(2, "row two             ");
+    _check_row(3, "                   X");
+
+    const lcd_device_stats_t * stats = lcd_device_stats();
+    CHECK_EQ(stats->transactions, 4);
+    CHECK_EQ(stats->bytes, 4 + 9 + 7 + 7 + 1);
+    CHECK_EQ(stats->port_writes, stats->bytes * LCD_BURST_PORT_WRITES_PER_BYTE);
+    CHECK_EQ(stats->backlight_off, 0);
+}
+
+static void _overwrite_body(void)
+{
+    _write_run(0, 0, "Temp 21.0 C");
+    _write_run(5, 0, "22.5");
+}
+
+// A run part-way along a row changes only its own cells
+static void test_run_overwrites(void)
+{
+    _run(_overwrite_body);
+    _check_row(0, "Temp 22.5 C         ");
+}
+
+static void _truncate_body(void)
+{
+    uint8_t burst[4 * LCD_BURST_PORT_WRITES_PER_BYTE + 3];
+    size_t len = lcd_burst_run(burst, sizeof(burst), 0, 1, "abcdefgh", BACKLIGHT);
+    CHECK_EQ(len, 4 * LCD_BURST_PORT_WRITES_PER_BYTE);
+    _send(burst, len);
+}
+
+// A string longer than the burst is cut at a whole character
+static void test_run_truncated(void)
+{
+    _run(_truncate_body);
+    _check_row(1, "abc                 ");
+}
+
+static void _shift_body(void)
+{
+    _write_run(0, 0, "01234567890123456789");
+    _write_run(0, 2, "abcdefghijklmnopqrst");
+    uint8_t burst[LCD_BURST_PORT_WRITES_PER_BYTE];
+    _send(burst, lcd_burst_append(burst, 0, LCD_BURST_SHIFT_LEFT, BACKLIGHT));
+}
+
+// Rows 0 and 2 are one 40-character DDRAM line, so a shift moves row 2's first character onto
+// row 0, and row 0's first onto the end of row 2
+static void test_shift_left(void)
+{
+    _run(_shift_body);
+    _check_row(0, "1234567890123456789a");
+    _check_row(2, "bcdefghijklmnopqrst0");
+}
+
+static const char * PAGE[LCD_DEVICE_ROWS] = {
+    "Pool 25.3C  Air 21.0",
+    "CP On   PP Off  Auto",
+    "Flow 12.4 LPM  Light",
+    "Power 1234 W  12:04 ",
+};
+
+// A row written as the i2c-lcd1602 component writes it: each port write of the cursor move and
+// of every character is its own SMBus send-byte, with its own START, address and STOP
+static void _library_write_run(smbus_info_t * smbus_info, uint8_t col, uint8_t row, const char * string)
+{
+    uint8_t burst[BURST_SIZE];
+    size_t len = lcd_burst_run(burst, sizeof(burst), col, row, string, BACKLIGHT);
+    i2c_master_lock(_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
+    for (size_t i = 0; i < len; ++i)
+    {
+        CHECK_EQ(smbus_send_byte(smbus_info, burst[i]), ESP_OK);
+    }
+    i2c_master_unlock(_info);
+}
+
+static void _library_repaint_body(void)
+{
+    smbus_info_t * smbus_info = smbus_malloc();
+    smbus_init(smbus_info, I2C_MASTER_NUM, CONFIG_LCD1602_I2C_ADDRESS);
+    for (int row = 0; row < LCD_DEVICE_ROWS; ++row)
+    {
+        _library_write_run(smbus_info, 0, row, PAGE[row]);
+    }
+}
+
+static void _burst_repaint_body(void)
+{
+    for (int row = 0; row < LCD_DEVICE_ROWS; ++row)
+    {
+        _write_run(0, row, PAGE[row]);
+    }
+}
+
+static void _check_page(void)
+{
+    for (int row = 0; row < LCD_DEVICE_ROWS; ++row)
+    {
+        _check_row(row, PAGE[row]);
+    }
+}
+
+// A full 4x20 repaint: 4 x 21 bytes (cursor move and 20 characters) of 6 port writes each.
+// Through the component that is 504 transactions of an address and one port write; as bursts
+// it is one transaction per row, each an address and 126 port writes. The simulated bus time
+// is 126 ms against 46 ms; the component's strobe delays come on top and are not modelled.
+static void test_full_repaint_library(void)
+{
+    _run(_library_repaint_body);
+    _check_page();
+    CHECK_EQ(lcd_device_stats()->transactions, 504);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->bytes, 1008);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->busy_us, 504 * TRANSACTION_US(2));
+}
+
+static void test_full_repaint_burst(void)
+{
+    _run(_burst_repaint_body);
+    _check_page();
+    CHECK_EQ(lcd_device_stats()->transactions, 4);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->bytes, 508);
+    CHECK_EQ(i2c_sim_stats(I2C_MASTER_NUM)->busy_us, 4 * TRANSACTION_US(127));
+}
+
+int main(void)
+{
+    RUN_TEST(test_append_encoding);
+    RUN_TEST_ISOLATED(test_runs_decoded);
+    RUN_TEST_ISOLATED(test_run_overwrites);
+    RUN_TEST_ISOLATED(test_run_truncated);
+    RUN_TEST_ISOLATED(test_shift_left);
+    RUN_TEST_ISOLATED(test_full_repaint_library);
+    RUN_TEST_ISOLATED(test_full_repaint_burst);
+    return CHECK_EXIT();
+}
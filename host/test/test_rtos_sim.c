@@ -0,0 +1,377 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the simulated scheduler and I2C bus that the task-level host harnesses run on:
+ * priority order, delays, notifications and queues in virtual time, pre-emption, and the
+ * timing and fault behaviour of the simulated bus.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "driver/gpio.h"
+#include "rom/ets_sys.h"
+#include "smbus.h"
+
+#include "vclock.h"
+#include "rtos_sim.h"
+#include "i2c_sim.h"
+#include "gpio_fake.h"
+#include "check.h"
+
+#define MAX_EVENTS (32)
+
+static char _events[MAX_EVENTS][16];
+static int64_t _event_times[MAX_EVENTS];
+static size_t _num_events = 0;
+
+static void _event(const char * name)
+{
+    if (_num_events < MAX_EVENTS)
+    {
+        snprintf(_events[_num_events], sizeof(_events[0]), "%s", name);
+        _event_times[_num_events] = vclock_now();
+        ++_num_events;
+    }
+}
+
+static void _setup(void)
+{
+    vclock_reset(0);
+    rtos_sim_reset();
+    gpio_fake_reset();
+    i2c_sim_reset();
+    memset(_events, 0, sizeof(_events));
+    _num_events = 0;
+}
+
+static void _delay_task(void * arg)
+{
+    const char * name = (const char *)arg;
+    vTaskDelay(5);
+    _event(name);
+    vTaskDelete(NULL);
+}
+
+static void test_priority_order(void)
+{
+    _setup();
+    xTaskCreate(_delay_task, "low", 2048, "low", 1, NULL);
+    xTaskCreate(_delay_task, "high", 2048, "high", 3, NULL);
+    xTaskCreate(_delay_task, "mid", 2048, "mid", 2, NULL);
+    CHECK_EQ(uxTaskGetNumberOfTasks(), 3);
+    CHECK_EQ(rtos_sim_stack_bytes(), 3 * 2048);
+
+    rtos_sim_run_for(100000);
+    CHECK_EQ(_num_events, 3);
+    CHECK(strcmp(_events[0], "high") == 0);
+    CHECK(strcmp(_events[1], "mid") == 0);
+    CHECK(strcmp(_events[2], "low") == 0);
+    CHECK_EQ(_event_times[0], 5 * portTICK_PERIOD_MS * 1000);
+    CHECK_EQ(uxTaskGetNumberOfTasks(), 0);
+    CHECK_EQ(vclock_now(), 100000);
+}
+
+static void _periodic_task(void * arg)
+{
+    TickType_t last = xTaskGetTickCount();
+    while (1)
+    {
+        vTaskDelayUntil(&last, 10);
+        _event("tick");
+        rtos_sim_busy_us(3000);    // work does not drift the period
+    }
+}
+
+static void test_delay_until_keeps_period(void)
+{
+    _setup();
+    xTaskCreate(_periodic_task, "periodic", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(1000000);
+    CHECK_EQ(_num_events, 10);
+    for (size_t i = 0; i < _num_events; ++i)
+    {
+        CHECK_EQ(_event_times[i], (int64_t)(i + 1) * 100000);
+    }
+}
+
+static TaskHandle_t _waiter = NULL;
+
+static void _notified_task(void * arg)
+{
+    while (1)
+    {
+        uint32_t value = ulTaskNotifyTake(pdTRUE, 50);
+        _event(value ? "notified" : "timeout");
+    }
+}
+
+static void _notifier_task(void * arg)
+{
+    vTaskDelay(20);
+    _event("give");
+    xTaskNotifyGive(_waiter);
+    _event("after give");
+    vTaskDelete(NULL);
+}
+
+// A notification readies a higher-priority waiter at once, and the giver resumes afterwards
+static void test_notify_preempts(void)
+{
+    _setup();
+    xTaskCreate(_notified_task, "waiter", 2048, NULL, 5, &_waiter);
+    xTaskCreate(_notifier_task, "notifier", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(800000);
+
+    CHECK_EQ(_num_events, 4);
+    CHECK(strcmp(_events[0], "give") == 0);
+    CHECK(strcmp(_events[1], "notified") == 0);
+    CHECK(strcmp(_events[2], "after give") == 0);
+    CHECK(strcmp(_events[3], "timeout") == 0);
+    CHECK_EQ(_event_times[1], 200000);
+    CHECK_EQ(_event_times[3], 700000);
+}
+
+static QueueHandle_t _queue = NULL;
+
+static void _producer_task(void * arg)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        xQueueSendToBack(_queue, &i, portMAX_DELAY);
+    }
+    _event("produced");
+    vTaskDelete(NULL);
+}
+
+static void _consumer_task(void * arg)
+{
+    int value = 0;
+    while (xQueueReceive(_queue, &value, 100) == pdTRUE)
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "got %d", value);
+        _event(name);
+        vTaskDelay(1);
+    }
+    _event("drained");
+    vTaskDelete(NULL);
+}
+
+// The producer blocks on the full queue and is released as the consumer drains it
+static void test_queue_blocks_when_full(void)
+{
+    _setup();
+    _queue = xQueueCreate(2, sizeof(int));
+    xTaskCreate(_producer_task, "producer", 2048, NULL, 2, NULL);
+    xTaskCreate(_consumer_task, "consumer", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(2000000);
+
+    CHECK_EQ(_num_events, 6);
+    CHECK(strcmp(_events[0], "got 0") == 0);
+    CHECK(strcmp(_events[1], "produced") == 0);
+    CHECK(strcmp(_events[2], "got 1") == 0);
+    CHECK(strcmp(_events[5], "drained") == 0);
+    CHECK_EQ(uxQueueMessagesWaiting(_queue), 0);
+}
+
+static void _busy_task(void * arg)
+{
+    _event("busy start");
+    rtos_sim_busy_us(50000);
+    _event("busy end");
+    vTaskDelete(NULL);
+}
+
+static void _urgent_task(void * arg)
+{
+    vTaskDelay(2);
+    _event("urgent");
+    vTaskDelete(NULL);
+}
+
+// A busy low-priority task is pre-empted when a higher-priority task wakes, and finishes later
+static void test_busy_preempted(void)
+{
+    _setup();
+    xTaskCreate(_busy_task, "busy", 2048, NULL, 1, NULL);
+    xTaskCreate(_urgent_task, "urgent", 2048, NULL, 4, NULL);
+    rtos_sim_run_for(100000);
+
+    CHECK_EQ(_num_events, 3);
+    CHECK(strcmp(_events[1], "urgent") == 0);
+    CHECK_EQ(_event_times[1], 20000);
+    CHECK(strcmp(_events[2], "busy end") == 0);
+    CHECK_EQ(_event_times[2], 50000);
+}
+
+typedef struct
+{
+    uint8_t reg;
+    uint8_t regs[4];
+    bool pointer_set;
+} echo_device_t;
+
+static bool _echo_start(void * context, bool read)
+{
+    ((echo_device_t *)context)->pointer_set = false;
+    return true;
+}
+
+static bool _echo_write(void * context, uint8_t value)
+{
+    echo_device_t * device = (echo_device_t *)context;
+    if (!device->pointer_set)
+    {
+        device->reg = value;
+        device->pointer_set = true;
+        return true;
+    }
+    device->regs[device->reg++ % 4] = value;
+    return true;
+}
+
+static uint8_t _echo_read(void * context)
+{
+    echo_device_t * device = (echo_device_t *)context;
+    return device->regs[device->reg++ % 4];
+}
+
+static const i2c_sim_device_t ECHO_DEVICE = { _echo_start, _echo_write, _echo_read, NULL };
+
+static void _install(void)
+{
+    i2c_config_t config = { 0 };
+    config.mode = I2C_MODE_MASTER;
+    config.sda_io_num = 18;
+    config.scl_io_num = 19;
+    config.master.clk_speed = 100000;
+    i2c_param_config(I2C_NUM_0, &config);
+    i2c_driver_install(I2C_NUM_0, config.mode, 0, 0, 0);
+}
+
+static echo_device_t _echo = { 0 };
+static smbus_info_t * _smbus = NULL;
+
+static void _bus_task(void * arg)
+{
+    uint8_t value = 0;
+    uint16_t word = 0;
+    CHECK_EQ(smbus_write_byte(_smbus, 1, 0xa5), ESP_OK);
+    _event("written");
+    CHECK_EQ(smbus_read_byte(_smbus, 1, &value), ESP_OK);
+    CHECK_EQ(value, 0xa5);
+    CHECK_EQ(smbus_write_word(_smbus, 2, 0x1234), ESP_OK);
+    CHECK_EQ(smbus_read_word(_smbus, 2, &word), ESP_OK);
+    CHECK_EQ(word, 0x1234);
+
+    smbus_info_t * absent = smbus_malloc();
+    smbus_init(absent, I2C_NUM_0, 0x20);
+    CHECK_EQ(smbus_send_byte(absent, 0), ESP_FAIL);
+    smbus_free(&absent);
+    _event("done");
+    vTaskDelete(NULL);
+}
+
+// Transactions take their wire time, and an absent address is NACKed
+static void test_i2c_timing(void)
+{
+    _setup();
+    _install();
+    memset(&_echo, 0, sizeof(_echo));
+    i2c_sim_attach(I2C_NUM_0, 0x44, &ECHO_DEVICE, &_echo);
+    _smbus = smbus_malloc();
+    smbus_init(_smbus, I2C_NUM_0, 0x44);
+
+    xTaskCreate(_bus_task, "bus", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(100000);
+
+    // START, 3 bytes, STOP at 100 kHz plus the command overhead
+    CHECK_EQ(_event_times[0], I2C_SIM_COMMAND_OVERHEAD_US + (2 + 3 * 9) * 10);
+    const i2c_sim_stats_t * stats = i2c_sim_stats(I2C_NUM_0);
+    CHECK_EQ(stats->commands, 5);
+    CHECK_EQ(stats->nacks, 1);
+    CHECK_EQ(stats->links_created, stats->links_deleted);
+    smbus_free(&_smbus);
+}
+
+static void _stuck_task(void * arg)
+{
+    CHECK_EQ(smbus_send_byte(_smbus, 0), ESP_ERR_TIMEOUT);
+    _event("timeout");
+
+    // clock SCL by hand with the driver removed, as bus recovery does
+    i2c_driver_delete(I2C_NUM_0);
+    for (int i = 0; i < 9 && gpio_get_level(18) == 0; ++i)
+    {
+        gpio_set_level(19, 0);
+        ets_delay_us(5);
+        gpio_set_level(19, 1);
+        ets_delay_us(5);
+    }
+    CHECK_EQ(gpio_get_level(18), 1);
+    _install();
+    CHECK_EQ(smbus_send_byte(_smbus, 0), ESP_OK);
+    _event("recovered");
+    vTaskDelete(NULL);
+}
+
+// A held SDA line times the command out, and is released by clocking SCL
+static void test_i2c_stuck_sda(void)
+{
+    _setup();
+    _install();
+    i2c_sim_attach(I2C_NUM_0, 0x44, &ECHO_DEVICE, &_echo);
+    _smbus = smbus_malloc();
+    smbus_init(_smbus, I2C_NUM_0, 0x44);
+    smbus_set_timeout(_smbus, 5);
+    i2c_sim_hold_sda(I2C_NUM_0, 3);
+
+    xTaskCreate(_stuck_task, "stuck", 2048, NULL, 1, NULL);
+    rtos_sim_run_for(1000000);
+
+    CHECK_EQ(_num_events, 2);
+    CHECK_EQ(_event_times[0], 50000);
+    CHECK_EQ(i2c_sim_stats(I2C_NUM_0)->timeouts, 1);
+    CHECK_EQ(i2c_sim_stats(I2C_NUM_0)->installs, 2);
+    smbus_free(&_smbus);
+}
+
+int main(void)
+{
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_delay_until_keeps_period);
+    RUN_TEST(test_notify_preempts);
+    RUN_TEST(test_queue_blocks_when_full);
+    RUN_TEST(test_busy_preempted);
+    RUN_TEST(test_i2c_timing);
+    RUN_TEST(test_i2c_stuck_sda);
+    return CHECK_EXIT();
+}
@@ -0,0 +1,258 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tests for the time-of-day scheduler across the New Zealand DST transitions, and with the
+ * wall clock stepped relative to uptime.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "schedule.h"
+
+#include "check.h"
+
+#define TIME_ZONE "NZST-12NZDT,M9.5.0,M4.1.0/3"
+
+static time_t _local(int year, int month, int day, int hour, int minute, int isdst)
+{
+    struct tm tm = {
+        .tm_year = year - 1900,
+        .tm_mon = month - 1,
+        .tm_mday = day,
+        .tm_hour = hour,
+        .tm_min = minute,
+        .tm_isdst = isdst,
+    };
+    return mktime(&tm);
+}
+
+static void _check_local(time_t t, int day, int hour, int minute, int isdst)
+{
+    struct tm tm;
+    localtime_r(&t, &tm);
+    CHECK_EQ(tm.tm_mday, day);
+    CHECK_EQ(tm.tm_hour, hour);
+    CHECK_EQ(tm.tm_min, minute);
+    CHECK_EQ(tm.tm_isdst, isdst);
+}
+
+static void test_next_same_day_and_following_day(void)
+{
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    time_t next = schedule_next(&entry, 1, _local(2018, 1, 15, 8, 0, -1));
+    _check_local(next, 15, 9, 0, 1);
+
+    // strictly after: at the firing time itself, the next is tomorrow
+    next = schedule_next(&entry, 1, next);
+    _check_local(next, 16, 9, 0, 1);
+}
+
+static void test_next_weekday_mask(void)
+{
+    // 2018-01-15 is a Monday; fire on Sundays only
+    schedule_entry_t entry = { 9, 0, 1 << 0 };
+    time_t next = schedule_next(&entry, 1, _local(2018, 1, 15, 8, 0, -1));
+    _check_local(next, 21, 9, 0, 1);
+
+    // a single-weekday mask that matches today but has passed is a week away
+    next = schedule_next(&entry, 1, _local(2018, 1, 21, 10, 0, -1));
+    _check_local(next, 28, 9, 0, 1);
+}
+
+static void test_next_disabled_entries(void)
+{
+    schedule_entry_t entries[] = {
+        { -1, 0, SCHEDULE_ALL_DAYS },
+        { 9, -1, SCHEDULE_ALL_DAYS },
+        { 9, 0, 0 },
+    };
+    CHECK_EQ(schedule_next(entries, 3, _local(2018, 1, 15, 8, 0, -1)), SCHEDULE_INVALID_TIME);
+}
+
+static void test_spring_forward_gap(void)
+{
+    // 2018-09-30 02:00 NZST jumps to 03:00 NZDT, so 02:30 does not exist that day. It fires
+    // once, an hour later in wall clock time, and at 02:30 again the next day.
+    schedule_entry_t entry = { 2, 30, SCHEDULE_ALL_DAYS };
+    time_t next = schedule_next(&entry, 1, _local(2018, 9, 30, 0, 0, -1));
+    CHECK_EQ(next, _local(2018, 9, 30, 1, 30, 0) + 3600);
+    _check_local(next, 30, 3, 30, 1);
+
+    next = schedule_next(&entry, 1, next);
+    _check_local(next, 1, 2, 30, 1);
+
+    // an entry either side of the gap is unaffected
+    schedule_entry_t before = { 1, 59, SCHEDULE_ALL_DAYS };
+    schedule_entry_t after = { 3, 0, SCHEDULE_ALL_DAYS };
+    _check_local(schedule_next(&before, 1, _local(2018, 9, 30, 0, 0, -1)), 30, 1, 59, 0);
+    _check_local(schedule_next(&after, 1, _local(2018, 9, 30, 0, 0, -1)), 30, 3, 0, 1);
+}
+
+static void test_fall_back_repeat(void)
+{
+    // 2018-04-01 03:00 NZDT falls back to 02:00 NZST, so 02:30 occurs twice. It fires at the
+    // first occurrence only.
+    schedule_entry_t entry = { 2, 30, SCHEDULE_ALL_DAYS };
+    time_t first = schedule_next(&entry, 1, _local(2018, 4, 1, 0, 0, -1));
+    CHECK_EQ(first, _local(2018, 4, 1, 2, 30, 1));
+    _check_local(first, 1, 2, 30, 1);
+
+    time_t next = schedule_next(&entry, 1, first);
+    _check_local(next, 2, 2, 30, 0);
+
+    // polled through the night, it fires once
+    schedule_t schedule;
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+    time_t start = _local(2018, 4, 1, 0, 0, -1);
+    uint32_t fired = 0;
+    for (uint32_t uptime = 0; uptime < 6 * 3600; uptime += 10)
+    {
+        if (schedule_poll(&schedule, start + uptime, uptime))
+        {
+            ++fired;
+            CHECK_EQ(start + uptime, first);
+        }
+    }
+    CHECK_EQ(fired, 1);
+}
+
+static void test_poll_fires_once(void)
+{
+    schedule_t schedule;
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+
+    time_t start = _local(2018, 1, 15, 8, 59, -1);
+    uint32_t fired = 0;
+    for (uint32_t uptime = 0; uptime < 120; ++uptime)
+    {
+        fired += schedule_poll(&schedule, start + uptime, uptime) ? 1 : 0;
+        if (start + uptime == _local(2018, 1, 15, 9, 0, -1))
+        {
+            CHECK_EQ(fired, 1);
+        }
+    }
+    CHECK_EQ(fired, 1);
+    _check_local(schedule.next, 16, 9, 0, 1);
+}
+
+static void test_poll_clock_step_forward_across_firing(void)
+{
+    schedule_t schedule;
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+
+    time_t start = _local(2018, 1, 15, 8, 58, -1);
+    CHECK(!schedule_poll(&schedule, start, 100));
+    CHECK(!schedule_poll(&schedule, start + 1, 101));
+
+    // SNTP steps the clock forward five minutes, past the firing time: fire late, once
+    CHECK(schedule_poll(&schedule, start + 302, 102));
+    CHECK(!schedule_poll(&schedule, start + 303, 103));
+    _check_local(schedule.next, 16, 9, 0, 1);
+}
+
+static void test_poll_clock_step_forward_before_firing(void)
+{
+    schedule_t schedule;
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+
+    time_t start = _local(2018, 1, 15, 8, 0, -1);
+    CHECK(!schedule_poll(&schedule, start, 100));
+
+    // a step that doesn't reach the firing time changes nothing
+    CHECK(!schedule_poll(&schedule, start + 1800, 101));
+    CHECK_EQ(schedule.next, _local(2018, 1, 15, 9, 0, -1));
+}
+
+static void test_poll_clock_step_backward_after_firing(void)
+{
+    schedule_t schedule;
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+
+    time_t fire = _local(2018, 1, 15, 9, 0, -1);
+    CHECK(!schedule_poll(&schedule, fire - 1, 99));
+    CHECK(schedule_poll(&schedule, fire, 100));
+
+    // the clock is stepped back 30 s, so 09:00 passes again: it must not fire a second time
+    uint32_t fired = 0;
+    for (uint32_t i = 1; i < 120; ++i)
+    {
+        fired += schedule_poll(&schedule, fire - 30 + i, 100 + i) ? 1 : 0;
+    }
+    CHECK_EQ(fired, 0);
+    _check_local(schedule.next, 16, 9, 0, 1);
+}
+
+static void test_poll_clock_step_backward_before_firing(void)
+{
+    schedule_t schedule;
+    schedule_entry_t entry = { 9, 0, SCHEDULE_ALL_DAYS };
+    schedule_init(&schedule);
+    schedule_set_entries(&schedule, &entry, 1);
+
+    // a step back an hour before the firing still fires once, at 09:00
+    time_t start = _local(2018, 1, 15, 8, 30, -1);
+    CHECK(!schedule_poll(&schedule, start, 100));
+    CHECK(!schedule_poll(&schedule, start - 3600, 101));
+    uint32_t fired = 0;
+    for (uint32_t i = 1; i <= 5400; ++i)
+    {
+        bool f = schedule_poll(&schedule, start - 3600 + i, 101 + i);
+        fired += f ? 1 : 0;
+        if (f)
+        {
+            CHECK_EQ(start - 3600 + i, _local(2018, 1, 15, 9, 0, -1));
+        }
+    }
+    CHECK_EQ(fired, 1);
+}
+
+int main(void)
+{
+    setenv("TZ", TIME_ZONE, 1);
+    tzset();
+
+    RUN_TEST(test_next_same_day_and_following_day);
+    RUN_TEST(test_next_weekday_mask);
+    RUN_TEST(test_next_disabled_entries);
+    RUN_TEST(test_spring_forward_gap);
+    RUN_TEST(test_fall_back_repeat);
+    RUN_TEST(test_poll_fires_once);
+    RUN_TEST(test_poll_clock_step_forward_across_firing);
+    RUN_TEST(test_poll_clock_step_forward_before_firing);
+    RUN_TEST(test_poll_clock_step_backward_after_firing);
+    RUN_TEST(test_poll_clock_step_backward_before_firing);
+    return CHECK_EXIT();
+}
@@ -0,0 +1,395 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Task-level tests: the application's tasks running together on the simulated scheduler and
+ * I2C bus (see system_harness.h). Each test runs in its own process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "resources.h"
+#include "avr_support.h"
+#include "i2c_master.h"
+#include "sdkconfig.h"
+#include "avr_sim.h"
+#include "esp_log.h"
+#include "../avr/avr-poolmon/registers.h"
+
+#include "vclock.h"
+#include "i2c_sim.h"
+#include "avr_device.h"
+#include "tsl2561_device.h"
+#include "system_harness.h"
+#include "check.h"
+
+static uint8_t _control = 0;
+static int64_t _ssr2_time = -1;
+static uint32_t _control_writes = 0;
+
+static void _control_written(uint8_t control, void * context)
+{
+    ++_control_writes;
+    if ((control & AVR_REGISTER_CONTROL_SSR2) && !(_control & AVR_REGISTER_CONTROL_SSR2))
+    {
+        _ssr2_time = vclock_now();
+    }
+    _control = control;
+}
+
+static void _init_config(system_harness_t * harness, const system_harness_config_t * config)
+{
+    system_harness_init(harness, config);
+    _control = 0;
+    _ssr2_time = -1;
+    _control_writes = 0;
+    avr_device_observe_control(_control_written, NULL);
+}
+
+static void _init(system_harness_t * harness, bool light_sensor, bool display_load)
+{
+    system_harness_config_t config = { .light_sensor = light_sensor, .display_load = display_load, .control_loops = true, .seed = 1 };
+    _init_config(harness, &config);
+}
+
+// Without the control loops, so that only the test changes the desired outputs
+static void _init_outputs_only(system_harness_t * harness)
+{
+    system_harness_config_t config = { .display_load = true, .seed = 1 };
+    _init_config(harness, &config);
+}
+
+static bool _ssr2_on(const system_harness_t * harness)
+{
+    return (_control & AVR_REGISTER_CONTROL_SSR2) != 0;
+}
+
+static bool _emergency_released(const system_harness_t * harness)
+{
+    return !avr_support_get_pp_emergency();
+}
+
+// The AVR, light sensor and control loops start and run without bus errors
+static void test_boot(void)
+{
+    system_harness_t harness;
+    _init(&harness, true, true);
+    system_harness_run(&harness, 30 * 1000);
+
+    uint8_t version = 0;
+    bool light_detected = false;
+    uint32_t illuminance = 0;
+    datastore_get_uint8(harness.datastore, RESOURCE_ID_AVR_VERSION, 0, &version);
+    datastore_get_bool(harness.datastore, RESOURCE_ID_LIGHT_DETECTED, 0, &light_detected);
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_LIGHT_ILLUMINANCE, 0, &illuminance);
+    CHECK_EQ(version, 1);
+    CHECK(light_detected);
+    CHECK(illuminance > 0);
+    CHECK_EQ(tsl2561_device_stats()->early_reads, 0);
+    CHECK_EQ(i2c_sim_stats(0)->nacks, 0);
+    CHECK_EQ(i2c_sim_stats(0)->timeouts, 0);
+    CHECK_EQ(i2c_sim_stats(0)->overlaps, 0);
+    CHECK_EQ(host_log_count(ESP_LOG_ERROR), 0);
+}
+
+// An overheated sample latches SSR2 on from the sensor task, well before the next PP loop
+// iteration, and the latch is released once the array has cooled
+static void test_emergency_latch(void)
+{
+    system_harness_t harness;
+    _init(&harness, true, true);
+    system_harness_run(&harness, 20 * 1000);
+    CHECK(!_ssr2_on(&harness));
+
+    harness.t_array = 85.0f;
+    CHECK(system_harness_run_until(&harness, _ssr2_on, 10 * 1000));
+    CHECK(_ssr2_time >= harness.t_array_published);
+    CHECK(_ssr2_time - harness.t_array_published < 200 * 1000);
+
+    uint32_t latency = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_EMERGENCY_LATENCY, 0, &latency);
+    CHECK(latency > 0);
+    CHECK(latency <= _ssr2_time - harness.t_array_published + 1000);
+
+    harness.t_array = 40.0f;
+    CHECK(system_harness_run_until(&harness, _emergency_released, 20 * 1000));
+    system_harness_run(&harness, 1000);
+    CHECK(!_ssr2_on(&harness));
+}
+
+// A temperature sensor that stops reporting after an overheated sample leaves SSR2 latched on,
+// failing safe, until it reports a cool array again
+static void test_emergency_stale_sample(void)
+{
+    system_harness_t harness;
+    _init(&harness, false, false);
+    system_harness_run(&harness, 20 * 1000);
+
+    harness.t_array = 85.0f;
+    CHECK(system_harness_run_until(&harness, _ssr2_on, 10 * 1000));
+    harness.sensors_ok = false;
+    system_harness_run(&harness, 60 * 1000);
+    CHECK(_ssr2_on(&harness));
+    CHECK(!_emergency_released(&harness));
+
+    harness.t_array = 40.0f;
+    harness.sensors_ok = true;
+    CHECK(system_harness_run_until(&harness, _emergency_released, 20 * 1000));
+    system_harness_run(&harness, 1000);
+    CHECK(!_ssr2_on(&harness));
+}
+
+// Poll counts and bus time are accumulated by the AVR task and published once a minute
+static void test_poll_stats_published(void)
+{
+    system_harness_t harness;
+    _init(&harness, false, false);
+    system_harness_run(&harness, 30 * 1000);
+    datastore_age_t age = 0;
+    datastore_get_age(harness.datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_MAX, 0, &age);
+    CHECK_EQ(age, DATASTORE_INVALID_AGE);
+
+    system_harness_run(&harness, 35 * 1000);
+    uint32_t avg = 0;
+    uint32_t max = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_AVG, 0, &avg);
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_MAX, 0, &max);
+    CHECK(avg > 0);
+    CHECK(avg <= max);
+
+    // polled every 250 ms without the attention line
+    uint32_t polls = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_COUNT_POLL, 0, &polls);
+    CHECK(polls >= 60 * 4 - 4 && polls <= 60 * 4 + 4);
+}
+
+static bool _switch_seen(const system_harness_t * harness)
+{
+    uint32_t value = 0;
+    datastore_get_uint32(harness->datastore, RESOURCE_ID_SWITCHES_CP_MODE_VALUE, 0, &value);
+    return value != 0;
+}
+
+// A single failed block read falls back to single-register reads for that poll only
+static void test_block_read_transient_failure(void)
+{
+    system_harness_t harness;
+    _init(&harness, false, false);
+    system_harness_run(&harness, 5 * 1000);
+    uint32_t block_reads = avr_device_block_reads();
+    CHECK(block_reads > 0);
+
+    avr_device_fail_block_reads(1);
+    system_harness_run(&harness, 2 * 1000);
+    CHECK(avr_device_block_reads() >= block_reads + 6);
+
+    // nothing was lost while falling back
+    avr_sim_set_switches(AVR_SIM_SWITCH_CP_MODE);
+    CHECK(system_harness_run_until(&harness, _switch_seen, 1000));
+}
+
+// Block reads that keep failing, including the re-run of the probe, are given up for good and
+// the poll carries on with single-register reads
+static void test_block_read_disabled(void)
+{
+    system_harness_t harness;
+    _init(&harness, false, false);
+    system_harness_run(&harness, 5 * 1000);
+
+    avr_device_fail_block_reads(UINT32_MAX);
+    system_harness_run(&harness, 5 * 1000);
+    uint32_t block_reads = avr_device_block_reads();
+    system_harness_run(&harness, 5 * 1000);
+    CHECK_EQ(avr_device_block_reads(), block_reads);
+
+    avr_sim_set_switches(AVR_SIM_SWITCH_CP_MODE);
+    CHECK(system_harness_run_until(&harness, _switch_seen, 1000));
+    uint32_t resets = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, &resets);
+    CHECK_EQ(resets, 0);
+}
+
+// A burst of output requests between two cycles of the AVR task collapses into one write of
+// the final state
+static void test_reconcile_burst(void)
+{
+    system_harness_t harness;
+    _init_outputs_only(&harness);
+    system_harness_run(&harness, 5 * 1000);
+    CHECK_EQ(avr_device_control(), 0);
+    uint32_t writes = _control_writes;
+
+    avr_support_set_cp_pump(AVR_PUMP_STATE_ON);
+    avr_support_set_pp_pump(AVR_PUMP_STATE_ON);
+    avr_support_set_alarm(AVR_ALARM_STATE_ON);
+    avr_support_set_cp_pump(AVR_PUMP_STATE_OFF);
+    avr_support_set_alarm(AVR_ALARM_STATE_OFF);
+    avr_support_set_cp_pump(AVR_PUMP_STATE_ON);
+    system_harness_run(&harness, 1000);
+
+    CHECK_EQ(avr_device_control(), AVR_REGISTER_CONTROL_SSR1 | AVR_REGISTER_CONTROL_SSR2);
+    CHECK_EQ(_control_writes, writes + 1);
+
+    // a request for the state already held writes nothing
+    avr_support_set_pp_pump(AVR_PUMP_STATE_ON);
+    system_harness_run(&harness, 1000);
+    CHECK_EQ(_control_writes, writes + 1);
+}
+
+static bool _cp_on(const system_harness_t * harness)
+{
+    return avr_device_control() & AVR_REGISTER_CONTROL_SSR1;
+}
+
+// An AVR reset clears CONTROL. The next poll reads it back and the desired state is written
+// again, without the control loops having to notice the reset.
+static void test_reconcile_after_reset(void)
+{
+    system_harness_t harness;
+    _init_outputs_only(&harness);
+    system_harness_run(&harness, 5 * 1000);
+    avr_support_set_cp_pump(AVR_PUMP_STATE_ON);
+    CHECK(system_harness_run_until(&harness, _cp_on, 1000));
+
+    avr_device_reset();
+    CHECK(!_cp_on(&harness));
+    int64_t reset_time = vclock_now();
+    CHECK(system_harness_run_until(&harness, _cp_on, 1000));
+
+    // within one poll period and the write
+    CHECK(vclock_now() - reset_time <= 260 * 1000);
+    system_harness_run(&harness, 1000);
+    uint32_t resets = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, &resets);
+    CHECK_EQ(resets, 1);
+}
+
+// Random output requests with resets injected between and during them: once the task has had
+// a poll period and a write to catch up, CONTROL always holds the last requested state
+static void test_reconcile_random_resets(void)
+{
+    system_harness_t harness;
+    _init_outputs_only(&harness);
+    system_harness_run(&harness, 5 * 1000);
+
+    srand(1);
+    uint8_t desired = 0;
+    uint32_t requests = 0;
+    uint32_t injected = 0;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        int action = rand() % 7;
+        bool on = action % 2;
+        switch (action / 2)
+        {
+            case 0:
+                avr_support_set_cp_pump(on ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
+                desired = on ? desired | AVR_REGISTER_CONTROL_SSR1 : desired & ~AVR_REGISTER_CONTROL_SSR1;
+                break;
+            case 1:
+                avr_support_set_pp_pump(on ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
+                desired = on ? desired | AVR_REGISTER_CONTROL_SSR2 : desired & ~AVR_REGISTER_CONTROL_SSR2;
+                break;
+            case 2:
+                avr_support_set_alarm(on ? AVR_ALARM_STATE_ON : AVR_ALARM_STATE_OFF);
+                desired = on ? desired | AVR_REGISTER_CONTROL_BUZZER : desired & ~AVR_REGISTER_CONTROL_BUZZER;
+                break;
+            default:
+                avr_device_reset();
+                ++injected;
+                break;
+        }
+        requests += action < 6 ? 1 : 0;
+
+        uint32_t run = rand() % 500;
+        system_harness_run(&harness, run);
+        if (run >= 260)
+        {
+            CHECK_EQ(avr_device_control(), desired);
+        }
+    }
+    system_harness_run(&harness, 1000);
+    CHECK_EQ(avr_device_control(), desired);
+
+    // one write at most per request or reset, and never a lost request or an error
+    CHECK(_control_writes <= requests + injected);
+    uint32_t resets = 0;
+    datastore_get_uint32(harness.datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, &resets);
+    CHECK(resets > 0 && resets <= injected);
+    CHECK_EQ(i2c_sim_stats(0)->nacks, 0);
+    CHECK_EQ(host_log_count(ESP_LOG_ERROR), 0);
+}
+
+// Per-device I2C statistics are published once a minute, setting only the values that changed.
+// The light sensor's latency covers its bus transactions, not the integration between them.
+static void test_i2c_stats_published(void)
+{
+    system_harness_t harness;
+    _init(&harness, true, true);
+    system_harness_run(&harness, 65 * 1000);
+
+    bool light_found = false;
+    for (datastore_instance_id_t i = 0; i < I2C_MASTER_MAX_DEVICES; ++i)
+    {
+        uint8_t address = 0;
+        datastore_get_uint8(harness.datastore, RESOURCE_ID_I2C_DEVICE_ADDRESS, i, &address);
+        if (address == CONFIG_LIGHT_SENSOR_I2C_ADDRESS)
+        {
+            uint32_t latency_max = 0;
+            datastore_get_uint32(harness.datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_MAX, i, &latency_max);
+            CHECK(latency_max > 0);
+            CHECK(latency_max < 1000);
+            light_found = true;
+        }
+    }
+    CHECK(light_found);
+
+    uint32_t transactions = datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_DEVICE_TRANSACTIONS);
+    uint32_t nacks = datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_DEVICE_NACKS);
+    uint32_t clock = datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_CLOCK_SPEED);
+    CHECK(nacks > 0);
+    CHECK_EQ(clock, 1);
+
+    // another minute of traffic without errors
+    system_harness_run(&harness, 60 * 1000);
+    CHECK(datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_DEVICE_TRANSACTIONS) > transactions);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_DEVICE_NACKS), nacks);
+    CHECK_EQ(datastore_fake_set_count(harness.datastore, RESOURCE_ID_I2C_CLOCK_SPEED), clock);
+}
+
+int main(void)
+{
+    RUN_TEST_ISOLATED(test_boot);
+    RUN_TEST_ISOLATED(test_emergency_latch);
+    RUN_TEST_ISOLATED(test_emergency_stale_sample);
+    RUN_TEST_ISOLATED(test_poll_stats_published);
+    RUN_TEST_ISOLATED(test_block_read_transient_failure);
+    RUN_TEST_ISOLATED(test_block_read_disabled);
+    RUN_TEST_ISOLATED(test_reconcile_burst);
+    RUN_TEST_ISOLATED(test_reconcile_after_reset);
+    RUN_TEST_ISOLATED(test_reconcile_random_resets);
+    RUN_TEST_ISOLATED(test_i2c_stats_published);
+    return CHECK_EXIT();
+}
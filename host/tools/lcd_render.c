@@ -0,0 +1,323 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Render the 20x4 LCD contents off the device, including custom glyphs, as text art that can be
+ * compared between builds.
+ *
+ * A long button press makes the display task log the visible characters and the CGRAM bitmaps:
+ *
+ *     I (123456) display: lcd row 0 5431204c6f6f702020202020200c2032352e3308
+ *     I (123456) display: lcd cgram 4 0000000001030f1f
+ *
+ * Render a captured console log (the last snapshot in it is used):
+ *
+ *     build/lcd_render console.log
+ *
+ * Show the glyphs that the display draws for a series of samples, oldest first, with 'nan' for a
+ * missing sample. This runs glyph_sparkline() and the glyph allocator from main/glyph.c:
+ *
+ *     build/lcd_render --sparkline 24.1,24.3,nan,24.8,25.0 --span 0.5
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "glyph.h"
+
+#define ROWS               4
+#define COLUMNS            20
+#define CGRAM_CHARACTERS   8
+#define CUSTOM_0           0x08      // character code that shows CGRAM 0, as i2c-lcd1602
+#define FIRST_RUN_TIME     4         // CGRAM slot of the first run-time glyph, as display.c
+#define MAX_SAMPLES        (COLUMNS * GLYPH_SPARK_SAMPLES_PER_CELL)
+#define MAX_LINE           512
+
+typedef struct
+{
+    uint8_t rows[ROWS][COLUMNS];
+    uint8_t cgram[CGRAM_CHARACTERS][GLYPH_HEIGHT];
+} lcd_t;
+
+// Codes 0x00-0x0f show CGRAM characters 0-7, twice over
+static int _custom_index(uint8_t code)
+{
+    return code < 0x10 ? code & 0x07 : -1;
+}
+
+static const char * _cell_text(uint8_t code, char buffer[8])
+{
+    int index = _custom_index(code);
+    if (index >= 0)
+    {
+        // subscript digit, U+2080 + index
+        buffer[0] = '\xe2';
+        buffer[1] = '\x82';
+        buffer[2] = 0x80 + index;
+        buffer[3] = '\0';
+        return buffer;
+    }
+    if (code >= 0x20 && code < 0x7f)
+    {
+        buffer[0] = code;
+        buffer[1] = '\0';
+        return buffer;
+    }
+
+    // HD44780 ROM characters used by the firmware that are not ASCII
+    switch (code)
+    {
+        case 0xa5: return "·";
+        case 0xdf: return "°";
+        case 0xff: return "█";
+        default:   return "?";
+    }
+}
+
+static void _border(void)
+{
+    printf("+");
+    for (int i = 0; i < COLUMNS; ++i)
+    {
+        printf("-");
+    }
+    printf("+\n");
+}
+
+// One pixel line of a cell: the bitmap of a custom glyph, or the character on the middle line
+static void _cell_pixels(const lcd_t * lcd, uint8_t code, int line, char out[GLYPH_WIDTH + 1])
+{
+    int index = _custom_index(code);
+    memset(out, ' ', GLYPH_WIDTH);
+    out[GLYPH_WIDTH] = '\0';
+    if (index >= 0)
+    {
+        for (int i = 0; i < GLYPH_WIDTH; ++i)
+        {
+            out[i] = lcd->cgram[index][line] & (1 << (GLYPH_WIDTH - 1 - i)) ? '#' : '.';
+        }
+    }
+    else if (line == GLYPH_HEIGHT / 2 && code >= 0x20 && code < 0x7f)
+    {
+        out[GLYPH_WIDTH / 2] = code;
+    }
+}
+
+// Text art of the display: the characters, then a pixel view of rows that contain glyphs
+static void _render(const lcd_t * lcd, int num_rows)
+{
+    char buffer[8];
+    _border();
+    for (int row = 0; row < num_rows; ++row)
+    {
+        printf("|");
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            printf("%s", _cell_text(lcd->rows[row][col], buffer));
+        }
+        printf("|\n");
+    }
+    _border();
+
+    for (int row = 0; row < num_rows; ++row)
+    {
+        bool glyphs = false;
+        for (int col = 0; col < COLUMNS; ++col)
+        {
+            glyphs |= _custom_index(lcd->rows[row][col]) >= 0;
+        }
+        if (!glyphs)
+        {
+            continue;
+        }
+
+        printf("row %d\n", row);
+        for (int line = 0; line < GLYPH_HEIGHT; ++line)
+        {
+            char text[COLUMNS * (GLYPH_WIDTH + 1) + 1] = "";
+            for (int col = 0; col < COLUMNS; ++col)
+            {
+                char pixels[GLYPH_WIDTH + 1];
+                _cell_pixels(lcd, lcd->rows[row][col], line, pixels);
+                strcat(text, col ? " " : "");
+                strcat(text, pixels);
+            }
+            size_t len = strlen(text);
+            while (len > 0 && text[len - 1] == ' ')
+            {
+                text[--len] = '\0';
+            }
+            printf("%s\n", text);
+        }
+    }
+}
+
+static size_t _parse_hex(const char * hex, uint8_t * out, size_t size)
+{
+    size_t len = 0;
+    unsigned int value = 0;
+    while (len < size && sscanf(hex + 2 * len, "%2x", &value) == 1)
+    {
+        out[len++] = value;
+    }
+    return len;
+}
+
+// Read the last snapshot in a console log
+static void _parse(FILE * file, lcd_t * lcd)
+{
+    memset(lcd, 0, sizeof(*lcd));
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), file))
+    {
+        char * match = strstr(line, "lcd ");
+        int index = 0;
+        char hex[MAX_LINE] = "";
+        if (match == NULL)
+        {
+            continue;
+        }
+        if (sscanf(match, "lcd row %d %511[0-9a-f]", &index, hex) >= 1 && index >= 0 && index < ROWS)
+        {
+            if (index == 0)
+            {
+                memset(lcd->cgram, 0, sizeof(lcd->cgram));
+            }
+            memset(lcd->rows[index], 0, COLUMNS);
+            _parse_hex(hex, lcd->rows[index], COLUMNS);
+        }
+        else if (sscanf(match, "lcd cgram %d %511[0-9a-f]", &index, hex) >= 1 && index >= 0 && index < CGRAM_CHARACTERS)
+        {
+            memset(lcd->cgram[index], 0, GLYPH_HEIGHT);
+            _parse_hex(hex, lcd->cgram[index], GLYPH_HEIGHT);
+        }
+    }
+}
+
+// Draw a sparkline in row 0 as the display would, with the slots it would allocate
+static int _sparkline(const char * list, float min_span, lcd_t * lcd)
+{
+    float samples[MAX_SAMPLES];
+    size_t num_samples = 0;
+    char * copy = strdup(list);
+    for (char * token = strtok(copy, ","); token != NULL; token = strtok(NULL, ","))
+    {
+        if (num_samples == MAX_SAMPLES)
+        {
+            fprintf(stderr, "at most %d samples\n", MAX_SAMPLES);
+            free(copy);
+            return 1;
+        }
+        samples[num_samples++] = strtof(token, NULL);
+    }
+    free(copy);
+    if (num_samples == 0 || num_samples % GLYPH_SPARK_SAMPLES_PER_CELL)
+    {
+        fprintf(stderr, "sparkline needs a multiple of %d samples\n", GLYPH_SPARK_SAMPLES_PER_CELL);
+        return 1;
+    }
+    if (!(min_span > 0.0f))
+    {
+        fprintf(stderr, "span must be positive\n");
+        return 1;
+    }
+
+    glyph_cache_t cache;
+    glyph_cache_init(&cache, CUSTOM_0 + FIRST_RUN_TIME);
+    char out[COLUMNS + 1];
+    glyph_sparkline(&cache, out, samples, num_samples / GLYPH_SPARK_SAMPLES_PER_CELL, min_span);
+
+    memset(lcd, 0, sizeof(*lcd));
+    memset(lcd->rows[0], ' ', COLUMNS);
+    memcpy(lcd->rows[0], out, strlen(out));
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        if (cache.slots[i].valid)
+        {
+            memcpy(lcd->cgram[FIRST_RUN_TIME + i], cache.slots[i].bitmap, GLYPH_HEIGHT);
+        }
+    }
+    return 0;
+}
+
+static void _usage(void)
+{
+    fprintf(stderr, "usage: lcd_render [LOG]\n"
+                    "       lcd_render --sparkline SAMPLES [--span SPAN]\n");
+}
+
+int main(int argc, char ** argv)
+{
+    const char * log = NULL;
+    const char * sparkline = NULL;
+    float span = 0.5f;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--sparkline") == 0 && i + 1 < argc)
+        {
+            sparkline = argv[++i];
+        }
+        else if (strcmp(argv[i], "--span") == 0 && i + 1 < argc)
+        {
+            span = strtof(argv[++i], NULL);
+        }
+        else if (argv[i][0] != '-' && log == NULL)
+        {
+            log = argv[i];
+        }
+        else
+        {
+            _usage();
+            return 2;
+        }
+    }
+
+    lcd_t lcd;
+    if (sparkline)
+    {
+        if (_sparkline(sparkline, span, &lcd) != 0)
+        {
+            return 2;
+        }
+        _render(&lcd, 1);
+        return 0;
+    }
+
+    FILE * file = log ? fopen(log, "r") : stdin;
+    if (file == NULL)
+    {
+        perror(log);
+        return 1;
+    }
+    _parse(file, &lcd);
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+    _render(&lcd, ROWS);
+    return 0;
+}
@@ -43,6 +43,7 @@
 #include "sensor_temp.h"
 #include "sensor_flow.h"
 #include "sensor_light.h"
+#include "sensor_scheduler.h"
 #include "publish.h"
 #include "nvs_support.h"
 #include "wifi_support.h"
@@ -51,15 +52,20 @@
 #include "avr_support.h"
 #include "display.h"
 #include "power.h"
+#include "trend.h"
 #include "control.h"
 #include "system_monitor.h"
 #include "sntp_rtc.h"
 #include "datastore/datastore.h"
 #include "ota.h"
+#include "timer_wheel.h"
+#include "coroutine_runner.h"
 
 #define TAG "app_main"
 
 #define MARK_PERIOD (60 * 10)  // emit something in the log every 10 minutes
+#define NETWORK_PERIOD (1000)  // milliseconds
+#define RESTART_STACK_SIZE (4096)
 
 #ifdef __GNUC__
 #  define SYMBOL_IS_NOT_USED __attribute__ ((unused))
@@ -114,6 +120,114 @@ static void SYMBOL_IS_NOT_USED avr_test_sequence(void)
     state = (state + 1) % 7;
 }
 
+typedef struct
+{
+    mqtt_info_t * mqtt_info;
+    datastore_t * datastore;
+    uint32_t last_mark_time;
+
+    // released by the restart task
+    i2c_master_info_t * i2c_master_info;
+    temp_sensors_t * temp_sensors;
+    publish_context_t * publish_context;
+} network_inputs_t;
+
+// These persist for the duration of the program, as app_main returns once everything is started
+static bool _running = true;
+static subscriptions_context_t _globals = { 0 };
+static network_inputs_t _network_inputs = { 0 };
+
+static void _restart_task(void * pvParameter)
+{
+    network_inputs_t * inputs = (network_inputs_t *)pvParameter;
+
+    datastore_set_string(inputs->datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Restarting");
+
+    // Delete all tasks before deallocating structures that they might be using.
+    ESP_LOGD(TAG, "Deleting tasks");
+
+    // "delete" all tasks
+    timer_wheel_delete();
+    system_monitor_delete();
+    coroutine_runner_delete();
+    sntp_rtc_delete();
+    power_delete();
+    trend_delete();
+    ota_delete();
+    publish_delete();
+    wifi_support_delete();
+    sensor_scheduler_delete();
+    avr_support_delete();
+    display_delete();
+
+    sensor_temp_close(inputs->temp_sensors);
+    i2c_master_close(inputs->i2c_master_info);
+    datastore_free(&inputs->datastore);
+    publish_free(&inputs->publish_context);
+
+    ESP_LOGW(TAG, "Restarting...");
+    vTaskDelay(1000 / portTICK_RATE_MS);
+    esp_restart();
+}
+
+// network connection state machine, run by the timer wheel
+static void _network_job(void * context)
+{
+    network_inputs_t * inputs = (network_inputs_t *)context;
+    const datastore_t * datastore = inputs->datastore;
+
+    if (!_running)
+    {
+        // the restart deletes the timer wheel, so it can't run in a job
+        static bool restarting = false;
+        if (!restarting)
+        {
+            restarting = true;
+            xTaskCreate(&_restart_task, "restart_task", RESTART_STACK_SIZE, inputs, uxTaskPriorityGet(NULL), NULL);
+        }
+        return;
+    }
+
+    //avr_test_sequence();
+
+    // period mark in log
+    uint32_t now = seconds_since_boot();
+    if (now >= inputs->last_mark_time + MARK_PERIOD)
+    {
+        ESP_LOGI(TAG, "-- mark --");
+        inputs->last_mark_time = now;
+    }
+
+    wifi_status_t wifi_status = WIFI_STATUS_DISCONNECTED;
+    mqtt_status_t mqtt_status = MQTT_STATUS_DISCONNECTED;
+    datastore_get_uint32(datastore, RESOURCE_ID_WIFI_STATUS, 0, &wifi_status);
+    datastore_get_uint32(datastore, RESOURCE_ID_MQTT_STATUS, 0, &mqtt_status);
+    ESP_LOGD(TAG, "wifi_status %d, mqtt_status %d", wifi_status, mqtt_status);
+
+    if (wifi_status == WIFI_STATUS_DISCONNECTED)
+    {
+        if (mqtt_status != MQTT_STATUS_DISCONNECTED)
+        {
+            ESP_LOGI(TAG, "MQTT stop");
+            esp_mqtt_stop();
+        }
+        ESP_LOGI(TAG, "WiFi connect");
+        esp_wifi_connect();
+    }
+    else if (wifi_status == WIFI_STATUS_GOT_ADDRESS)
+    {
+        if (mqtt_status == MQTT_STATUS_DISCONNECTED)
+        {
+            ESP_LOGI(TAG, "MQTT start");
+            mqtt_error_t mqtt_error = MQTT_ERROR_UNKNOWN;
+            if ((mqtt_error = mqtt_start(inputs->mqtt_info, datastore)) != MQTT_OK)
+            {
+                ESP_LOGE(TAG, "mqtt_start failed: %d", mqtt_error);
+            }
+        }
+    }
+}
+
 void app_main()
 {
     esp_log_level_set("*", ESP_LOG_WARN);
@@ -137,6 +251,7 @@ void app_main()
     esp_log_level_set("app_main", ESP_LOG_INFO);
     esp_log_level_set("subscriptions", ESP_LOG_INFO);
     esp_log_level_set("ota", ESP_LOG_INFO);
+    esp_log_level_set("timer_wheel", ESP_LOG_INFO);
 
     // Ensure RMT peripheral is reset properly, in case of prior crash
     periph_module_disable(PERIPH_RMT_MODULE);
@@ -146,11 +261,10 @@ void app_main()
     UBaseType_t publish_priority = CONFIG_ESP_MQTT_TASK_STACK_PRIORITY;
     UBaseType_t display_priority = publish_priority - 1;
     UBaseType_t sensor_priority = publish_priority - 1;
-    UBaseType_t avr_priority = sensor_priority;
-    UBaseType_t wifi_monitor_priority = sensor_priority;
+    UBaseType_t avr_priority = sensor_priority + 1;   // emergency PP path must pre-empt sensors and display
     UBaseType_t control_priority = sensor_priority;
-    UBaseType_t system_priority = publish_priority;
-    UBaseType_t ota_priority = publish_priority + 1;
+    UBaseType_t housekeeping_priority = sensor_priority;   // timer wheel: power, system, wifi, sntp, ota, network
+    UBaseType_t ota_priority = publish_priority + 1;       // transient upgrade task
 
     // round to nearest MHz (stored value is only precise to MHz)
     uint32_t apb_freq = (rtc_clk_apb_freq_get() + 500000) / 1000000 * 1000000;
@@ -163,16 +277,27 @@ void app_main()
     datastore_t * datastore = resources_init();
     resources_load(datastore);
 
+    // periodic housekeeping jobs share a single task
+    timer_wheel_init(housekeeping_priority);
+
+    // control loops share a single coroutine runner task
+    coroutine_runner_init(control_priority);
+
     // Onboard LED
     led_init(CONFIG_ONBOARD_LED_GPIO);
 
     // I2C bus
     _delay();
-    i2c_master_info_t * i2c_master_info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ);
+    i2c_master_info_t * i2c_master_info = i2c_master_init(I2C_MASTER_NUM, CONFIG_I2C_MASTER_SDA_GPIO, CONFIG_I2C_MASTER_SCL_GPIO, I2C_MASTER_FREQ_HZ, datastore);
 
     _delay();
-    int num_i2c_devices = i2c_master_scan(i2c_master_info);
-    ESP_LOGI(TAG, "%d I2C devices detected", num_i2c_devices);
+    const uint8_t known_i2c_devices[] = { CONFIG_AVR_I2C_ADDRESS, CONFIG_LCD1602_I2C_ADDRESS, CONFIG_LIGHT_SENSOR_I2C_ADDRESS };
+    int num_known_i2c_devices = sizeof(known_i2c_devices) / sizeof(known_i2c_devices[0]);
+    int num_i2c_devices = i2c_master_scan(i2c_master_info, known_i2c_devices, num_known_i2c_devices);
+    ESP_LOGI(TAG, "%d of %d known I2C devices detected", num_i2c_devices, num_known_i2c_devices);
+#ifdef CONFIG_I2C_MASTER_FULL_SCAN
+    i2c_master_scan_background(i2c_master_info, tskIDLE_PRIORITY + 1);
+#endif
 
     // bring up the display ASAP in case of error
     _delay();
@@ -180,9 +305,12 @@ void app_main()
 
     // It works best to find all connected devices before starting WiFi, otherwise it can be unreliable.
 
+    // all sensor drivers share a single acquisition task
+    sensor_scheduler_init(i2c_master_info, sensor_priority, datastore);
+
     // Temp sensors
     _delay();
-    temp_sensors_t * SYMBOL_IS_NOT_USED temp_sensors = sensor_temp_init(CONFIG_ONE_WIRE_GPIO, sensor_priority, datastore);
+    temp_sensors_t * SYMBOL_IS_NOT_USED temp_sensors = sensor_temp_init(CONFIG_ONE_WIRE_GPIO, datastore);
 
     // I2C devices - AVR, Light Sensor, LCD
     _delay();
@@ -196,15 +324,13 @@ void app_main()
     avr_support_set_alarm(AVR_ALARM_STATE_OFF);
 
     _delay();
-    sensor_light_init(i2c_master_info, sensor_priority, datastore);
+    sensor_light_init(i2c_master_info, datastore);
 
     // Flow Meter
     _delay();
     sensor_flow_init(CONFIG_FLOW_METER_PULSE_GPIO, FLOW_METER_PCNT_UNIT, FLOW_METER_PCNT_CHANNEL,
                      CONFIG_FLOW_METER_RMT_GPIO, FLOW_METER_RMT_CHANNEL, FLOW_METER_RMT_CLK_DIV,
-                     FLOW_METER_SAMPLING_PERIOD, FLOW_METER_SAMPLING_WINDOW, FLOW_METER_FILTER_LENGTH, sensor_priority, datastore);
-
-    bool running = true;
+                     FLOW_METER_SAMPLING_PERIOD, FLOW_METER_SAMPLING_WINDOW, FLOW_METER_FILTER_LENGTH, datastore);
 
     mqtt_info_t * mqtt_info = mqtt_malloc();
 
@@ -215,118 +341,56 @@ void app_main()
     }
 
     _delay();
-    wifi_support_init(wifi_monitor_priority, datastore);   // requires NVS to be initialised
+    wifi_support_init(datastore);   // requires NVS to be initialised
 
     _delay();
     publish_context_t * publish_context = publish_init(mqtt_info, PUBLISH_QUEUE_DEPTH, publish_priority, ROOT_TOPIC);
     publish_topics_init(datastore, publish_context);
 
     _delay();
-    power_init(sensor_priority, datastore);
+    power_init(datastore);
 
     _delay();
-    datastore_dump(datastore);
+    trend_init(datastore);
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    _delay();
+    datastore_dump(datastore);
 
-    // be careful of the scope on this - it needs to persist for the duration of the program:
-    subscriptions_context_t globals = {
+    _globals = (subscriptions_context_t){
         .mqtt_info = mqtt_info,
-        .running = &running,
+        .running = &_running,
         .datastore = datastore,
         .publish_context = publish_context,
     };
 
-    datastore_status_t status = datastore_add_set_callback(datastore, RESOURCE_ID_MQTT_STATUS, 0, subscriptions_init, &globals);
+    datastore_status_t status = datastore_add_set_callback(datastore, RESOURCE_ID_MQTT_STATUS, 0, subscriptions_init, &_globals);
     if (status != DATASTORE_STATUS_OK)
     {
         ESP_LOGE(TAG, "datastore_add_set_callback for resource %d failed: %d", RESOURCE_ID_MQTT_STATUS, status);
     }
 
-    sntp_rtc_init(wifi_monitor_priority, datastore);
+    sntp_rtc_init(datastore);
     _delay();
 
-    control_init(control_priority, datastore);
+    control_init(datastore);
     _delay();
 
-    system_monitor_init(system_priority, datastore, publish_context);
+    system_monitor_init(datastore, publish_context);
     _delay();
 
     ota_init(ota_priority, datastore);
     _delay();
 
-    uint32_t last_mark_time = 0;
-
-    while (running)
-    {
-        last_wake_time = xTaskGetTickCount();
-
-        //avr_test_sequence();
-
-        // period mark in log
-        uint32_t now = seconds_since_boot();
-        if (now >= last_mark_time + MARK_PERIOD)
-        {
-            ESP_LOGI(TAG, "-- mark --");
-            last_mark_time = now;
-        }
-
-        // network connection state machine
-        wifi_status_t wifi_status = WIFI_STATUS_DISCONNECTED;
-        mqtt_status_t mqtt_status = MQTT_STATUS_DISCONNECTED;
-        datastore_get_uint32(datastore, RESOURCE_ID_WIFI_STATUS, 0, &wifi_status);
-        datastore_get_uint32(datastore, RESOURCE_ID_MQTT_STATUS, 0, &mqtt_status);
-        ESP_LOGD(TAG, "wifi_status %d, mqtt_status %d", wifi_status, mqtt_status);
-
-        if (wifi_status == WIFI_STATUS_DISCONNECTED)
-        {
-            if (mqtt_status != MQTT_STATUS_DISCONNECTED)
-            {
-                ESP_LOGI(TAG, "MQTT stop");
-                esp_mqtt_stop();
-            }
-            ESP_LOGI(TAG, "WiFi connect");
-            esp_wifi_connect();
-        }
-        else if (wifi_status == WIFI_STATUS_GOT_ADDRESS)
-        {
-            if (mqtt_status == MQTT_STATUS_DISCONNECTED)
-            {
-                ESP_LOGI(TAG, "MQTT start");
-                if ((mqtt_error = mqtt_start(mqtt_info, datastore)) != MQTT_OK)
-                {
-                    ESP_LOGE(TAG, "mqtt_start failed: %d", mqtt_error);
-                }
-            }
-        }
-
-        vTaskDelayUntil(&last_wake_time, 1000 / portTICK_RATE_MS);
-    }
-
-    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Restarting");
-
-    // Delete all tasks before deallocating structures that they might be using.
-    ESP_LOGD(TAG, "Deleting tasks");
-
-    // "delete" all tasks
-    system_monitor_delete();
-    control_delete();
-    sntp_rtc_delete();
-    power_delete();
-    publish_delete();
-    wifi_support_delete();
-    sensor_flow_delete();
-    sensor_light_delete();
-    avr_support_delete();
-    sensor_temp_delete();
-    display_delete();
-
-    sensor_temp_close(temp_sensors);
-    i2c_master_close(i2c_master_info);
-    datastore_free(&datastore);
-    publish_free(&publish_context);
+    _network_inputs = (network_inputs_t){
+        .mqtt_info = mqtt_info,
+        .datastore = datastore,
+        .i2c_master_info = i2c_master_info,
+        .temp_sensors = temp_sensors,
+        .publish_context = publish_context,
+    };
+    timer_wheel_add("network", NETWORK_PERIOD, _network_job, &_network_inputs);
 
-    ESP_LOGW(TAG, "Restarting...");
-    vTaskDelay(1000 / portTICK_RATE_MS);
-    esp_restart();
+    // Everything from here on runs in the tasks and timer wheel jobs started above. Returning
+    // deletes the main task and frees its stack; a restart request is handled by _network_job.
+    ESP_LOGI(TAG, "startup complete");
 }
@@ -26,17 +26,17 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "esp_system.h"
 #include "driver/i2c.h"
+#include "driver/gpio.h"
 #include "esp_log.h"
 
 #include "avr_support.h"
 #include "constants.h"
 #include "utils.h"
 #include "i2c_master.h"
+#include "timer_wheel.h"
 #include "smbus.h"
-#include "publish.h"
 #include "resources.h"
 #include "../avr/avr-poolmon/registers.h"
 #include "datastore/datastore.h"
@@ -45,36 +45,77 @@
 
 #define SMBUS_TIMEOUT     1000   // milliseconds
 #define TICKS_PER_UPDATE  (250 / portTICK_RATE_MS)
+#define TICKS_PER_SAFETY_POLL  (5000 / portTICK_RATE_MS)   // when the attention line is in use
 #define EXPECTED_ID       0x44
 #define EXPECTED_VERSION  1
 #define SCRATCH_VALUE     0x55
+#define STATS_PERIOD      (60 * 1000)   // milliseconds, poll statistics to datastore
+#define BLOCK_READ_MAX_FAILURES  (3)    // consecutive failed block reads before the probe is re-run
+
+// The periodic poll covers the contiguous register range CONTROL..COUNT_PP_MAN.
+// Firmware that auto-increments its register pointer returns it in one I2C block read.
+#define POLL_FIRST_REGISTER  AVR_REGISTER_CONTROL
+#define POLL_LAST_REGISTER   AVR_REGISTER_COUNT_PP_MAN
+#define POLL_LENGTH          (POLL_LAST_REGISTER - POLL_FIRST_REGISTER + 1)
+#define POLL_OFFSET(reg)     ((reg) - POLL_FIRST_REGISTER)
+
+static const uint8_t POLLED_REGISTERS[] = {
+    AVR_REGISTER_CONTROL,
+    AVR_REGISTER_STATUS,
+    AVR_REGISTER_SCRATCH,
+    AVR_REGISTER_COUNT_CP,
+    AVR_REGISTER_COUNT_PP,
+    AVR_REGISTER_COUNT_BUZZER,
+    AVR_REGISTER_COUNT_CP_MODE,
+    AVR_REGISTER_COUNT_CP_MAN,
+    AVR_REGISTER_COUNT_PP_MODE,
+    AVR_REGISTER_COUNT_PP_MAN,
+};
+
+// Desired state of the CONTROL register, updated by callers under _desired_mux. The task
+// reconciles it against the value read back from the AVR, so requests are never dropped,
+// bursts collapse into a single write, and CONTROL is restored after an AVR reset.
+static uint8_t _desired_control = 0;
+static volatile bool _reset_requested = false;
+static portMUX_TYPE _desired_mux = portMUX_INITIALIZER_UNLOCKED;
 
-// use as bitwise OR combinations
-typedef enum
+typedef struct
 {
-    // AVR reset command
-    COMMAND_AVR_RESET    = 0b10000000,
+    i2c_master_info_t * i2c_master_info;
+    const datastore_t * datastore;
+} task_inputs_t;
 
-    // control commands
-    COMMAND_OFF          = 0b01000000,
-    COMMAND_ON           = 0b00100000,
+static TaskHandle_t _task_handle = NULL;
 
-    // select commands
-    COMMAND_SELECT_ALARM = 0b00000001,
-    COMMAND_SELECT_CP    = 0b00000010,
-    COMMAND_SELECT_PP    = 0b00000100,
+// Emergency purge pump latch. Set directly from the temperature sample path and cleared by the PP controller once the safe temperature is restored.
+// While latched, SSR2 is forced on in every write of the CONTROL register.
+static volatile bool _pp_emergency = false;
+static volatile uint64_t _pp_emergency_request_time = 0;  // microseconds since boot
 
-} command_t;
+// Set by the attention line interrupt when the AVR reports a STATUS or counter change,
+// cleared by the task just before it reads the registers.
+static volatile bool _attention = false;
 
-static QueueHandle_t command_queue;
+// Prebuilt command links for the transactions repeated every cycle. The links reference these
+// buffers, so a run needs no heap allocation: patch the CONTROL value before each write and
+// read the poll result after each block read.
+static uint8_t _poll_buffer[POLL_LENGTH] = { 0 };
+static uint8_t _control_buffer[2] = { AVR_REGISTER_CONTROL, 0 };
+static i2c_cmd_handle_t _poll_link = NULL;
+static i2c_cmd_handle_t _control_link = NULL;
 
+// Poll counts and bus hold time per poll, accumulated by the task and published by a timer wheel job
 typedef struct
 {
-    i2c_master_info_t * i2c_master_info;
-    const datastore_t * datastore;
-} task_inputs_t;
+    uint32_t polls;
+    uint32_t attentions;       // polls triggered by the attention line
+    uint64_t hold_total;       // microseconds
+    uint32_t hold_max;         // microseconds
+} poll_stats_t;
 
-static TaskHandle_t _task_handle = NULL;
+static poll_stats_t _poll_stats = { 0 };
+static portMUX_TYPE _poll_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static timer_wheel_job_t _stats_job = TIMER_WHEEL_INVALID_JOB;
 
 #define I2C_ERROR_CHECK(x) do {                                             \
         esp_err_t rc = (x);                                                 \
@@ -83,19 +124,221 @@ static TaskHandle_t _task_handle = NULL;
         }                                                                   \
     } while(0);
 
+// A register read (send-byte then receive-byte) is accounted as one transaction
 static uint8_t _read_register(const smbus_info_t * smbus_info, uint8_t address)
 {
     uint8_t value = 0;
-    I2C_ERROR_CHECK(smbus_send_byte(smbus_info, address));
-    I2C_ERROR_CHECK(smbus_receive_byte(smbus_info, &value));
+    uint64_t start = microseconds_since_boot();
+    esp_err_t err = smbus_send_byte(smbus_info, address);
+    I2C_ERROR_CHECK(err);
+    esp_err_t err2 = smbus_receive_byte(smbus_info, &value);
+    I2C_ERROR_CHECK(err2);
+    i2c_master_record(smbus_info, err != ESP_OK ? err : err2, start, 0);
     return value;
 }
 
+/*
+ * Read the polled register range into regs, indexed by POLL_OFFSET(). With block reads enabled
+ * this is a single I2C transaction (one START, address, register pointer, repeated START and
+ * POLL_LENGTH data bytes) instead of a send-byte/receive-byte pair per register. Returns false
+ * if the block read failed, in which case the caller should fall back to individual reads.
+ */
+static bool _read_poll_registers(const i2c_master_info_t * i2c_master_info, const smbus_info_t * smbus_info, bool block_read, uint8_t * regs)
+{
+    if (block_read)
+    {
+        uint64_t start = microseconds_since_boot();
+        esp_err_t err = i2c_master_run(i2c_master_info, _poll_link, SMBUS_TIMEOUT / portTICK_RATE_MS);
+        i2c_master_record(smbus_info, err, start, 0);
+        if (err == ESP_OK)
+        {
+            memcpy(regs, _poll_buffer, POLL_LENGTH);
+            return true;
+        }
+        ESP_LOGW(TAG, "I2C block read failed: %d", err);
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(POLLED_REGISTERS) / sizeof(POLLED_REGISTERS[0]); ++i)
+    {
+        regs[POLL_OFFSET(POLLED_REGISTERS[i])] = _read_register(smbus_info, POLLED_REGISTERS[i]);
+    }
+    return true;
+}
+
+/*
+ * Determine whether the firmware supports auto-incrementing block reads. SCRATCH has just been
+ * written with SCRATCH_VALUE, so a block read that starts at CONTROL and stops at SCRATCH must
+ * return it in the right position. Firmware that does not advance its register pointer repeats
+ * CONTROL instead. The counter registers are not touched, so no counts are lost.
+ */
+static bool _probe_block_read(const smbus_info_t * smbus_info)
+{
+    for (size_t i = 0; i < sizeof(POLLED_REGISTERS) / sizeof(POLLED_REGISTERS[0]); ++i)
+    {
+        if (POLLED_REGISTERS[i] < POLL_FIRST_REGISTER || POLLED_REGISTERS[i] > POLL_LAST_REGISTER)
+        {
+            ESP_LOGW(TAG, "Register 0x%02x outside poll range", POLLED_REGISTERS[i]);
+            return false;
+        }
+    }
+
+    uint8_t regs[POLL_OFFSET(AVR_REGISTER_SCRATCH) + 1] = { 0 };
+    esp_err_t err = smbus_i2c_read_block(smbus_info, POLL_FIRST_REGISTER, regs, sizeof(regs));
+    return err == ESP_OK && regs[POLL_OFFSET(AVR_REGISTER_SCRATCH)] == SCRATCH_VALUE;
+}
+
+static void _record_poll(bool attention, uint32_t hold_time)
+{
+    portENTER_CRITICAL(&_poll_stats_mux);
+    ++_poll_stats.polls;
+    _poll_stats.attentions += attention ? 1 : 0;
+    _poll_stats.hold_total += hold_time;
+    if (hold_time > _poll_stats.hold_max)
+        _poll_stats.hold_max = hold_time;
+    portEXIT_CRITICAL(&_poll_stats_mux);
+}
+
+static void _stats_job_func(void * context)
+{
+    const datastore_t * datastore = (const datastore_t *)context;
+
+    portENTER_CRITICAL(&_poll_stats_mux);
+    poll_stats_t stats = _poll_stats;
+    portEXIT_CRITICAL(&_poll_stats_mux);
+
+    if (stats.polls > 0)
+    {
+        datastore_set_uint32(datastore, RESOURCE_ID_AVR_COUNT_POLL, 0, stats.polls);
+        datastore_set_uint32(datastore, RESOURCE_ID_AVR_COUNT_ATTENTION, 0, stats.attentions);
+        datastore_set_uint32(datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_AVG, 0, stats.hold_total / stats.polls);
+        datastore_set_uint32(datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_MAX, 0, stats.hold_max);
+    }
+}
+
+#if defined(CONFIG_AVR_ATTENTION)
+static void IRAM_ATTR _attention_isr(void * arg)
+{
+    _attention = true;
+    BaseType_t woken = pdFALSE;
+    if (_task_handle)
+    {
+        vTaskNotifyGiveFromISR(_task_handle, &woken);
+    }
+    if (woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+#endif
+
+/*
+ * With CONFIG_AVR_ATTENTION, the AVR is expected to pull the attention line low whenever
+ * STATUS or any COUNT_* register changes, and release it once the registers have been read.
+ * The registers are read on each falling edge, plus a slow safety-net poll in case an edge is
+ * missed. Otherwise (the default, as the AVR firmware does not drive the line yet) the
+ * registers are polled every TICKS_PER_UPDATE.
+ */
+static TickType_t _attention_init(void)
+{
+#if defined(CONFIG_AVR_ATTENTION)
+    gpio_pad_select_gpio(CONFIG_AVR_ATTENTION_GPIO);
+    gpio_set_direction(CONFIG_AVR_ATTENTION_GPIO, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(CONFIG_AVR_ATTENTION_GPIO, GPIO_PULLUP_ONLY);
+    gpio_set_intr_type(CONFIG_AVR_ATTENTION_GPIO, GPIO_INTR_NEGEDGE);
+
+    // the service may already be installed by another driver
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE)
+    {
+        err = gpio_isr_handler_add(CONFIG_AVR_ATTENTION_GPIO, _attention_isr, NULL);
+    }
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Attention line on GPIO %d", CONFIG_AVR_ATTENTION_GPIO);
+        return TICKS_PER_SAFETY_POLL;
+    }
+    ESP_LOGE(TAG, "Attention line setup failed: %d", err);
+#endif
+    return TICKS_PER_UPDATE;
+}
+
 static void _write_register(const smbus_info_t * smbus_info, uint8_t address, uint8_t value)
 {
-    I2C_ERROR_CHECK(smbus_write_byte(smbus_info, address, value));
+    uint64_t start = microseconds_since_boot();
+    I2C_ERROR_CHECK(i2c_master_record(smbus_info, smbus_write_byte(smbus_info, address, value), start, 0));
+}
+
+static uint8_t _get_desired_control(void)
+{
+    portENTER_CRITICAL(&_desired_mux);
+    uint8_t control = _desired_control;
+    portEXIT_CRITICAL(&_desired_mux);
+    return _pp_emergency ? control | AVR_REGISTER_CONTROL_SSR2 : control;
 }
 
+static void _set_desired_control(uint8_t mask, bool on)
+{
+    portENTER_CRITICAL(&_desired_mux);
+    _desired_control = on ? _desired_control | mask : _desired_control & ~mask;
+    portEXIT_CRITICAL(&_desired_mux);
+
+    // the task may be sleeping until the next poll
+    if (_task_handle)
+    {
+        xTaskNotifyGive(_task_handle);
+    }
+}
+
+/*
+ * Write CONTROL if it differs from the desired state, with SSR2 forced on while the emergency
+ * latch is held. *actual tracks the register contents and is refreshed from every poll, so
+ * an AVR reset (which clears CONTROL) is corrected on the next cycle.
+ *
+ * Worst-case latency from an emergency request to the SSR2 write completing is bounded by the
+ * longest unbroken hold of the I2C lock by another client, plus a poll already in progress on
+ * this task, plus a single SMBus write. This task runs above the sensor and display tasks and is
+ * granted the bus first. The display yields between glyph loads and rows, so its longest chunk
+ * is one CGRAM glyph load: 54 single-byte PCF8574 writes, about 14 ms at 100 kHz. Sensor
+ * transactions are about 1.5 ms. Without bus errors, the bound does not depend on the control
+ * loop period or the poll period. Retries after bus errors can extend it. The measured latency
+ * is published as AVR_EMERGENCY_LATENCY.
+ */
+static void _reconcile_control(const smbus_info_t * smbus_info, i2c_master_info_t * i2c_master_info, uint8_t * actual,
+                               bool * emergency_applied, const datastore_t * datastore)
+{
+    bool emergency = _pp_emergency;
+    uint8_t desired = _get_desired_control();
+    if (desired != *actual)
+    {
+        ESP_LOGI(TAG, "CONTROL 0x%02x -> 0x%02x", *actual, desired);
+        i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+        _control_buffer[1] = desired;
+        uint64_t start = microseconds_since_boot();
+        esp_err_t err = i2c_master_run(i2c_master_info, _control_link, SMBUS_TIMEOUT / portTICK_RATE_MS);
+        I2C_ERROR_CHECK(i2c_master_record(smbus_info, err, start, 0));
+        i2c_master_unlock(i2c_master_info);
+        *actual = desired;
+        datastore_increment(datastore, RESOURCE_ID_AVR_COUNT_CONTROL_WRITE, 0);
+    }
+
+    if (emergency != *emergency_applied)
+    {
+        *emergency_applied = emergency;
+        if (emergency)
+        {
+            uint32_t latency = microseconds_since_boot() - _pp_emergency_request_time;
+            ESP_LOGW(TAG, "PP emergency on, latency %u us", latency);
+            datastore_set_uint32(datastore, RESOURCE_ID_AVR_EMERGENCY_LATENCY, 0, latency);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "PP emergency off");
+        }
+    }
+}
+
+
 static uint8_t _decode_switch_states(uint8_t status)
 {
     uint8_t new_states = 0;
@@ -175,12 +418,6 @@ static void _publish_pump_changes(uint8_t last_pump_states, uint8_t new_pump_sta
     }
 }
 
-static bool _test_command(command_t command, command_t flag)
-{
-    // handle multi-bit flags
-    return (command & flag) == flag;
-}
-
 static void avr_support_task(void * pvParameter)
 {
     assert(pvParameter);
@@ -191,7 +428,7 @@ static void avr_support_task(void * pvParameter)
     i2c_port_t i2c_port = i2c_master_info->port;
 
     // before accessing I2C, use a lock to gain exclusive use of the bus
-    i2c_master_lock(i2c_master_info, portMAX_DELAY);
+    i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
 
     // Set up the SMBus
     smbus_info_t * smbus_info = smbus_malloc();
@@ -232,122 +469,116 @@ static void avr_support_task(void * pvParameter)
     // write a known value to scratch register
     _write_register(smbus_info, AVR_REGISTER_SCRATCH, SCRATCH_VALUE);
 
+    bool block_read = _probe_block_read(smbus_info);
+    uint32_t block_read_failures = 0;
+    ESP_LOGI(TAG, "Register poll uses %s", block_read ? "block read" : "single-register reads");
+
+    // build the repeated transactions once
+    _control_link = i2c_master_build_write(CONFIG_AVR_I2C_ADDRESS, _control_buffer, sizeof(_control_buffer));
+    if (block_read)
+    {
+        _poll_link = i2c_master_build_read(CONFIG_AVR_I2C_ADDRESS, POLL_FIRST_REGISTER, _poll_buffer, POLL_LENGTH);
+    }
+
     i2c_master_unlock(i2c_master_info);
 
-    uint8_t control_reg = 0x0;
+    // CONTROL is cleared by reset and nothing has been written yet
+    uint8_t actual_control = 0x0;
+    bool emergency_applied = false;
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    TickType_t poll_period = _attention_init();
+    TickType_t last_poll_time = xTaskGetTickCount();
 
     while (1)
     {
-        last_wake_time = xTaskGetTickCount();
+        if (_reset_requested)
+        {
+            _reset_requested = false;
+            ESP_LOGI(TAG, "AVR reset");
+            i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+            gpio_set_level(CONFIG_AVR_RESET_GPIO, 0);
+            vTaskDelay(10);
+            gpio_set_level(CONFIG_AVR_RESET_GPIO, 1);
+
+            // give the I2C bus some time to stabilise after AVR reset
+            vTaskDelay(10);
+            i2c_master_unlock(i2c_master_info);
+            actual_control = 0x0;
+        }
+
+        _reconcile_control(smbus_info, i2c_master_info, &actual_control, &emergency_applied, task_inputs->datastore);
 
-        command_t command = 0;
-        while (xQueueReceive(command_queue, &command, 0) == pdTRUE)
+        // emergencies, output changes and the attention line all wake the task -
+        // read the registers only on attention or once per poll period
+        TickType_t elapsed = xTaskGetTickCount() - last_poll_time;
+        if (!_attention && elapsed < poll_period)
         {
-            char binary_digits[9] = "";
-            uint8_t command8 = command;
-            ESP_LOGD(TAG, "command 0x%02x, 0b%s", command, bits_to_string(binary_digits, 9, &command8, sizeof(command8)));
+            ulTaskNotifyTake(pdTRUE, poll_period - elapsed);
+            continue;
+        }
+        bool attention = _attention;
+        _attention = false;
+        last_poll_time = xTaskGetTickCount();
 
-            if (_test_command(command, COMMAND_ON))
-            {
-                if (_test_command(command, COMMAND_SELECT_CP))
-                {
-                    ESP_LOGI(TAG, "CP on");
-                    control_reg |= AVR_REGISTER_CONTROL_SSR1;
-                }
-                if (_test_command(command, COMMAND_SELECT_PP))
-                {
-                    ESP_LOGI(TAG, "PP on");
-                    control_reg |= AVR_REGISTER_CONTROL_SSR2;
-                }
-                if (_test_command(command, COMMAND_SELECT_ALARM))
-                {
-                    ESP_LOGI(TAG, "Alarm on");
-                    control_reg |= AVR_REGISTER_CONTROL_BUZZER;
-                }
-                i2c_master_lock(i2c_master_info, portMAX_DELAY);
-                _write_register(smbus_info, AVR_REGISTER_CONTROL, control_reg);
-                i2c_master_unlock(i2c_master_info);
-            }
-            else if (_test_command(command, COMMAND_OFF))
-            {
-                if (_test_command(command, COMMAND_SELECT_CP))
-                {
-                    ESP_LOGI(TAG, "CP off");
-                    control_reg &= ~AVR_REGISTER_CONTROL_SSR1;
-                }
-                if (_test_command(command, COMMAND_SELECT_PP))
-                {
-                    ESP_LOGI(TAG, "PP off");
-                    control_reg &= ~AVR_REGISTER_CONTROL_SSR2;
-                }
-                if (_test_command(command, COMMAND_SELECT_ALARM))
-                {
-                    ESP_LOGI(TAG, "Alarm off");
-                    control_reg &= ~AVR_REGISTER_CONTROL_BUZZER;
-                }
-                i2c_master_lock(i2c_master_info, portMAX_DELAY);
-                _write_register(smbus_info, AVR_REGISTER_CONTROL, control_reg);
-                i2c_master_unlock(i2c_master_info);            }
-
-            if (_test_command(command, COMMAND_AVR_RESET))
+        uint8_t regs[POLL_LENGTH] = { 0 };
+        i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_AVR, portMAX_DELAY);
+        uint64_t hold_start = microseconds_since_boot();
+
+        bool block_failed = false;
+        if (!_read_poll_registers(i2c_master_info, smbus_info, block_read, regs))
+        {
+            // don't trust a partial block - use single-register reads for this poll
+            block_failed = true;
+            _read_poll_registers(i2c_master_info, smbus_info, false, regs);
+        }
+
+        uint8_t scratch = regs[POLL_OFFSET(AVR_REGISTER_SCRATCH)];
+        bool reset = scratch != SCRATCH_VALUE;
+        if (reset)
+        {
+            _write_register(smbus_info, AVR_REGISTER_SCRATCH, SCRATCH_VALUE);
+        }
+
+        // A single failure is usually bus noise. After several in a row, check that the
+        // firmware still auto-increments (SCRATCH is valid again by now) before giving up.
+        block_read_failures = block_failed ? block_read_failures + 1 : 0;
+        if (block_read_failures >= BLOCK_READ_MAX_FAILURES)
+        {
+            block_read_failures = 0;
+            if (!_probe_block_read(smbus_info))
             {
-                ESP_LOGI(TAG, "AVR reset");
-                i2c_master_lock(i2c_master_info, portMAX_DELAY);
-                gpio_set_level(CONFIG_AVR_RESET_GPIO, 0);
-                vTaskDelay(10);
-                gpio_set_level(CONFIG_AVR_RESET_GPIO, 1);
-
-                // give the I2C bus some time to stabilise after AVR reset
-                vTaskDelay(10);
-                i2c_master_unlock(i2c_master_info);
+                ESP_LOGW(TAG, "Block read probe failed - register poll uses single-register reads");
+                block_read = false;
             }
         }
 
-        i2c_master_lock(i2c_master_info, portMAX_DELAY);
+        uint32_t hold_time = microseconds_since_boot() - hold_start;
+        i2c_master_unlock(i2c_master_info);
+        _record_poll(attention, hold_time);
 
-        // read control register
-        ESP_LOGD(TAG, "I2C %d, REG 0x00: 0x%02x", i2c_port, _read_register(smbus_info, AVR_REGISTER_CONTROL));
+        // reconciled against the desired state at the top of the loop
+        actual_control = regs[POLL_OFFSET(AVR_REGISTER_CONTROL)];
+        ESP_LOGD(TAG, "I2C %d, REG 0x00: 0x%02x", i2c_port, actual_control);
 
-        // read status register
-        status = _read_register(smbus_info, AVR_REGISTER_STATUS);
+        status = regs[POLL_OFFSET(AVR_REGISTER_STATUS)];
         ESP_LOGD(TAG, "I2C %d, REG 0x01: 0x%02x", i2c_port, status);
 
-        // read value from scratch register
-        // compare with expected value
-        uint8_t scratch = _read_register(smbus_info, AVR_REGISTER_SCRATCH);
-        if (scratch != SCRATCH_VALUE)
+        // compare scratch register with expected value
+        if (reset)
         {
             ESP_LOGW(TAG, "AVR reset detected");
             datastore_set_string(task_inputs->datastore, RESOURCE_ID_SYSTEM_LOG, 0, "AVR reset");
-            _write_register(smbus_info, AVR_REGISTER_SCRATCH, SCRATCH_VALUE);
             datastore_increment(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_RESET, 0);
         }
 
-        // read and increment counters
-        uint8_t count_cp = _read_register(smbus_info, AVR_REGISTER_COUNT_CP);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP, 0, count_cp);
-
-        uint8_t count_pp = _read_register(smbus_info, AVR_REGISTER_COUNT_PP);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP, 0, count_pp);
-
-        uint8_t count_buzzer = _read_register(smbus_info, AVR_REGISTER_COUNT_BUZZER);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_BUZZER, 0, count_buzzer);
-
-        uint8_t count_sw1 = _read_register(smbus_info, AVR_REGISTER_COUNT_CP_MODE);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP_MODE, 0, count_sw1);
-
-        uint8_t count_sw2 = _read_register(smbus_info, AVR_REGISTER_COUNT_CP_MAN);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP_MAN, 0, count_sw2);
-
-        uint8_t count_sw3 = _read_register(smbus_info, AVR_REGISTER_COUNT_PP_MODE);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP_MODE, 0, count_sw3);
-
-        uint8_t count_sw4 = _read_register(smbus_info, AVR_REGISTER_COUNT_PP_MAN);
-        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP_MAN, 0, count_sw4);
-
-        i2c_master_unlock(i2c_master_info);
+        // increment counters
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_CP)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_PP)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_BUZZER, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_BUZZER)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP_MODE, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_CP_MODE)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_CP_MAN, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_CP_MAN)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP_MODE, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_PP_MODE)]);
+        datastore_add(task_inputs->datastore, RESOURCE_ID_AVR_COUNT_PP_MAN, 0, regs[POLL_OFFSET(AVR_REGISTER_COUNT_PP_MAN)]);
 
         // if any switches have changed state, publish them
         uint8_t new_switch_states = _decode_switch_states(status);
@@ -358,8 +589,6 @@ static void avr_support_task(void * pvParameter)
         uint8_t new_pump_states = _decode_pump_states(status);
         _publish_pump_changes(pump_states, new_pump_states, task_inputs->datastore);
         pump_states = new_pump_states;
-
-        vTaskDelayUntil(&last_wake_time, TICKS_PER_UPDATE);
     }
 
   stop: ;
@@ -373,8 +602,6 @@ void avr_support_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority,
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
 
-    command_queue = xQueueCreate(10, sizeof(command_t));
-
     // task will take ownership of this struct
     task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
     if (task_inputs)
@@ -385,6 +612,8 @@ void avr_support_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority,
         xTaskCreate(&avr_support_task, "avr_support_task", 4096, task_inputs, priority, &_task_handle);
     }
 
+    _stats_job = timer_wheel_add("avr", STATS_PERIOD, _stats_job_func, (void *)datastore);
+
     // set up the AVR reset line
     // and make sure it is not held in reset
     gpio_pad_select_gpio(CONFIG_AVR_RESET_GPIO);
@@ -394,6 +623,8 @@ void avr_support_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority,
 
 void avr_support_delete(void)
 {
+    timer_wheel_remove(_stats_job);
+    _stats_job = TIMER_WHEEL_INVALID_JOB;
     if (_task_handle)
         vTaskDelete(_task_handle);
 }
@@ -402,39 +633,45 @@ void avr_support_reset(void)
 {
     ESP_LOGD(TAG, "request AVR reset");
 
-    command_t cmd = COMMAND_OFF | COMMAND_SELECT_CP | COMMAND_SELECT_PP | COMMAND_SELECT_ALARM | COMMAND_AVR_RESET;
-    if (xQueueSendToBack(command_queue, &cmd, 0) != pdTRUE)
-    {
-        ESP_LOGE(TAG, "xQueueSendToBack failed");
-    }
+    _reset_requested = true;
+    _set_desired_control(AVR_REGISTER_CONTROL_SSR1 | AVR_REGISTER_CONTROL_SSR2 | AVR_REGISTER_CONTROL_BUZZER, false);
 }
 
 void avr_support_set_cp_pump(avr_pump_state_t state)
 {
     ESP_LOGD(TAG, "request set CP pump %s", state == AVR_PUMP_STATE_ON ? "on" : "off");
-    command_t cmd = (state == AVR_PUMP_STATE_ON ? COMMAND_ON : COMMAND_OFF) | COMMAND_SELECT_CP;
-    if (xQueueSendToBack(command_queue, &cmd, 0) != pdTRUE)
-    {
-        ESP_LOGE(TAG, "xQueueSendToBack failed");
-    }
+    _set_desired_control(AVR_REGISTER_CONTROL_SSR1, state == AVR_PUMP_STATE_ON);
 }
 
 void avr_support_set_pp_pump(avr_pump_state_t state)
 {
     ESP_LOGD(TAG, "request set PP pump %s", state == AVR_PUMP_STATE_ON ? "on" : "off");
-    command_t cmd = (state == AVR_PUMP_STATE_ON ? COMMAND_ON : COMMAND_OFF) | COMMAND_SELECT_PP;
-    if (xQueueSendToBack(command_queue, &cmd, 0) != pdTRUE)
+    _set_desired_control(AVR_REGISTER_CONTROL_SSR2, state == AVR_PUMP_STATE_ON);
+}
+
+void avr_support_set_pp_emergency(bool emergency)
+{
+    if (emergency != _pp_emergency)
     {
-        ESP_LOGE(TAG, "xQueueSendToBack failed");
+        if (emergency)
+        {
+            _pp_emergency_request_time = microseconds_since_boot();
+        }
+        _pp_emergency = emergency;
+        if (_task_handle)
+        {
+            xTaskNotifyGive(_task_handle);
+        }
     }
 }
 
+bool avr_support_get_pp_emergency(void)
+{
+    return _pp_emergency;
+}
+
 void avr_support_set_alarm(avr_alarm_state_t state)
 {
     ESP_LOGD(TAG, "request set alarm %s", state == AVR_ALARM_STATE_ON ? "on" : "off");
-    command_t cmd = (state == AVR_ALARM_STATE_ON ? COMMAND_ON : COMMAND_OFF) | COMMAND_SELECT_ALARM;
-    if (xQueueSendToBack(command_queue, &cmd, 0) != pdTRUE)
-    {
-        ESP_LOGE(TAG, "xQueueSendToBack failed");
-    }
+    _set_desired_control(AVR_REGISTER_CONTROL_BUZZER, state == AVR_ALARM_STATE_ON);
 }
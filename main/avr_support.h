@@ -63,9 +63,16 @@ void avr_support_delete(void);
 // reset the AVR
 void avr_support_reset(void);
 
+// Update the desired output state. The AVR task writes CONTROL only when it differs from
+// the value read back from the AVR, and restores it after an AVR reset.
 void avr_support_set_cp_pump(avr_pump_state_t state);
 void avr_support_set_pp_pump(avr_pump_state_t state);
 void avr_support_set_alarm(avr_alarm_state_t state);
 
+// Force the purge pump on (or release it) regardless of the desired PP state.
+// Safe to call from any task; the AVR task is woken immediately to apply the change.
+void avr_support_set_pp_emergency(bool emergency);
+bool avr_support_get_pp_emergency(void);
+
 
 #endif // AVR_SUPPORT_H
@@ -66,5 +66,6 @@
 // TODO: configurable sampling periods
 
 #define POWER_CALCULATION_PERIOD    (10.0)   // seconds
+#define TREND_SAMPLING_PERIOD       (60.0)   // seconds
 
 #endif // CONSTANTS
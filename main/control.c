@@ -36,470 +36,500 @@
 #include "utils.h"
 #include "datastore/datastore.h"
 #include "sensor_temp.h"
+#include "schedule.h"
+#include "control_trace.h"
+#include "coroutine_runner.h"
 
 #define POLL_PERIOD                  (1000)            // control loop period in milliseconds
 #define FLOW_RATE_MEASUREMENT_EXPIRY (15 * 1000000)    // microseconds
-#define PP_HOLD_OFF                  (30 * 1000000)    // to check for flow when CP is on, wait at least this many seconds before deciding to start PP if flow rate is below threshold
 
 #define TAG "control"
 
 typedef struct
 {
-    const datastore_t * datastore;
-} task_inputs_t;
+    const char * message;      // console log message
+    const char * system_log;   // system log entry, or NULL for none
+} reason_info_t;
+
+static const reason_info_t REASON_INFO[CONTROL_REASON_LAST] = {
+    [CONTROL_REASON_CP_DELTA_ON]      = { "circulation pump ON",                               "Circulation pump on" },
+    [CONTROL_REASON_CP_DELTA_OFF]     = { "circulation pump OFF",                              "Circulation pump off" },
+    [CONTROL_REASON_CP_REFRESH]       = { "refresh CP state (AVR reset)",                      NULL },
+    [CONTROL_REASON_CP_PREDICTED]     = { "circulation pump ON (predicted)",                   "Circulation pump on (predicted)" },
+    [CONTROL_REASON_PP_SAFE_RESTORED] = { "safe temperature restored - purge pump OFF",        "Safe temperature restored - purge pump off" },
+    [CONTROL_REASON_PP_EMERGENCY]     = { "EMERGENCY - SAFE THRESHOLD EXCEEDED - purge pump ON", "Safe threshold exceeded - purge pump on" },
+    [CONTROL_REASON_PP_TIME_OF_DAY]   = { "purge pump ON: time of day",                        "Purge pump on (time of day)" },
+    [CONTROL_REASON_PP_LOW_FLOW]      = { "purge pump ON: low flow",                           "Purge pump on (low flow)" },
+    [CONTROL_REASON_PP_CYCLE_PAUSE]   = { "purge pump PAUSE",                                  NULL },
+    [CONTROL_REASON_PP_CYCLE_ON]      = { "purge pump ON",                                     NULL },
+    [CONTROL_REASON_PP_CYCLE_DONE]    = { "purge pump OFF",                                    "Purge pump off" },
+    [CONTROL_REASON_PP_MANUAL]        = { "purge pump OFF (manual)",                           "Purge pump off (manual)" },
+};
+
+typedef struct
+{
+    const char * name;                          // name used in log messages
+    datastore_instance_id_t sensor_high;        // TEMP_VALUE instance of the collector (high) sensor
+    datastore_instance_id_t sensor_low;         // TEMP_VALUE instance of the pool (low) sensor
+    void (*set_pump)(avr_pump_state_t state);   // circulation pump output
+} control_cp_config_t;
 
-static TaskHandle_t _cp_task_handle = NULL;
-static TaskHandle_t _pp_task_handle = NULL;
+// One entry per collector circuit - the AVR currently provides a single CP output
+static const control_cp_config_t CP_CONFIG[CONTROL_CP_INSTANCES] = {
+    { "CP", CONTROL_CP_SENSOR_HIGH_INSTANCE, CONTROL_CP_SENSOR_LOW_INSTANCE, avr_support_set_cp_pump },
+};
 
 
-void _avr_reset_handler(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * ctxt)
+static void _set_flag_handler(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * ctxt)
 {
     bool * flag = (bool *)ctxt;
     assert(flag != NULL);
     *flag = true;
 }
 
-static void control_cp_task(void * pvParameter)
+static bool _overheated(const datastore_t * datastore)
 {
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
-
-    TickType_t last_wake_time = xTaskGetTickCount();
-
-    control_cp_state_t state = CONTROL_CP_STATE_OFF;
-    avr_support_set_cp_pump(AVR_PUMP_STATE_OFF);
-
-    datastore_age_t t_high_age = DATASTORE_INVALID_AGE;
-    datastore_age_t t_low_age = DATASTORE_INVALID_AGE;
+    float t_high = 0.0f;
+    float safe_temp_high = 0.0f;
+    datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH, 0, &safe_temp_high);
+    return t_high >= safe_temp_high;
+}
 
-    // scale measurement expiry threshold by current temp poll period
-    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
+// Only a current array temperature below the safe temperature releases the emergency latch. An
+// expired sample leaves it held: without a temperature the purge pump fails safe, running.
+static bool _safe_restored(const datastore_t * datastore)
+{
+    datastore_age_t age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &age);
+    float t_high = 0.0f;
+    float safe_temp_low = 0.0f;
+    datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_LOW, 0, &safe_temp_low);
+    return age < sensor_temp_expiry(datastore) && t_high < safe_temp_low;
+}
 
-    // wait for stable sensor readings
-    bool stable = false;
-    while (!stable)
+// Called in the sensor task as each array temperature sample is stored. Latches the purge
+// pump on directly in the AVR task rather than waiting for the next PP control loop iteration.
+static void _overheat_handler(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * ctxt)
+{
+    if (!avr_support_get_pp_emergency() && _overheated(datastore))
     {
-        last_wake_time = xTaskGetTickCount();
-        ESP_LOGD(TAG, "CP control loop: wait for stable sensors");
-
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high_age);
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, &t_low_age);
+        avr_support_set_pp_emergency(true);
+    }
+}
 
-        if ((t_high_age < temp_expiry) && (t_low_age < temp_expiry))
-        {
-            stable = true;
-            ESP_LOGI(TAG, "CP control loop: sensors stable");
-        }
+static void _log_event(const datastore_t * datastore, const char * loop, const control_event_t * event)
+{
+    const reason_info_t * info = &REASON_INFO[event->reason];
+    if (event->reason == CONTROL_REASON_PP_EMERGENCY)
+    {
+        ESP_LOGE(TAG, "%s control loop: %s", loop, info->message);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "%s control loop: %s (%" PRIu32 ")", loop, info->message, event->cycle);
+    }
 
-        vTaskDelayUntil(&last_wake_time, POLL_PERIOD / portTICK_PERIOD_MS);
+    if (info->system_log)
+    {
+        datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, info->system_log);
     }
+}
 
-    // In the case of an AVR reset, refresh the pump states
-    bool refresh_cp = false;
-    datastore_add_set_callback(datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, _avr_reset_handler, &refresh_cp);
+static void _apply_cp_outputs(const datastore_t * datastore, const control_cp_config_t * config, datastore_instance_id_t instance, const control_outputs_t * outputs)
+{
+    for (uint8_t i = 0; i < outputs->num_events; ++i)
+    {
+        const control_event_t * event = &outputs->events[i];
+        _log_event(datastore, config->name, event);
+        config->set_pump(event->pump_on ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
+        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_CP, instance, event->state);
+    }
+}
 
-    while (1)
+static void _apply_pp_outputs(const datastore_t * datastore, const control_outputs_t * outputs)
+{
+    for (uint8_t i = 0; i < outputs->num_events; ++i)
     {
-        last_wake_time = xTaskGetTickCount();
-        ESP_LOGD(TAG, "--");
-        ESP_LOGD(TAG, "CP control loop: state %d", state);
+        const control_event_t * event = &outputs->events[i];
+        _log_event(datastore, "PP", event);
+        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, event->state);
+        avr_support_set_pp_pump(event->pump_on ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
+    }
+}
 
-        float t_high = 0.0f;
-        float t_low = 0.0f;
-        bool transition = false;
+static bool _cp_sensors_stable(const datastore_t * datastore, const control_cp_config_t * config, datastore_age_t temp_expiry, bool warn)
+{
+    datastore_age_t t_high_age = DATASTORE_INVALID_AGE;
+    datastore_age_t t_low_age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_high, &t_high_age);
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_low, &t_low_age);
 
-        t_high_age = DATASTORE_INVALID_AGE;
-        t_low_age = DATASTORE_INVALID_AGE;
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high_age);
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, &t_low_age);
+    if (t_high_age >= temp_expiry)
+    {
+        if (warn)
+            ESP_LOGW(TAG, "%s control loop: T HIGH measurement timeout", config->name);
+        return false;
+    }
+    if (t_low_age >= temp_expiry)
+    {
+        if (warn)
+            ESP_LOGW(TAG, "%s control loop: T LOW measurement timeout", config->name);
+        return false;
+    }
+    return true;
+}
 
-        // update measurement expiry in case temp poll period has changed
-        temp_expiry = sensor_temp_expiry(datastore);
+static void _cp_gather_inputs(const datastore_t * datastore, const control_cp_config_t * config, datastore_instance_id_t instance, datastore_age_t temp_expiry, control_cp_inputs_t * inputs)
+{
+    memset(inputs, 0, sizeof(*inputs));
+    if (_cp_sensors_stable(datastore, config, temp_expiry, true))
+    {
+        inputs->temps_valid = true;
+        datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_high, &inputs->t_high);
+        datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_low, &inputs->t_low);
+        datastore_get_float(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, instance, &inputs->on_delta);
+        datastore_get_float(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, instance, &inputs->off_delta);
+        datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, instance, &inputs->predict_horizon);
+        ESP_LOGD(TAG, "%s control loop: T HIGH %.2f, T LOW %.2f, delta on %f, delta off %f", config->name, inputs->t_high, inputs->t_low, inputs->on_delta, inputs->off_delta);
+    }
+}
 
-        if (t_high_age < temp_expiry)
-        {
-            if (t_low_age < temp_expiry)
-            {
-                datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
-                datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_LOW_INSTANCE, &t_low);
-                ESP_LOGD(TAG, "CP control loop: T HIGH %.2f, T LOW %.2f", t_high, t_low);
-
-                // transitions
-                if (state == CONTROL_CP_STATE_OFF)
-                {
-                    float delta = 0.0f;
-                    datastore_get_float(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, 0, &delta);
-                    ESP_LOGD(TAG, "CP control loop: delta on %f", delta);
-                    if (t_high - t_low >= delta)
-                    {
-                        ESP_LOGI(TAG, "CP control loop: circulation pump ON");
-                        datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Circulation pump on");
-                        state = CONTROL_CP_STATE_ON;
-                        transition = true;
-                    }
-                }
-                else
-                {
-                    float delta = 0.0f;
-                    datastore_get_float(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, 0, &delta);
-                    ESP_LOGD(TAG, "CP control loop: delta off %f", delta);
-                    if (t_high - t_low <= delta)
-                    {
-                        ESP_LOGI(TAG, "CP control loop: circulation pump OFF");
-                        datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Circulation pump off");
-                        state = CONTROL_CP_STATE_OFF;
-                        transition = true;
-                    }
-                }
-            }
-            else
-            {
-                ESP_LOGW(TAG, "CP control loop: T LOW measurement timeout");
-            }
-        }
-        else
-        {
-            ESP_LOGW(TAG, "CP control loop: T HIGH measurement timeout");
-        }
+typedef struct
+{
+    const datastore_t * datastore;
+    control_cp_t cp[CONTROL_CP_INSTANCES];
+    bool refresh;           // set when the AVR is reset, to refresh the pump states
+    uint32_t last_wake;     // milliseconds
+} cp_loop_t;
 
-        if (refresh_cp)
-        {
-            ESP_LOGW(TAG, "Refresh CP state (AVR reset)");
-            transition = true;
-            refresh_cp = false;
-        }
+static cp_loop_t _cp_loop = { 0 };
 
-        // output
-        if (transition)
-        {
-            avr_support_set_cp_pump(state == CONTROL_CP_STATE_ON ? AVR_PUMP_STATE_ON : AVR_PUMP_STATE_OFF);
-            datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_CP, 0, state);
-        }
+static bool _cp_all_stable(const datastore_t * datastore)
+{
+    // scale measurement expiry threshold by current temp poll period
+    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
 
-        vTaskDelayUntil(&last_wake_time, POLL_PERIOD / portTICK_PERIOD_MS);
+    bool stable = true;
+    for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+    {
+        stable = stable && _cp_sensors_stable(datastore, &CP_CONFIG[i], temp_expiry, false);
     }
-
-    free(task_inputs);
-    _cp_task_handle = NULL;
-    vTaskDelete(NULL);
+    return stable;
 }
 
-// TODO: refactor into a Time module
-static void _get_local_time(time_t * now_time, struct tm * timeinfo)
+static void _cp_iterate(cp_loop_t * loop)
 {
-    assert(now_time != NULL);
-    assert(timeinfo != NULL);
-    time(now_time);
-    localtime_r(now_time, timeinfo);
-}
+    const datastore_t * datastore = loop->datastore;
+    ESP_LOGD(TAG, "--");
 
-static void control_pp_task(void * pvParameter)
-{
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
+    // update measurement expiry in case temp poll period has changed
+    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
+    uint32_t now = seconds_since_boot();
+    bool refresh = loop->refresh;
+    loop->refresh = false;
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+    {
+        const control_cp_config_t * config = &CP_CONFIG[i];
+        control_cp_t * cp = &loop->cp[i];
+        ESP_LOGD(TAG, "%s control loop: state %d", config->name, cp->fsm.state);
 
-    avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
+        control_cp_inputs_t inputs;
+        _cp_gather_inputs(datastore, config, i, temp_expiry, &inputs);
+        inputs.refresh = refresh;
 
-    // wait for stable sensor readings
-    datastore_age_t age = DATASTORE_INVALID_AGE;
-    bool stable = false;
-    while (!stable)
-    {
-        last_wake_time = xTaskGetTickCount();
-        ESP_LOGD(TAG, "PP control loop: wait for stable sensors");
+        control_cp_state_t prev_state = cp->fsm.state;
+        control_outputs_t outputs;
+        control_cp_step(cp, &inputs, now, &outputs);
+        _apply_cp_outputs(datastore, config, i, &outputs);
 
-        datastore_get_age(datastore, RESOURCE_ID_FLOW_RATE, 0, &age);
+        datastore_age_t t_high_age = DATASTORE_INVALID_AGE;
+        datastore_age_t t_low_age = DATASTORE_INVALID_AGE;
+        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_high, &t_high_age);
+        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, config->sensor_low, &t_low_age);
+        control_trace_record_t record = {
+            .flags = (inputs.temps_valid ? CONTROL_TRACE_FLAG_TEMPS_VALID : 0)
+                     | (cp->fsm.state == CONTROL_CP_STATE_ON ? CONTROL_TRACE_FLAG_PUMP_ON : 0),
+            .t_high = control_trace_fixed(inputs.t_high),
+            .t_low = control_trace_fixed(inputs.t_low),
+            .t_high_age = control_trace_age(t_high_age),
+            .t_low_age = control_trace_age(t_low_age),
+            .flow_age = CONTROL_TRACE_NO_AGE,
+        };
+        control_trace_add(i, prev_state, cp->fsm.state, &outputs, &record);
+    }
+}
 
-        if (age < FLOW_RATE_MEASUREMENT_EXPIRY)
-        {
-            stable = true;
-            ESP_LOGI(TAG, "PP control loop: sensors stable");
-        }
+static coroutine_status_t _control_cp_loop(coroutine_t * co, void * context, uint32_t now)
+{
+    cp_loop_t * loop = (cp_loop_t *)context;
+    const datastore_t * datastore = loop->datastore;
+
+    CO_BEGIN(co);
 
-        vTaskDelayUntil(&last_wake_time, POLL_PERIOD / portTICK_PERIOD_MS);
+    for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+    {
+        control_cp_logic_init(&loop->cp[i]);
+        CP_CONFIG[i].set_pump(AVR_PUMP_STATE_OFF);
     }
 
-    control_pp_state_t state = CONTROL_PP_STATE_OFF;
-    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-    uint32_t cycle_start_time = 0;
-    uint32_t n = 0;
-    struct tm last_timeinfo = { 0 };
+    // wait for stable sensor readings on all circuits
+    while (!_cp_all_stable(datastore))
+    {
+        ESP_LOGD(TAG, "CP control loop: wait for stable sensors");
+        CO_DELAY(co, now, POLL_PERIOD);
+    }
+    ESP_LOGI(TAG, "CP control loop: sensors stable");
 
-    // scale measurement expiry threshold by current temp poll period
-    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
+    // In the case of an AVR reset, refresh the pump states
+    datastore_add_set_callback(datastore, RESOURCE_ID_AVR_COUNT_RESET, 0, _set_flag_handler, &loop->refresh);
 
     while (1)
     {
-        last_wake_time = xTaskGetTickCount();
-        uint32_t now = seconds_since_boot();
+        loop->last_wake = now;
+        _cp_iterate(loop);
+        CO_WAIT_UNTIL_TIME(co, now, loop->last_wake + POLL_PERIOD);
+    }
 
-        ESP_LOGD(TAG, "PP control loop: state %d, n %d", state, n);
+    CO_END(co);
+}
 
-        bool daily_enable = false;
-        datastore_get_bool(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, &daily_enable);
-        bool daily_trigger = false;
+static void _load_schedule(const datastore_t * datastore, schedule_t * schedule)
+{
+    bool daily_enable = false;
+    datastore_get_bool(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, &daily_enable);
 
-        if (daily_enable)
+    schedule_entry_t entries[CONTROL_PP_DAILY_INSTANCES] = { 0 };
+    size_t num_entries = 0;
+    if (daily_enable)
+    {
+        for (size_t i = 0; i < CONTROL_PP_DAILY_INSTANCES; ++i)
         {
-            // run cycle daily at configured time
-            bool system_time_set = false;
-            datastore_get_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, &system_time_set);
-            if (system_time_set)
-            {
-                int32_t daily_hour = -1;
-                int32_t daily_minute = -1;
-                datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, 0, &daily_hour);
-                datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0, &daily_minute);
-
-                if (daily_hour >= 0 && daily_minute >= 0)
-                {
-                    time_t now;
-                    struct tm timeinfo;
-                    _get_local_time(&now, &timeinfo);
-                    ESP_LOGD(TAG, "PP control loop: timeinfo.tm_hour %d, last_timeinfo.tm_hour %d", timeinfo.tm_hour, last_timeinfo.tm_hour);
-                    ESP_LOGD(TAG, "PP control loop: timeinfo.tm_min %d, last_timeinfo.tm_min %d", timeinfo.tm_min, last_timeinfo.tm_min);
-                    if ((timeinfo.tm_min != last_timeinfo.tm_min)
-                        && (timeinfo.tm_hour == daily_hour && timeinfo.tm_min == daily_minute))
-                    {
-                        daily_trigger = true;
-                        char strftime_buf[64];
-                        strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-                        ESP_LOGI(TAG, "PP control loop: triggered Purge Pump at %s", strftime_buf);
-                    }
-                    else
-                    {
-                        int now_minutes = timeinfo.tm_hour * 60 + timeinfo.tm_min;
-                        int set_minutes = daily_hour * 60 + daily_minute;
-                        int rem_minutes = now_minutes <= set_minutes ? set_minutes - now_minutes : 24 * 60 - now_minutes + set_minutes;
-                        int hours_remaining = rem_minutes / 60;  // floor
-                        int minutes_remaining = rem_minutes - (hours_remaining * 60);
-                        ESP_LOGD(TAG, "PP control loop: %dh%02dm until daily purge (now %d, set %d, rem %d)", hours_remaining, minutes_remaining, now_minutes, set_minutes, rem_minutes);
-                    }
-                    last_timeinfo = timeinfo;
-                }
-                else
-                {
-                    ESP_LOGD(TAG, "PP control loop: daily PP timer disabled");
-                }
-            }
-            else
-            {
-                ESP_LOGD(TAG, "PP control loop: waiting for system time to be set");
-            }
+            entries[i].hour = -1;
+            entries[i].minute = -1;
+            entries[i].days = SCHEDULE_ALL_DAYS;
+            datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, i, &entries[i].hour);
+            datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, i, &entries[i].minute);
+            datastore_get_uint8(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, i, &entries[i].days);
+            ESP_LOGD(TAG, "PP control loop: schedule %d: %02d:%02d days 0x%02x", (int)i, entries[i].hour, entries[i].minute, entries[i].days);
         }
+        num_entries = CONTROL_PP_DAILY_INSTANCES;
+    }
+    else
+    {
+        ESP_LOGD(TAG, "PP control loop: daily PP timer disabled");
+    }
+    schedule_set_entries(schedule, entries, num_entries);
+}
 
-        // update measurement expiry in case temp poll period has changed
-        temp_expiry = sensor_temp_expiry(datastore);
+static bool _check_daily_trigger(const datastore_t * datastore, schedule_t * schedule)
+{
+    bool daily_trigger = false;
+    bool system_time_set = false;
+    datastore_get_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, &system_time_set);
 
-        // If the array temperature (hard-coded as T2) exceeds the safe threshold,
-        // immediately run the purge pump cycle until the temperature returns to a safe level
-        datastore_age_t t_high_age = DATASTORE_INVALID_AGE;
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high_age);
-        if (t_high_age < temp_expiry)
-        {
-            float t_high = 0.0f;
-            datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high);
+    if (system_time_set)
+    {
+        time_t now = time(NULL);
+        time_t previous_next = schedule->next;
+        daily_trigger = schedule_poll(schedule, now, seconds_since_boot());
 
-            if (state == CONTROL_PP_STATE_EMERGENCY)
-            {
-                float threshold = 0.0f;
-                datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_LOW, 0, &threshold);
-                if (t_high < threshold)
-                {
-                    ESP_LOGI(TAG, "PP control loop: safe temperature restored - purge pump OFF");
-                    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Safe temperature restored - purge pump off");
-                    state = CONTROL_PP_STATE_OFF;
-                    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                    avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
-                }
-                else
-                {
-                    // keep the PP running
-                    // TODO: in the case of emergency, do we cycle the PP?
-                    // TODO: sound alarm?
-                    // TODO: what to do if the temperature isn't dropping?
-                }
-            }
-            else
+        char strftime_buf[64];
+        struct tm timeinfo;
+        if (daily_trigger)
+        {
+            localtime_r(&now, &timeinfo);
+            strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+            ESP_LOGI(TAG, "PP control loop: triggered Purge Pump at %s", strftime_buf);
+            if (now - previous_next > SCHEDULE_CLOCK_STEP)
             {
-                float threshold = 0.0f;
-                datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH, 0, &threshold);
-                if (t_high >= threshold)
-                {
-                    ESP_LOGE(TAG, "EMERGENCY - SAFE THRESHOLD EXCEEDED!");
-                    ESP_LOGI(TAG, "PP control loop: purge pump ON");
-                    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Safe threshold exceeded - purge pump on");
-                    state = CONTROL_PP_STATE_EMERGENCY;
-                    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                    avr_support_set_pp_pump(AVR_PUMP_STATE_ON);
-                }
+                ESP_LOGW(TAG, "PP control loop: daily purge %ld seconds late - system clock stepped", (long)(now - previous_next));
             }
         }
 
-        // Outputs are changed on state transitions
-        switch (state)
+        // local time conversion is only needed when the next firing changes
+        if (schedule->next != previous_next)
         {
-            case CONTROL_PP_STATE_OFF:
+            if (schedule->next != SCHEDULE_INVALID_TIME)
             {
-                avr_switch_mode_t pp_mode = AVR_SWITCH_MODE_AUTO;
-                datastore_get_uint32(datastore, RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 0, &pp_mode);
-                if (pp_mode == AVR_SWITCH_MODE_AUTO)
-                {
-                    datastore_get_age(datastore, RESOURCE_ID_FLOW_RATE, 0, &age);
-                    if (age < FLOW_RATE_MEASUREMENT_EXPIRY)
-                    {
-                        float flow_rate = 0.0f;
-                        datastore_get_float(datastore, RESOURCE_ID_FLOW_RATE, 0, &flow_rate);
-                        avr_pump_state_t cp_pump_state = AVR_PUMP_STATE_OFF;
-
-                        datastore_get_uint32(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, &cp_pump_state);
-                        datastore_age_t cp_state_age = 0;
-                        datastore_get_age(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, &cp_state_age);
-                        ESP_LOGD(TAG, "PP control loop: cp_state_age %" PRIu64, cp_state_age);
-
-                        float flow_threshold = 0.0f;
-                        datastore_get_float(datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 0, &flow_threshold);
-
-                        ESP_LOGD(TAG, "PP control loop: flow rate %f, cp state %d, threshold %f", flow_rate, cp_pump_state, flow_threshold);
-
-                        if (daily_trigger ||
-                            ((cp_pump_state == AVR_PUMP_STATE_ON) && (flow_rate <= flow_threshold) && (cp_state_age > PP_HOLD_OFF)))
-                        {
-                            datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT, 0, &n);
-                            ESP_LOGI(TAG, "PP control loop: purge pump ON (%d): %s", n, daily_trigger ? "time of day" : "low flow");
-                            datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, daily_trigger ? "Purge pump on (time of day)" : "Purge pump on (low flow)");
-                            state = CONTROL_PP_STATE_ON;
-                            datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                            avr_support_set_pp_pump(AVR_PUMP_STATE_ON);
-                            cycle_start_time = now;
-                            --n;
-                        }
-                    }
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "PP control loop: flow measurement expired");
-                }
-                break;
+                localtime_r(&schedule->next, &timeinfo);
+                strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+                ESP_LOGI(TAG, "PP control loop: next daily purge at %s", strftime_buf);
             }
+            datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_NEXT, 0, schedule->next != SCHEDULE_INVALID_TIME ? schedule->next : 0);
+        }
+    }
+    else
+    {
+        ESP_LOGD(TAG, "PP control loop: waiting for system time to be set");
+    }
 
-            case CONTROL_PP_STATE_ON:
-            {
-                uint32_t duration = 0;
-                datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION, 0, &duration);
-                uint32_t cycle_end_time = cycle_start_time + duration;
-
-                if (now >= cycle_end_time)
-                {
-                    ESP_LOGI(TAG, "PP control loop: purge pump PAUSE (%d)", n);
-                    // don't set log
-                    state = CONTROL_PP_STATE_PAUSE;
-                    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                    cycle_start_time = now;
-                    avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
-                }
-                break;
-            }
+    return daily_trigger;
+}
 
-            case CONTROL_PP_STATE_PAUSE:
-            {
-                uint32_t duration = 0;
-                datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_PAUSE_DURATION, 0, &duration);
-                TickType_t cycle_end_time = cycle_start_time + duration;
-
-                if (n > 0)
-                {
-                    if (now >= cycle_end_time)
-                    {
-                        ESP_LOGI(TAG, "PP control loop: purge pump ON (%d)", n);
-                        // don't set log
-                        state = CONTROL_PP_STATE_ON;
-                        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                        avr_support_set_pp_pump(AVR_PUMP_STATE_ON);
-                        cycle_start_time = now;
-                        --n;
-                    }
-                }
-                else
-                {
-                    if (now >= cycle_end_time)
-                    {
-                        ESP_LOGI(TAG, "PP control loop: purge pump OFF");
-                        datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Purge pump off");
-                        state = CONTROL_PP_STATE_OFF;
-                        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                        avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
-                    }
-                }
-                break;
-            }
+typedef struct
+{
+    const datastore_t * datastore;
+    control_pp_t pp;
+    schedule_t schedule;
+    bool schedule_changed;  // reload the purge schedule
+    bool temp_lost;         // array temperature expired during an emergency, alarm raised
+    uint32_t last_wake;     // milliseconds
+} pp_loop_t;
 
-            case CONTROL_PP_STATE_EMERGENCY:
-                // no-op
-                break;
+static pp_loop_t _pp_loop = { 0 };
 
-            default:
-                ESP_LOGE(TAG, "PP control loop: invalid case %d", state);
-        }
+static bool _pp_sensors_stable(const datastore_t * datastore)
+{
+    datastore_age_t age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_FLOW_RATE, 0, &age);
+    return age < FLOW_RATE_MEASUREMENT_EXPIRY;
+}
 
-        // if PP in manual mode, drop out of cycle
-        if (state == CONTROL_PP_STATE_ON || state == CONTROL_PP_STATE_PAUSE)
-        {
-            avr_switch_mode_t pp_mode = AVR_SWITCH_MODE_AUTO;
-            datastore_get_uint32(datastore, RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 0, &pp_mode);
-            if (pp_mode != AVR_SWITCH_MODE_AUTO)
-            {
-                ESP_LOGI(TAG, "PP control loop: purge pump OFF (manual)");
-                datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Purge pump off (manual)");
-                state = CONTROL_PP_STATE_OFF;
-                datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, state);
-                avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
-            }
-        }
+static void _pp_iterate(pp_loop_t * loop)
+{
+    const datastore_t * datastore = loop->datastore;
+    control_pp_t * pp = &loop->pp;
+
+    ESP_LOGD(TAG, "PP control loop: state %d, n %d", pp->fsm.state, pp->n);
+
+    control_pp_inputs_t inputs = { 0 };
+    if (loop->schedule_changed)
+    {
+        loop->schedule_changed = false;
+        _load_schedule(datastore, &loop->schedule);
+    }
+    inputs.daily_trigger = _check_daily_trigger(datastore, &loop->schedule);
+
+    // update measurement expiry in case temp poll period has changed
+    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
+
+    // the array temperature is hard-coded as the CP high sensor
+    datastore_age_t t_high_age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &t_high_age);
+    inputs.t_high_valid = t_high_age < temp_expiry;
+    datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, &inputs.t_high);
+    datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH, 0, &inputs.safe_temp_high);
+    datastore_get_float(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_LOW, 0, &inputs.safe_temp_low);
+
+    avr_switch_mode_t pp_mode = AVR_SWITCH_MODE_AUTO;
+    datastore_get_uint32(datastore, RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 0, &pp_mode);
+    inputs.auto_mode = pp_mode == AVR_SWITCH_MODE_AUTO;
+
+    datastore_age_t age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_FLOW_RATE, 0, &age);
+    inputs.flow_valid = age < FLOW_RATE_MEASUREMENT_EXPIRY;
+    if (!inputs.flow_valid && pp->fsm.state == CONTROL_PP_STATE_OFF)
+    {
+        ESP_LOGW(TAG, "PP control loop: flow measurement expired");
+    }
+    datastore_get_float(datastore, RESOURCE_ID_FLOW_RATE, 0, &inputs.flow_rate);
+    datastore_get_float(datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 0, &inputs.flow_threshold);
+
+    avr_pump_state_t cp_pump_state = AVR_PUMP_STATE_OFF;
+    datastore_get_uint32(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, &cp_pump_state);
+    inputs.cp_pump_on = cp_pump_state == AVR_PUMP_STATE_ON;
+    datastore_get_age(datastore, RESOURCE_ID_PUMPS_CP_STATE, 0, &inputs.cp_state_age);
+
+    datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT, 0, &inputs.cycle_count);
+    datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION, 0, &inputs.on_duration);
+    datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_PAUSE_DURATION, 0, &inputs.pause_duration);
 
-        vTaskDelayUntil(&last_wake_time, POLL_PERIOD / portTICK_PERIOD_MS);
+    ESP_LOGD(TAG, "PP control loop: flow rate %f, cp state %d, cp_state_age %" PRIu64 ", threshold %f", inputs.flow_rate, cp_pump_state, inputs.cp_state_age, inputs.flow_threshold);
+
+    control_pp_state_t prev_state = pp->fsm.state;
+    control_outputs_t outputs;
+    control_pp_step(pp, &inputs, seconds_since_boot(), &outputs);
+    _apply_pp_outputs(datastore, &outputs);
+
+    // release the emergency latch once the state machine has caught up and a
+    // current sample is below the safe temperature
+    bool latched = avr_support_get_pp_emergency();
+    if (pp->fsm.state != CONTROL_PP_STATE_EMERGENCY && latched && _safe_restored(datastore))
+    {
+        avr_support_set_pp_emergency(false);
+        latched = false;
     }
 
-    free(task_inputs);
-    _pp_task_handle = NULL;
-    vTaskDelete(NULL);
+    // the purge pump stays on without an array temperature - raise the alarm once per loss
+    bool temp_lost = (pp->fsm.state == CONTROL_PP_STATE_EMERGENCY || latched) && !inputs.t_high_valid;
+    if (temp_lost && !loop->temp_lost)
+    {
+        ESP_LOGE(TAG, "PP control loop: array temperature expired during EMERGENCY - purge pump held ON");
+        datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "Array temperature lost - purge pump held on");
+    }
+    loop->temp_lost = temp_lost;
+
+    control_trace_record_t record = {
+        .flags = (inputs.t_high_valid ? CONTROL_TRACE_FLAG_TEMPS_VALID : 0)
+                 | (inputs.flow_valid ? CONTROL_TRACE_FLAG_FLOW_VALID : 0)
+                 | (inputs.auto_mode ? CONTROL_TRACE_FLAG_AUTO_MODE : 0)
+                 | (inputs.cp_pump_on ? CONTROL_TRACE_FLAG_CP_PUMP_ON : 0)
+                 | (inputs.daily_trigger ? CONTROL_TRACE_FLAG_DAILY_TRIGGER : 0)
+                 | ((pp->fsm.state == CONTROL_PP_STATE_ON || pp->fsm.state == CONTROL_PP_STATE_EMERGENCY) ? CONTROL_TRACE_FLAG_PUMP_ON : 0),
+        .cycle = pp->n > UINT8_MAX ? UINT8_MAX : pp->n,
+        .t_high = control_trace_fixed(inputs.t_high),
+        .flow = control_trace_fixed(inputs.flow_rate),
+        .t_high_age = control_trace_age(t_high_age),
+        .t_low_age = CONTROL_TRACE_NO_AGE,
+        .flow_age = control_trace_age(age),
+    };
+    control_trace_add(CONTROL_TRACE_LOOP_PP, prev_state, pp->fsm.state, &outputs, &record);
 }
 
-void control_init(UBaseType_t priority, const datastore_t * datastore)
+static coroutine_status_t _control_pp_loop(coroutine_t * co, void * context, uint32_t now)
 {
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    pp_loop_t * loop = (pp_loop_t *)context;
+    const datastore_t * datastore = loop->datastore;
 
-    // task will take ownership of this struct
-    task_inputs_t * cp_task_inputs = malloc(sizeof(*cp_task_inputs));
-    if (cp_task_inputs)
+    CO_BEGIN(co);
+
+    avr_support_set_pp_pump(AVR_PUMP_STATE_OFF);
+
+    // wait for stable sensor readings
+    while (!_pp_sensors_stable(datastore))
     {
-        memset(cp_task_inputs, 0, sizeof(*cp_task_inputs));
-        cp_task_inputs->datastore = datastore;
-        xTaskCreate(&control_cp_task, "control_cp_task", 4096, cp_task_inputs, priority, &_cp_task_handle);
+        ESP_LOGD(TAG, "PP control loop: wait for stable sensors");
+        CO_DELAY(co, now, POLL_PERIOD);
     }
+    ESP_LOGI(TAG, "PP control loop: sensors stable");
 
-    // task will take ownership of this struct
-    task_inputs_t * pp_task_inputs = malloc(sizeof(*pp_task_inputs));
-    if (pp_task_inputs)
+    control_pp_logic_init(&loop->pp);
+    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_STATE_PP, 0, loop->pp.fsm.state);
+
+    // reload the purge schedule whenever its settings change
+    schedule_init(&loop->schedule);
+    loop->schedule_changed = true;
+    datastore_add_set_callback(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, _set_flag_handler, &loop->schedule_changed);
+    for (size_t i = 0; i < CONTROL_PP_DAILY_INSTANCES; ++i)
+    {
+        datastore_add_set_callback(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, i, _set_flag_handler, &loop->schedule_changed);
+        datastore_add_set_callback(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, i, _set_flag_handler, &loop->schedule_changed);
+        datastore_add_set_callback(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, i, _set_flag_handler, &loop->schedule_changed);
+    }
+
+    while (1)
     {
-        memset(pp_task_inputs, 0, sizeof(*pp_task_inputs));
-        pp_task_inputs->datastore = datastore;
-        xTaskCreate(&control_pp_task, "control_pp_task", 4096, pp_task_inputs, priority, &_pp_task_handle);
+        loop->last_wake = now;
+        _pp_iterate(loop);
+        CO_WAIT_UNTIL_TIME(co, now, loop->last_wake + POLL_PERIOD);
     }
+
+    CO_END(co);
 }
 
-void control_delete(void)
+void control_init(const datastore_t * datastore)
 {
-    if (_cp_task_handle)
-        vTaskDelete(_cp_task_handle);
-    if (_pp_task_handle)
-        vTaskDelete(_pp_task_handle);
-}
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
 
+    datastore_add_set_callback(datastore, RESOURCE_ID_TEMP_VALUE, CONTROL_CP_SENSOR_HIGH_INSTANCE, _overheat_handler, NULL);
 
+    // both control loops run as coroutines on the shared runner task
+    _cp_loop.datastore = datastore;
+    coroutine_runner_start("control_cp", _control_cp_loop, &_cp_loop);
+
+    _pp_loop.datastore = datastore;
+    coroutine_runner_start("control_pp", _control_pp_loop, &_pp_loop);
+}
@@ -0,0 +1,361 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "control_logic.h"
+
+#define CP_TREND_MIN_SAMPLES         (3)               // minimum samples before the trend is used
+#define PP_HOLD_OFF                  (30 * 1000000)    // to check for flow when CP is on, wait at least this many seconds before deciding to start PP if flow rate is below threshold
+
+// Per-step context passed to guards, timers and actions
+typedef struct
+{
+    control_cp_t * cp;
+    const control_cp_inputs_t * inputs;
+    control_outputs_t * outputs;
+    float delta;
+} cp_context_t;
+
+typedef struct
+{
+    control_pp_t * pp;
+    const control_pp_inputs_t * inputs;
+    control_outputs_t * outputs;
+} pp_context_t;
+
+// pump output required in each state
+static const bool CP_PUMP_ON[] = {
+    [CONTROL_CP_STATE_OFF] = false,
+    [CONTROL_CP_STATE_ON]  = true,
+};
+
+static const bool PP_PUMP_ON[] = {
+    [CONTROL_PP_STATE_OFF]       = false,
+    [CONTROL_PP_STATE_ON]        = true,
+    [CONTROL_PP_STATE_PAUSE]     = false,
+    [CONTROL_PP_STATE_EMERGENCY] = true,
+};
+
+static void _add_event(control_outputs_t * outputs, uint32_t state, bool pump_on, control_reason_t reason, uint32_t cycle)
+{
+    if (outputs->num_events < CONTROL_MAX_EVENTS)
+    {
+        control_event_t * event = &outputs->events[outputs->num_events++];
+        event->state = state;
+        event->pump_on = pump_on;
+        event->reason = reason;
+        event->cycle = cycle;
+    }
+}
+
+static void _cp_add_trend_sample(control_cp_t * cp, uint32_t now, float delta)
+{
+    if (cp->trend_count > 0)
+    {
+        uint8_t last = (cp->trend_head + CONTROL_CP_TREND_SAMPLES - 1) % CONTROL_CP_TREND_SAMPLES;
+        if (now - cp->trend_time[last] < CONTROL_CP_TREND_INTERVAL)
+        {
+            return;
+        }
+    }
+
+    cp->trend_time[cp->trend_head] = now;
+    cp->trend_delta[cp->trend_head] = delta;
+    cp->trend_head = (cp->trend_head + 1) % CONTROL_CP_TREND_SAMPLES;
+    if (cp->trend_count < CONTROL_CP_TREND_SAMPLES)
+    {
+        ++cp->trend_count;
+    }
+}
+
+bool control_cp_trend(const control_cp_t * cp, float * slope)
+{
+    assert(cp != NULL);
+    assert(slope != NULL);
+    if (cp->trend_count < CP_TREND_MIN_SAMPLES)
+    {
+        return false;
+    }
+
+    // least-squares fit, with time relative to the oldest sample to preserve float precision
+    uint8_t oldest = (cp->trend_head + CONTROL_CP_TREND_SAMPLES - cp->trend_count) % CONTROL_CP_TREND_SAMPLES;
+    float sum_t = 0.0f, sum_d = 0.0f, sum_tt = 0.0f, sum_td = 0.0f;
+    for (uint8_t i = 0; i < cp->trend_count; ++i)
+    {
+        uint8_t idx = (oldest + i) % CONTROL_CP_TREND_SAMPLES;
+        float t = (float)(cp->trend_time[idx] - cp->trend_time[oldest]);
+        float d = cp->trend_delta[idx];
+        sum_t += t;
+        sum_d += d;
+        sum_tt += t * t;
+        sum_td += t * d;
+    }
+
+    float n = (float)cp->trend_count;
+    float denominator = n * sum_tt - sum_t * sum_t;
+    if (denominator <= 0.0f)
+    {
+        return false;
+    }
+    *slope = (n * sum_td - sum_t * sum_d) / denominator;
+    return true;
+}
+
+/*
+ * Circulation pump
+ */
+
+static bool _cp_delta_on(const void * ctxt)
+{
+    const cp_context_t * c = ctxt;
+    return c->inputs->temps_valid && c->delta >= c->inputs->on_delta;
+}
+
+static bool _cp_delta_off(const void * ctxt)
+{
+    const cp_context_t * c = ctxt;
+    return c->inputs->temps_valid && c->delta <= c->inputs->off_delta;
+}
+
+static bool _cp_predicted(const void * ctxt)
+{
+    const cp_context_t * c = ctxt;
+    float slope = 0.0f;
+    return c->inputs->temps_valid
+        && c->inputs->predict_horizon > 0
+        && c->delta > c->inputs->off_delta    // hysteresis remains the floor, so the pump won't immediately turn off
+        && control_cp_trend(c->cp, &slope)
+        && slope > 0.0f
+        && c->delta + slope * c->inputs->predict_horizon >= c->inputs->on_delta;
+}
+
+static void _cp_emit(void * ctxt, const fsm_transition_t * transition)
+{
+    cp_context_t * c = ctxt;
+    _add_event(c->outputs, transition->to, CP_PUMP_ON[transition->to], transition->id, 0);
+}
+
+static const fsm_transition_t CP_TRANSITIONS[] = {
+    // from                              to                    phase  id                           guard          timeout  action
+    { FSM_STATE(CONTROL_CP_STATE_OFF),   CONTROL_CP_STATE_ON,  0,     CONTROL_REASON_CP_DELTA_ON,  _cp_delta_on,  NULL,    _cp_emit },
+    { FSM_STATE(CONTROL_CP_STATE_OFF),   CONTROL_CP_STATE_ON,  0,     CONTROL_REASON_CP_PREDICTED, _cp_predicted, NULL,    _cp_emit },
+    { FSM_STATE(CONTROL_CP_STATE_ON),    CONTROL_CP_STATE_OFF, 0,     CONTROL_REASON_CP_DELTA_OFF, _cp_delta_off, NULL,    _cp_emit },
+};
+
+static const fsm_def_t CP_FSM = {
+    .transitions = CP_TRANSITIONS,
+    .num_transitions = sizeof(CP_TRANSITIONS) / sizeof(CP_TRANSITIONS[0]),
+    .num_phases = 1,
+};
+
+void control_cp_logic_init(control_cp_t * cp)
+{
+    assert(cp != NULL);
+    memset(cp, 0, sizeof(*cp));
+    fsm_init(&cp->fsm, CONTROL_CP_STATE_OFF, 0);
+}
+
+void control_cp_step(control_cp_t * cp, const control_cp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs)
+{
+    assert(cp != NULL);
+    assert(inputs != NULL);
+    assert(outputs != NULL);
+    outputs->num_events = 0;
+
+    cp_context_t ctxt = {
+        .cp = cp,
+        .inputs = inputs,
+        .outputs = outputs,
+        .delta = inputs->t_high - inputs->t_low,
+    };
+
+    if (inputs->temps_valid)
+    {
+        _cp_add_trend_sample(cp, now, ctxt.delta);
+    }
+    else
+    {
+        // don't project across a gap in measurements
+        cp->trend_count = 0;
+    }
+
+    fsm_step(&CP_FSM, &cp->fsm, &ctxt, now);
+
+    // a state change already drives the output, so only refresh if there wasn't one
+    if (inputs->refresh && outputs->num_events == 0)
+    {
+        _add_event(outputs, cp->fsm.state, CP_PUMP_ON[cp->fsm.state], CONTROL_REASON_CP_REFRESH, 0);
+    }
+}
+
+/*
+ * Purge pump
+ */
+
+static bool _pp_safe_restored(const void * ctxt)
+{
+    const pp_context_t * c = ctxt;
+    return c->inputs->t_high_valid && c->inputs->t_high < c->inputs->safe_temp_low;
+}
+
+static bool _pp_overheat(const void * ctxt)
+{
+    const pp_context_t * c = ctxt;
+    return c->inputs->t_high_valid && c->inputs->t_high >= c->inputs->safe_temp_high;
+}
+
+static bool _pp_time_of_day(const void * ctxt)
+{
+    const pp_context_t * c = ctxt;
+    return c->inputs->auto_mode && c->inputs->flow_valid && c->inputs->daily_trigger;
+}
+
+static bool _pp_low_flow(const void * ctxt)
+{
+    const pp_context_t * c = ctxt;
+    return c->inputs->auto_mode && c->inputs->flow_valid
+        && c->inputs->cp_pump_on
+        && (c->inputs->flow_rate <= c->inputs->flow_threshold)
+        && (c->inputs->cp_state_age > PP_HOLD_OFF);
+}
+
+static bool _pp_manual(const void * ctxt)
+{
+    const pp_context_t * c = ctxt;
+    return !c->inputs->auto_mode;
+}
+
+static void _pp_emit(void * ctxt, const fsm_transition_t * transition)
+{
+    pp_context_t * c = ctxt;
+    _add_event(c->outputs, transition->to, PP_PUMP_ON[transition->to], transition->id, c->pp->n);
+}
+
+static void _pp_start_cycle(void * ctxt, const fsm_transition_t * transition)
+{
+    pp_context_t * c = ctxt;
+    c->pp->n = c->inputs->cycle_count;
+    _pp_emit(ctxt, transition);
+    --c->pp->n;
+    CO_INIT(&c->pp->cycle);
+}
+
+static void _pp_enter(pp_context_t * c, control_pp_state_t state, control_reason_t reason, uint32_t now)
+{
+    c->pp->fsm.state = state;
+    c->pp->fsm.entered = now;
+    _add_event(c->outputs, state, PP_PUMP_ON[state], reason, c->pp->n);
+}
+
+// The purge cycle: ON, then PAUSE, repeated until no ON periods remain. Takes at most
+// one transition per call. Emergency and manual exits are handled by the state machine,
+// and a new cycle restarts the coroutine.
+static coroutine_status_t _pp_cycle(pp_context_t * c, uint32_t now)
+{
+    control_pp_t * pp = c->pp;
+    const control_pp_inputs_t * inputs = c->inputs;
+    coroutine_t * co = &pp->cycle;
+
+    CO_BEGIN(co);
+    while (1)
+    {
+        CO_WAIT_UNTIL(co, now - pp->fsm.entered >= inputs->on_duration);
+        _pp_enter(c, CONTROL_PP_STATE_PAUSE, CONTROL_REASON_PP_CYCLE_PAUSE, now);
+        CO_YIELD(co);
+
+        CO_WAIT_UNTIL(co, now - pp->fsm.entered >= inputs->pause_duration);
+        if (pp->n == 0)
+        {
+            _pp_enter(c, CONTROL_PP_STATE_OFF, CONTROL_REASON_PP_CYCLE_DONE, now);
+            CO_EXIT(co);
+        }
+        _pp_enter(c, CONTROL_PP_STATE_ON, CONTROL_REASON_PP_CYCLE_ON, now);
+        --pp->n;
+        CO_YIELD(co);
+    }
+    CO_END(co);
+}
+
+#define PP_OFF        FSM_STATE(CONTROL_PP_STATE_OFF)
+#define PP_ON         FSM_STATE(CONTROL_PP_STATE_ON)
+#define PP_PAUSE      FSM_STATE(CONTROL_PP_STATE_PAUSE)
+#define PP_EMERGENCY  FSM_STATE(CONTROL_PP_STATE_EMERGENCY)
+
+enum
+{
+    PP_PHASE_SAFETY = 0,   // emergency entry and exit
+    PP_PHASE_CYCLE,        // start of a purge cycle; the rest of the cycle is _pp_cycle
+    PP_PHASE_MANUAL,       // drop out of the cycle if the switch leaves AUTO
+    PP_PHASE_LAST,
+};
+
+static const fsm_transition_t PP_TRANSITIONS[] = {
+    // from                      to                          phase             id                                guard              timeout             action
+    { PP_EMERGENCY,              CONTROL_PP_STATE_OFF,       PP_PHASE_SAFETY,  CONTROL_REASON_PP_SAFE_RESTORED,  _pp_safe_restored, NULL,               _pp_emit },
+    { PP_OFF | PP_ON | PP_PAUSE, CONTROL_PP_STATE_EMERGENCY, PP_PHASE_SAFETY,  CONTROL_REASON_PP_EMERGENCY,      _pp_overheat,      NULL,               _pp_emit },
+
+    { PP_OFF,                    CONTROL_PP_STATE_ON,        PP_PHASE_CYCLE,   CONTROL_REASON_PP_TIME_OF_DAY,    _pp_time_of_day,   NULL,               _pp_start_cycle },
+    { PP_OFF,                    CONTROL_PP_STATE_ON,        PP_PHASE_CYCLE,   CONTROL_REASON_PP_LOW_FLOW,       _pp_low_flow,      NULL,               _pp_start_cycle },
+
+    { PP_ON | PP_PAUSE,          CONTROL_PP_STATE_OFF,       PP_PHASE_MANUAL,  CONTROL_REASON_PP_MANUAL,         _pp_manual,        NULL,               _pp_emit },
+};
+
+static const fsm_def_t PP_FSM = {
+    .transitions = PP_TRANSITIONS,
+    .num_transitions = sizeof(PP_TRANSITIONS) / sizeof(PP_TRANSITIONS[0]),
+    .num_phases = PP_PHASE_LAST,
+};
+
+void control_pp_logic_init(control_pp_t * pp)
+{
+    assert(pp != NULL);
+    memset(pp, 0, sizeof(*pp));
+    fsm_init(&pp->fsm, CONTROL_PP_STATE_OFF, 0);
+}
+
+void control_pp_step(control_pp_t * pp, const control_pp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs)
+{
+    assert(pp != NULL);
+    assert(inputs != NULL);
+    assert(outputs != NULL);
+    outputs->num_events = 0;
+
+    pp_context_t ctxt = {
+        .pp = pp,
+        .inputs = inputs,
+        .outputs = outputs,
+    };
+    fsm_step_phase(&PP_FSM, &pp->fsm, &ctxt, now, PP_PHASE_SAFETY);
+    if (pp->fsm.state == CONTROL_PP_STATE_ON || pp->fsm.state == CONTROL_PP_STATE_PAUSE)
+    {
+        _pp_cycle(&ctxt, now);
+    }
+    else
+    {
+        fsm_step_phase(&PP_FSM, &pp->fsm, &ctxt, now, PP_PHASE_CYCLE);
+    }
+    fsm_step_phase(&PP_FSM, &pp->fsm, &ctxt, now, PP_PHASE_MANUAL);
+}
@@ -0,0 +1,190 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file control_logic.h
+ * @brief Pure decision logic for the circulation pump (CP) and purge pump (PP) controllers.
+ *
+ * These functions have no dependency on FreeRTOS, the datastore or the AVR, so the same
+ * code can be stepped from the control tasks on the device, or from a host-side
+ * program driving virtual time. The caller gathers inputs, calls the step function,
+ * then applies the resulting events to the hardware.
+ *
+ * Both controllers are expressed as transition tables for the fsm engine. The sequence of
+ * ON and PAUSE periods within a purge cycle is a coroutine, run in place of the table's
+ * cycle phase while a purge is in progress.
+ */
+
+#ifndef CONTROL_LOGIC_H
+#define CONTROL_LOGIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fsm.h"
+#include "coroutine.h"
+
+typedef enum
+{
+    CONTROL_CP_STATE_OFF = 0,  //
+    CONTROL_CP_STATE_ON,       //
+} control_cp_state_t;
+
+typedef enum
+{
+    CONTROL_PP_STATE_OFF = 0,   //
+    CONTROL_PP_STATE_ON,        //
+    CONTROL_PP_STATE_PAUSE,     //
+    CONTROL_PP_STATE_EMERGENCY, //
+} control_pp_state_t;
+
+typedef enum
+{
+    CONTROL_REASON_CP_DELTA_ON = 0,        // temperature delta reached the on threshold
+    CONTROL_REASON_CP_DELTA_OFF,           // temperature delta fell to the off threshold
+    CONTROL_REASON_CP_REFRESH,             // output re-sent without a state change (e.g. AVR reset)
+    CONTROL_REASON_CP_PREDICTED,           // temperature delta is projected to reach the on threshold
+    CONTROL_REASON_PP_SAFE_RESTORED,       // emergency cleared
+    CONTROL_REASON_PP_EMERGENCY,           // safe temperature exceeded
+    CONTROL_REASON_PP_TIME_OF_DAY,         // purge cycle started by the daily schedule
+    CONTROL_REASON_PP_LOW_FLOW,            // purge cycle started by low flow while CP is on
+    CONTROL_REASON_PP_CYCLE_PAUSE,         // end of an ON period within a purge cycle
+    CONTROL_REASON_PP_CYCLE_ON,            // end of a PAUSE period within a purge cycle
+    CONTROL_REASON_PP_CYCLE_DONE,          // purge cycle complete
+    CONTROL_REASON_PP_MANUAL,              // purge cycle abandoned because switch is not in AUTO
+    CONTROL_REASON_LAST,
+} control_reason_t;
+
+#define CONTROL_MAX_EVENTS (4)   // maximum number of events produced by a single step
+
+/**
+ * @brief A single state transition, to be applied to the outputs by the caller.
+ */
+typedef struct
+{
+    uint32_t state;              ///< new controller state (control_cp_state_t or control_pp_state_t)
+    bool pump_on;                ///< required pump output
+    control_reason_t reason;     ///< why the transition occurred
+    uint32_t cycle;              ///< remaining purge cycles at the time of the event (PP only)
+} control_event_t;
+
+typedef struct
+{
+    uint8_t num_events;
+    control_event_t events[CONTROL_MAX_EVENTS];
+} control_outputs_t;
+
+#define CONTROL_CP_TREND_SAMPLES   (12)   // number of temperature delta samples used to estimate the trend
+#define CONTROL_CP_TREND_INTERVAL  (5)    // seconds between trend samples
+
+/**
+ * @brief Circulation pump controller state.
+ */
+typedef struct
+{
+    fsm_t fsm;                   ///< fsm.state is a control_cp_state_t
+
+    // recent temperature delta samples, for predictive control
+    uint32_t trend_time[CONTROL_CP_TREND_SAMPLES];
+    float trend_delta[CONTROL_CP_TREND_SAMPLES];
+    uint8_t trend_head;          ///< index of the next sample to be written
+    uint8_t trend_count;         ///< number of valid samples
+} control_cp_t;
+
+typedef struct
+{
+    bool temps_valid;            ///< both temperature measurements are current
+    float t_high;                ///< high (array) temperature
+    float t_low;                 ///< low (pool) temperature
+    float on_delta;              ///< switch pump on when t_high - t_low >= on_delta
+    float off_delta;             ///< switch pump off when t_high - t_low <= off_delta
+    uint32_t predict_horizon;    ///< seconds to project the delta trend forward, or 0 to disable prediction
+    bool refresh;                ///< re-send the current output even if the state does not change
+} control_cp_inputs_t;
+
+/**
+ * @brief Purge pump controller state.
+ */
+typedef struct
+{
+    fsm_t fsm;                   ///< fsm.state is a control_pp_state_t; fsm.entered is the start of the current ON or PAUSE period
+    uint32_t n;                  ///< remaining ON periods in the current purge cycle
+    coroutine_t cycle;           ///< purge cycle sequence, restarted at the start of each cycle
+} control_pp_t;
+
+typedef struct
+{
+    bool daily_trigger;          ///< scheduled purge time has been reached
+    bool t_high_valid;           ///< high temperature measurement is current
+    float t_high;                ///< high (array) temperature
+    float safe_temp_high;        ///< enter emergency at or above this temperature
+    float safe_temp_low;         ///< leave emergency below this temperature
+    bool auto_mode;              ///< purge pump switch is in AUTO
+    bool flow_valid;             ///< flow rate measurement is current
+    float flow_rate;             ///< measured flow rate
+    float flow_threshold;        ///< start purge if CP is on and flow rate is at or below this
+    bool cp_pump_on;             ///< circulation pump is currently on
+    uint64_t cp_state_age;       ///< microseconds since the circulation pump state last changed
+    uint32_t cycle_count;        ///< number of ON periods in a purge cycle
+    uint32_t on_duration;        ///< seconds per ON period
+    uint32_t pause_duration;     ///< seconds per PAUSE period
+} control_pp_inputs_t;
+
+/**
+ * @brief Initialise the circulation pump controller state.
+ */
+void control_cp_logic_init(control_cp_t * cp);
+
+/**
+ * @brief Advance the circulation pump controller by one step.
+ * @param[in,out] cp Controller state.
+ * @param[in] inputs Current inputs.
+ * @param[in] now Current time in seconds.
+ * @param[out] outputs Transitions that occurred during this step, in order.
+ */
+void control_cp_step(control_cp_t * cp, const control_cp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs);
+
+/**
+ * @brief Estimate the rate of change of the temperature delta from recent samples.
+ * @param[in] cp Controller state.
+ * @param[out] slope Least-squares slope in degrees per second.
+ * @return true if there were enough samples to make an estimate.
+ */
+bool control_cp_trend(const control_cp_t * cp, float * slope);
+
+/**
+ * @brief Initialise the purge pump controller state.
+ */
+void control_pp_logic_init(control_pp_t * pp);
+
+/**
+ * @brief Advance the purge pump controller by one step.
+ * @param[in,out] pp Controller state.
+ * @param[in] inputs Current inputs.
+ * @param[in] now Current time in seconds.
+ * @param[out] outputs Transitions that occurred during this step, in order.
+ */
+void control_pp_step(control_pp_t * pp, const control_pp_inputs_t * inputs, uint32_t now, control_outputs_t * outputs);
+
+#endif // CONTROL_LOGIC_H
@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "control_trace.h"
+#include "constants.h"
+#include "mqtt.h"
+#include "utils.h"
+
+#define TAG "control_trace"
+
+#define TRACE_TOPIC           ROOT_TOPIC"/control/trace/data"
+#define RECORDS_PER_MESSAGE   (4)          // keeps each payload and topic under the 256 byte MQTT buffer
+#define DUMP_TASK_STACK_SIZE  (3072)
+
+static control_trace_record_t _ring[CONTROL_TRACE_RECORDS];
+static uint16_t _head = 0;        // next record to be written
+static uint16_t _count = 0;       // valid records
+static uint16_t _seq = 0;
+static portMUX_TYPE _ring_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// cost of control_trace_add, for comparison against the control loop period
+static uint64_t _overhead_total_us = 0;
+static uint32_t _overhead_max_us = 0;
+static uint32_t _overhead_samples = 0;
+
+static TaskHandle_t _dump_task_handle = NULL;
+
+int16_t control_trace_fixed(float value)
+{
+    float scaled = value * 100.0f;
+    if (scaled > INT16_MAX)
+        return INT16_MAX;
+    if (scaled < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)scaled;
+}
+
+uint16_t control_trace_age(uint64_t age)
+{
+    uint64_t tenths = age / 100000;
+    return tenths > CONTROL_TRACE_NO_AGE ? CONTROL_TRACE_NO_AGE : (uint16_t)tenths;
+}
+
+void control_trace_add(uint8_t loop, uint32_t prev_state, uint32_t state, const control_outputs_t * outputs, control_trace_record_t * record)
+{
+    uint64_t start = microseconds_since_boot();
+
+    record->time = seconds_since_boot();
+    record->loop = loop;
+    record->prev_state = prev_state;
+    record->state = state;
+    record->reason = CONTROL_TRACE_NO_REASON;
+    if (outputs->num_events > 0)
+    {
+        const control_event_t * last = &outputs->events[outputs->num_events - 1];
+        record->reason = last->reason;
+    }
+    uint8_t num_events = outputs->num_events > 3 ? 3 : outputs->num_events;
+    record->flags |= num_events << CONTROL_TRACE_FLAG_EVENTS_SHIFT;
+
+    portENTER_CRITICAL(&_ring_mux);
+    record->seq = _seq++;
+    _ring[_head] = *record;
+    _head = (_head + 1) % CONTROL_TRACE_RECORDS;
+    if (_count < CONTROL_TRACE_RECORDS)
+    {
+        ++_count;
+    }
+
+    uint32_t elapsed = microseconds_since_boot() - start;
+    _overhead_total_us += elapsed;
+    _overhead_samples += 1;
+    if (elapsed > _overhead_max_us)
+    {
+        _overhead_max_us = elapsed;
+    }
+    portEXIT_CRITICAL(&_ring_mux);
+}
+
+static void _publish_line(const char * line)
+{
+    if (!mqtt_publish(TRACE_TOPIC, (const uint8_t *)line, strlen(line), 0, false))
+    {
+        ESP_LOGW(TAG, "publish failed");
+    }
+}
+
+static void control_trace_dump_task(void * pvParameter)
+{
+    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+
+    // snapshot the ring so that the control loops are not held up while publishing
+    control_trace_record_t * snapshot = malloc(sizeof(_ring));
+    if (snapshot)
+    {
+        portENTER_CRITICAL(&_ring_mux);
+        uint16_t count = _count;
+        uint16_t oldest = (_head + CONTROL_TRACE_RECORDS - _count) % CONTROL_TRACE_RECORDS;
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            snapshot[i] = _ring[(oldest + i) % CONTROL_TRACE_RECORDS];
+        }
+        uint32_t overhead_avg_us = _overhead_samples ? _overhead_total_us / _overhead_samples : 0;
+        uint32_t overhead_max_us = _overhead_max_us;
+        portEXIT_CRITICAL(&_ring_mux);
+
+        ESP_LOGI(TAG, "Dumping %d records, overhead avg %" PRIu32 " us, max %" PRIu32 " us", count, overhead_avg_us, overhead_max_us);
+
+        char line[16 + RECORDS_PER_MESSAGE * sizeof(control_trace_record_t) * 2] = "";
+        snprintf(line, sizeof(line), "H %d %zu %" PRIu32 " %" PRIu32, count, sizeof(control_trace_record_t), overhead_avg_us, overhead_max_us);
+        _publish_line(line);
+
+        for (uint16_t i = 0; i < count; i += RECORDS_PER_MESSAGE)
+        {
+            size_t len = snprintf(line, sizeof(line), "R ");
+            for (uint16_t j = i; j < count && j < i + RECORDS_PER_MESSAGE; ++j)
+            {
+                const uint8_t * bytes = (const uint8_t *)&snapshot[j];
+                for (size_t k = 0; k < sizeof(control_trace_record_t); ++k)
+                {
+                    len += snprintf(&line[len], sizeof(line) - len, "%02x", bytes[k]);
+                }
+            }
+            _publish_line(line);
+        }
+
+        _publish_line("E");
+        free(snapshot);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "malloc failed");
+    }
+
+    _dump_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+void control_trace_request_dump(void)
+{
+    if (_dump_task_handle == NULL)
+    {
+        xTaskCreate(&control_trace_dump_task, "control_trace_dump_task", DUMP_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &_dump_task_handle);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Dump already in progress");
+    }
+}
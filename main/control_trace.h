@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file control_trace.h
+ * @brief Compact binary trace of control loop decisions.
+ *
+ * Each control loop iteration appends a fixed-size record of its inputs and outcome to a
+ * RAM ring. The ring can be dumped over MQTT on demand, as hex-encoded records on the
+ * topic ROOT_TOPIC/control/trace/data, and decoded on a host with tools/control_trace_decode.py.
+ */
+
+#ifndef CONTROL_TRACE_H
+#define CONTROL_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "control_logic.h"
+
+#define CONTROL_TRACE_RECORDS      (256)     // ring capacity
+#define CONTROL_TRACE_LOOP_PP      (0x80)    // loop identifier for the purge pump; CP instances use their index
+#define CONTROL_TRACE_NO_REASON    (0xff)    // iteration produced no transition
+#define CONTROL_TRACE_NO_AGE       (0xffff)  // measurement never received, or older than the age range
+
+// record flags
+#define CONTROL_TRACE_FLAG_PUMP_ON        (1 << 0)   // pump output after this iteration
+#define CONTROL_TRACE_FLAG_TEMPS_VALID    (1 << 1)   // temperature measurement(s) current
+#define CONTROL_TRACE_FLAG_FLOW_VALID     (1 << 2)   // flow measurement current (PP only)
+#define CONTROL_TRACE_FLAG_AUTO_MODE      (1 << 3)   // pump switch in AUTO (PP only)
+#define CONTROL_TRACE_FLAG_CP_PUMP_ON     (1 << 4)   // circulation pump running (PP only)
+#define CONTROL_TRACE_FLAG_DAILY_TRIGGER  (1 << 5)   // scheduled purge fired (PP only)
+#define CONTROL_TRACE_FLAG_EVENTS_SHIFT   (6)        // bits 6-7: number of transitions, saturated at 3
+
+// 24 bytes, little-endian - keep in sync with tools/control_trace_decode.py
+typedef struct __attribute__((packed))
+{
+    uint16_t seq;          ///< incrementing sequence number, to detect gaps
+    uint32_t time;         ///< seconds since boot
+    uint8_t loop;          ///< CP instance, or CONTROL_TRACE_LOOP_PP
+    uint8_t prev_state;    ///< state before the iteration
+    uint8_t state;         ///< state after the iteration
+    uint8_t reason;        ///< control_reason_t of the last transition, or CONTROL_TRACE_NO_REASON
+    uint8_t flags;         ///< CONTROL_TRACE_FLAG_*
+    uint8_t cycle;         ///< remaining purge cycles, saturated at 255
+    int16_t t_high;        ///< hundredths of a degree
+    int16_t t_low;         ///< hundredths of a degree (CP only)
+    int16_t flow;          ///< hundredths of a litre per minute (PP only)
+    uint16_t t_high_age;   ///< tenths of a second since the sample, or CONTROL_TRACE_NO_AGE
+    uint16_t t_low_age;    ///< tenths of a second since the sample, or CONTROL_TRACE_NO_AGE (CP only)
+    uint16_t flow_age;     ///< tenths of a second since the sample, or CONTROL_TRACE_NO_AGE (PP only)
+} control_trace_record_t;
+
+/**
+ * @brief Append a record for one control loop iteration.
+ * @param[in] loop CP instance, or CONTROL_TRACE_LOOP_PP.
+ * @param[in] prev_state State before the step.
+ * @param[in] outputs Outputs of the step.
+ * @param[in] record Caller-filled inputs, outputs and cycle; seq, time, loop, states, reason and event count are set here.
+ */
+void control_trace_add(uint8_t loop, uint32_t prev_state, uint32_t state, const control_outputs_t * outputs, control_trace_record_t * record);
+
+/**
+ * @brief Convert a value in fixed point hundredths, saturating at the int16_t range.
+ */
+int16_t control_trace_fixed(float value);
+
+/**
+ * @brief Convert a measurement age in microseconds to tenths of a second, saturating at CONTROL_TRACE_NO_AGE.
+ */
+uint16_t control_trace_age(uint64_t age);
+
+/**
+ * @brief Request that the trace ring be published over MQTT. Publication happens in a
+ *        short-lived task so that neither the caller nor the control loops are delayed.
+ */
+void control_trace_request_dump(void);
+
+#endif // CONTROL_TRACE_H
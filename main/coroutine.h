@@ -0,0 +1,91 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file coroutine.h
+ * @brief Stackless coroutines, in the style of protothreads.
+ *
+ * A coroutine is an ordinary function whose body is wrapped in CO_BEGIN / CO_END. It may
+ * suspend itself at a CO_ macro and, when called again, resumes from that point. The only
+ * state preserved across a suspension is the coroutine_t itself: local variables are NOT
+ * preserved, so anything that must survive a wait belongs in a context struct. Function
+ * parameters are re-supplied on every call, so waits on "now" or on live inputs see
+ * current values.
+ *
+ * The implementation uses a switch statement on the source line, so a coroutine body
+ * must not itself contain a switch statement that spans a CO_ macro, and at most one
+ * CO_ macro may appear on each source line.
+ *
+ * This header has no dependency on FreeRTOS. Time is supplied by the caller, in whatever
+ * unit the caller chooses. See coroutine_runner.h for running many coroutines on a
+ * single task.
+ */
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    CO_WAITING = 0,    ///< suspended until a condition or time is reached
+    CO_YIELDED,        ///< suspended, but ready to run again immediately
+    CO_DONE,           ///< reached CO_END or CO_EXIT
+} coroutine_status_t;
+
+typedef struct
+{
+    uint16_t line;         ///< resume point, 0 to start from the beginning
+    bool timed;            ///< currently waiting for deadline
+    uint32_t deadline;     ///< time at which a timed wait completes
+} coroutine_t;
+
+#define CO_LINE_DONE  (UINT16_MAX)
+
+/// (Re)start a coroutine from the beginning on its next call
+#define CO_INIT(co)  do { (co)->line = 0; (co)->timed = false; (co)->deadline = 0; } while (0)
+
+#define CO_IS_DONE(co)  ((co)->line == CO_LINE_DONE)
+
+#define CO_BEGIN(co)  switch ((co)->line) { case 0:
+
+#define CO_END(co)  default: ; } (co)->line = CO_LINE_DONE; (co)->timed = false; return CO_DONE
+
+/// Finish the coroutine early
+#define CO_EXIT(co)  do { (co)->line = CO_LINE_DONE; (co)->timed = false; return CO_DONE; } while (0)
+
+/// Suspend, resuming at the next call
+#define CO_YIELD(co)  do { (co)->line = __LINE__; return CO_YIELDED; case __LINE__: ; } while (0)
+
+/// Suspend until cond is true. cond is evaluated immediately, then on every call.
+#define CO_WAIT_UNTIL(co, cond)  do { (co)->timed = false; (co)->line = __LINE__; case __LINE__: if (!(cond)) return CO_WAITING; } while (0)
+
+/// Suspend until now reaches time t. t is evaluated once, when the wait begins. Wraparound safe.
+#define CO_WAIT_UNTIL_TIME(co, now, t)  do { (co)->deadline = (t); (co)->timed = true; (co)->line = __LINE__; case __LINE__: if ((int32_t)((uint32_t)(now) - (co)->deadline) < 0) return CO_WAITING; (co)->timed = false; } while (0)
+
+/// Suspend for duration, measured from the time the wait begins
+#define CO_DELAY(co, now, duration)  CO_WAIT_UNTIL_TIME(co, now, (uint32_t)(now) + (duration))
+
+#endif // COROUTINE_H
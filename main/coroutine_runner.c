@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "coroutine_runner.h"
+
+#define TAG "coroutine"
+
+#define STACK_SIZE 4096
+
+typedef struct
+{
+    const char * name;         // NULL if slot is unused
+    coroutine_func_t func;
+    void * context;
+    coroutine_t co;
+} slot_t;
+
+static slot_t _slots[COROUTINE_RUNNER_MAX] = { 0 };
+static portMUX_TYPE _slots_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t _task_handle = NULL;
+
+static uint32_t _now(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+static void coroutine_runner_task(void * pvParameter)
+{
+    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+
+    while (1)
+    {
+        // sleep until the earliest deadline, polling only if a coroutine waits on a condition
+        uint32_t wait = UINT32_MAX;
+        for (size_t i = 0; i < COROUTINE_RUNNER_MAX; ++i)
+        {
+            slot_t * slot = &_slots[i];
+            if (slot->name == NULL)
+                continue;
+
+            uint32_t now = _now();
+            coroutine_status_t status = slot->func(&slot->co, slot->context, now);
+
+            switch (status)
+            {
+            case CO_DONE:
+                ESP_LOGD(TAG, "%s done", slot->name);
+                portENTER_CRITICAL(&_slots_mux);
+                slot->name = NULL;
+                portEXIT_CRITICAL(&_slots_mux);
+                break;
+            case CO_YIELDED:
+                wait = 0;
+                break;
+            case CO_WAITING:
+            default:
+                if (slot->co.timed)
+                {
+                    now = _now();
+                    int32_t remaining = (int32_t)(slot->co.deadline - now);
+                    if (remaining < 0)
+                        remaining = 0;
+                    if ((uint32_t)remaining < wait)
+                        wait = remaining;
+                }
+                else if (wait > COROUTINE_RUNNER_POLL_PERIOD)
+                {
+                    wait = COROUTINE_RUNNER_POLL_PERIOD;
+                }
+                break;
+            }
+        }
+
+        if (wait == UINT32_MAX)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        else if (wait > 0)
+        {
+            ulTaskNotifyTake(pdTRUE, (wait + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS);
+        }
+        else
+        {
+            taskYIELD();
+        }
+    }
+
+    _task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+void coroutine_runner_init(UBaseType_t priority)
+{
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    xTaskCreate(&coroutine_runner_task, "coroutine_task", STACK_SIZE, NULL, priority, &_task_handle);
+}
+
+void coroutine_runner_delete(void)
+{
+    if (_task_handle)
+        vTaskDelete(_task_handle);
+    _task_handle = NULL;
+}
+
+bool coroutine_runner_start(const char * name, coroutine_func_t func, void * context)
+{
+    assert(name != NULL && func != NULL);
+    bool started = false;
+
+    portENTER_CRITICAL(&_slots_mux);
+    for (size_t i = 0; !started && i < COROUTINE_RUNNER_MAX; ++i)
+    {
+        if (_slots[i].name == NULL)
+        {
+            _slots[i].func = func;
+            _slots[i].context = context;
+            CO_INIT(&_slots[i].co);
+            _slots[i].name = name;
+            started = true;
+        }
+    }
+    portEXIT_CRITICAL(&_slots_mux);
+
+    if (!started)
+    {
+        ESP_LOGE(TAG, "no free slot for coroutine %s", name);
+    }
+    else
+    {
+        coroutine_runner_wake();
+    }
+    return started;
+}
+
+void coroutine_runner_wake(void)
+{
+    if (_task_handle)
+    {
+        xTaskNotifyGive(_task_handle);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COROUTINE_RUNNER_H
+#define COROUTINE_RUNNER_H
+
+#include "freertos/FreeRTOS.h"
+
+#include "coroutine.h"
+
+/*
+ * Runs many coroutines on a single FreeRTOS task. Time is supplied to each coroutine in
+ * milliseconds since boot. The task sleeps on a task notification until the earliest
+ * timed wait completes. Coroutines waiting on a condition (CO_WAIT_UNTIL) are polled
+ * every COROUTINE_RUNNER_POLL_PERIOD, or sooner if coroutine_runner_wake() is called;
+ * while none is, the task sleeps until the earliest deadline or a wake.
+ */
+
+#define COROUTINE_RUNNER_MAX         (4)
+#define COROUTINE_RUNNER_POLL_PERIOD (100)   // milliseconds
+
+typedef coroutine_status_t (*coroutine_func_t)(coroutine_t * co, void * context, uint32_t now);
+
+void coroutine_runner_init(UBaseType_t priority);
+void coroutine_runner_delete(void);
+
+// Start a coroutine. The context must persist until the coroutine is done.
+bool coroutine_runner_start(const char * name, coroutine_func_t func, void * context);
+
+// Re-evaluate all waiting coroutines as soon as possible. Safe to call from any task.
+void coroutine_runner_wake(void);
+
+#endif // COROUTINE_RUNNER_H
@@ -24,6 +24,7 @@
 
 #include <string.h>
 #include <time.h>
+#include <math.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -38,6 +39,8 @@
 #include "i2c_master.h"
 #include "smbus.h"
 #include "i2c-lcd1602.h"
+#include "lcd_burst.h"
+#include "glyph.h"
 #include "avr_support.h"
 #include "sensor_temp.h"
 #include "wifi_support.h"
@@ -47,6 +50,7 @@
 #include "datastore/datastore.h"
 #include "led.h"
 #include "control.h"
+#include "trend.h"
 #include "sdkconfig.h"
 
 #define TAG "display"
@@ -72,17 +76,38 @@
 typedef struct
 {
     char * row[LCD_NUM_ROWS];
+    bool scroll;     // set by the handler to marquee content written with _set_wide_line()
 } page_buffer_t;
 
 typedef void (*page_handler_t)(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
 
+// A page is re-rendered when one of its dependencies is set, and every period milliseconds
+// if it shows a clock, countdown, blinking field or measurement expiry (0 = never).
+typedef struct
+{
+    datastore_resource_id_t id;
+    datastore_instance_id_t num_instances;
+} page_dependency_t;
+
 typedef struct
 {
     display_page_id_t id;
     page_handler_t handler;
     void * state;
+    const page_dependency_t * dependencies;
+    size_t num_dependencies;
+    uint32_t period;
+    uint32_t scroll;    // milliseconds per display shift step, when the handler requests scrolling
 } page_spec_t;
 
+#define DEPENDENCIES(x) x, sizeof(x) / sizeof(x[0])
+#define NO_DEPENDENCIES NULL, 0
+
+#define PERIOD_BLINK   500     // milliseconds
+#define PERIOD_CLOCK   1000
+#define PERIOD_EXPIRY  5000    // measurement expiry and other values not held in the datastore
+#define SCROLL_STEP    400
+
 static TaskHandle_t _task_handle = NULL;
 
 // page handlers are responsible for displaying their content
@@ -102,28 +127,139 @@ static void _handle_page_wifi_status(page_buffer_t * page_buffer, void * state,
 static void _handle_page_mqtt_status(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
 static void _handle_page_resource_status(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
 static void _handle_page_avr_status(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
+static void _handle_page_i2c_status(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
+static void _handle_page_log(page_buffer_t * page_buffer, void * state, const datastore_t * datastore);
 
 static bool main_activity = false;
 static bool blink_arrow = false;
 
+// resources read by each page handler
+static const page_dependency_t main_dependencies[] = {
+    { RESOURCE_ID_SYSTEM_VERSION, 1 },
+    { RESOURCE_ID_SYSTEM_BUILD_DATE_TIME, 1 },
+    { RESOURCE_ID_SYSTEM_BUILD_GIT_COMMIT, 1 },
+};
+
+static const page_dependency_t sensors_temp_dependencies[] = {
+    { RESOURCE_ID_TEMP_VALUE, SENSOR_TEMP_INSTANCES },
+    { RESOURCE_ID_TEMP_LABEL, SENSOR_TEMP_INSTANCES },
+};
+
+static const page_dependency_t sensors_light_dependencies[] = {
+    { RESOURCE_ID_LIGHT_DETECTED, 1 },
+    { RESOURCE_ID_LIGHT_FULL, 1 },
+    { RESOURCE_ID_LIGHT_VISIBLE, 1 },
+    { RESOURCE_ID_LIGHT_INFRARED, 1 },
+    { RESOURCE_ID_LIGHT_ILLUMINANCE, 1 },
+};
+
+static const page_dependency_t sensors_flow_dependencies[] = {
+    { RESOURCE_ID_FLOW_FREQUENCY, 1 },
+    { RESOURCE_ID_FLOW_RATE, 1 },
+};
+
+static const page_dependency_t power_dependencies[] = {
+    { RESOURCE_ID_POWER_TEMP_DELTA, 1 },
+    { RESOURCE_ID_FLOW_FREQUENCY, 1 },
+    { RESOURCE_ID_FLOW_RATE, 1 },
+    { RESOURCE_ID_POWER_VALUE, 1 },
+};
+
+static const page_dependency_t switches_dependencies[] = {
+    { RESOURCE_ID_SWITCHES_CP_MODE_VALUE, 1 },
+    { RESOURCE_ID_SWITCHES_CP_MAN_VALUE, 1 },
+    { RESOURCE_ID_SWITCHES_PP_MODE_VALUE, 1 },
+    { RESOURCE_ID_SWITCHES_PP_MAN_VALUE, 1 },
+    { RESOURCE_ID_AVR_COUNT_CP_MODE, 1 },
+    { RESOURCE_ID_AVR_COUNT_CP_MAN, 1 },
+    { RESOURCE_ID_AVR_COUNT_PP_MODE, 1 },
+    { RESOURCE_ID_AVR_COUNT_PP_MAN, 1 },
+};
+
+static const page_dependency_t pump_status_dependencies[] = {
+    { RESOURCE_ID_PUMPS_CP_STATE, 1 },
+    { RESOURCE_ID_PUMPS_PP_STATE, 1 },
+    { RESOURCE_ID_AVR_COUNT_CP, 1 },
+    { RESOURCE_ID_AVR_COUNT_PP, 1 },
+};
+
+static const page_dependency_t cp_control_dependencies[] = {
+    { RESOURCE_ID_CONTROL_STATE_CP, 1 },
+    { RESOURCE_ID_TEMP_VALUE, SENSOR_TEMP_INSTANCES },
+    { RESOURCE_ID_CONTROL_CP_ON_DELTA, 1 },
+    { RESOURCE_ID_CONTROL_CP_OFF_DELTA, 1 },
+};
+
+static const page_dependency_t pp_control_dependencies[] = {
+    { RESOURCE_ID_CONTROL_STATE_PP, 1 },
+    { RESOURCE_ID_CONTROL_STATE_CP, 1 },
+    { RESOURCE_ID_FLOW_RATE, 1 },
+    { RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 1 },
+    { RESOURCE_ID_SYSTEM_TIME_SET, 1 },
+    { RESOURCE_ID_CONTROL_PP_DAILY_NEXT, 1 },
+};
+
+static const page_dependency_t wifi_status_dependencies[] = {
+    { RESOURCE_ID_WIFI_STATUS, 1 },
+    { RESOURCE_ID_WIFI_CONNECTION_COUNT, 1 },
+    { RESOURCE_ID_WIFI_SSID, 1 },
+    { RESOURCE_ID_WIFI_RSSI, 1 },
+    { RESOURCE_ID_WIFI_ADDRESS, 1 },
+    { RESOURCE_ID_WIFI_TIMESTAMP, 1 },
+};
+
+static const page_dependency_t mqtt_status_dependencies[] = {
+    { RESOURCE_ID_MQTT_STATUS, 1 },
+    { RESOURCE_ID_MQTT_CONNECTION_COUNT, 1 },
+    { RESOURCE_ID_MQTT_BROKER_ADDRESS, 1 },
+    { RESOURCE_ID_MQTT_BROKER_PORT, 1 },
+    { RESOURCE_ID_MQTT_MESSAGE_RX_COUNT, 1 },
+    { RESOURCE_ID_MQTT_MESSAGE_TX_COUNT, 1 },
+    { RESOURCE_ID_MQTT_TIMESTAMP, 1 },
+};
+
+static const page_dependency_t avr_status_dependencies[] = {
+    { RESOURCE_ID_AVR_VERSION, 1 },
+    { RESOURCE_ID_AVR_COUNT_RESET, 1 },
+};
+
+static const page_dependency_t i2c_status_dependencies[] = {
+    { RESOURCE_ID_I2C_DEVICE_ADDRESS, I2C_MASTER_MAX_DEVICES },
+    { RESOURCE_ID_I2C_DEVICE_TRANSACTIONS, I2C_MASTER_MAX_DEVICES },
+    { RESOURCE_ID_I2C_DEVICE_NACKS, I2C_MASTER_MAX_DEVICES },
+    { RESOURCE_ID_I2C_DEVICE_TIMEOUTS, I2C_MASTER_MAX_DEVICES },
+    { RESOURCE_ID_I2C_DEVICE_ERRORS, I2C_MASTER_MAX_DEVICES },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_MAX, I2C_MASTER_MAX_DEVICES },
+};
+
+static const page_dependency_t log_dependencies[] = {
+    { RESOURCE_ID_SYSTEM_LOG, 1 },
+    { RESOURCE_ID_WIFI_SSID, 1 },
+    { RESOURCE_ID_WIFI_ADDRESS, 1 },
+    { RESOURCE_ID_MQTT_BROKER_ADDRESS, 1 },
+    { RESOURCE_ID_MQTT_BROKER_PORT, 1 },
+};
+
 static const page_spec_t page_specs[] = {
-    // ID                       handler                        state
-    { DISPLAY_PAGE_BLANK,               _handle_page_blank,            NULL },
-    { DISPLAY_PAGE_MAIN,                _handle_page_main,             &main_activity },
-    { DISPLAY_PAGE_SENSORS_TEMP,        _handle_page_sensors_temp,     &blink_arrow },
-    { DISPLAY_PAGE_SENSORS_TEMP_2,      _handle_page_sensors_temp2,    &blink_arrow },
-    { DISPLAY_PAGE_SENSORS_LIGHT,       _handle_page_sensors_light,    NULL },
-    { DISPLAY_PAGE_SENSORS_FLOW,        _handle_page_sensors_flow,     NULL },
-    { DISPLAY_PAGE_POWER,               _handle_page_power,            NULL },
-    { DISPLAY_PAGE_SWITCHES,            _handle_page_switches,         NULL },
-    { DISPLAY_PAGE_PUMP_STATUS,         _handle_page_pump_status,      NULL },
-    { DISPLAY_PAGE_CP_CONTROL,          _handle_page_cp_control,       NULL },
-    { DISPLAY_PAGE_PP_CONTROL,          _handle_page_pp_control,       NULL },
-    { DISPLAY_PAGE_ALARM,               _handle_page_alarm,            NULL },
-    { DISPLAY_PAGE_WIFI_STATUS,         _handle_page_wifi_status,      NULL },
-    { DISPLAY_PAGE_MQTT_STATUS,         _handle_page_mqtt_status,      NULL },
-    { DISPLAY_PAGE_RESOURCE_STATUS,     _handle_page_resource_status,  NULL },
-    { DISPLAY_PAGE_AVR_STATUS,          _handle_page_avr_status,       NULL },
+    // ID                       handler                        state            dependencies                                  period         scroll
+    { DISPLAY_PAGE_BLANK,               _handle_page_blank,            NULL,            NO_DEPENDENCIES,                              0,             0 },
+    { DISPLAY_PAGE_MAIN,                _handle_page_main,             &main_activity,  DEPENDENCIES(main_dependencies),              PERIOD_BLINK,  0 },
+    { DISPLAY_PAGE_SENSORS_TEMP,        _handle_page_sensors_temp,     &blink_arrow,    DEPENDENCIES(sensors_temp_dependencies),      PERIOD_BLINK,  0 },
+    { DISPLAY_PAGE_SENSORS_TEMP_2,      _handle_page_sensors_temp2,    &blink_arrow,    DEPENDENCIES(sensors_temp_dependencies),      PERIOD_BLINK,  0 },
+    { DISPLAY_PAGE_SENSORS_LIGHT,       _handle_page_sensors_light,    NULL,            DEPENDENCIES(sensors_light_dependencies),     PERIOD_EXPIRY, 0 },
+    { DISPLAY_PAGE_SENSORS_FLOW,        _handle_page_sensors_flow,     NULL,            DEPENDENCIES(sensors_flow_dependencies),      PERIOD_EXPIRY, 0 },
+    { DISPLAY_PAGE_POWER,               _handle_page_power,            NULL,            DEPENDENCIES(power_dependencies),             PERIOD_EXPIRY, 0 },
+    { DISPLAY_PAGE_SWITCHES,            _handle_page_switches,         NULL,            DEPENDENCIES(switches_dependencies),          0,             0 },
+    { DISPLAY_PAGE_PUMP_STATUS,         _handle_page_pump_status,      NULL,            DEPENDENCIES(pump_status_dependencies),       PERIOD_CLOCK,  0 },
+    { DISPLAY_PAGE_CP_CONTROL,          _handle_page_cp_control,       NULL,            DEPENDENCIES(cp_control_dependencies),        0,             0 },
+    { DISPLAY_PAGE_PP_CONTROL,          _handle_page_pp_control,       NULL,            DEPENDENCIES(pp_control_dependencies),        PERIOD_CLOCK,  0 },
+    { DISPLAY_PAGE_ALARM,               _handle_page_alarm,            NULL,            NO_DEPENDENCIES,                              0,             0 },
+    { DISPLAY_PAGE_WIFI_STATUS,         _handle_page_wifi_status,      NULL,            DEPENDENCIES(wifi_status_dependencies),       PERIOD_CLOCK,  0 },
+    { DISPLAY_PAGE_MQTT_STATUS,         _handle_page_mqtt_status,      NULL,            DEPENDENCIES(mqtt_status_dependencies),       PERIOD_CLOCK,  0 },
+    { DISPLAY_PAGE_RESOURCE_STATUS,     _handle_page_resource_status,  NULL,            NO_DEPENDENCIES,                              PERIOD_EXPIRY, 0 },
+    { DISPLAY_PAGE_AVR_STATUS,          _handle_page_avr_status,       NULL,            DEPENDENCIES(avr_status_dependencies),        PERIOD_CLOCK,  0 },
+    { DISPLAY_PAGE_I2C_STATUS,          _handle_page_i2c_status,       NULL,            DEPENDENCIES(i2c_status_dependencies),        0,             0 },
+    { DISPLAY_PAGE_LOG,                 _handle_page_log,              NULL,            DEPENDENCIES(log_dependencies),               0,             SCROLL_STEP },
 };
 
 // page transition table
@@ -139,7 +275,7 @@ typedef struct
 static const transition_t transitions[] = {
     // ID                       counter-clockwise      clockwise               short                  long
     { DISPLAY_PAGE_BLANK,               DISPLAY_PAGE_MAIN,             DISPLAY_PAGE_MAIN,              DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
-    { DISPLAY_PAGE_MAIN,                DISPLAY_PAGE_AVR_STATUS,       DISPLAY_PAGE_SENSORS_TEMP,      DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
+    { DISPLAY_PAGE_MAIN,                DISPLAY_PAGE_LOG,              DISPLAY_PAGE_SENSORS_TEMP,      DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
     { DISPLAY_PAGE_SENSORS_TEMP,        DISPLAY_PAGE_MAIN,             DISPLAY_PAGE_SENSORS_LIGHT,     DISPLAY_PAGE_SENSORS_TEMP_2,   DISPLAY_PAGE_IGNORE },
     { DISPLAY_PAGE_SENSORS_TEMP_2,      DISPLAY_PAGE_MAIN,             DISPLAY_PAGE_SENSORS_LIGHT,     DISPLAY_PAGE_SENSORS_TEMP,     DISPLAY_PAGE_IGNORE },
     { DISPLAY_PAGE_SENSORS_LIGHT,       DISPLAY_PAGE_SENSORS_TEMP,     DISPLAY_PAGE_SENSORS_FLOW,      DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
@@ -153,7 +289,9 @@ static const transition_t transitions[] = {
     { DISPLAY_PAGE_WIFI_STATUS,         DISPLAY_PAGE_ALARM,            DISPLAY_PAGE_MQTT_STATUS,       DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
     { DISPLAY_PAGE_MQTT_STATUS,         DISPLAY_PAGE_WIFI_STATUS,      DISPLAY_PAGE_RESOURCE_STATUS,   DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
     { DISPLAY_PAGE_RESOURCE_STATUS,     DISPLAY_PAGE_MQTT_STATUS,      DISPLAY_PAGE_AVR_STATUS,        DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
-    { DISPLAY_PAGE_AVR_STATUS,          DISPLAY_PAGE_RESOURCE_STATUS,  DISPLAY_PAGE_MAIN,              DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
+    { DISPLAY_PAGE_AVR_STATUS,          DISPLAY_PAGE_RESOURCE_STATUS,  DISPLAY_PAGE_I2C_STATUS,        DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
+    { DISPLAY_PAGE_I2C_STATUS,          DISPLAY_PAGE_AVR_STATUS,       DISPLAY_PAGE_LOG,               DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
+    { DISPLAY_PAGE_LOG,                 DISPLAY_PAGE_I2C_STATUS,       DISPLAY_PAGE_MAIN,              DISPLAY_PAGE_IGNORE,           DISPLAY_PAGE_IGNORE },
 };
 
 static const char * BLANK_LINE = "                    ";
@@ -200,9 +338,59 @@ static const uint8_t delta[8]  = { 0b00000,
                                    0b00000 };
 #define DELTA "\xb"
 
+// CGRAM slots 4-7 hold glyphs drawn at run time, such as sparklines, see glyph.h
+#define GLYPH_FIRST_SLOT   4
+
+static glyph_cache_t _glyphs;
+
+// Sparklines of trend samples, with the least vertical range shown for each quantity
+#define SPARK_SAMPLES_PER_CELL  GLYPH_SPARK_SAMPLES_PER_CELL
+#define SPARK_CELLS             4
+#define SPARK_SPAN_TEMP         (0.5f)    // degrees C
+#define SPARK_SPAN_FLOW         (1.0f)    // LPM
+#define SPARK_SPAN_POWER        (100.0f)  // W
+
+// Shadow of the visible LCD contents. The renderer compares each new page against it and
+// sends only the cells that differ. SHADOW_UNKNOWN never appears in a padded page row, so an
+// invalidated cell is always rewritten.
+#define SHADOW_UNKNOWN     '\0'
+#define SHADOW_MAX_GAP     1      // rewrite unchanged gaps up to this long instead of moving the cursor
+
+// Command and data bytes sent to the LCD controller, and page handler invocations and time, are
+// counted here and added to their resources every STATS_PERIOD, rather than on every render
+#define STATS_PERIOD       (60 * 1000)   // milliseconds
+
+static char _shadow[LCD_NUM_ROWS][LCD_NUM_VISIBLE_COLUMNS];
+static uint32_t _lcd_bytes = 0;                              // since last published
+static uint32_t _handler_count[DISPLAY_PAGE_LAST] = { 0 };   // since last published
+static uint32_t _handler_time[DISPLAY_PAGE_LAST] = { 0 };    // microseconds, since last published
+
+// Display shift applied with LCD_BURST_SHIFT_LEFT, in columns. The shadow mirrors DDRAM, so it is
+// unaffected by the shift - rows 0 and 2 hold DDRAM line 1, rows 1 and 3 hold line 2.
+static int _shift = 0;
+
+// One bit per page, set from datastore callbacks (on the setting task) and cleared by the display task
+static uint32_t _dirty_pages = 0;
+static portMUX_TYPE _dirty_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void _invalidate_shadow(void)
+{
+    memset(_shadow, SHADOW_UNKNOWN, sizeof(_shadow));
+
+    // whatever page is showing must be redrawn
+    portENTER_CRITICAL(&_dirty_mux);
+    _dirty_pages = ~0;
+    portEXIT_CRITICAL(&_dirty_mux);
+}
+
 static esp_err_t _display_reset(const i2c_lcd1602_info_t * lcd_info)
 {
     ESP_LOGI(TAG, "display reset");
+
+    // reset clears the display, and is also used to recover from I2C errors part-way through a write
+    _invalidate_shadow();
+    _shift = 0;
+    glyph_cache_undefine(&_glyphs);
     esp_err_t err = i2c_lcd1602_reset(lcd_info);
     // Define custom characters
     if (err == ESP_OK)
@@ -228,11 +416,13 @@ static esp_err_t _display_reset(const i2c_lcd1602_info_t * lcd_info)
     return err;
 }
 
-// display wrappers to reset and reinitialise display on any I2C error
+// display wrappers to reset and reinitialise display on any I2C error,
+// accounted as one transaction including any retries
 static esp_err_t _clear(const i2c_lcd1602_info_t * lcd_info)
 {
     esp_err_t err = ESP_FAIL;
     int count = 0;
+    uint64_t start = microseconds_since_boot();
     while (count < 10 && (err = i2c_lcd1602_clear(lcd_info)) != ESP_OK)
     {
         ++count;
@@ -240,13 +430,17 @@ static esp_err_t _clear(const i2c_lcd1602_info_t * lcd_info)
         _display_reset(lcd_info);
         ESP_LOGW(TAG, "retry _clear %d", count);
     }
-    return err;
+    _lcd_bytes += 1;
+    _invalidate_shadow();
+    _shift = 0;
+    return i2c_master_record(lcd_info->smbus_info, err, start, count);
 }
 
 static esp_err_t _move_cursor(const i2c_lcd1602_info_t * lcd_info, uint8_t col, uint8_t row)
 {
     esp_err_t err = ESP_FAIL;
     int count = 0;
+    uint64_t start = microseconds_since_boot();
     while (count < 10 && (err = i2c_lcd1602_move_cursor(lcd_info, col, row)) != ESP_OK)
     {
         ++count;
@@ -254,19 +448,114 @@ static esp_err_t _move_cursor(const i2c_lcd1602_info_t * lcd_info, uint8_t col,
         _display_reset(lcd_info);
         ESP_LOGW(TAG, "retry _move_cursor %d", count);
     }
-    return err;
+    _lcd_bytes += 1;
+    return i2c_master_record(lcd_info->smbus_info, err, start, count);
+}
+
+static esp_err_t _home(const i2c_lcd1602_info_t * lcd_info)
+{
+    esp_err_t err = ESP_FAIL;
+    int count = 0;
+    uint64_t start = microseconds_since_boot();
+    while (count < 10 && (err = i2c_lcd1602_home(lcd_info)) != ESP_OK)
+    {
+        ++count;
+        vTaskDelay(10 / portTICK_RATE_MS);
+        _display_reset(lcd_info);
+        ESP_LOGW(TAG, "retry _home %d", count);
+    }
+    _lcd_bytes += 1;
+    _shift = 0;
+    return i2c_master_record(lcd_info->smbus_info, err, start, count);
 }
 
-static esp_err_t _write_string(const i2c_lcd1602_info_t * lcd_info, const char * string)
+// Load a bitmap into a CGRAM slot
+static esp_err_t _define_char(const i2c_lcd1602_info_t * lcd_info, i2c_lcd1602_custom_index_t index, const uint8_t bitmap[])
 {
     esp_err_t err = ESP_FAIL;
     int count = 0;
-    while (count < 10 && (err = i2c_lcd1602_write_string(lcd_info, string)) != ESP_OK)
+    uint64_t start = microseconds_since_boot();
+    while (count < 10 && (err = i2c_lcd1602_define_char(lcd_info, index, bitmap)) != ESP_OK)
     {
         ++count;
         vTaskDelay(10 / portTICK_RATE_MS);
         _display_reset(lcd_info);
-        ESP_LOGW(TAG, "retry _write_string %d", count);
+        ESP_LOGW(TAG, "retry _define_char %d", count);
+    }
+    _lcd_bytes += 1 + GLYPH_HEIGHT;
+    return i2c_master_record(lcd_info->smbus_info, err, start, count);
+}
+
+// Load any glyph slots that have changed since they were last sent. The bus must already be
+// locked. Each glyph is a separate chunk, as a slot takes as long to load as a full row.
+static void _define_glyphs(const i2c_master_info_t * i2c_master_info, const i2c_lcd1602_info_t * lcd_info)
+{
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        glyph_slot_t * slot = &_glyphs.slots[i];
+        if (slot->valid && !slot->defined)
+        {
+            i2c_master_yield(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY);
+            if (_define_char(lcd_info, I2C_LCD1602_INDEX_CUSTOM_0 + GLYPH_FIRST_SLOT + i, slot->bitmap) == ESP_OK)
+            {
+                slot->defined = true;
+            }
+        }
+    }
+}
+
+// Render the trend of one series as a sparkline ending with the most recent sample
+static void _render_trend(char * out, trend_series_t series, size_t num_cells, float min_span)
+{
+    float samples[SPARK_CELLS * SPARK_SAMPLES_PER_CELL];
+    assert(num_cells <= SPARK_CELLS);
+    trend_get(series, samples, num_cells * SPARK_SAMPLES_PER_CELL);
+    glyph_sparkline(&_glyphs, out, samples, num_cells, min_span);
+}
+
+// Send port writes as one I2C transaction, with the same retry and reset policy as the wrappers above
+static esp_err_t _send_burst(const i2c_master_info_t * i2c_master_info, const i2c_lcd1602_info_t * lcd_info, uint8_t * burst, size_t len)
+{
+    esp_err_t err = ESP_FAIL;
+    int count = 0;
+    uint64_t start = microseconds_since_boot();
+    i2c_cmd_handle_t cmd = i2c_master_build_write(CONFIG_LCD1602_I2C_ADDRESS, burst, len);
+    while (count < 10 && (err = i2c_master_run(i2c_master_info, cmd, SMBUS_TIMEOUT / portTICK_RATE_MS)) != ESP_OK)
+    {
+        ++count;
+        vTaskDelay(10 / portTICK_RATE_MS);
+        _display_reset(lcd_info);
+        ESP_LOGW(TAG, "retry _send_burst %d", count);
+    }
+    i2c_cmd_link_delete(cmd);
+    return i2c_master_record(lcd_info->smbus_info, err, start, count);
+}
+
+/*
+ * Write a run of characters starting at (col, row) as a single I2C transaction: the cursor move
+ * followed by the characters. i2c_lcd1602_write_string() uses three transactions per nibble,
+ * each with its own START, address and STOP. Including the move makes a retry after a display
+ * reset idempotent. The bus must already be locked.
+ */
+static esp_err_t _write_run(const i2c_master_info_t * i2c_master_info, const i2c_lcd1602_info_t * lcd_info,
+                            uint8_t col, uint8_t row, const char * string)
+{
+    uint8_t burst[(ROW_STRING_WIDTH + 1) * LCD_BURST_PORT_WRITES_PER_BYTE];
+    size_t len = lcd_burst_run(burst, sizeof(burst), col, row, string, lcd_info->backlight_flag);
+    _lcd_bytes += len / LCD_BURST_PORT_WRITES_PER_BYTE;
+    return _send_burst(i2c_master_info, lcd_info, burst, len);
+}
+
+// Shift the whole display one column left - a single command, whatever the page contents
+static esp_err_t _shift_left(const i2c_master_info_t * i2c_master_info, const i2c_lcd1602_info_t * lcd_info)
+{
+    uint8_t burst[LCD_BURST_PORT_WRITES_PER_BYTE];
+    size_t len = lcd_burst_append(burst, 0, LCD_BURST_SHIFT_LEFT, lcd_info->backlight_flag);
+    _lcd_bytes += 1;
+    esp_err_t err = _send_burst(i2c_master_info, lcd_info, burst, len);
+    if (err == ESP_OK)
+    {
+        _shift = (_shift + 1) % LCD_NUM_COLUMNS;
     }
     return err;
 }
@@ -343,13 +632,16 @@ static void _render_temp_line(char * line, unsigned int len, datastore_instance_
 
     _get_temp_sensor(datastore, instance, &value, label, sizeof(label), &age, datastore);
 
+    char spark[2] = "";
+    _render_trend(spark, TREND_SERIES_TEMP + instance, 1, SPARK_SPAN_TEMP);
+
     if (age < sensor_temp_expiry(datastore))
     {
-        snprintf(line, ROW_STRING_WIDTH, "T%d %-10s %4.1f"DEGREES_C, instance + 1, label, value);
+        snprintf(line, ROW_STRING_WIDTH, "T%d %-9s%s %4.1f"DEGREES_C, instance + 1, label, spark, value);
     }
     else
     {
-        snprintf(line, ROW_STRING_WIDTH, "T%d %-10s --.-  "DEGREES_C, instance + 1, label);
+        snprintf(line, ROW_STRING_WIDTH, "T%d %-9s%s --.-  "DEGREES_C, instance + 1, label, spark);
     }
 }
 
@@ -444,11 +736,18 @@ static void _handle_page_sensors_flow(page_buffer_t * page_buffer, void * state,
         snprintf(page_buffer->row[0], ROW_STRING_WIDTH, "Flow Rate  ---.- LPM");
         snprintf(page_buffer->row[1], ROW_STRING_WIDTH, "           ---.- Hz");
     }
+
+    char spark[SPARK_CELLS + 1] = "";
+    _render_trend(spark, TREND_SERIES_FLOW_RATE, SPARK_CELLS, SPARK_SPAN_FLOW);
+    snprintf(page_buffer->row[3], ROW_STRING_WIDTH, "Trend %2d min    %s",
+             (int)(SPARK_CELLS * SPARK_SAMPLES_PER_CELL * TREND_SAMPLING_PERIOD / 60), spark);
 }
 
 static void _handle_page_power(page_buffer_t * page_buffer, void * state, const datastore_t * datastore)
 {
-    snprintf(page_buffer->row[0], ROW_STRING_WIDTH, "Power Calculation");
+    char spark[SPARK_CELLS + 1] = "";
+    _render_trend(spark, TREND_SERIES_POWER, SPARK_CELLS, SPARK_SPAN_POWER);
+    snprintf(page_buffer->row[0], ROW_STRING_WIDTH, "Power Calc.     %s", spark);
 
     float delta = 0;
     datastore_get_float(datastore, RESOURCE_ID_POWER_TEMP_DELTA, 0, &delta);
@@ -576,15 +875,6 @@ static void _handle_page_cp_control(page_buffer_t * page_buffer, void * state, c
     snprintf(page_buffer->row[3], ROW_STRING_WIDTH, DELTA"T  %4.1f"DEGREES_C " "DELTA"Th  %4.1f"DEGREES_C , diff, -margin);
 }
 
-// TODO: refactor into a Time module
-static void _get_local_time(time_t * now_time, struct tm * timeinfo)
-{
-    assert(now_time != NULL);
-    assert(timeinfo != NULL);
-    time(now_time);
-    localtime_r(now_time, timeinfo);
-}
-
 static void _handle_page_pp_control(page_buffer_t * page_buffer, void * state, const datastore_t * datastore)
 {
     control_pp_state_t pp_state = CONTROL_PP_STATE_OFF;
@@ -628,32 +918,34 @@ static void _handle_page_pp_control(page_buffer_t * page_buffer, void * state, c
         snprintf(page_buffer->row[2], ROW_STRING_WIDTH, "Flow ----   Min %4.1f", flow_threshold);
     }
 
-    // borrowed this code from control.c but modified to show remaining seconds (not just minutes)
+    // the next purge time is computed by the control task, so only the countdown is calculated here
     bool system_time_set = false;
     datastore_get_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, &system_time_set);
     if (system_time_set)
     {
-        bool daily_enable = false;
-        int32_t daily_hour = -1;
-        int32_t daily_minute = -1;
-        datastore_get_bool(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, &daily_enable);
-        datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, 0, &daily_hour);
-        datastore_get_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0, &daily_minute);
-
-        if (daily_enable && daily_hour >= 0 && daily_minute >= 0)
+        uint32_t daily_next = 0;
+        datastore_get_uint32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_NEXT, 0, &daily_next);
+
+        if (daily_next != 0)
         {
-            time_t now;
+            time_t now = time(NULL);
+            time_t next = daily_next;
             struct tm timeinfo;
-            _get_local_time(&now, &timeinfo);
+            localtime_r(&next, &timeinfo);
 
-            int now_seconds = timeinfo.tm_hour * 60 * 60 + timeinfo.tm_min * 60 + timeinfo.tm_sec;
-            int set_seconds = daily_hour * 60 * 60 + daily_minute * 60;
-            int rem_seconds = now_seconds - 1 < set_seconds ? set_seconds - now_seconds : 24 * 60 * 60 - now_seconds + set_seconds;
+            int rem_seconds = next > now ? next - now : 0;
             int hours_remaining = rem_seconds / 60 / 60;  // floor
             int minutes_remaining = (rem_seconds - (hours_remaining * 60 * 60)) / 60;
             int seconds_remaining = rem_seconds - (hours_remaining * 60 * 60) - (minutes_remaining * 60);
+            if (hours_remaining > 99)
+            {
+                // more than four days away - don't overflow the row
+                hours_remaining = 99;
+                minutes_remaining = 59;
+                seconds_remaining = 59;
+            }
             snprintf(page_buffer->row[3], ROW_STRING_WIDTH, "%02d:%02d:00  T-%02d:%02d:%02d",
-                     daily_hour, daily_minute, hours_remaining, minutes_remaining, seconds_remaining);
+                     timeinfo.tm_hour, timeinfo.tm_min, hours_remaining, minutes_remaining, seconds_remaining);
         }
         else
         {
@@ -820,6 +1112,77 @@ static void _handle_page_avr_status(page_buffer_t * page_buffer, void * state, c
     }
 }
 
+static void _handle_page_i2c_status(page_buffer_t * page_buffer, void * state, const datastore_t * datastore)
+{
+    // one row per device: address, transactions, errors (NACK + timeout + other), max latency in us
+    snprintf(page_buffer->row[0], ROW_STRING_WIDTH, "I2C     txn err  max");
+    for (int i = 0; i < I2C_MASTER_MAX_DEVICES && i < LCD_NUM_ROWS - 1; ++i)
+    {
+        uint8_t address = 0;
+        uint32_t transactions = 0, nacks = 0, timeouts = 0, errors = 0, latency_max = 0;
+        datastore_get_uint8(datastore, RESOURCE_ID_I2C_DEVICE_ADDRESS, i, &address);
+        datastore_get_uint32(datastore, RESOURCE_ID_I2C_DEVICE_TRANSACTIONS, i, &transactions);
+        datastore_get_uint32(datastore, RESOURCE_ID_I2C_DEVICE_NACKS, i, &nacks);
+        datastore_get_uint32(datastore, RESOURCE_ID_I2C_DEVICE_TIMEOUTS, i, &timeouts);
+        datastore_get_uint32(datastore, RESOURCE_ID_I2C_DEVICE_ERRORS, i, &errors);
+        datastore_get_uint32(datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_MAX, i, &latency_max);
+
+        if (address)
+        {
+            snprintf(page_buffer->row[i + 1], ROW_STRING_WIDTH, "%02X %7u %3u %5u", address,
+                     transactions % 10000000, (nacks + timeouts + errors) % 1000, latency_max > 99999 ? 99999 : latency_max);
+        }
+        else
+        {
+            snprintf(page_buffer->row[i + 1], ROW_STRING_WIDTH, BLANK_LINE);
+        }
+    }
+}
+
+/*
+ * Wide pages use the full 40-character DDRAM lines: line 0 is shown on rows 0 and 2, and line 1
+ * on rows 1 and 3. Text longer than one row requests scrolling, and the display shift then
+ * carries each line through its two rows as a marquee. The text is limited to leave a gap
+ * between its end and its start.
+ */
+static void _set_wide_line(page_buffer_t * page_buffer, int line, const char * text)
+{
+    assert(line >= 0 && line < LCD_NUM_ROWS / 2);
+    char wide[LCD_NUM_COLUMNS + 1] = "";
+    snprintf(wide, sizeof(wide), "%-*.*s", LCD_NUM_COLUMNS, LCD_NUM_COLUMNS - 2, text);
+    snprintf(page_buffer->row[line], ROW_STRING_WIDTH, "%.*s", DISPLAY_WIDTH, wide);
+    snprintf(page_buffer->row[line + 2], ROW_STRING_WIDTH, "%s", &wide[DISPLAY_WIDTH]);
+    if (strlen(text) > DISPLAY_WIDTH)
+    {
+        page_buffer->scroll = true;
+    }
+}
+
+static void _handle_page_log(page_buffer_t * page_buffer, void * state, const datastore_t * datastore)
+{
+    char log[SYSTEM_LEN_LOG] = "";
+    datastore_get_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, log, sizeof(log));
+    _set_wide_line(page_buffer, 0, log[0] ? log : "No log");
+
+    char ssid[WIFI_LEN_SSID] = "";
+    uint32_t ip_address = 0;
+    char broker_address[MQTT_LEN_BROKER_ADDRESS] = "";
+    uint32_t broker_port = 0;
+    datastore_get_string(datastore, RESOURCE_ID_WIFI_SSID, 0, ssid, sizeof(ssid));
+    datastore_get_uint32(datastore, RESOURCE_ID_WIFI_ADDRESS, 0, &ip_address);
+    datastore_get_string(datastore, RESOURCE_ID_MQTT_BROKER_ADDRESS, 0, broker_address, sizeof(broker_address));
+    datastore_get_uint32(datastore, RESOURCE_ID_MQTT_BROKER_PORT, 0, &broker_port);
+
+    char network[LCD_NUM_COLUMNS + 1] = "";
+    snprintf(network, sizeof(network), "%s %d.%d.%d.%d %s:%d", ssid,
+             (ip_address & 0xff),
+             (ip_address & 0xff00) >> 8,
+             (ip_address & 0xff0000) >> 16,
+             (ip_address & 0xff000000) >> 24,
+             broker_address, broker_port);
+    _set_wide_line(page_buffer, 1, network);
+}
+
 static void dispatch_to_handler(page_buffer_t * buffer, display_page_id_t current_page, const datastore_t * datastore)
 {
     assert(sizeof(page_specs) / sizeof(page_specs[0]) == DISPLAY_PAGE_LAST);
@@ -830,7 +1193,10 @@ static void dispatch_to_handler(page_buffer_t * buffer, display_page_id_t curren
         {
             if (page_specs[current_page].handler)
             {
+                uint64_t start = microseconds_since_boot();
                 page_specs[current_page].handler(buffer, page_specs[current_page].state, datastore);
+                _handler_count[current_page] += 1;
+                _handler_time[current_page] += microseconds_since_boot() - start;
             }
             else
             {
@@ -851,6 +1217,44 @@ static void dispatch_to_handler(page_buffer_t * buffer, display_page_id_t curren
     }
 }
 
+static void _dependency_changed(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * context)
+{
+    display_page_id_t page = (display_page_id_t)(intptr_t)context;
+    portENTER_CRITICAL(&_dirty_mux);
+    _dirty_pages |= 1 << page;
+    portEXIT_CRITICAL(&_dirty_mux);
+}
+
+static void _add_dependency_callbacks(const datastore_t * datastore)
+{
+    assert(DISPLAY_PAGE_LAST <= 32);
+    for (display_page_id_t page = 0; page < DISPLAY_PAGE_LAST; ++page)
+    {
+        for (size_t i = 0; i < page_specs[page].num_dependencies; ++i)
+        {
+            const page_dependency_t * dependency = &page_specs[page].dependencies[i];
+            for (datastore_instance_id_t instance = 0; instance < dependency->num_instances; ++instance)
+            {
+                datastore_status_t status = datastore_add_set_callback(datastore, dependency->id, instance, _dependency_changed, (void *)(intptr_t)page);
+                if (status != DATASTORE_STATUS_OK)
+                {
+                    ESP_LOGE(TAG, "datastore_add_set_callback for resource %d failed: %d", dependency->id, status);
+                }
+            }
+        }
+    }
+}
+
+// Returns true if a dependency of the page has been set since the last call
+static bool _take_dirty(display_page_id_t page)
+{
+    portENTER_CRITICAL(&_dirty_mux);
+    bool dirty = _dirty_pages & (1 << page);
+    _dirty_pages &= ~(1 << page);
+    portEXIT_CRITICAL(&_dirty_mux);
+    return dirty;
+}
+
 static display_page_id_t _handle_transition(int input, display_page_id_t current_page)
 {
     display_page_id_t new_page = DISPLAY_PAGE_BLANK;
@@ -892,6 +1296,37 @@ static void _dump_datastore(const datastore_t * datastore)
     xTaskCreate(&dump_datastore_task, "dump_datastore_task", 4096, (void *)datastore, tskIDLE_PRIORITY, NULL);
 }
 
+static void _log_hex(const char * name, int index, const uint8_t * data, size_t len)
+{
+    char hex[LCD_NUM_VISIBLE_COLUMNS * 2 + 1] = "";
+    for (size_t i = 0; i < len && i < LCD_NUM_VISIBLE_COLUMNS; ++i)
+    {
+        snprintf(&hex[i * 2], 3, "%02x", data[i]);
+    }
+    ESP_LOGI(TAG, "lcd %s %d %s", name, index, hex);
+}
+
+// Log the LCD contents as held in the shadow, and the CGRAM bitmaps, as hex
+static void _log_snapshot(void)
+{
+    for (int i = 0; i < LCD_NUM_ROWS; ++i)
+    {
+        _log_hex("row", i, (const uint8_t *)_shadow[i], LCD_NUM_VISIBLE_COLUMNS);
+    }
+    const uint8_t * fixed[GLYPH_FIRST_SLOT] = { degrees_C, arrow_down, arrow_up, delta };
+    for (int i = 0; i < GLYPH_FIRST_SLOT; ++i)
+    {
+        _log_hex("cgram", i, fixed[i], GLYPH_HEIGHT);
+    }
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        if (_glyphs.slots[i].valid)
+        {
+            _log_hex("cgram", GLYPH_FIRST_SLOT + i, _glyphs.slots[i].bitmap, GLYPH_HEIGHT);
+        }
+    }
+}
+
 static void _extend_page_buffer_rows(page_buffer_t * buffer)
 {
     for (int i = 0; i < LCD_NUM_ROWS; ++i)
@@ -905,18 +1340,85 @@ static void _extend_page_buffer_rows(page_buffer_t * buffer)
     }
 }
 
-static void _render_page_buffer(i2c_master_info_t * i2c_master_info, i2c_lcd1602_info_t * lcd_info, page_buffer_t * buffer)
+/*
+ * Write the cells of one row that differ from the shadow. Each run of changed cells is one I2C
+ * transaction containing a cursor move plus its characters, so runs separated by no more than
+ * SHADOW_MAX_GAP unchanged cells are merged.
+ */
+static void _render_row(const i2c_master_info_t * i2c_master_info, i2c_lcd1602_info_t * lcd_info, int row, const char * line)
+{
+    int col = 0;
+    while (col < LCD_NUM_VISIBLE_COLUMNS)
+    {
+        if (line[col] == _shadow[row][col])
+        {
+            ++col;
+            continue;
+        }
+
+        // extend the run over any changed cells, and over short unchanged gaps
+        int end = col + 1;
+        int last_changed = col;
+        while (end < LCD_NUM_VISIBLE_COLUMNS && end - last_changed <= SHADOW_MAX_GAP + 1)
+        {
+            if (line[end] != _shadow[row][end])
+            {
+                last_changed = end;
+            }
+            ++end;
+        }
+        end = last_changed + 1;
+
+        char run[ROW_STRING_WIDTH] = "";
+        memcpy(run, &line[col], end - col);
+        run[end - col] = '\0';
+
+        if (_write_run(i2c_master_info, lcd_info, col, row, run) == ESP_OK)
+        {
+            memcpy(&_shadow[row][col], run, end - col);
+        }
+        col = last_changed + 1;
+    }
+}
+
+/*
+ * Write the page to the LCD, one row at a time. The render is abandoned between rows if user
+ * input arrives, as the page is about to be replaced - returns false in that case. Rows already
+ * written are recorded in the shadow, so nothing is lost if the same page is rendered again.
+ */
+static bool _render_page_buffer(i2c_master_info_t * i2c_master_info, i2c_lcd1602_info_t * lcd_info, page_buffer_t * buffer,
+                                QueueHandle_t input_queue)
 {
     assert(i2c_master_info);
     assert(lcd_info);
     assert(buffer);
-    i2c_master_lock(i2c_master_info, portMAX_DELAY);
+    bool completed = true;
+    i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
+
+    // a previous page may have left the display shifted
+    if (!buffer->scroll && _shift != 0)
+    {
+        I2C_LCD1602_ERROR_CHECK(_home(lcd_info));
+    }
+
+    // glyphs change in place, so load them before the rows that show them
+    _define_glyphs(i2c_master_info, lcd_info);
+
     for (int i = 0; i < LCD_NUM_ROWS; ++i)
     {
-        I2C_LCD1602_ERROR_CHECK(_move_cursor(lcd_info, 0, i));
-        I2C_LCD1602_ERROR_CHECK(_write_string(lcd_info, buffer->row[i]));
+        if (uxQueueMessagesWaiting(input_queue) > 0)
+        {
+            ESP_LOGD(TAG, "render aborted at row %d", i);
+            completed = false;
+            break;
+        }
+
+        // let pump control and sensors in between rows and after the glyph loads
+        i2c_master_yield(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY);
+        _render_row(i2c_master_info, lcd_info, i, buffer->row[i]);
     }
     i2c_master_unlock(i2c_master_info);
+    return completed;
 }
 
 static void display_task(void * pvParameter)
@@ -931,7 +1433,7 @@ static void display_task(void * pvParameter)
     QueueHandle_t input_queue = task_inputs->input_queue;
 
     // before accessing I2C, use a lock to gain exclusive use of the bus
-    i2c_master_lock(i2c_master_info, portMAX_DELAY);
+    i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
 
     // Set up the SMBus
     smbus_info_t * smbus_info = smbus_malloc();
@@ -942,11 +1444,13 @@ static void display_task(void * pvParameter)
     i2c_lcd1602_info_t * lcd_info = i2c_lcd1602_malloc();
     ESP_ERROR_CHECK(i2c_lcd1602_init(lcd_info, smbus_info, true,
             LCD_NUM_ROWS, LCD_NUM_COLUMNS, LCD_NUM_VISIBLE_COLUMNS));
+    glyph_cache_init(&_glyphs, I2C_LCD1602_CHARACTER_CUSTOM_0 + GLYPH_FIRST_SLOT);
     ESP_ERROR_CHECK(_display_reset(lcd_info));
 
     // Move to home position
     I2C_LCD1602_ERROR_CHECK(_move_cursor(lcd_info, 0, 0));
     i2c_lcd1602_write_char(lcd_info, 'B');
+    _shadow[0][0] = 'B';
 
     i2c_master_unlock(i2c_master_info);
 
@@ -961,51 +1465,156 @@ static void display_task(void * pvParameter)
     // backlight age
     uint32_t backlight_timestamp = seconds_since_boot();
 
-    // update pages once per second
+    _add_dependency_callbacks(datastore);
+
+    // Render the current page when its inputs change, when its period elapses, or after user input.
+    // Dependency changes are picked up within TICKS_PER_UPDATE.
+    bool render = true;
+    TickType_t last_render_time = 0;
+    TickType_t last_scroll_time = 0;
+    TickType_t last_publish_time = xTaskGetTickCount();
+    uint64_t input_time = 0;   // first input not yet shown on the LCD
     while (1)
     {
         ESP_LOGD(TAG, "display loop");
 
-        for (int i = 0; i < LCD_NUM_ROWS; ++i)
+        TickType_t period = page_specs[current_page].period / portTICK_RATE_MS;
+        TickType_t elapsed = xTaskGetTickCount() - last_render_time;
+        render |= _take_dirty(current_page);
+        render |= period > 0 && elapsed >= period;
+
+        if (render)
         {
-            buffer.row[i][0] = '\0';
+            for (int i = 0; i < LCD_NUM_ROWS; ++i)
+            {
+                buffer.row[i][0] = '\0';
+            }
+            buffer.scroll = false;
+
+            // glyphs allocated by the previous render may now be replaced
+            glyph_cache_next_render(&_glyphs);
+            dispatch_to_handler(&buffer, current_page, datastore);
+            _extend_page_buffer_rows(&buffer);
+            // an aborted render is retried once the new input has been handled
+            render = !_render_page_buffer(i2c_master_info, lcd_info, &buffer, input_queue);
+            last_render_time = xTaskGetTickCount();
+            elapsed = 0;
+
+            if (!render && input_time != 0)
+            {
+                datastore_set_uint32(datastore, RESOURCE_ID_DISPLAY_INPUT_LATENCY, 0, microseconds_since_boot() - input_time);
+                input_time = 0;
+            }
         }
 
-        dispatch_to_handler(&buffer, current_page, datastore);
-        _extend_page_buffer_rows(&buffer);
-        _render_page_buffer(i2c_master_info, lcd_info, &buffer);
+        TickType_t timeout = TICKS_PER_UPDATE;
+        if (period > 0 && period - elapsed < timeout)
+        {
+            timeout = period - elapsed;
+        }
+
+        // scrolling pages step the hardware shift rather than re-sending their rows
+        TickType_t scroll = buffer.scroll ? page_specs[current_page].scroll / portTICK_RATE_MS : 0;
+        if (scroll > 0 && !render)
+        {
+            TickType_t since_scroll = xTaskGetTickCount() - last_scroll_time;
+            if (since_scroll >= scroll)
+            {
+                i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
+                I2C_LCD1602_ERROR_CHECK(_shift_left(i2c_master_info, lcd_info));
+                i2c_master_unlock(i2c_master_info);
+                last_scroll_time = xTaskGetTickCount();
+                since_scroll = 0;
+            }
+            if (scroll - since_scroll < timeout)
+            {
+                timeout = scroll - since_scroll;
+            }
+        }
+
+        // the loop runs at least every TICKS_PER_UPDATE, which is ample for this period
+        if (xTaskGetTickCount() - last_publish_time >= STATS_PERIOD / portTICK_RATE_MS)
+        {
+            datastore_add(datastore, RESOURCE_ID_DISPLAY_LCD_BYTES, 0, _lcd_bytes);
+            _lcd_bytes = 0;
+            for (display_page_id_t page = 0; page < DISPLAY_PAGE_LAST; ++page)
+            {
+                // only the pages shown since the last publish
+                if (_handler_count[page] > 0)
+                {
+                    datastore_add(datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT, page, _handler_count[page]);
+                    datastore_add(datastore, RESOURCE_ID_DISPLAY_HANDLER_TIME, page, _handler_time[page]);
+                    _handler_count[page] = 0;
+                    _handler_time[page] = 0;
+                }
+            }
+            last_publish_time = xTaskGetTickCount();
+        }
 
         button_event_t input = 0;
-        BaseType_t rc = xQueueReceive(input_queue, &input, TICKS_PER_UPDATE);
+        BaseType_t rc = xQueueReceive(input_queue, &input, timeout);
         if (rc == pdTRUE)
         {
-            ESP_LOGI(TAG, "from queue: %d", input);
+            render = true;
+
+            if (input_time == 0)
+            {
+                input_time = microseconds_since_boot();
+            }
 
             // turn on backlight
+            i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
             i2c_lcd1602_set_backlight(lcd_info, true);
+            i2c_master_unlock(i2c_master_info);
             backlight_timestamp = seconds_since_boot();
 
-            display_page_id_t new_page = _handle_transition(input, current_page);
-            if (new_page != current_page && new_page >= 0 && new_page < DISPLAY_PAGE_LAST)
+            // apply every queued event before rendering, so a fast knob turn is a single page jump
+            display_page_id_t new_page = current_page;
+            bool through_main = false;
+            do
+            {
+                ESP_LOGI(TAG, "from queue: %d", input);
+                display_page_id_t next_page = _handle_transition(input, new_page);
+                if (next_page >= 0 && next_page < DISPLAY_PAGE_LAST)
+                {
+                    new_page = next_page;
+                    through_main |= new_page == DISPLAY_PAGE_MAIN;
+                }
+
+                // special case - short button press on Main page will dump datastore to console
+                if (new_page == DISPLAY_PAGE_MAIN && input == BUTTON_EVENT_SHORT)
+                {
+                    _dump_datastore(datastore);
+                }
+
+                // special case - long button press on any page logs the LCD contents for host/tools/lcd_render
+                if (input == BUTTON_EVENT_LONG)
+                {
+                    _log_snapshot();
+                }
+            }
+            while (xQueueReceive(input_queue, &input, 0) == pdTRUE);
+
+            if (new_page != current_page)
             {
                 ESP_LOGI(TAG, "change to page %d", new_page);
                 current_page = new_page;
+                _take_dirty(current_page);
                 datastore_set_int32(datastore, RESOURCE_ID_DISPLAY_PAGE, 0, current_page);
 
+                // a scrolling page shows its first frame for a full step
+                last_scroll_time = xTaskGetTickCount();
+
                 // reset the display when going through the Main page
-                if (current_page == DISPLAY_PAGE_MAIN)
+                if (through_main)
                 {
-                    // reset display when changing page
+                    // _clear records its transactions, which may recover the bus - both need the lock
+                    i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
                     _display_reset(lcd_info);
                     I2C_LCD1602_ERROR_CHECK(_clear(lcd_info));
+                    i2c_master_unlock(i2c_master_info);
                 }
             }
-
-            // special case - short button press on Main page will dump datastore to console
-            if (current_page == DISPLAY_PAGE_MAIN && input == BUTTON_EVENT_SHORT)
-            {
-                _dump_datastore(datastore);
-            }
         }
 
         // TODO: reset display every 5 seconds as a precaution
@@ -1015,7 +1624,9 @@ static void display_task(void * pvParameter)
         datastore_get_uint32(datastore, RESOURCE_ID_DISPLAY_BACKLIGHT_TIMEOUT, 0, &backlight_timeout);
         if (backlight_timeout > 0 && ((seconds_since_boot() - backlight_timestamp) > backlight_timeout))
         {
+            i2c_master_lock(i2c_master_info, I2C_MASTER_CLIENT_DISPLAY, portMAX_DELAY);
             i2c_lcd1602_set_backlight(lcd_info, false);
+            i2c_master_unlock(i2c_master_info);
         }
     }
 
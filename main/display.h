@@ -51,6 +51,8 @@ typedef enum
     DISPLAY_PAGE_MQTT_STATUS,
     DISPLAY_PAGE_RESOURCE_STATUS,
     DISPLAY_PAGE_AVR_STATUS,
+    DISPLAY_PAGE_I2C_STATUS,
+    DISPLAY_PAGE_LOG,
     DISPLAY_PAGE_LAST,
 } display_page_id_t;
 
@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+
+#include "fsm.h"
+
+void fsm_init(fsm_t * fsm, uint8_t initial_state, uint32_t now)
+{
+    assert(fsm != NULL);
+    fsm->state = initial_state;
+    fsm->entered = now;
+}
+
+static bool _can_take(const fsm_transition_t * transition, const fsm_t * fsm, const void * ctxt, uint32_t now)
+{
+    if ((transition->from & FSM_STATE(fsm->state)) == 0)
+    {
+        return false;
+    }
+    if (transition->timeout && now - fsm->entered < transition->timeout(ctxt))
+    {
+        return false;
+    }
+    return transition->guard == NULL || transition->guard(ctxt);
+}
+
+uint8_t fsm_step_phase(const fsm_def_t * def, fsm_t * fsm, void * ctxt, uint32_t now, uint8_t phase)
+{
+    assert(def != NULL);
+    assert(fsm != NULL);
+
+    for (size_t i = 0; i < def->num_transitions; ++i)
+    {
+        const fsm_transition_t * transition = &def->transitions[i];
+        if (transition->phase == phase && _can_take(transition, fsm, ctxt, now))
+        {
+            fsm->state = transition->to;
+            fsm->entered = now;
+            if (transition->action)
+            {
+                transition->action(ctxt, transition);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t fsm_step(const fsm_def_t * def, fsm_t * fsm, void * ctxt, uint32_t now)
+{
+    assert(def != NULL);
+    uint8_t count = 0;
+
+    for (uint8_t phase = 0; phase < def->num_phases; ++phase)
+    {
+        count += fsm_step_phase(def, fsm, ctxt, now, phase);
+    }
+    return count;
+}
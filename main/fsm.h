@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file fsm.h
+ * @brief Table-driven finite state machine engine.
+ *
+ * A state machine is declared as a const table of transitions, each with a set of source
+ * states, a destination state, an optional guard, an optional timer and an optional action.
+ * Transitions are grouped into phases that are evaluated in order on each step. Within a
+ * phase, the first transition whose source set contains the current state, whose timer
+ * has expired and whose guard passes is taken, and evaluation continues with the next
+ * phase from the new state. A step therefore takes at most one transition per phase.
+ *
+ * The engine has no dependency on FreeRTOS. Time is supplied by the caller.
+ */
+
+#ifndef FSM_H
+#define FSM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define FSM_STATE(s)  (1u << (s))    ///< source state set containing a single state
+
+typedef struct fsm_transition fsm_transition_t;
+
+/// Return true if the transition may be taken
+typedef bool (*fsm_guard_t)(const void * ctxt);
+
+/// Return the minimum time in seconds that must be spent in the source state
+typedef uint32_t (*fsm_timeout_t)(const void * ctxt);
+
+/// Called after the state has changed
+typedef void (*fsm_action_t)(void * ctxt, const fsm_transition_t * transition);
+
+struct fsm_transition
+{
+    uint32_t from;            ///< set of source states, built with FSM_STATE()
+    uint8_t to;               ///< destination state
+    uint8_t phase;            ///< evaluation phase
+    uint8_t id;               ///< user identifier, passed through to the action
+    fsm_guard_t guard;        ///< NULL if unconditional
+    fsm_timeout_t timeout;    ///< NULL if not timed
+    fsm_action_t action;      ///< NULL if none
+};
+
+typedef struct
+{
+    const fsm_transition_t * transitions;
+    size_t num_transitions;
+    uint8_t num_phases;
+} fsm_def_t;
+
+typedef struct
+{
+    uint8_t state;            ///< current state
+    uint32_t entered;         ///< time at which the current state was entered, in seconds
+} fsm_t;
+
+/**
+ * @brief Initialise a state machine instance.
+ */
+void fsm_init(fsm_t * fsm, uint8_t initial_state, uint32_t now);
+
+/**
+ * @brief Evaluate each phase of the state machine once.
+ * @param[in] def State machine definition.
+ * @param[in,out] fsm State machine instance.
+ * @param[in,out] ctxt Passed to guards, timers and actions.
+ * @param[in] now Current time in seconds.
+ * @return Number of transitions taken.
+ */
+uint8_t fsm_step(const fsm_def_t * def, fsm_t * fsm, void * ctxt, uint32_t now);
+
+/**
+ * @brief Evaluate a single phase of the state machine, for callers that interleave
+ *        their own logic between phases.
+ * @return Number of transitions taken (0 or 1).
+ */
+uint8_t fsm_step_phase(const fsm_def_t * def, fsm_t * fsm, void * ctxt, uint32_t now, uint8_t phase);
+
+#endif // FSM_H
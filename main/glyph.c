@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "glyph.h"
+
+#define TAG "glyph"
+
+void glyph_cache_init(glyph_cache_t * cache, char first_code)
+{
+    assert(cache);
+    memset(cache, 0, sizeof(*cache));
+    cache->generation = 1;
+    cache->first_code = first_code;
+}
+
+void glyph_cache_next_render(glyph_cache_t * cache)
+{
+    ++cache->generation;
+}
+
+void glyph_cache_undefine(glyph_cache_t * cache)
+{
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        cache->slots[i].defined = false;
+    }
+}
+
+char glyph_allocate(glyph_cache_t * cache, const uint8_t bitmap[GLYPH_HEIGHT])
+{
+    glyph_slot_t * victim = NULL;
+    for (int i = 0; i < GLYPH_NUM_SLOTS; ++i)
+    {
+        glyph_slot_t * slot = &cache->slots[i];
+        if (slot->valid && memcmp(slot->bitmap, bitmap, GLYPH_HEIGHT) == 0)
+        {
+            slot->used = cache->generation;
+            return cache->first_code + i;
+        }
+        if (slot->used != cache->generation && (victim == NULL || slot->used < victim->used))
+        {
+            victim = slot;
+        }
+    }
+
+    if (victim == NULL)
+    {
+        ESP_LOGD(TAG, "no free glyph slot");
+        return GLYPH_FALLBACK;
+    }
+
+    memcpy(victim->bitmap, bitmap, GLYPH_HEIGHT);
+    victim->valid = true;
+    victim->defined = false;
+    victim->used = cache->generation;
+    return cache->first_code + (victim - cache->slots);
+}
+
+void glyph_sparkline(glyph_cache_t * cache, char * out, const float * samples, size_t num_cells, float min_span)
+{
+    assert(min_span > 0.0f);
+    float lo = INFINITY;
+    float hi = -INFINITY;
+    for (size_t i = 0; i < num_cells * GLYPH_SPARK_SAMPLES_PER_CELL; ++i)
+    {
+        if (!isnan(samples[i]))
+        {
+            lo = fminf(lo, samples[i]);
+            hi = fmaxf(hi, samples[i]);
+        }
+    }
+    if (lo > hi)
+    {
+        // no valid samples: every cell is empty
+        lo = hi = 0.0f;
+    }
+    if (hi - lo < min_span)
+    {
+        // centre a small or flat range
+        lo = (lo + hi - min_span) / 2.0f;
+        hi = lo + min_span;
+    }
+
+    for (size_t cell = 0; cell < num_cells; ++cell)
+    {
+        uint8_t bitmap[GLYPH_HEIGHT] = { 0 };
+        bool empty = true;
+        for (int col = 0; col < GLYPH_SPARK_SAMPLES_PER_CELL; ++col)
+        {
+            float value = samples[cell * GLYPH_SPARK_SAMPLES_PER_CELL + col];
+            if (!isnan(value))
+            {
+                // the lowest sample is a single pixel, the highest fills the column
+                int level = 1 + (int)roundf((value - lo) / (hi - lo) * (GLYPH_HEIGHT - 1));
+                for (int row = GLYPH_HEIGHT - level; row < GLYPH_HEIGHT; ++row)
+                {
+                    bitmap[row] |= 1 << (GLYPH_WIDTH - 1 - col);
+                }
+                empty = false;
+            }
+        }
+        out[cell] = empty ? ' ' : glyph_allocate(cache, bitmap);
+    }
+    out[num_cells] = '\0';
+}
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Run-time glyphs in the HD44780's CGRAM, such as sparklines. Each slot is loaded only when its
+ * bitmap changes, identical bitmaps share a slot, and the least recently used slot is replaced
+ * when a new bitmap is needed. A slot used by the render in progress is never replaced - further
+ * glyphs fall back to GLYPH_FALLBACK.
+ */
+
+#define GLYPH_HEIGHT       8
+#define GLYPH_WIDTH        5
+#define GLYPH_NUM_SLOTS    4
+#define GLYPH_FALLBACK     '\xff'   // full block
+
+// Sparklines show GLYPH_SPARK_SAMPLES_PER_CELL samples per character cell, one pixel column each
+#define GLYPH_SPARK_SAMPLES_PER_CELL  GLYPH_WIDTH
+
+typedef struct
+{
+    uint8_t bitmap[GLYPH_HEIGHT];
+    bool valid;         // slot holds a bitmap
+    bool defined;       // bitmap has been loaded into CGRAM
+    uint32_t used;      // render generation that last used this slot
+} glyph_slot_t;
+
+typedef struct
+{
+    glyph_slot_t slots[GLYPH_NUM_SLOTS];
+    uint32_t generation;
+    char first_code;    // character code that shows the first slot
+} glyph_cache_t;
+
+// Empty the cache. Slot i is shown by character code first_code + i.
+void glyph_cache_init(glyph_cache_t * cache, char first_code);
+
+// Start a new render: slots used only by earlier renders may be replaced
+void glyph_cache_next_render(glyph_cache_t * cache);
+
+// Mark every slot as needing to be loaded again, after the controller has been reset
+void glyph_cache_undefine(glyph_cache_t * cache);
+
+// Return the character code for a glyph, reserving a slot for it if necessary. The caller
+// loads slots that are valid but not yet defined before showing the page.
+char glyph_allocate(glyph_cache_t * cache, const uint8_t bitmap[GLYPH_HEIGHT]);
+
+/*
+ * Draw samples as a sparkline of num_cells glyphs into out, with a terminating null. There are
+ * num_cells * GLYPH_SPARK_SAMPLES_PER_CELL samples, oldest first, each one filled pixel column
+ * scaled between the lowest and highest valid samples. The vertical scale spans at least
+ * min_span, which must be positive, so noise does not fill the graph. Missing samples (NAN)
+ * leave the column empty, and an empty cell is a space rather than a glyph.
+ */
+void glyph_sparkline(glyph_cache_t * cache, char * out, const float * samples, size_t num_cells, float min_span);
+
+#endif // GLYPH_H
@@ -23,19 +23,332 @@
  */
 
 #include <string.h>
+#include <inttypes.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_system.h"
 #include "driver/i2c.h"
+#include "driver/gpio.h"
+#include "rom/ets_sys.h"
 #include "esp_log.h"
 
 #include "i2c_master.h"
+#include "utils.h"
+#include "timer_wheel.h"
+#include "resources.h"
 
 #define TAG "i2c"
 
-i2c_master_info_t * i2c_master_init(i2c_port_t i2c_port, gpio_num_t sda_io_num, gpio_num_t scl_io_num, uint32_t clk_speed)
+#define CLIENT_NONE    I2C_MASTER_CLIENT_LAST
+#define UPDATE_PERIOD  (60 * 1000)         // milliseconds, device statistics to datastore
+#define REPORT_EVERY   10                  // updates per logged report
+#define LATENCY_BASE   128                 // microseconds, upper bound of first bucket
+
+#define ADAPT_WINDOW          64           // transactions per error-rate window
+#define ADAPT_ERROR_PERCENT   10           // step the clock down at or above this error rate
+#define ADAPT_CLEAN_WINDOWS   16           // error-free windows before stepping back up
+#define RECOVERY_CLOCKS       9            // enough for a slave to finish any byte and release SDA
+#define RECOVERY_HALF_PERIOD  5            // microseconds, 100 kHz
+#define PROBE_TIMEOUT         (10 / portTICK_RATE_MS)
+
+static const char * CLIENT_NAMES[I2C_MASTER_CLIENT_LAST] = { "avr", "sensor", "display", "other" };
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t yields;           // times the bus was handed to a higher-priority client
+    uint64_t wait_total;       // microseconds
+    uint32_t wait_max;         // microseconds
+    uint32_t hold_max;         // microseconds
+} client_stats_t;
+
+/*
+ * Bus arbitration. The bus is free when owner is CLIENT_NONE. A client that finds it busy
+ * counts itself in waiting[] and blocks on its own grant semaphore; on release the bus is
+ * handed directly to the highest-priority waiting client, so a lower-priority client can
+ * never take it in between.
+ */
+struct i2c_master_bus_t
+{
+    portMUX_TYPE mux;
+    i2c_master_client_t owner;
+    uint64_t hold_start;       // microseconds
+    uint8_t waiting[I2C_MASTER_CLIENT_LAST];
+    SemaphoreHandle_t grant[I2C_MASTER_CLIENT_LAST];
+    client_stats_t stats[I2C_MASTER_CLIENT_LAST];
+
+    // bus recovery and adaptive clock, updated with the bus locked
+    uint32_t clk_max;                  // Hz
+    uint32_t window_transactions;
+    uint32_t window_errors;
+    uint32_t clean_windows;
+    uint32_t clock_changes;
+    uint32_t recoveries;
+    uint32_t recovery_time_max;        // microseconds
+
+    // prebuilt command links, counted in _links_built as they are not tied to a bus
+    uint32_t prebuilt_runs;            // each one is a link that did not need to be allocated
+
+    // addresses that acknowledged a probe, one bit per 7-bit address
+    uint32_t detected[4];
+    const datastore_t * datastore;
+};
+
+static i2c_master_info_t * _masters[I2C_NUM_MAX] = { 0 };
+
+typedef struct
+{
+    i2c_port_t port;
+    uint8_t address;           // 0 if the slot is unused
+    uint32_t transactions;
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t errors;
+    uint32_t retries;
+    uint32_t latency_max;      // microseconds
+    uint32_t latency[I2C_MASTER_LATENCY_BUCKETS];
+} device_stats_t;
+
+// Updated only with the bus locked, read without it (32-bit reads are atomic)
+static device_stats_t _devices[I2C_MASTER_MAX_DEVICES] = { 0 };
+static volatile uint32_t _last_error_time = 0;  // seconds since boot
+
+static device_stats_t * _find_device(i2c_port_t port, uint8_t address)
+{
+    for (size_t i = 0; i < I2C_MASTER_MAX_DEVICES; ++i)
+    {
+        if (_devices[i].address == 0)
+        {
+            _devices[i].port = port;
+            _devices[i].address = address;
+            return &_devices[i];
+        }
+        if (_devices[i].port == port && _devices[i].address == address)
+        {
+            return &_devices[i];
+        }
+    }
+    return NULL;
+}
+
+static i2c_master_bus_t * _bus_create(void)
+{
+    i2c_master_bus_t * bus = malloc(sizeof(*bus));
+    if (bus)
+    {
+        memset(bus, 0, sizeof(*bus));
+        portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+        bus->mux = mux;
+        bus->owner = CLIENT_NONE;
+        for (size_t i = 0; i < I2C_MASTER_CLIENT_LAST; ++i)
+        {
+            bus->grant[i] = xSemaphoreCreateBinary();
+        }
+    }
+    return bus;
+}
+
+static void _install(const i2c_master_info_t * info)
+{
+    ESP_ERROR_CHECK(i2c_param_config(info->port, &info->config));
+    ESP_ERROR_CHECK(i2c_driver_install(info->port, info->config.mode,
+                                       I2C_MASTER_RX_BUF_LEN,
+                                       I2C_MASTER_TX_BUF_LEN, 0));
+}
+
+static bool _bus_stuck(const i2c_master_info_t * info)
+{
+    return gpio_get_level(info->config.sda_io_num) == 0 || gpio_get_level(info->config.scl_io_num) == 0;
+}
+
+static void _recover(i2c_master_info_t * info)
+{
+    i2c_master_bus_t * bus = info->bus;
+    gpio_num_t sda = info->config.sda_io_num;
+    gpio_num_t scl = info->config.scl_io_num;
+    uint64_t start = microseconds_since_boot();
+
+    // take the pins back from the I2C peripheral and drive them as open-drain GPIOs
+    i2c_driver_delete(info->port);
+    gpio_pad_select_gpio(sda);
+    gpio_pad_select_gpio(scl);
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    gpio_set_direction(sda, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(scl, GPIO_MODE_INPUT_OUTPUT_OD);
+
+    // clock out whatever the slave thinks it is still sending
+    int clocks = 0;
+    while (clocks < RECOVERY_CLOCKS && gpio_get_level(sda) == 0)
+    {
+        gpio_set_level(scl, 0);
+        ets_delay_us(RECOVERY_HALF_PERIOD);
+        gpio_set_level(scl, 1);
+        ets_delay_us(RECOVERY_HALF_PERIOD);
+        ++clocks;
+    }
+
+    // STOP: SDA rises while SCL is high
+    gpio_set_level(sda, 0);
+    ets_delay_us(RECOVERY_HALF_PERIOD);
+    gpio_set_level(scl, 1);
+    ets_delay_us(RECOVERY_HALF_PERIOD);
+    gpio_set_level(sda, 1);
+    ets_delay_us(RECOVERY_HALF_PERIOD);
+    bool released = !_bus_stuck(info);
+
+    _install(info);
+
+    uint32_t duration = microseconds_since_boot() - start;
+    ++bus->recoveries;
+    bus->recovery_time_max = duration > bus->recovery_time_max ? duration : bus->recovery_time_max;
+    ESP_LOGW(TAG, "bus recovery on port %d after %d clocks in %u us: %s", info->port, clocks, duration,
+             released ? "released" : "still held low");
+}
+
+static void _set_clock(i2c_master_info_t * info, uint32_t clk_speed)
+{
+    ESP_LOGW(TAG, "bus clock on port %d: %u -> %u Hz", info->port, info->config.master.clk_speed, clk_speed);
+    info->config.master.clk_speed = clk_speed;
+    esp_err_t err = i2c_param_config(info->port, &info->config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "i2c_param_config failed: %d", err);
+    }
+    ++info->bus->clock_changes;
+}
+
+static void _adapt_clock(i2c_master_info_t * info, bool error)
+{
+    i2c_master_bus_t * bus = info->bus;
+    ++bus->window_transactions;
+    bus->window_errors += error ? 1 : 0;
+    if (bus->window_transactions >= ADAPT_WINDOW)
+    {
+        uint32_t clk_speed = info->config.master.clk_speed;
+        if (bus->window_errors * 100 >= bus->window_transactions * ADAPT_ERROR_PERCENT)
+        {
+            bus->clean_windows = 0;
+            if (clk_speed / 2 >= I2C_MASTER_MIN_FREQ_HZ)
+            {
+                _set_clock(info, clk_speed / 2);
+            }
+        }
+        else if (bus->window_errors == 0 && clk_speed < bus->clk_max && ++bus->clean_windows >= ADAPT_CLEAN_WINDOWS)
+        {
+            bus->clean_windows = 0;
+            _set_clock(info, clk_speed * 2 < bus->clk_max ? clk_speed * 2 : bus->clk_max);
+        }
+        bus->window_transactions = 0;
+        bus->window_errors = 0;
+    }
+}
+
+/*
+ * Values last set in the datastore. Every set is an MQTT publish into the publish queue, so
+ * the job sets a value only when it has changed since the last update - a device's values are
+ * all set once when it is first seen, then usually only its transaction count and histogram.
+ */
+typedef struct
+{
+    device_stats_t devices[I2C_MASTER_MAX_DEVICES];
+    uint32_t clk_speed;
+    uint32_t recoveries;
+    uint32_t recovery_time_max;
+    bool bus_published;
+} published_stats_t;
+
+typedef struct
+{
+    const i2c_master_info_t * info;
+    const datastore_t * datastore;
+    uint32_t updates;
+    published_stats_t published;
+} stats_job_t;
+
+static stats_job_t _stats_job = { 0 };
+
+static void _render_histogram(const device_stats_t * device, char * buffer, size_t buffer_size)
+{
+    size_t len = 0;
+    buffer[0] = '\0';
+    for (size_t i = 0; i < I2C_MASTER_LATENCY_BUCKETS && len < buffer_size; ++i)
+    {
+        len += snprintf(buffer + len, buffer_size - len, i ? ",%" PRIu32 : "%" PRIu32, device->latency[i]);
+    }
+}
+
+static void _set_if_changed(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance,
+                            uint32_t value, uint32_t * published, bool force)
+{
+    if (force || value != *published)
+    {
+        datastore_set_uint32(datastore, id, instance, value);
+        *published = value;
+    }
+}
+
+static void _stats_job_func(void * context)
+{
+    stats_job_t * job = (stats_job_t *)context;
+    const datastore_t * datastore = job->datastore;
+    published_stats_t * published = &job->published;
+
+    uint32_t total_errors = 0;
+    for (size_t i = 0; i < I2C_MASTER_MAX_DEVICES; ++i)
+    {
+        // copied, as transactions may be recorded while the values are compared
+        device_stats_t device = _devices[i];
+        device_stats_t * last = &published->devices[i];
+        if (device.address)
+        {
+            bool force = last->address != device.address;
+            if (force)
+            {
+                datastore_set_uint8(datastore, RESOURCE_ID_I2C_DEVICE_ADDRESS, i, device.address);
+                last->address = device.address;
+            }
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_TRANSACTIONS, i, device.transactions, &last->transactions, force);
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_NACKS, i, device.nacks, &last->nacks, force);
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_TIMEOUTS, i, device.timeouts, &last->timeouts, force);
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_ERRORS, i, device.errors, &last->errors, force);
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_RETRIES, i, device.retries, &last->retries, force);
+            _set_if_changed(datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_MAX, i, device.latency_max, &last->latency_max, force);
+            if (force || memcmp(device.latency, last->latency, sizeof(device.latency)) != 0)
+            {
+                char histogram[I2C_MASTER_LEN_HISTOGRAM] = "";
+                _render_histogram(&device, histogram, sizeof(histogram));
+                datastore_set_string(datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM, i, histogram);
+                memcpy(last->latency, device.latency, sizeof(last->latency));
+            }
+            total_errors += device.nacks + device.timeouts + device.errors;
+        }
+    }
+
+    uint32_t previous_errors = 0;
+    datastore_get_uint32(datastore, RESOURCE_ID_I2C_ERROR_COUNT, 0, &previous_errors);
+    if (total_errors != previous_errors)
+    {
+        datastore_set_uint32(datastore, RESOURCE_ID_I2C_ERROR_COUNT, 0, total_errors);
+        datastore_set_uint32(datastore, RESOURCE_ID_I2C_ERROR_TIMESTAMP, 0, _last_error_time);
+    }
+
+    const i2c_master_bus_t * bus = job->info->bus;
+    bool force = !published->bus_published;
+    published->bus_published = true;
+    _set_if_changed(datastore, RESOURCE_ID_I2C_CLOCK_SPEED, 0, job->info->config.master.clk_speed, &published->clk_speed, force);
+    _set_if_changed(datastore, RESOURCE_ID_I2C_RECOVERY_COUNT, 0, bus->recoveries, &published->recoveries, force);
+    _set_if_changed(datastore, RESOURCE_ID_I2C_RECOVERY_TIME_MAX, 0, bus->recovery_time_max, &published->recovery_time_max, force);
+
+    if (++job->updates % REPORT_EVERY == 0)
+    {
+        i2c_master_log_stats(job->info);
+    }
+}
+
+i2c_master_info_t * i2c_master_init(i2c_port_t i2c_port, gpio_num_t sda_io_num, gpio_num_t scl_io_num, uint32_t clk_speed, const datastore_t * datastore)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
 
@@ -51,39 +364,128 @@ i2c_master_info_t * i2c_master_init(i2c_port_t i2c_port, gpio_num_t sda_io_num,
         info->config.scl_pullup_en = GPIO_PULLUP_DISABLE;  // use external pullups
         info->config.master.clk_speed = clk_speed;         // Hz
 
-        ESP_ERROR_CHECK(i2c_param_config(i2c_port, &info->config));
-        ESP_ERROR_CHECK(i2c_driver_install(i2c_port, info->config.mode,
-                                           I2C_MASTER_RX_BUF_LEN,
-                                           I2C_MASTER_TX_BUF_LEN, 0));
-        info->semaphore = xSemaphoreCreateMutex();
+        _install(info);
+        info->bus = _bus_create();
+        info->bus->clk_max = clk_speed;
+        info->bus->datastore = datastore;
+        if (i2c_port < I2C_NUM_MAX)
+        {
+            _masters[i2c_port] = info;
+        }
+
+        _stats_job.info = info;
+        _stats_job.datastore = datastore;
+        timer_wheel_add("i2c", UPDATE_PERIOD, _stats_job_func, &_stats_job);
     }
     return info;
 }
 
-int i2c_master_scan(const i2c_master_info_t * info)
+static volatile uint32_t _links_built = 0;
+
+i2c_cmd_handle_t i2c_master_build_read(uint8_t address, uint8_t reg, uint8_t * data, size_t len)
+{
+    assert(data && len > 0);
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1 | I2C_MASTER_WRITE, true /*ACK_CHECK*/);
+    i2c_master_write_byte(cmd, reg, true /*ACK_CHECK*/);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1 | I2C_MASTER_READ, true /*ACK_CHECK*/);
+    if (len > 1)
+    {
+        i2c_master_read(cmd, data, len - 1, I2C_MASTER_ACK);
+    }
+    i2c_master_read_byte(cmd, data + len - 1, I2C_MASTER_NACK);
+    i2c_master_stop(cmd);
+    ++_links_built;
+    return cmd;
+}
+
+i2c_cmd_handle_t i2c_master_build_write(uint8_t address, uint8_t * data, size_t len)
+{
+    assert(data && len > 0);
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1 | I2C_MASTER_WRITE, true /*ACK_CHECK*/);
+    i2c_master_write(cmd, data, len, true /*ACK_CHECK*/);
+    i2c_master_stop(cmd);
+    ++_links_built;
+    return cmd;
+}
+
+esp_err_t i2c_master_run(const i2c_master_info_t * info, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait)
+{
+    ++info->bus->prebuilt_runs;
+    return i2c_master_cmd_begin(info->port, cmd, ticks_to_wait);
+}
+
+static bool _probe(const i2c_master_info_t * info, uint8_t address)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, address << 1, true /*ACK_CHECK*/);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(info->port, cmd, PROBE_TIMEOUT);
+    i2c_cmd_link_delete(cmd);
+    return err == ESP_OK;
+}
+
+// Record a probe result and refresh the cached device list in the datastore
+static void _update_detected(const i2c_master_info_t * info, uint8_t address, bool detected)
+{
+    i2c_master_bus_t * bus = info->bus;
+    uint32_t mask = 1u << (address % 32);
+    bool known = (bus->detected[address / 32] & mask) != 0;
+    if (detected == known)
+    {
+        return;
+    }
+    bus->detected[address / 32] ^= mask;
+
+    char devices[I2C_MASTER_LEN_DEVICES] = "";
+    size_t len = 0;
+    int count = 0;
+    for (int a = 1; a < 0x7f; ++a)
+    {
+        if (bus->detected[a / 32] & (1u << (a % 32)))
+        {
+            ++count;
+            if (len + 4 < sizeof(devices))
+            {
+                len += snprintf(devices + len, sizeof(devices) - len, count > 1 ? " %02x" : "%02x", a);
+            }
+        }
+    }
+    if (bus->datastore)
+    {
+        datastore_set_uint8(bus->datastore, RESOURCE_ID_I2C_MASTER_DEVICE_COUNT, 0, count);
+        datastore_set_string(bus->datastore, RESOURCE_ID_I2C_MASTER_DEVICES, 0, devices);
+    }
+}
+
+int i2c_master_scan(const i2c_master_info_t * info, const uint8_t * addresses, size_t num_addresses)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
 
     int num_detected = 0;
     if (info)
     {
-        xSemaphoreTake(info->semaphore, portMAX_DELAY);
-        for (int address = 1; address < 0x7f; ++address)
+        i2c_master_lock(info, I2C_MASTER_CLIENT_OTHER, portMAX_DELAY);
+        for (size_t i = 0; i < num_addresses; ++i)
         {
-            i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, address << 1, true /*ACK_CHECK*/);
-            i2c_master_stop(cmd);
-            esp_err_t err = i2c_master_cmd_begin(info->port, cmd, (1000 / portTICK_RATE_MS));
-            //ESP_LOGI(TAG, "address 0x%02x %d", address, err);
-            if (err == 0)
+            bool detected = _probe(info, addresses[i]);
+            if (detected)
             {
                 ++num_detected;
-                ESP_LOGI(TAG, "detected I2C address on master %d at address 0x%02x", info->port, address);
+                ESP_LOGI(TAG, "detected I2C address on master %d at address 0x%02x", info->port, addresses[i]);
+            }
+            else
+            {
+                ESP_LOGW(TAG, "no I2C device on master %d at address 0x%02x", info->port, addresses[i]);
             }
-            i2c_cmd_link_delete(cmd);
+            _update_detected(info, addresses[i], detected);
         }
-        xSemaphoreGive(info->semaphore);
+        i2c_master_unlock(info);
     }
     else
     {
@@ -92,24 +494,111 @@ int i2c_master_scan(const i2c_master_info_t * info)
     return num_detected;
 }
 
+static void _sweep_task(void * pvParameter)
+{
+    const i2c_master_info_t * info = (const i2c_master_info_t *)pvParameter;
+    uint64_t start = microseconds_since_boot();
+    int num_detected = 0;
+
+    // one address per lock, as the lowest-priority client, so other clients are barely delayed
+    for (int address = 1; address < 0x7f; ++address)
+    {
+        i2c_master_lock(info, I2C_MASTER_CLIENT_OTHER, portMAX_DELAY);
+        bool detected = _probe(info, address);
+        _update_detected(info, address, detected);
+        i2c_master_unlock(info);
+        num_detected += detected ? 1 : 0;
+    }
+
+    ESP_LOGI(TAG, "full scan of master %d: %d devices in %" PRIu64 " ms", info->port, num_detected,
+             (microseconds_since_boot() - start) / 1000);
+    vTaskDelete(NULL);
+}
+
+void i2c_master_scan_background(const i2c_master_info_t * info, UBaseType_t priority)
+{
+    if (info)
+    {
+        xTaskCreate(&_sweep_task, "i2c_scan_task", 2048, (void *)info, priority, NULL);
+    }
+}
+
 void i2c_master_close(i2c_master_info_t * info)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
+    if (info && info->bus)
+    {
+        for (size_t i = 0; i < I2C_MASTER_CLIENT_LAST; ++i)
+        {
+            vSemaphoreDelete(info->bus->grant[i]);
+        }
+        free(info->bus);
+    }
     free(info);
 }
 
-bool i2c_master_lock(const i2c_master_info_t * info, TickType_t ticks_to_wait)
+bool i2c_master_lock(const i2c_master_info_t * info, i2c_master_client_t client, TickType_t ticks_to_wait)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
     bool result = false;
-    if (info)
+    if (info && client < I2C_MASTER_CLIENT_LAST)
     {
-        result = xSemaphoreTake(info->semaphore, ticks_to_wait) == pdTRUE ? true : false;
+        i2c_master_bus_t * bus = info->bus;
+        uint64_t start = microseconds_since_boot();
+
+        portENTER_CRITICAL(&bus->mux);
+        if (bus->owner == CLIENT_NONE)
+        {
+            bus->owner = client;
+            result = true;
+        }
+        else
+        {
+            ++bus->waiting[client];
+        }
+        portEXIT_CRITICAL(&bus->mux);
+
+        if (!result)
+        {
+            result = xSemaphoreTake(bus->grant[client], ticks_to_wait) == pdTRUE;
+            if (!result)
+            {
+                // the bus may have been handed over just as the wait timed out
+                bool granted = false;
+                portENTER_CRITICAL(&bus->mux);
+                if (bus->waiting[client] > 0)
+                {
+                    --bus->waiting[client];
+                }
+                else
+                {
+                    granted = true;
+                }
+                portEXIT_CRITICAL(&bus->mux);
+                if (granted)
+                {
+                    result = xSemaphoreTake(bus->grant[client], portMAX_DELAY) == pdTRUE;
+                }
+            }
+        }
+
+        if (result)
+        {
+            // only the owner updates its statistics
+            uint64_t now = microseconds_since_boot();
+            uint32_t wait = now - start;
+            client_stats_t * stats = &bus->stats[client];
+            ++stats->count;
+            stats->wait_total += wait;
+            stats->wait_max = wait > stats->wait_max ? wait : stats->wait_max;
+            bus->hold_start = now;
+        }
     }
     else
     {
-        ESP_LOGE(TAG, "info is NULL");
-    }    return result;
+        ESP_LOGE(TAG, "info is NULL or invalid client %d", client);
+    }
+    return result;
 }
 
 void i2c_master_unlock(const i2c_master_info_t * info)
@@ -117,10 +606,139 @@ void i2c_master_unlock(const i2c_master_info_t * info)
     ESP_LOGD(TAG, "%s", __FUNCTION__);
     if (info)
     {
-        xSemaphoreGive(info->semaphore);
+        i2c_master_bus_t * bus = info->bus;
+        if (bus->owner < I2C_MASTER_CLIENT_LAST)
+        {
+            client_stats_t * stats = &bus->stats[bus->owner];
+            uint32_t hold = microseconds_since_boot() - bus->hold_start;
+            stats->hold_max = hold > stats->hold_max ? hold : stats->hold_max;
+        }
+
+        i2c_master_client_t next = CLIENT_NONE;
+        portENTER_CRITICAL(&bus->mux);
+        for (size_t i = 0; i < I2C_MASTER_CLIENT_LAST; ++i)
+        {
+            if (bus->waiting[i] > 0)
+            {
+                --bus->waiting[i];
+                next = i;
+                break;
+            }
+        }
+        bus->owner = next;
+        portEXIT_CRITICAL(&bus->mux);
+
+        if (next != CLIENT_NONE)
+        {
+            xSemaphoreGive(bus->grant[next]);
+        }
     }
     else
     {
         ESP_LOGE(TAG, "info is NULL");
     }
 }
+
+void i2c_master_yield(const i2c_master_info_t * info, i2c_master_client_t client)
+{
+    if (info && client < I2C_MASTER_CLIENT_LAST)
+    {
+        i2c_master_bus_t * bus = info->bus;
+        bool higher = false;
+        portENTER_CRITICAL(&bus->mux);
+        for (size_t i = 0; i < client; ++i)
+        {
+            higher = higher || bus->waiting[i] > 0;
+        }
+        portEXIT_CRITICAL(&bus->mux);
+
+        if (higher)
+        {
+            ++bus->stats[client].yields;
+            i2c_master_unlock(info);
+            i2c_master_lock(info, client, portMAX_DELAY);
+        }
+    }
+}
+
+void i2c_master_log_stats(const i2c_master_info_t * info)
+{
+    if (info)
+    {
+        const i2c_master_bus_t * bus = info->bus;
+        ESP_LOGI(TAG, "%-8s %8s %8s %10s %10s %10s", "client", "locks", "yields", "wait avg", "wait max", "hold max");
+        for (size_t i = 0; i < I2C_MASTER_CLIENT_LAST; ++i)
+        {
+            const client_stats_t * stats = &bus->stats[i];
+            uint32_t wait_avg = stats->count ? stats->wait_total / stats->count : 0;
+            ESP_LOGI(TAG, "%-8s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "us %8" PRIu32 "us %8" PRIu32 "us",
+                     CLIENT_NAMES[i], stats->count, stats->yields, wait_avg, stats->wait_max, stats->hold_max);
+        }
+
+        ESP_LOGI(TAG, "clock %u Hz (%u changes), %u recoveries, max recovery %u us",
+                 info->config.master.clk_speed, bus->clock_changes, bus->recoveries, bus->recovery_time_max);
+        ESP_LOGI(TAG, "prebuilt links: %u built, %u runs without allocation", _links_built, bus->prebuilt_runs);
+        ESP_LOGI(TAG, "%-8s %10s %8s %8s %8s %8s %10s", "device", "txns", "nacks", "timeouts", "errors", "retries", "lat max");
+        for (size_t i = 0; i < I2C_MASTER_MAX_DEVICES; ++i)
+        {
+            const device_stats_t * device = &_devices[i];
+            if (device->address && device->port == info->port)
+            {
+                char histogram[I2C_MASTER_LEN_HISTOGRAM] = "";
+                _render_histogram(device, histogram, sizeof(histogram));
+                ESP_LOGI(TAG, "0x%02x     %10" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "us [%s]",
+                         device->address, device->transactions, device->nacks, device->timeouts, device->errors,
+                         device->retries, device->latency_max, histogram);
+            }
+        }
+    }
+}
+
+esp_err_t i2c_master_record(const smbus_info_t * smbus_info, esp_err_t err, uint64_t start_us, uint32_t retries)
+{
+    uint32_t latency = microseconds_since_boot() - start_us;
+    device_stats_t * device = _find_device(smbus_info->i2c_port, smbus_info->address);
+    if (device)
+    {
+        size_t bucket = 0;
+        for (uint32_t limit = LATENCY_BASE; bucket < I2C_MASTER_LATENCY_BUCKETS - 1 && latency >= limit; limit <<= 1)
+        {
+            ++bucket;
+        }
+        ++device->latency[bucket];
+        ++device->transactions;
+        device->retries += retries;
+        device->latency_max = latency > device->latency_max ? latency : device->latency_max;
+
+        if (err != ESP_OK)
+        {
+            if (err == ESP_FAIL)
+            {
+                ++device->nacks;
+            }
+            else if (err == ESP_ERR_TIMEOUT)
+            {
+                ++device->timeouts;
+            }
+            else
+            {
+                ++device->errors;
+            }
+            _last_error_time = seconds_since_boot();
+        }
+    }
+
+    i2c_master_info_t * info = smbus_info->i2c_port < I2C_NUM_MAX ? _masters[smbus_info->i2c_port] : NULL;
+    if (info)
+    {
+        // a NACK is a device's answer on a working bus - only timeouts, which include lost
+        // arbitration, and failures that leave the bus stuck say anything about the clock
+        bool bus_error = err == ESP_ERR_TIMEOUT || (err != ESP_OK && _bus_stuck(info));
+        if (bus_error)
+        {
+            _recover(info);
+        }
+        _adapt_clock(info, bus_error);
+    }
+    return err;
+}
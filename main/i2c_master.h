@@ -29,26 +29,94 @@
 #include "freertos/semphr.h"
 
 #include "driver/i2c.h"
+#include "smbus.h"
+#include "datastore/datastore.h"
 
 #define I2C_MASTER_NUM           I2C_NUM_0
 #define I2C_MASTER_TX_BUF_LEN    0                     // disabled
 #define I2C_MASTER_RX_BUF_LEN    0                     // disabled
-#define I2C_MASTER_FREQ_HZ       100000                // Hz
+#define I2C_MASTER_FREQ_HZ       100000                // Hz, maximum - PCF8574 LCD backpack is rated to 100 kHz
+#define I2C_MASTER_MIN_FREQ_HZ   25000                 // Hz, lower limit of adaptive clock
+
+#define I2C_MASTER_MAX_DEVICES     3                   // devices with transaction statistics
+#define I2C_MASTER_LATENCY_BUCKETS 8                   // 0: < 128 us, doubling, last is open-ended
+#define I2C_MASTER_LEN_HISTOGRAM   (I2C_MASTER_LATENCY_BUCKETS * 11)
+#define I2C_MASTER_LEN_DEVICES     64                  // space-separated hex addresses
+
+/*
+ * Bus clients, highest priority first. When the bus is released it is granted to the
+ * highest-priority waiting client, regardless of the priority of the waiting tasks.
+ */
+typedef enum
+{
+    I2C_MASTER_CLIENT_AVR = 0,     // pump control
+    I2C_MASTER_CLIENT_SENSOR,
+    I2C_MASTER_CLIENT_DISPLAY,
+    I2C_MASTER_CLIENT_OTHER,       // diagnostics such as bus scans
+    I2C_MASTER_CLIENT_LAST,
+} i2c_master_client_t;
+
+typedef struct i2c_master_bus_t i2c_master_bus_t;
 
 typedef struct
 {
     i2c_port_t port;
     i2c_config_t config;
-    SemaphoreHandle_t semaphore;
+    i2c_master_bus_t * bus;
 } i2c_master_info_t;
 
-i2c_master_info_t * i2c_master_init(i2c_port_t i2c_port, gpio_num_t sda_io_num, gpio_num_t scl_io_num, uint32_t clk_speed);
+i2c_master_info_t * i2c_master_init(i2c_port_t i2c_port, gpio_num_t sda_io_num, gpio_num_t scl_io_num, uint32_t clk_speed, const datastore_t * datastore);
+
+// Probe the given addresses with a short timeout. Returns the number that responded.
+// Detected devices are cached in I2C_MASTER_DEVICE_COUNT and I2C_MASTER_DEVICES.
+int i2c_master_scan(const i2c_master_info_t * info, const uint8_t * addresses, size_t num_addresses);
 
-int i2c_master_scan(const i2c_master_info_t * info);
+// Probe every address from a transient low-priority task, updating the cached result.
+void i2c_master_scan_background(const i2c_master_info_t * info, UBaseType_t priority);
 
 void i2c_master_close(i2c_master_info_t * info);
 
-bool i2c_master_lock(const i2c_master_info_t * info, TickType_t ticks_to_wait);
+// Gain exclusive use of the bus on behalf of a client.
+bool i2c_master_lock(const i2c_master_info_t * info, i2c_master_client_t client, TickType_t ticks_to_wait);
 void i2c_master_unlock(const i2c_master_info_t * info);
 
+// Between the chunks of a long update, hand the bus to any higher-priority client that
+// is waiting, then reacquire it. Returns immediately if no such client is waiting.
+void i2c_master_yield(const i2c_master_info_t * info, i2c_master_client_t client);
+
+// Log per-client lock counts, wait and hold times, and per-device transaction statistics.
+void i2c_master_log_stats(const i2c_master_info_t * info);
+
+/*
+ * Prebuilt command links for transactions that repeat with the same shape. Building a link
+ * allocates one heap node per step, so a fixed transaction is built once and run many times.
+ * The data buffer is referenced, not copied: patch it before each run of a write, and read the
+ * result from it after each run of a read. The buffer must outlive the link.
+ */
+// START, address+W, reg, repeated START, address+R, read len bytes into data, STOP
+i2c_cmd_handle_t i2c_master_build_read(uint8_t address, uint8_t reg, uint8_t * data, size_t len);
+
+// START, address+W, write len bytes from data (usually register then value), STOP
+i2c_cmd_handle_t i2c_master_build_write(uint8_t address, uint8_t * data, size_t len);
+
+// Run a prebuilt link with the bus locked
+esp_err_t i2c_master_run(const i2c_master_info_t * info, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait);
+
+/*
+ * The bus clock starts at the clk_speed given to i2c_master_init. It is halved (down to
+ * I2C_MASTER_MIN_FREQ_HZ) when the rate of bus errors over a window of transactions is high,
+ * and doubled again after a run of error-free windows. Bus errors are the failures that
+ * trigger recovery below; NACKs are counted against the device but not against the clock.
+ *
+ * A timeout, or an error that leaves SDA or SCL held low, triggers bus recovery: the driver is
+ * removed, SCL is clocked until the slave releases SDA, a STOP is generated and the driver is
+ * reinstalled.
+ *
+ * Account for one transaction (or one logical register access) with the device behind
+ * smbus_info, started at start_us and finished now with result err after the given number of
+ * retries. ESP_FAIL is counted as a NACK and ESP_ERR_TIMEOUT as a timeout. Call with the bus
+ * locked - the lock serialises updates to the statistics. Returns err.
+ */
+esp_err_t i2c_master_record(const smbus_info_t * smbus_info, esp_err_t err, uint64_t start_us, uint32_t retries);
+
 #endif // I2C_MASTER_H
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+
+#include "lcd_burst.h"
+
+#define NUM_ROWS 4
+
+// DDRAM address of the first visible column of each row - rows 0 and 2 show line 1, 1 and 3 line 2
+static const uint8_t ROW_OFFSETS[NUM_ROWS] = { 0x00, 0x40, 0x14, 0x54 };
+
+size_t lcd_burst_append(uint8_t * burst, size_t len, uint8_t value, uint8_t flags)
+{
+    uint8_t nibbles[2] = { value & 0xf0, (value << 4) & 0xf0 };
+    for (int i = 0; i < 2; ++i)
+    {
+        burst[len++] = nibbles[i] | flags;
+        burst[len++] = nibbles[i] | flags | LCD_BURST_E;
+        burst[len++] = nibbles[i] | flags;
+    }
+    return len;
+}
+
+size_t lcd_burst_run(uint8_t * burst, size_t size, uint8_t col, uint8_t row, const char * string, uint8_t backlight_flag)
+{
+    assert(row < NUM_ROWS);
+    assert(size >= LCD_BURST_PORT_WRITES_PER_BYTE);
+    size_t len = lcd_burst_append(burst, 0, LCD_BURST_SET_DDRAM_ADDR | (ROW_OFFSETS[row] + col), backlight_flag);
+    for (const char * c = string; *c && len + LCD_BURST_PORT_WRITES_PER_BYTE <= size; ++c)
+    {
+        len = lcd_burst_append(burst, len, *c, backlight_flag | LCD_BURST_RS);
+    }
+    return len;
+}
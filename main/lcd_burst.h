@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LCD_BURST_H
+#define LCD_BURST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Encoding of HD44780 commands and characters as PCF8574 port writes, for an LCD on an I2C
+ * backpack wired P0 = RS, P1 = RW, P2 = E, P3 = backlight, P4-P7 = D4-D7.
+ *
+ * Each byte sent to the LCD is two nibbles, high first, and each nibble is three port writes
+ * (set up, E high, E low) that the PCF8574 accepts back to back in a single I2C write. A burst
+ * of several bytes can therefore be sent as one transaction.
+ */
+
+#define LCD_BURST_RS                    0x01    // register select: data rather than a command
+#define LCD_BURST_E                     0x04    // enable: the controller latches a nibble as E falls
+#define LCD_BURST_PORT_WRITES_PER_BYTE  6
+
+#define LCD_BURST_SET_DDRAM_ADDR        0x80
+#define LCD_BURST_SHIFT_LEFT            0x18    // cursor or display shift: display, left
+
+// Append the port writes for one command byte, or one character if flags includes
+// LCD_BURST_RS. Flags also carries the backlight bit. Returns the new length.
+size_t lcd_burst_append(uint8_t * burst, size_t len, uint8_t value, uint8_t flags);
+
+// Build a burst that moves the cursor to (col, row) of a 4-row display with 2 x 40 character
+// DDRAM, then writes the characters of string, as many as fit in size. Returns the length.
+size_t lcd_burst_run(uint8_t * burst, size_t size, uint8_t col, uint8_t row, const char * string, uint8_t backlight_flag);
+
+#endif // LCD_BURST_H
@@ -37,6 +37,7 @@
 
 #include "ota.h"
 #include "resources.h"
+#include "timer_wheel.h"
 
 #define TAG "ota"
 
@@ -59,7 +60,10 @@ typedef struct
     const datastore_t * datastore;
 } task_inputs_t;
 
-static TaskHandle_t _task_handle = NULL;
+static TaskHandle_t _task_handle = NULL;   // transient upgrade task
+static timer_wheel_job_t _job = TIMER_WHEEL_INVALID_JOB;
+static UBaseType_t _priority = 0;
+static volatile bool _trigger = false;
 
 /*read buffer by byte still delim ,return read bytes counts*/
 static int read_until(char *buffer, char delim, int len)
@@ -316,7 +320,7 @@ static bool _do_ota_upgrade(const char * server_name, const char * server_port,
 static void _ota_url_changed(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, void * context)
 {
     ESP_LOGD(TAG, "ota url changed");
-    bool * trigger = (bool *)context;
+    volatile bool * trigger = (volatile bool *)context;
     *trigger = true;
 }
 
@@ -343,6 +347,7 @@ static bool _parse_url(const char * url,
     return result;
 }
 
+// Transient task that performs a single upgrade - the download is too long-running for the timer wheel
 static void ota_task(void * pvParameter)
 {
     assert(pvParameter);
@@ -350,52 +355,35 @@ static void ota_task(void * pvParameter)
     task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
     const datastore_t * datastore = task_inputs->datastore;
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    char server_name[SERVER_NAME_LEN + 1] = "";
+    char server_port[SERVER_PORT_LEN + 1] = "80";
+    char filename[FILENAME_LEN + 1] = "";
+    binary_file_length = 0;
 
-    bool trigger = false;
-    datastore_add_set_callback(datastore, RESOURCE_ID_OTA_URL, 0, _ota_url_changed, &trigger);
+    char url[OTA_URL_LEN] = "";
+    datastore_get_as_string(datastore, RESOURCE_ID_OTA_URL, 0, url, sizeof(url));
 
-    while (1)
-    {
-        ESP_LOGD(TAG, "ota loop");
-        last_wake_time = xTaskGetTickCount();
+    char buffer[256] = "";
+    snprintf(buffer, 256, "OTA upgrade initiated: %s", url);
+    ESP_LOGI(TAG, "%s", buffer);
+    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, buffer);
 
-        if (trigger)
+    if (_parse_url(url, server_name, server_port, filename))
+    {
+        if (_do_ota_upgrade(server_name, server_port, filename))
         {
-            char server_name[SERVER_NAME_LEN + 1] = "";
-            char server_port[SERVER_PORT_LEN + 1] = "80";
-            char filename[FILENAME_LEN + 1] = "";
-            binary_file_length = 0;
-
-            char url[OTA_URL_LEN] = "";
-            datastore_get_as_string(datastore, RESOURCE_ID_OTA_URL, 0, url, sizeof(url));
-
-            char buffer[256] = "";
-            snprintf(buffer, 256, "OTA upgrade initiated: %s", url);
-            ESP_LOGI(TAG, "%s", buffer);
-            datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, buffer);
-
-            if (_parse_url(url, server_name, server_port, filename))
-            {
-                if (_do_ota_upgrade(server_name, server_port, filename))
-                {
-                    ESP_LOGI(TAG, "OTA upgrade successful - reboot to activate new software");
-                    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "OTA upgrade successful");
-                }
-                else
-                {
-                    ESP_LOGE(TAG, "OTA upgrade failed");
-                    datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "OTA upgrade failed");
-                }
-            }
-            else
-            {
-                ESP_LOGE(TAG, "Error parsing URL '%s'", url);
-            }
-            trigger = false;
+            ESP_LOGI(TAG, "OTA upgrade successful - reboot to activate new software");
+            datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "OTA upgrade successful");
+        }
+        else
+        {
+            ESP_LOGE(TAG, "OTA upgrade failed");
+            datastore_set_string(datastore, RESOURCE_ID_SYSTEM_LOG, 0, "OTA upgrade failed");
         }
-
-        vTaskDelayUntil(&last_wake_time, OTA_PERIOD * 1000 / portTICK_PERIOD_MS);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Error parsing URL '%s'", url);
     }
 
     free(task_inputs);
@@ -403,22 +391,40 @@ static void ota_task(void * pvParameter)
     vTaskDelete(NULL);
 }
 
-void ota_init(UBaseType_t priority, const datastore_t * datastore)
+static void _ota_job(void * context)
 {
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    const datastore_t * datastore = (const datastore_t *)context;
+    ESP_LOGD(TAG, "ota check");
 
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
+    // only one upgrade at a time - a trigger during an upgrade is handled afterwards
+    if (_trigger && _task_handle == NULL)
     {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->datastore = datastore;
-        xTaskCreate(&ota_task, "ota_task", 8192, task_inputs, priority, &_task_handle);
+        _trigger = false;
+
+        // task will take ownership of this struct
+        task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
+        if (task_inputs)
+        {
+            memset(task_inputs, 0, sizeof(*task_inputs));
+            task_inputs->datastore = datastore;
+            xTaskCreate(&ota_task, "ota_task", 8192, task_inputs, _priority, &_task_handle);
+        }
     }
 }
 
+void ota_init(UBaseType_t priority, const datastore_t * datastore)
+{
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+
+    _priority = priority;
+    datastore_add_set_callback(datastore, RESOURCE_ID_OTA_URL, 0, _ota_url_changed, (void *)&_trigger);
+    _job = timer_wheel_add("ota", OTA_PERIOD * 1000, _ota_job, (void *)datastore);
+}
+
 void ota_delete(void)
 {
+    timer_wheel_remove(_job);
+    _job = TIMER_WHEEL_INVALID_JOB;
     if (_task_handle)
     {
         vTaskDelete(_task_handle);
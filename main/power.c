@@ -22,10 +22,7 @@
  * SOFTWARE.
  */
 
-#include <string.h>
-
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "esp_log.h"
 
 #include "power.h"
@@ -36,6 +33,7 @@
 #include "display.h"
 #include "led.h"
 #include "sensor_temp.h"
+#include "timer_wheel.h"
 
 #define TAG "power"
 
@@ -43,12 +41,7 @@
 #define SHC_WATER (4184.0)               // J/kg/K
 #define MASS_PER_VOLUME_WATER (1000.0)   // kg/m^3
 
-typedef struct
-{
-    const datastore_t * datastore;
-} task_inputs_t;
-
-static TaskHandle_t _task_handle = NULL;
+static timer_wheel_job_t _job = TIMER_WHEEL_INVALID_JOB;
 
 static float _calculate_transfer_power_watts(float lpm, float temp_delta)
 {
@@ -60,88 +53,64 @@ static float _calculate_transfer_power_watts(float lpm, float temp_delta)
     return power;
 }
 
-static void power_calculation_task(void * pvParameter)
+static void _power_calculation_job(void * context)
 {
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
-
-    TickType_t last_wake_time = xTaskGetTickCount();
+    const datastore_t * datastore = (const datastore_t *)context;
+    ESP_LOGD(TAG, "power calculation");
 
-    while (1)
-    {
-        ESP_LOGD(TAG, "power calculation loop");
-        last_wake_time = xTaskGetTickCount();
-
-        // for now, use T1 and T3
-        const uint8_t in = 0;  // Pool
-        const uint8_t out = 2; // Output
+    // for now, use T1 and T3
+    const uint8_t in = 0;  // Pool
+    const uint8_t out = 2; // Output
 
-        datastore_age_t age_in = DATASTORE_INVALID_AGE;
-        datastore_age_t age_out = DATASTORE_INVALID_AGE;
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, in, &age_in);
-        datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, out, &age_out);
-        datastore_age_t expiry = sensor_temp_expiry(datastore);
+    datastore_age_t age_in = DATASTORE_INVALID_AGE;
+    datastore_age_t age_out = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, in, &age_in);
+    datastore_get_age(datastore, RESOURCE_ID_TEMP_VALUE, out, &age_out);
+    datastore_age_t expiry = sensor_temp_expiry(datastore);
 
-        if (age_in < expiry)
+    if (age_in < expiry)
+    {
+        if (age_out < expiry)
         {
-            if (age_out < expiry)
-            {
-                float temp_in = 0.0f;
-                float temp_out = 0.0f;
-                datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, in, &temp_in);
-                datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, out, &temp_out);
-                float delta = temp_out - temp_in;
+            float temp_in = 0.0f;
+            float temp_out = 0.0f;
+            datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, in, &temp_in);
+            datastore_get_float(datastore, RESOURCE_ID_TEMP_VALUE, out, &temp_out);
+            float delta = temp_out - temp_in;
 
-                float lpm = 0.0f;
-                datastore_get_float(datastore, RESOURCE_ID_FLOW_RATE, 0, &lpm);
+            float lpm = 0.0f;
+            datastore_get_float(datastore, RESOURCE_ID_FLOW_RATE, 0, &lpm);
 
-                float power = _calculate_transfer_power_watts(lpm, delta);
-                ESP_LOGI(TAG, "flow %f lpm, temp delta %f K, power %f W", lpm, delta, power);
+            float power = _calculate_transfer_power_watts(lpm, delta);
+            ESP_LOGI(TAG, "flow %f lpm, temp delta %f K, power %f W", lpm, delta, power);
 
-                datastore_set_float(datastore, RESOURCE_ID_POWER_VALUE, 0, power);
-                datastore_set_float(datastore, RESOURCE_ID_POWER_TEMP_DELTA, 0, delta);
+            datastore_set_float(datastore, RESOURCE_ID_POWER_VALUE, 0, power);
+            datastore_set_float(datastore, RESOURCE_ID_POWER_TEMP_DELTA, 0, delta);
 
-                if (display_is_currently(datastore, DISPLAY_PAGE_POWER))
-                {
-                    led_flash(50, 0, 1);
-                }
-            }
-            else
+            if (display_is_currently(datastore, DISPLAY_PAGE_POWER))
             {
-                ESP_LOGW(TAG, "output temperature measurement has expired");
+                led_flash(50, 0, 1);
             }
         }
         else
         {
-            ESP_LOGW(TAG, "input temperature measurement has expired");
+            ESP_LOGW(TAG, "output temperature measurement has expired");
         }
-
-        vTaskDelayUntil(&last_wake_time, POWER_CALCULATION_PERIOD * 1000 / portTICK_PERIOD_MS);
     }
-
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
+    else
+    {
+        ESP_LOGW(TAG, "input temperature measurement has expired");
+    }
 }
 
-void power_init(UBaseType_t priority, const datastore_t * datastore)
+void power_init(const datastore_t * datastore)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
-
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
-    {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->datastore = datastore;
-        xTaskCreate(&power_calculation_task, "power_calculation_task", 4096, task_inputs, priority, &_task_handle);
-    }
+    _job = timer_wheel_add("power", POWER_CALCULATION_PERIOD * 1000, _power_calculation_job, (void *)datastore);
 }
 
 void power_delete(void)
 {
-    if (_task_handle)
-        vTaskDelete(_task_handle);
+    timer_wheel_remove(_job);
+    _job = TIMER_WHEEL_INVALID_JOB;
 }
@@ -28,7 +28,7 @@
 #include "freertos/FreeRTOS.h"
 #include "datastore/datastore.h"
 
-void power_init(UBaseType_t priority, const datastore_t * datastore);
+void power_init(const datastore_t * datastore);
 void power_delete(void);
 
 #endif // POWER_H
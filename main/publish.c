@@ -107,6 +107,48 @@ static const value_info_t values_info[] =
     { RESOURCE_ID_PUMPS_CP_STATE, 0, "pumps/cp/state", _as_string },
     { RESOURCE_ID_PUMPS_PP_STATE, 0, "pumps/pp/state", _as_string },
 
+    { RESOURCE_ID_AVR_EMERGENCY_LATENCY, 0, "avr/emergency_latency", _as_string },
+    { RESOURCE_ID_AVR_POLL_BUS_TIME_AVG, 0, "avr/poll_bus_time/avg", _as_string },
+    { RESOURCE_ID_AVR_POLL_BUS_TIME_MAX, 0, "avr/poll_bus_time/max", _as_string },
+    { RESOURCE_ID_AVR_COUNT_POLL, 0, "avr/count/poll", _as_string },
+    { RESOURCE_ID_AVR_COUNT_ATTENTION, 0, "avr/count/attention", _as_string },
+    { RESOURCE_ID_AVR_COUNT_CONTROL_WRITE, 0, "avr/count/control_write", _as_string },
+
+    { RESOURCE_ID_DISPLAY_LCD_BYTES, 0, "display/lcd_bytes", _as_string },
+    { RESOURCE_ID_DISPLAY_INPUT_LATENCY, 0, "display/input_latency", _as_string },
+
+    { RESOURCE_ID_I2C_ERROR_COUNT, 0, "i2c/error_count", _as_string },
+    { RESOURCE_ID_I2C_CLOCK_SPEED, 0, "i2c/clock_speed", _as_string },
+    { RESOURCE_ID_I2C_RECOVERY_COUNT, 0, "i2c/recovery_count", _as_string },
+    { RESOURCE_ID_I2C_RECOVERY_TIME_MAX, 0, "i2c/recovery_time_max", _as_string },
+
+    { RESOURCE_ID_I2C_DEVICE_ADDRESS,           0, "i2c/device/1/address",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TRANSACTIONS,      0, "i2c/device/1/transactions", _as_string },
+    { RESOURCE_ID_I2C_DEVICE_NACKS,             0, "i2c/device/1/nacks",        _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TIMEOUTS,          0, "i2c/device/1/timeouts",     _as_string },
+    { RESOURCE_ID_I2C_DEVICE_ERRORS,            0, "i2c/device/1/errors",       _as_string },
+    { RESOURCE_ID_I2C_DEVICE_RETRIES,           0, "i2c/device/1/retries",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_MAX,       0, "i2c/device/1/latency_max",  _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM, 0, "i2c/device/1/latency",      _as_string },
+
+    { RESOURCE_ID_I2C_DEVICE_ADDRESS,           1, "i2c/device/2/address",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TRANSACTIONS,      1, "i2c/device/2/transactions", _as_string },
+    { RESOURCE_ID_I2C_DEVICE_NACKS,             1, "i2c/device/2/nacks",        _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TIMEOUTS,          1, "i2c/device/2/timeouts",     _as_string },
+    { RESOURCE_ID_I2C_DEVICE_ERRORS,            1, "i2c/device/2/errors",       _as_string },
+    { RESOURCE_ID_I2C_DEVICE_RETRIES,           1, "i2c/device/2/retries",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_MAX,       1, "i2c/device/2/latency_max",  _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM, 1, "i2c/device/2/latency",      _as_string },
+
+    { RESOURCE_ID_I2C_DEVICE_ADDRESS,           2, "i2c/device/3/address",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TRANSACTIONS,      2, "i2c/device/3/transactions", _as_string },
+    { RESOURCE_ID_I2C_DEVICE_NACKS,             2, "i2c/device/3/nacks",        _as_string },
+    { RESOURCE_ID_I2C_DEVICE_TIMEOUTS,          2, "i2c/device/3/timeouts",     _as_string },
+    { RESOURCE_ID_I2C_DEVICE_ERRORS,            2, "i2c/device/3/errors",       _as_string },
+    { RESOURCE_ID_I2C_DEVICE_RETRIES,           2, "i2c/device/3/retries",      _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_MAX,       2, "i2c/device/3/latency_max",  _as_string },
+    { RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM, 2, "i2c/device/3/latency",      _as_string },
+
     { RESOURCE_ID_WIFI_ADDRESS,     0, "wifi/address",     _as_ipv4_address },
     //{ RESOURCE_ID_WIFI_RSSI,        0, "wifi/rssi",        _as_string },
 
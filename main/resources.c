@@ -33,8 +33,11 @@
 #include "wifi_support.h"
 #include "mqtt.h"
 #include "sensor_temp.h"
+#include "control.h"
 #include "nvs_support.h"
 #include "ota.h"
+#include "i2c_master.h"
+#include "display.h"
 
 #define TAG "resources"
 
@@ -67,6 +70,22 @@ datastore_t * resources_init(void)
         _add_resource(datastore, RESOURCE_ID_SYSTEM_IRAM_FREE,       "SYSTEM_IRAM_FREE",       datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_SYSTEM_UPTIME,          "SYSTEM_UPTIME",          datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
+        _add_resource(datastore, RESOURCE_ID_I2C_MASTER_DEVICE_COUNT,       "I2C_MASTER_DEVICE_COUNT",       datastore_create_resource(DATASTORE_TYPE_UINT8,  1));
+        _add_resource(datastore, RESOURCE_ID_I2C_MASTER_DEVICES,            "I2C_MASTER_DEVICES",            datastore_create_string_resource(I2C_MASTER_LEN_DEVICES, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_ERROR_COUNT,               "I2C_ERROR_COUNT",               datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_ERROR_TIMESTAMP,           "I2C_ERROR_TIMESTAMP",           datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_CLOCK_SPEED,               "I2C_CLOCK_SPEED",               datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_RECOVERY_COUNT,            "I2C_RECOVERY_COUNT",            datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_RECOVERY_TIME_MAX,         "I2C_RECOVERY_TIME_MAX",         datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_ADDRESS,            "I2C_DEVICE_ADDRESS",            datastore_create_resource(DATASTORE_TYPE_UINT8,  I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_TRANSACTIONS,       "I2C_DEVICE_TRANSACTIONS",       datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_NACKS,              "I2C_DEVICE_NACKS",              datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_TIMEOUTS,           "I2C_DEVICE_TIMEOUTS",           datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_ERRORS,             "I2C_DEVICE_ERRORS",             datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_RETRIES,            "I2C_DEVICE_RETRIES",            datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_MAX,        "I2C_DEVICE_LATENCY_MAX",        datastore_create_resource(DATASTORE_TYPE_UINT32, I2C_MASTER_MAX_DEVICES));
+        _add_resource(datastore, RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM,  "I2C_DEVICE_LATENCY_HISTOGRAM",  datastore_create_string_resource(I2C_MASTER_LEN_HISTOGRAM, I2C_MASTER_MAX_DEVICES));
+
         _add_resource(datastore, RESOURCE_ID_WIFI_SSID,              "WIFI_SSID",              datastore_create_string_resource(WIFI_LEN_SSID, 1));
         _add_resource(datastore, RESOURCE_ID_WIFI_PASSWORD,          "WIFI_PASSWORD",          datastore_create_string_resource(WIFI_LEN_PASSWORD, 1));
         _add_resource(datastore, RESOURCE_ID_WIFI_STATUS,            "WIFI_STATUS",            datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
@@ -112,22 +131,25 @@ datastore_t * resources_init(void)
         _add_resource(datastore, RESOURCE_ID_PUMPS_CP_STATE,         "PUMPS_CP_STATE",         datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_PUMPS_PP_STATE,         "PUMPS_PP_STATE",         datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
-        _add_resource(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA,    "CONTROL_CP_ON_DELTA",    datastore_create_resource(DATASTORE_TYPE_FLOAT, 1));
-        _add_resource(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA,   "CONTROL_CP_OFF_DELTA",   datastore_create_resource(DATASTORE_TYPE_FLOAT, 1));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA,    "CONTROL_CP_ON_DELTA",    datastore_create_resource(DATASTORE_TYPE_FLOAT, CONTROL_CP_INSTANCES));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA,   "CONTROL_CP_OFF_DELTA",   datastore_create_resource(DATASTORE_TYPE_FLOAT, CONTROL_CP_INSTANCES));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, "CONTROL_CP_PREDICT_HORIZON", datastore_create_resource(DATASTORE_TYPE_UINT32, CONTROL_CP_INSTANCES));
         _add_resource(datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, "CONTROL_FLOW_THRESHOLD", datastore_create_resource(DATASTORE_TYPE_FLOAT, 1));
 
         _add_resource(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT,          "CONTROL_PP_CYCLE_COUNT",          datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION,    "CONTROL_PP_CYCLE_ON_DURATION",    datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_CONTROL_PP_CYCLE_PAUSE_DURATION, "CONTROL_PP_CYCLE_PAUSE_DURATION", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
-        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR,           "CONTROL_PP_DAILY_HOUR",           datastore_create_resource(DATASTORE_TYPE_INT32, 1));
-        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE,         "CONTROL_PP_DAILY_MINUTE",         datastore_create_resource(DATASTORE_TYPE_INT32, 1));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR,           "CONTROL_PP_DAILY_HOUR",           datastore_create_resource(DATASTORE_TYPE_INT32, CONTROL_PP_DAILY_INSTANCES));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE,         "CONTROL_PP_DAILY_MINUTE",         datastore_create_resource(DATASTORE_TYPE_INT32, CONTROL_PP_DAILY_INSTANCES));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS,           "CONTROL_PP_DAILY_DAYS",           datastore_create_resource(DATASTORE_TYPE_UINT8, CONTROL_PP_DAILY_INSTANCES));
         _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE,         "CONTROL_PP_DAILY_ENABLE",         datastore_create_resource(DATASTORE_TYPE_BOOL, 1));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_PP_DAILY_NEXT,           "CONTROL_PP_DAILY_NEXT",           datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
         _add_resource(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH, "CONTROL_SAFE_TEMP_HIGH", datastore_create_resource(DATASTORE_TYPE_FLOAT, 1));
         _add_resource(datastore, RESOURCE_ID_CONTROL_SAFE_TEMP_LOW,  "CONTROL_SAFE_TEMP_LOW",  datastore_create_resource(DATASTORE_TYPE_FLOAT, 1));
 
-        _add_resource(datastore, RESOURCE_ID_CONTROL_STATE_CP, "CONTROL_STATE_CP",   datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_CONTROL_STATE_CP, "CONTROL_STATE_CP",   datastore_create_resource(DATASTORE_TYPE_UINT32, CONTROL_CP_INSTANCES));
         _add_resource(datastore, RESOURCE_ID_CONTROL_STATE_PP, "CONTROL_STATE_PP",   datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
         _add_resource(datastore, RESOURCE_ID_AVR_VERSION,       "AVR_VERSION",       datastore_create_resource(DATASTORE_TYPE_UINT8, 1));
@@ -139,9 +161,19 @@ datastore_t * resources_init(void)
         _add_resource(datastore, RESOURCE_ID_AVR_COUNT_PP_MODE, "AVR_COUNT_PP_MODE", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_AVR_COUNT_PP_MAN,  "AVR_COUNT_PP_MAN",  datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
         _add_resource(datastore, RESOURCE_ID_AVR_COUNT_BUZZER,  "AVR_COUNT_BUZZER",  datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_EMERGENCY_LATENCY, "AVR_EMERGENCY_LATENCY", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_AVG, "AVR_POLL_BUS_TIME_AVG", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_POLL_BUS_TIME_MAX, "AVR_POLL_BUS_TIME_MAX", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_COUNT_POLL,      "AVR_COUNT_POLL",      datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_COUNT_ATTENTION, "AVR_COUNT_ATTENTION", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_AVR_COUNT_CONTROL_WRITE, "AVR_COUNT_CONTROL_WRITE", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
         _add_resource(datastore, RESOURCE_ID_DISPLAY_PAGE,              "DISPLAY_PAGE",              datastore_create_resource(DATASTORE_TYPE_INT32, 1));
         _add_resource(datastore, RESOURCE_ID_DISPLAY_BACKLIGHT_TIMEOUT, "DISPLAY_BACKLIGHT_TIMEOUT", datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_DISPLAY_LCD_BYTES,         "DISPLAY_LCD_BYTES",         datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
+        _add_resource(datastore, RESOURCE_ID_DISPLAY_HANDLER_COUNT,     "DISPLAY_HANDLER_COUNT",     datastore_create_resource(DATASTORE_TYPE_UINT32, DISPLAY_PAGE_LAST));
+        _add_resource(datastore, RESOURCE_ID_DISPLAY_HANDLER_TIME,      "DISPLAY_HANDLER_TIME",      datastore_create_resource(DATASTORE_TYPE_UINT32, DISPLAY_PAGE_LAST));
+        _add_resource(datastore, RESOURCE_ID_DISPLAY_INPUT_LATENCY,     "DISPLAY_INPUT_LATENCY",     datastore_create_resource(DATASTORE_TYPE_UINT32, 1));
 
         _add_resource(datastore, RESOURCE_ID_OTA_URL, "OTA_URL", datastore_create_string_resource(OTA_URL_LEN, 1));
     }
@@ -238,12 +270,26 @@ void resources_load(const datastore_t * datastore)
 
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_TEMP_PERIOD, 0, "5000"));
 
-        ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, 0, "7.0"));
-        ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, 0, "5.0"));
+        for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+        {
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, i, "7.0"));
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, i, "5.0"));
+            // predictive start is experimental: on the host plant model (host/test/bench_predict.c)
+            // it trades more pump starts for a little more heat, so it stays off by default
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, i, "0"));
+        }
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 0, "8.0"));
 
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, 0, "9"));
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0, "0"));
+        ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, 0, "127"));
+        for (size_t i = 1; i < CONTROL_PP_DAILY_INSTANCES; ++i)
+        {
+            // additional purge times are disabled by default
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, i, "-1"));
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, i, "-1"));
+            ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, i, "127"));
+        }
 
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT, 0, "5"));
         ERROR_CHECK(_load_from_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION, 0, "30"));
@@ -296,12 +342,20 @@ void resources_save(const datastore_t * datastore)
 
             ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_TEMP_PERIOD, 0));
 
-            ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, 0));
-            ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, 0));
+            for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+            {
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, i));
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, i));
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, i));
+            }
             ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_FLOW_THRESHOLD, 0));
 
-            ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, 0));
-            ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0));
+            for (size_t i = 0; i < CONTROL_PP_DAILY_INSTANCES; ++i)
+            {
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, i));
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, i));
+                ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, i));
+            }
 
             ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_CYCLE_COUNT, 0));
             ESP_ERROR_CHECK(_save_to_nvs(nh, datastore, RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION, 0));
@@ -39,10 +39,22 @@ typedef enum
     RESOURCE_ID_SYSTEM_IRAM_FREE,
     RESOURCE_ID_SYSTEM_UPTIME,
 
-//    RESOURCE_ID_I2C_MASTER_DEVICE_COUNT,
-//    RESOURCE_ID_I2C_ERROR_COUNT,
-//    RESOURCE_ID_I2C_ERROR_TIMESTAMP,
-//
+    RESOURCE_ID_I2C_MASTER_DEVICE_COUNT,
+    RESOURCE_ID_I2C_MASTER_DEVICES,                 // addresses that responded to a probe
+    RESOURCE_ID_I2C_ERROR_COUNT,
+    RESOURCE_ID_I2C_ERROR_TIMESTAMP,                // seconds since boot of the latest error
+    RESOURCE_ID_I2C_CLOCK_SPEED,                    // Hz, current adaptive bus clock
+    RESOURCE_ID_I2C_RECOVERY_COUNT,                 // stuck-bus recoveries
+    RESOURCE_ID_I2C_RECOVERY_TIME_MAX,              // microseconds
+    RESOURCE_ID_I2C_DEVICE_ADDRESS,
+    RESOURCE_ID_I2C_DEVICE_TRANSACTIONS,
+    RESOURCE_ID_I2C_DEVICE_NACKS,
+    RESOURCE_ID_I2C_DEVICE_TIMEOUTS,
+    RESOURCE_ID_I2C_DEVICE_ERRORS,
+    RESOURCE_ID_I2C_DEVICE_RETRIES,
+    RESOURCE_ID_I2C_DEVICE_LATENCY_MAX,             // microseconds
+    RESOURCE_ID_I2C_DEVICE_LATENCY_HISTOGRAM,       // comma-separated counts per log2 bucket
+
     RESOURCE_ID_WIFI_SSID,
     RESOURCE_ID_WIFI_PASSWORD,
     RESOURCE_ID_WIFI_STATUS,
@@ -94,13 +106,16 @@ typedef enum
 
     RESOURCE_ID_CONTROL_CP_ON_DELTA,
     RESOURCE_ID_CONTROL_CP_OFF_DELTA,
+    RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON,  // seconds, 0 to disable predictive control
     RESOURCE_ID_CONTROL_FLOW_THRESHOLD,
     RESOURCE_ID_CONTROL_PP_CYCLE_COUNT,
     RESOURCE_ID_CONTROL_PP_CYCLE_ON_DURATION,  // seconds
     RESOURCE_ID_CONTROL_PP_CYCLE_PAUSE_DURATION,  // seconds
     RESOURCE_ID_CONTROL_PP_DAILY_HOUR,
     RESOURCE_ID_CONTROL_PP_DAILY_MINUTE,
+    RESOURCE_ID_CONTROL_PP_DAILY_DAYS,   // bitmask of weekdays, bit 0 is Sunday
     RESOURCE_ID_CONTROL_PP_DAILY_ENABLE,
+    RESOURCE_ID_CONTROL_PP_DAILY_NEXT,   // absolute time of next scheduled purge, 0 if none
     RESOURCE_ID_CONTROL_SAFE_TEMP_HIGH,  // temperature at which to initiate emergency PP cycle
     RESOURCE_ID_CONTROL_SAFE_TEMP_LOW,   // temperature at which to terminate emergency PP cycle
     RESOURCE_ID_CONTROL_STATE_CP,
@@ -115,9 +130,19 @@ typedef enum
     RESOURCE_ID_AVR_COUNT_PP_MODE,
     RESOURCE_ID_AVR_COUNT_PP_MAN,
     RESOURCE_ID_AVR_COUNT_BUZZER,
+    RESOURCE_ID_AVR_EMERGENCY_LATENCY,   // microseconds from emergency request to SSR2 write
+    RESOURCE_ID_AVR_POLL_BUS_TIME_AVG,   // microseconds the I2C bus is held per register poll, since boot
+    RESOURCE_ID_AVR_POLL_BUS_TIME_MAX,   // microseconds
+    RESOURCE_ID_AVR_COUNT_POLL,          // register polls since boot
+    RESOURCE_ID_AVR_COUNT_ATTENTION,     // register polls triggered by the attention line
+    RESOURCE_ID_AVR_COUNT_CONTROL_WRITE, // writes of CONTROL to reconcile the desired outputs
 
     RESOURCE_ID_DISPLAY_PAGE,
     RESOURCE_ID_DISPLAY_BACKLIGHT_TIMEOUT,
+    RESOURCE_ID_DISPLAY_LCD_BYTES,       // command and data bytes sent to the LCD controller since boot, added once a minute
+    RESOURCE_ID_DISPLAY_HANDLER_COUNT,   // per page: handler invocations since boot, added once a minute
+    RESOURCE_ID_DISPLAY_HANDLER_TIME,    // per page: microseconds spent in the handler since boot, added once a minute
+    RESOURCE_ID_DISPLAY_INPUT_LATENCY,   // microseconds from user input to the resulting page being on the LCD
 
     RESOURCE_ID_OTA_URL,
 
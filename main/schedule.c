@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "schedule.h"
+
+#define DAYS_PER_WEEK (7)
+
+static bool _entry_enabled(const schedule_entry_t * entry)
+{
+    return entry->hour >= 0 && entry->hour < 24
+        && entry->minute >= 0 && entry->minute < 60
+        && (entry->days & SCHEDULE_ALL_DAYS) != 0;
+}
+
+void schedule_init(schedule_t * schedule)
+{
+    assert(schedule != NULL);
+    memset(schedule, 0, sizeof(*schedule));
+    schedule->next = SCHEDULE_INVALID_TIME;
+    schedule->last = SCHEDULE_INVALID_TIME;
+    schedule->dirty = true;
+}
+
+void schedule_set_entries(schedule_t * schedule, const schedule_entry_t * entries, size_t num_entries)
+{
+    assert(schedule != NULL);
+    assert(num_entries == 0 || entries != NULL);
+    if (num_entries > SCHEDULE_MAX_ENTRIES)
+    {
+        num_entries = SCHEDULE_MAX_ENTRIES;
+    }
+    memcpy(schedule->entries, entries, num_entries * sizeof(*entries));
+    schedule->num_entries = num_entries;
+    schedule->dirty = true;
+}
+
+time_t schedule_next(const schedule_entry_t * entries, size_t num_entries, time_t after)
+{
+    time_t next = SCHEDULE_INVALID_TIME;
+    struct tm after_tm = { 0 };
+    localtime_r(&after, &after_tm);
+
+    for (size_t i = 0; i < num_entries; ++i)
+    {
+        const schedule_entry_t * entry = &entries[i];
+        if (!_entry_enabled(entry))
+        {
+            continue;
+        }
+
+        // today, and then each following day - a full week plus one day covers
+        // a single-weekday mask that matches today but has already passed
+        for (int day = 0; day <= DAYS_PER_WEEK; ++day)
+        {
+            // compare wall clock time for today, so that a time in the repeated hour
+            // at the end of DST does not fire a second time
+            if (day == 0 && entry->hour * 60 + entry->minute <= after_tm.tm_hour * 60 + after_tm.tm_min)
+            {
+                continue;
+            }
+
+            struct tm candidate = after_tm;
+            candidate.tm_mday += day;
+            candidate.tm_hour = entry->hour;
+            candidate.tm_min = entry->minute;
+            candidate.tm_sec = 0;
+            candidate.tm_isdst = -1;   // let mktime determine DST for the candidate date
+
+            // a time inside a DST gap is normalised forward by mktime
+            time_t t = mktime(&candidate);
+            if (t != SCHEDULE_INVALID_TIME && t > after && (entry->days & (1 << candidate.tm_wday)))
+            {
+                if (next == SCHEDULE_INVALID_TIME || t < next)
+                {
+                    next = t;
+                }
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+bool schedule_poll(schedule_t * schedule, time_t now, uint32_t uptime)
+{
+    assert(schedule != NULL);
+    bool fired = false;
+
+    // detect the wall clock being stepped relative to uptime
+    int64_t clock_offset = (int64_t)now - (int64_t)uptime;
+    int64_t drift = clock_offset - schedule->clock_offset;
+    bool stepped = drift > SCHEDULE_CLOCK_STEP || drift < -SCHEDULE_CLOCK_STEP;
+
+    // fire once the next time is reached - including when the clock is stepped forward across
+    // it, in which case the firing is late rather than skipped
+    if (!schedule->dirty && schedule->next != SCHEDULE_INVALID_TIME && now >= schedule->next)
+    {
+        fired = true;
+        schedule->last = now;
+    }
+
+    if (fired || stepped || schedule->dirty)
+    {
+        // a step backward must not repeat the last firing
+        time_t after = now;
+        if (!schedule->dirty && schedule->last != SCHEDULE_INVALID_TIME && schedule->last > after)
+        {
+            after = schedule->last;
+        }
+        schedule->next = schedule_next(schedule->entries, schedule->num_entries, after);
+        schedule->clock_offset = clock_offset;
+        schedule->dirty = false;
+    }
+
+    return fired;
+}
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file schedule.h
+ * @brief Time-of-day scheduler.
+ *
+ * Each entry fires at a local hour and minute on a set of weekdays. Rather than converting
+ * the current time to local time and comparing fields on every poll, the scheduler computes
+ * the absolute time of the next firing once, and the caller then only compares against
+ * time(). The next firing is recomputed when it fires, when the entries change, or when
+ * the system clock is stepped (e.g. by SNTP). DST is accounted for by mktime() at the time
+ * of computation, so no periodic recomputation is needed.
+ */
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define SCHEDULE_MAX_ENTRIES   (4)
+#define SCHEDULE_ALL_DAYS      (0x7f)       // bit 0 is Sunday, as per tm_wday
+#define SCHEDULE_INVALID_TIME  ((time_t)-1)
+#define SCHEDULE_CLOCK_STEP    (2)          // seconds of clock movement that forces recomputation
+
+typedef struct
+{
+    int32_t hour;      ///< 0-23, or negative to disable the entry
+    int32_t minute;    ///< 0-59, or negative to disable the entry
+    uint8_t days;      ///< bitmask of weekdays, bit 0 is Sunday
+} schedule_entry_t;
+
+typedef struct
+{
+    schedule_entry_t entries[SCHEDULE_MAX_ENTRIES];
+    size_t num_entries;
+    time_t next;            ///< absolute time of the next firing, or SCHEDULE_INVALID_TIME
+    time_t last;            ///< time of the last firing, or SCHEDULE_INVALID_TIME
+    int64_t clock_offset;   ///< wall clock minus uptime when next was computed
+    bool dirty;             ///< entries have changed, recompute on next poll
+} schedule_t;
+
+/**
+ * @brief Initialise a schedule with no entries.
+ */
+void schedule_init(schedule_t * schedule);
+
+/**
+ * @brief Replace the entries of a schedule. The next firing is recomputed on the next poll.
+ */
+void schedule_set_entries(schedule_t * schedule, const schedule_entry_t * entries, size_t num_entries);
+
+/**
+ * @brief Compute the earliest time strictly after the given time at which any entry fires.
+ * @return Absolute time, or SCHEDULE_INVALID_TIME if no entry is enabled.
+ */
+time_t schedule_next(const schedule_entry_t * entries, size_t num_entries, time_t after);
+
+/**
+ * @brief Check whether the schedule has fired.
+ *
+ * If the wall clock is stepped forward past the next firing, the firing is reported (late) on
+ * this poll rather than skipped. If it is stepped backward past the last firing, that firing is
+ * not repeated.
+ * @param[in,out] schedule The schedule.
+ * @param[in] now Current wall clock time.
+ * @param[in] uptime Current time since boot in seconds, used to detect clock steps.
+ * @return true if an entry fired since the last poll.
+ */
+bool schedule_poll(schedule_t * schedule, time_t now, uint32_t uptime);
+
+#endif // SCHEDULE_H
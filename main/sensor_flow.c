@@ -22,11 +22,8 @@
  * SOFTWARE.
  */
 
-#include <string.h>
-
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "driver/rmt.h"
@@ -36,10 +33,10 @@
 #include "sensor_flow.h"
 #include "constants.h"
 #include "resources.h"
-#include "publish.h"
 #include "utils.h"
 #include "datastore/datastore.h"
 #include "display.h"
+#include "sensor_scheduler.h"
 
 #define TAG "sensor_flow"
 
@@ -55,9 +52,12 @@ typedef struct
     float sampling_window;     // sample window length (in seconds)
     uint16_t filter_length;    // counter filter length in APB cycles
     const datastore_t * datastore;
-} task_inputs_t;
+    rmt_item32_t rmt_items[RMT_MEM_ITEM_NUM];
+    int num_rmt_items;
+    int16_t count;
+} flow_context_t;
 
-static TaskHandle_t _task_handle = NULL;
+static flow_context_t _context = { 0 };
 
 static void init_rmt(uint8_t tx_gpio, rmt_channel_t channel, uint8_t clk_div)
 {
@@ -192,106 +192,103 @@ static void _display_page_changed(const datastore_t * datastore, datastore_resou
     }
 }
 
-static void sensor_flow_task(void * pvParameter)
+static bool _flow_init(sensor_driver_t * driver)
 {
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
+    flow_context_t * context = (flow_context_t *)driver->context;
 
-    init_rmt(task_inputs->rmt_gpio, task_inputs->rmt_channel, task_inputs->rmt_clk_div);
-    init_pcnt(task_inputs->pcnt_gpio, task_inputs->rmt_gpio, task_inputs->pcnt_unit, task_inputs->pcnt_channel, task_inputs->filter_length);
+    init_rmt(context->rmt_gpio, context->rmt_channel, context->rmt_clk_div);
+    init_pcnt(context->pcnt_gpio, context->rmt_gpio, context->pcnt_unit, context->pcnt_channel, context->filter_length);
 
     // assuming 80MHz APB clock
-    const double rmt_period = (double)(task_inputs->rmt_clk_div) / 80000000.0;
+    const double rmt_period = (double)(context->rmt_clk_div) / 80000000.0;
 
-    rmt_item32_t rmt_items[RMT_MEM_ITEM_NUM] = { 0 };
-    int num_rmt_items = create_rmt_window(rmt_items, task_inputs->sampling_window, rmt_period);
-    assert(num_rmt_items < RMT_MEM_ITEM_NUM);
-
-    TickType_t last_wake_time = xTaskGetTickCount();
+    context->num_rmt_items = create_rmt_window(context->rmt_items, context->sampling_window, rmt_period);
+    assert(context->num_rmt_items < RMT_MEM_ITEM_NUM);
 
     // subscribe to display changes
-    datastore_add_set_callback(datastore, RESOURCE_ID_DISPLAY_PAGE, 0, _display_page_changed, NULL);
+    datastore_add_set_callback(context->datastore, RESOURCE_ID_DISPLAY_PAGE, 0, _display_page_changed, NULL);
+    return true;
+}
 
-    while (1)
-    {
-        last_wake_time = xTaskGetTickCount();
+static void _flow_start(sensor_driver_t * driver)
+{
+    flow_context_t * context = (flow_context_t *)driver->context;
 
-        // clear counter
-        pcnt_counter_clear(task_inputs->pcnt_unit);
+    // clear counter
+    pcnt_counter_clear(context->pcnt_unit);
 
-        // start sampling window
-        rmt_write_items(task_inputs->rmt_channel, rmt_items, num_rmt_items, false);
+    // start sampling window
+    rmt_write_items(context->rmt_channel, context->rmt_items, context->num_rmt_items, false);
+}
 
-        // wait for window to finish
-        rmt_wait_tx_done(task_inputs->rmt_channel, portMAX_DELAY);
+static bool _flow_collect(sensor_driver_t * driver)
+{
+    flow_context_t * context = (flow_context_t *)driver->context;
 
-        // read counter
-        int16_t count = 0;
-        pcnt_get_counter_value(task_inputs->pcnt_unit, &count);
+    // the window should have finished by now, but make sure
+    rmt_wait_tx_done(context->rmt_channel, portMAX_DELAY);
 
-        double frequency_hz = 0.0;
-        double rate_lpm = 0.0;
-        bool override = false;
+    // read counter
+    context->count = 0;
+    return pcnt_get_counter_value(context->pcnt_unit, &context->count) == ESP_OK;
+}
 
-        datastore_age_t override_age = 0;
-        datastore_get_age(datastore, RESOURCE_ID_FLOW_RATE_OVERRIDE, 0, &override_age);
-        override = override_age < (esp_timer_get_time() - 10);
-        if (override)
-        {
-            float override_value = 0.0f;
-            datastore_get_float(datastore, RESOURCE_ID_FLOW_RATE_OVERRIDE, 0, &override_value);
-            frequency_hz = -1.0;  // to indicate override
-            rate_lpm = override_value;
-        }
-        else
-        {
-            // TODO: check for overflow?
-            frequency_hz = count / 2.0 / task_inputs->sampling_window;
-            rate_lpm = calc_flow_rate_lpm(frequency_hz);
-        }
+static void _flow_publish(sensor_driver_t * driver, bool ok)
+{
+    flow_context_t * context = (flow_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
 
-        datastore_set_float(datastore, RESOURCE_ID_FLOW_FREQUENCY, 0, frequency_hz);
-        datastore_set_float(datastore, RESOURCE_ID_FLOW_RATE, 0, rate_lpm);
-        ESP_LOGI(TAG, "counter %d, frequency %f Hz, rate %f LPM%s", count, frequency_hz, rate_lpm, override ? " OVERRIDE" : "");
+    double frequency_hz = 0.0;
+    double rate_lpm = 0.0;
 
-        vTaskDelayUntil(&last_wake_time, task_inputs->sampling_period * 1000 / portTICK_PERIOD_MS);
+    float override_value = 0.0f;
+    bool override = sensor_scheduler_override(datastore, RESOURCE_ID_FLOW_RATE_OVERRIDE, 0, &override_value);
+    if (override)
+    {
+        frequency_hz = -1.0;  // to indicate override
+        rate_lpm = override_value;
+    }
+    else
+    {
+        // TODO: check for overflow?
+        frequency_hz = context->count / 2.0 / context->sampling_window;
+        rate_lpm = calc_flow_rate_lpm(frequency_hz);
     }
 
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
+    datastore_set_float(datastore, RESOURCE_ID_FLOW_FREQUENCY, 0, frequency_hz);
+    datastore_set_float(datastore, RESOURCE_ID_FLOW_RATE, 0, rate_lpm);
+    ESP_LOGI(TAG, "counter %d, frequency %f Hz, rate %f LPM%s", context->count, frequency_hz, rate_lpm, override ? " OVERRIDE" : "");
 }
 
+// the LED mirrors the pulse input on the flow page instead of flashing per sample
+static sensor_driver_t _driver = {
+    .name = "flow",
+    .bus = SENSOR_BUS_PCNT,
+    .init = _flow_init,
+    .start = _flow_start,
+    .collect = _flow_collect,
+    .publish = _flow_publish,
+    .context = &_context,
+};
+
 void sensor_flow_init(uint8_t pcnt_gpio, pcnt_unit_t pcnt_unit, pcnt_channel_t pcnt_channel,
                       uint8_t rmt_gpio, rmt_channel_t rmt_channel, uint8_t rmt_clk_div,
-                      float sampling_period, float sampling_window, uint16_t filter_length, UBaseType_t priority, const datastore_t * datastore)
+                      float sampling_period, float sampling_window, uint16_t filter_length, const datastore_t * datastore)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
 
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
-    {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->pcnt_gpio = pcnt_gpio;
-        task_inputs->pcnt_unit = pcnt_unit;
-        task_inputs->pcnt_channel = pcnt_channel;
-        task_inputs->rmt_gpio = rmt_gpio;
-        task_inputs->rmt_channel = rmt_channel;
-        task_inputs->rmt_clk_div = rmt_clk_div;
-        task_inputs->sampling_period = sampling_period;
-        task_inputs->sampling_window = sampling_window;
-        task_inputs->filter_length = filter_length;
-        task_inputs->datastore = datastore;
-        xTaskCreate(&sensor_flow_task, "sensor_flow_task", 4096, task_inputs, priority, &_task_handle);
-    }
-}
-
-void sensor_flow_delete(void)
-{
-    if (_task_handle)
-        vTaskDelete(_task_handle);
+    _context.pcnt_gpio = pcnt_gpio;
+    _context.pcnt_unit = pcnt_unit;
+    _context.pcnt_channel = pcnt_channel;
+    _context.rmt_gpio = rmt_gpio;
+    _context.rmt_channel = rmt_channel;
+    _context.rmt_clk_div = rmt_clk_div;
+    _context.sampling_period = sampling_period;
+    _context.sampling_window = sampling_window;
+    _context.filter_length = filter_length;
+    _context.datastore = datastore;
+
+    _driver.period = sampling_period * 1000;
+    _driver.delay = sampling_window * 1000;
+    sensor_scheduler_add(&_driver);
 }
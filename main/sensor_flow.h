@@ -29,7 +29,7 @@
 #include "driver/pcnt.h"
 #include "datastore/datastore.h"
 
-/* @brief Initialise Flow Meter sensor task.
+/* @brief Register the Flow Meter sensor with the sensor scheduler.
  * @param[in] pcnt_gpio The GPIO from which to count events.
  * @param[in] pcnt_unit The PCNT unit to use.
  * @param[in] pcnt_channel The PCNT channel to use.
@@ -42,7 +42,6 @@
  */
 void sensor_flow_init(uint8_t pcnt_gpio, pcnt_unit_t pcnt_unit, pcnt_channel_t pcnt_channel,
                       uint8_t rmt_gpio, rmt_channel_t rmt_channel, uint8_t rmt_clk_div,
-                      float sampling_period, float sampling_window, uint16_t filter_length, UBaseType_t priority, const datastore_t * datastore);
-void sensor_flow_delete(void);
+                      float sampling_period, float sampling_window, uint16_t filter_length, const datastore_t * datastore);
 
 #endif // SENSOR_FLOW_H
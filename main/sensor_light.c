@@ -22,11 +22,8 @@
  * SOFTWARE.
  */
 
-#include <string.h>
-
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_log.h"
 
@@ -36,133 +33,179 @@
 #include "utils.h"
 #include "smbus.h"
 #include "tsl2561.h"
-#include "publish.h"
 #include "datastore/datastore.h"
 #include "display.h"
-#include "led.h"
+#include "sensor_scheduler.h"
 
 #define TAG "sensor_light"
 
 #define SAMPLE_PERIOD (5000)  // sensor sampling period in milliseconds
-
-static TaskHandle_t _task_handle = NULL;
+#define INTEGRATION_DELAY (102)  // milliseconds, 101 ms integration time plus margin
+
+// TSL2561 registers, accessed directly so that the integration time is spent off the bus
+#define TSL2561_COMMAND_CMD       (0x80)
+#define TSL2561_COMMAND_WORD      (0x20)
+#define TSL2561_REG_CONTROL       (0x00)
+#define TSL2561_REG_TIMING        (0x01)
+#define TSL2561_REG_DATA0LOW      (0x0C)
+#define TSL2561_REG_DATA1LOW      (0x0E)
+#define TSL2561_CONTROL_POWER_ON  (0x03)
+#define TSL2561_CONTROL_POWER_OFF (0x00)
 
 typedef struct
 {
     i2c_master_info_t * i2c_master_info;
     const datastore_t * datastore;
-} task_inputs_t;
+    smbus_info_t * smbus_info;
+    tsl2561_info_t * tsl2561_info;
+    tsl2561_visible_t visible;
+    tsl2561_infrared_t infrared;
+    esp_err_t start_err;
+} light_context_t;
 
-static void sensor_light_task(void * pvParameter)
-{
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+static light_context_t _context = { 0 };
 
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    i2c_master_info_t * i2c_master_info = task_inputs->i2c_master_info;
-    i2c_port_t i2c_port = i2c_master_info->port;
-    const datastore_t * datastore = task_inputs->datastore;
+// called with the I2C bus held
+static bool _light_init(sensor_driver_t * driver)
+{
+    light_context_t * context = (light_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
 
     uint8_t i2c_address = 0;
     datastore_get_uint8(datastore, RESOURCE_ID_LIGHT_I2C_ADDRESS, 0, &i2c_address);
 
-    // before accessing I2C, use a lock to gain exclusive use of the bus
-    i2c_master_lock(i2c_master_info, portMAX_DELAY);
-
     // Set up the SMBus
-    smbus_info_t * smbus_info = smbus_malloc();
-    smbus_init(smbus_info, i2c_port, i2c_address);
-    smbus_set_timeout(smbus_info, 1000 / portTICK_RATE_MS);
+    context->smbus_info = smbus_malloc();
+    smbus_init(context->smbus_info, context->i2c_master_info->port, i2c_address);
+    smbus_set_timeout(context->smbus_info, 1000 / portTICK_RATE_MS);
 
     // Set up the TSL2561 device
-    tsl2561_info_t * tsl2561_info = tsl2561_malloc();
-    if (tsl2561_init(tsl2561_info, smbus_info) == ESP_OK)
+    context->tsl2561_info = tsl2561_malloc();
+    if (tsl2561_init(context->tsl2561_info, context->smbus_info) == ESP_OK)
     {
         // Set sensor integration time and gain
         //tsl2561_set_integration_time_and_gain(tsl2561_info, TSL2561_INTEGRATION_TIME_402MS, TSL2561_GAIN_1X);
-        tsl2561_set_integration_time_and_gain(tsl2561_info, TSL2561_INTEGRATION_TIME_101MS, TSL2561_GAIN_1X);
+        tsl2561_set_integration_time_and_gain(context->tsl2561_info, TSL2561_INTEGRATION_TIME_101MS, TSL2561_GAIN_1X);
         //tsl2561_set_integration_time_and_gain(tsl2561_info, TSL2561_INTEGRATION_TIME_402MS, TSL2561_GAIN_16X);
 
         datastore_set_bool(datastore, RESOURCE_ID_LIGHT_DETECTED, 0, true);
-        i2c_master_unlock(i2c_master_info);
-
-        TickType_t last_wake_time = xTaskGetTickCount();
-
-        while (1)
-        {
-            last_wake_time = xTaskGetTickCount();
-
-            tsl2561_visible_t visible = 0;
-            tsl2561_infrared_t infrared = 0;
-
-            bool control_led = display_is_currently(datastore, DISPLAY_PAGE_SENSORS_LIGHT);
-            if (control_led)
-            {
-                led_on();
-            }
-
-            i2c_master_lock(i2c_master_info, portMAX_DELAY);
-            esp_err_t err = tsl2561_read(tsl2561_info, &visible, &infrared);
-            i2c_master_unlock(i2c_master_info);
-
-            if (control_led)
-            {
-                led_off();
-            }
-
-            if (err == ESP_OK)
-            {
-                uint32_t lux = tsl2561_compute_lux(tsl2561_info, visible, infrared);
-
-                ESP_LOGI(TAG, "Light Sensor Readings:");
-                ESP_LOGI(TAG, "  Full spectrum: %d", visible + infrared);
-                ESP_LOGI(TAG, "  Infrared:      %d", infrared);
-                ESP_LOGI(TAG, "  Visible:       %d", visible);
-                ESP_LOGI(TAG, "  Illuminance:   %d lux", lux);
-
-                datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_FULL, 0, visible + infrared);
-                datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_INFRARED, 0, infrared);
-                datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_VISIBLE, 0, visible);
-                datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_ILLUMINANCE, 0, lux);
-            }
-            else
-            {
-                ESP_LOGW(TAG, "sensor error");
-            }
-
-            vTaskDelayUntil(&last_wake_time, SAMPLE_PERIOD / portTICK_PERIOD_MS);
-        }
+        return true;
     }
-    else
+
+    datastore_set_bool(datastore, RESOURCE_ID_LIGHT_DETECTED, 0, false);
+    smbus_free(&context->smbus_info);
+    tsl2561_free(&context->tsl2561_info);
+    return false;
+}
+
+// Each register access is one transaction, recorded on its own so that the I2C statistics
+// hold bus time only - the integration runs between transactions with the bus released
+static esp_err_t _write_register(const light_context_t * context, uint8_t reg, uint8_t value)
+{
+    uint64_t start = microseconds_since_boot();
+    esp_err_t err = smbus_write_byte(context->smbus_info, TSL2561_COMMAND_CMD | reg, value);
+    return i2c_master_record(context->smbus_info, err, start, 0);
+}
+
+static esp_err_t _read_channel(const light_context_t * context, uint8_t reg, uint16_t * value)
+{
+    uint64_t start = microseconds_since_boot();
+    esp_err_t err = smbus_read_word(context->smbus_info, TSL2561_COMMAND_CMD | TSL2561_COMMAND_WORD | reg, value);
+    return i2c_master_record(context->smbus_info, err, start, 0);
+}
+
+// called with the I2C bus held: power up to begin one integration period
+static void _light_start(sensor_driver_t * driver)
+{
+    light_context_t * context = (light_context_t *)driver->context;
+    const tsl2561_info_t * tsl2561_info = context->tsl2561_info;
+
+    // restore the timing in case the device has been power cycled since init
+    esp_err_t err = _write_register(context, TSL2561_REG_TIMING, tsl2561_info->integration_time | tsl2561_info->gain);
+    if (err == ESP_OK)
+    {
+        err = _write_register(context, TSL2561_REG_CONTROL, TSL2561_CONTROL_POWER_ON);
+    }
+    context->start_err = err;
+}
+
+// called with the I2C bus held, once the integration period has passed
+static bool _light_collect(sensor_driver_t * driver)
+{
+    light_context_t * context = (light_context_t *)driver->context;
+    context->visible = 0;
+    context->infrared = 0;
+    if (context->start_err != ESP_OK)
+    {
+        return false;
+    }
+
+    uint16_t ch0 = 0;
+    uint16_t ch1 = 0;
+    esp_err_t err = _read_channel(context, TSL2561_REG_DATA0LOW, &ch0);
+    if (err == ESP_OK)
     {
-        datastore_set_bool(datastore, RESOURCE_ID_LIGHT_DETECTED, 0, false);
-        i2c_master_unlock(i2c_master_info);
+        err = _read_channel(context, TSL2561_REG_DATA1LOW, &ch1);
     }
+    _write_register(context, TSL2561_REG_CONTROL, TSL2561_CONTROL_POWER_OFF);
 
-    smbus_free(&smbus_info);
-    tsl2561_free(&tsl2561_info);
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
+    // channel 0 is visible and infrared, channel 1 is infrared only
+    if (err == ESP_OK)
+    {
+        context->visible = ch0 > ch1 ? ch0 - ch1 : 0;
+        context->infrared = ch1;
+    }
+    return err == ESP_OK;
 }
 
-void sensor_light_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority, const datastore_t * datastore)
+static void _light_publish(sensor_driver_t * driver, bool ok)
 {
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    light_context_t * context = (light_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
 
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
+    if (ok)
     {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->i2c_master_info = i2c_master_info;
-        task_inputs->datastore = datastore;
-        xTaskCreate(&sensor_light_task, "sensor_light_task", 4096, task_inputs, priority, &_task_handle);
+        tsl2561_visible_t visible = context->visible;
+        tsl2561_infrared_t infrared = context->infrared;
+        uint32_t lux = tsl2561_compute_lux(context->tsl2561_info, visible, infrared);
+
+        ESP_LOGI(TAG, "Light Sensor Readings:");
+        ESP_LOGI(TAG, "  Full spectrum: %d", visible + infrared);
+        ESP_LOGI(TAG, "  Infrared:      %d", infrared);
+        ESP_LOGI(TAG, "  Visible:       %d", visible);
+        ESP_LOGI(TAG, "  Illuminance:   %d lux", lux);
+
+        datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_FULL, 0, visible + infrared);
+        datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_INFRARED, 0, infrared);
+        datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_VISIBLE, 0, visible);
+        datastore_set_uint32(datastore, RESOURCE_ID_LIGHT_ILLUMINANCE, 0, lux);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "sensor error");
     }
 }
 
-void sensor_light_delete(void)
+// The integration runs between start and collect with the bus released, rather than inside
+// tsl2561_read, which sleeps for the integration time with the bus held
+static sensor_driver_t _driver = {
+    .name = "light",
+    .bus = SENSOR_BUS_I2C,
+    .period = SAMPLE_PERIOD,
+    .delay = INTEGRATION_DELAY,
+    .led_pages = { DISPLAY_PAGE_SENSORS_LIGHT },
+    .num_led_pages = 1,
+    .init = _light_init,
+    .start = _light_start,
+    .collect = _light_collect,
+    .publish = _light_publish,
+    .context = &_context,
+};
+
+void sensor_light_init(i2c_master_info_t * i2c_master_info, const datastore_t * datastore)
 {
-    if (_task_handle)
-        vTaskDelete(_task_handle);
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    _context.i2c_master_info = i2c_master_info;
+    _context.datastore = datastore;
+    sensor_scheduler_add(&_driver);
 }
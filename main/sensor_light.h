@@ -31,7 +31,7 @@
 #include "i2c_master.h"
 #include "datastore/datastore.h"
 
-void sensor_light_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority, const datastore_t * datastore);
-void sensor_light_delete(void);
+// Register the light sensor with the sensor scheduler
+void sensor_light_init(i2c_master_info_t * i2c_master_info, const datastore_t * datastore);
 
 #endif // SENSOR_LIGHT_H
@@ -0,0 +1,368 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "sensor_scheduler.h"
+#include "timer_wheel.h"
+#include "utils.h"
+#include "led.h"
+
+#define TAG "sensor_scheduler"
+
+#define STACK_SIZE     4096
+#define REPORT_PERIOD  (10 * 60 * 1000)   // milliseconds
+
+typedef enum
+{
+    SLOT_STATE_INIT = 0,
+    SLOT_STATE_IDLE,        // waiting to start the next measurement
+    SLOT_STATE_MEASURING,   // waiting to collect the measurement
+    SLOT_STATE_DISABLED,
+} slot_state_t;
+
+typedef struct
+{
+    sensor_driver_t * driver;
+    slot_state_t state;
+    uint64_t started;          // microseconds since boot
+    uint64_t next;             // microseconds since boot, for the next start or collect
+    bool led;
+    bool publish_pending;
+    bool ok;
+
+    uint32_t samples;
+    uint32_t errors;
+    uint64_t late_total;       // microseconds
+    uint32_t late_max;         // microseconds
+} slot_t;
+
+typedef struct
+{
+    i2c_master_info_t * i2c_master_info;
+    const datastore_t * datastore;
+} task_inputs_t;
+
+static TaskHandle_t _task_handle = NULL;
+static slot_t _slots[SENSOR_SCHEDULER_MAX_DRIVERS] = { 0 };
+static volatile size_t _num_slots = 0;
+static portMUX_TYPE _slots_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// time spent by the scheduler itself, excluding driver callbacks
+static uint32_t _overhead_passes = 0;
+static uint64_t _overhead_total = 0;     // microseconds
+static uint32_t _overhead_max = 0;       // microseconds
+
+static bool _led_wanted(const datastore_t * datastore, const sensor_driver_t * driver)
+{
+    bool wanted = false;
+    for (size_t i = 0; !wanted && i < driver->num_led_pages; ++i)
+    {
+        wanted = display_is_currently(datastore, driver->led_pages[i]);
+    }
+    return wanted;
+}
+
+static uint64_t _period(const sensor_driver_t * driver)
+{
+    uint32_t period = driver->get_period ? driver->get_period(driver) : driver->period;
+    return (uint64_t)period * 1000;
+}
+
+// Advance a slot by one step. Returns the time spent in driver callbacks, in microseconds.
+static uint32_t _step(slot_t * slot, const datastore_t * datastore, uint64_t now)
+{
+    sensor_driver_t * driver = slot->driver;
+    uint64_t callback_start = microseconds_since_boot();
+
+    switch (slot->state)
+    {
+    case SLOT_STATE_INIT:
+        if (driver->init == NULL || driver->init(driver))
+        {
+            ESP_LOGI(TAG, "%s: bus %d, delay %u ms", driver->name, driver->bus, driver->delay);
+            slot->state = SLOT_STATE_IDLE;
+            slot->next = microseconds_since_boot();
+        }
+        else
+        {
+            ESP_LOGW(TAG, "%s: init failed - disabled", driver->name);
+            slot->state = SLOT_STATE_DISABLED;
+        }
+        break;
+
+    case SLOT_STATE_IDLE:
+    {
+        uint32_t late = now - slot->next;
+        slot->late_total += late;
+        if (late > slot->late_max)
+            slot->late_max = late;
+
+        slot->led = _led_wanted(datastore, driver);
+        if (slot->led)
+        {
+            led_on();
+        }
+
+        slot->started = slot->next;
+        callback_start = microseconds_since_boot();
+        if (driver->start)
+        {
+            driver->start(driver);
+        }
+        slot->state = SLOT_STATE_MEASURING;
+        slot->next = now + (uint64_t)driver->delay * 1000;
+        if (driver->delay > 0)
+        {
+            break;
+        }
+        // no delay - collect immediately
+    }
+    // fall through
+
+    case SLOT_STATE_MEASURING:
+    {
+        slot->ok = driver->collect(driver);
+        slot->publish_pending = true;
+        ++slot->samples;
+        if (!slot->ok)
+            ++slot->errors;
+
+        if (slot->led)
+        {
+            led_off();
+            slot->led = false;
+        }
+
+        // keep the original phase, but skip any samples that are already overdue
+        uint64_t period = _period(driver);
+        uint64_t finish = microseconds_since_boot();
+        slot->next = slot->started + period;
+        while (period > 0 && slot->next <= finish)
+        {
+            slot->next += period;
+        }
+        slot->state = SLOT_STATE_IDLE;
+        break;
+    }
+
+    case SLOT_STATE_DISABLED:
+    default:
+        break;
+    }
+
+    return microseconds_since_boot() - callback_start;
+}
+
+static void sensor_scheduler_task(void * pvParameter)
+{
+    assert(pvParameter);
+    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+
+    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
+    const datastore_t * datastore = task_inputs->datastore;
+
+    while (1)
+    {
+        uint64_t pass_start = microseconds_since_boot();
+        uint32_t callback_time = 0;
+        bool worked = false;
+        size_t num_slots = _num_slots;
+
+        // Non-I2C drivers first, then all due I2C drivers under one lock, so that
+        // the I2C bus is never held while waiting on other hardware.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            bool i2c_pass = pass == 1;
+            bool locked = false;
+            for (size_t i = 0; i < num_slots; ++i)
+            {
+                slot_t * slot = &_slots[i];
+                bool due = slot->state == SLOT_STATE_INIT
+                           || (slot->state != SLOT_STATE_DISABLED && slot->next <= microseconds_since_boot());
+                if ((slot->driver->bus == SENSOR_BUS_I2C) == i2c_pass && due)
+                {
+                    if (i2c_pass && !locked)
+                    {
+                        i2c_master_lock(task_inputs->i2c_master_info, I2C_MASTER_CLIENT_SENSOR, portMAX_DELAY);
+                        locked = true;
+                    }
+                    else if (locked)
+                    {
+                        // pump control may take the bus between drivers
+                        i2c_master_yield(task_inputs->i2c_master_info, I2C_MASTER_CLIENT_SENSOR);
+                    }
+                    callback_time += _step(slot, datastore, microseconds_since_boot());
+                    worked = true;
+                }
+            }
+            if (locked)
+            {
+                i2c_master_unlock(task_inputs->i2c_master_info);
+            }
+        }
+
+        // publish outside of any bus lock
+        uint64_t next = UINT64_MAX;
+        for (size_t i = 0; i < num_slots; ++i)
+        {
+            slot_t * slot = &_slots[i];
+            if (slot->publish_pending)
+            {
+                uint64_t t = microseconds_since_boot();
+                slot->driver->publish(slot->driver, slot->ok);
+                callback_time += microseconds_since_boot() - t;
+                slot->publish_pending = false;
+            }
+            if (slot->state == SLOT_STATE_INIT)
+            {
+                next = 0;
+            }
+            else if (slot->state != SLOT_STATE_DISABLED && slot->next < next)
+            {
+                next = slot->next;
+            }
+        }
+
+        if (worked)
+        {
+            uint32_t pass_time = microseconds_since_boot() - pass_start;
+            uint32_t overhead = pass_time > callback_time ? pass_time - callback_time : 0;
+            ++_overhead_passes;
+            _overhead_total += overhead;
+            if (overhead > _overhead_max)
+                _overhead_max = overhead;
+        }
+
+        // sleep until the next start or collect, or until a driver is added
+        TickType_t wait = portMAX_DELAY;
+        if (next != UINT64_MAX)
+        {
+            uint64_t now = microseconds_since_boot();
+            uint64_t tick_us = portTICK_PERIOD_MS * 1000;
+            wait = next > now ? (next - now + tick_us - 1) / tick_us : 0;
+        }
+        if (wait > 0)
+        {
+            ulTaskNotifyTake(pdTRUE, wait);
+        }
+    }
+
+    free(task_inputs);
+    _task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static void _report_job(void * context)
+{
+    sensor_scheduler_log_stats();
+}
+
+void sensor_scheduler_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority, const datastore_t * datastore)
+{
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+
+    // task will take ownership of this struct
+    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
+    if (task_inputs)
+    {
+        memset(task_inputs, 0, sizeof(*task_inputs));
+        task_inputs->i2c_master_info = i2c_master_info;
+        task_inputs->datastore = datastore;
+        xTaskCreate(&sensor_scheduler_task, "sensor_task", STACK_SIZE, task_inputs, priority, &_task_handle);
+    }
+
+    timer_wheel_add("sensors", REPORT_PERIOD, _report_job, NULL);
+}
+
+void sensor_scheduler_delete(void)
+{
+    if (_task_handle)
+        vTaskDelete(_task_handle);
+}
+
+void sensor_scheduler_add(sensor_driver_t * driver)
+{
+    assert(driver != NULL && driver->collect != NULL && driver->publish != NULL);
+    bool added = false;
+
+    portENTER_CRITICAL(&_slots_mux);
+    if (_num_slots < SENSOR_SCHEDULER_MAX_DRIVERS)
+    {
+        slot_t * slot = &_slots[_num_slots];
+        memset(slot, 0, sizeof(*slot));
+        slot->driver = driver;
+        slot->state = SLOT_STATE_INIT;
+        ++_num_slots;
+        added = true;
+    }
+    portEXIT_CRITICAL(&_slots_mux);
+
+    if (!added)
+    {
+        ESP_LOGE(TAG, "no free slot for driver %s", driver->name);
+    }
+    else if (_task_handle)
+    {
+        xTaskNotifyGive(_task_handle);
+    }
+}
+
+void sensor_scheduler_log_stats(void)
+{
+    ESP_LOGI(TAG, "%-8s %8s %8s %10s %10s", "driver", "samples", "errors", "late avg", "late max");
+    for (size_t i = 0; i < _num_slots; ++i)
+    {
+        const slot_t * slot = &_slots[i];
+        uint32_t late_avg = slot->samples ? slot->late_total / slot->samples : 0;
+        ESP_LOGI(TAG, "%-8s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "us %8" PRIu32 "us",
+                 slot->driver->name, slot->samples, slot->errors, late_avg, slot->late_max);
+    }
+    uint32_t overhead_avg = _overhead_passes ? _overhead_total / _overhead_passes : 0;
+    ESP_LOGI(TAG, "scheduler overhead per pass: avg %" PRIu32 " us, max %" PRIu32 " us over %" PRIu32 " passes",
+             overhead_avg, _overhead_max, _overhead_passes);
+    if (_task_handle)
+    {
+        ESP_LOGI(TAG, "stack high water mark %u bytes", uxTaskGetStackHighWaterMark(_task_handle));
+    }
+}
+
+bool sensor_scheduler_override(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, float * value)
+{
+    datastore_age_t override_age = 0;
+    datastore_get_age(datastore, id, instance, &override_age);
+    bool override = override_age < (esp_timer_get_time() - 10);
+    if (override)
+    {
+        datastore_get_float(datastore, id, instance, value);
+    }
+    return override;
+}
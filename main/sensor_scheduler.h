@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SENSOR_SCHEDULER_H
+#define SENSOR_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "i2c_master.h"
+#include "display.h"
+#include "datastore/datastore.h"
+
+/*
+ * Sensor drivers are multiplexed onto a single acquisition task. Each driver declares
+ * its sampling period and the delay between starting a measurement and collecting the
+ * result (conversion time, sampling window), so the scheduler can start other
+ * measurements while one is in progress rather than blocking.
+ *
+ * Collection for all drivers on the I2C bus that fall due in the same pass is batched
+ * under a single bus lock. Results are published to the datastore after the lock is
+ * released.
+ */
+
+#define SENSOR_SCHEDULER_MAX_DRIVERS  (4)
+#define SENSOR_DRIVER_MAX_LED_PAGES   (2)
+
+typedef enum
+{
+    SENSOR_BUS_NONE = 0,
+    SENSOR_BUS_ONE_WIRE,
+    SENSOR_BUS_I2C,
+    SENSOR_BUS_PCNT,
+} sensor_bus_t;
+
+typedef struct sensor_driver_t sensor_driver_t;
+
+struct sensor_driver_t
+{
+    const char * name;
+    sensor_bus_t bus;
+    uint32_t period;      // milliseconds between the start of subsequent samples, unless get_period is provided
+    uint32_t delay;       // milliseconds between start and collect
+
+    // the onboard LED is lit during a measurement when any of these pages are displayed
+    display_page_id_t led_pages[SENSOR_DRIVER_MAX_LED_PAGES];
+    size_t num_led_pages;
+
+    bool (*init)(sensor_driver_t * driver);                  // optional; called once, with the bus held. Return false to disable the driver
+    void (*start)(sensor_driver_t * driver);                 // optional; begin a measurement without blocking
+    bool (*collect)(sensor_driver_t * driver);               // read the measurement, with the bus held. Return false on error
+    void (*publish)(sensor_driver_t * driver, bool ok);      // write results to the datastore, applying any override
+    uint32_t (*get_period)(const sensor_driver_t * driver);  // optional; period in milliseconds, if it can change at runtime
+
+    void * context;
+};
+
+void sensor_scheduler_init(i2c_master_info_t * i2c_master_info, UBaseType_t priority, const datastore_t * datastore);
+void sensor_scheduler_delete(void);
+
+// The driver must persist for as long as the scheduler is running
+void sensor_scheduler_add(sensor_driver_t * driver);
+
+void sensor_scheduler_log_stats(void);
+
+/**
+ * @brief Obtain the override value for a sensor resource, if an override has been set.
+ * @return true if the override is active and value has been set.
+ */
+bool sensor_scheduler_override(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, float * value);
+
+#endif // SENSOR_SCHEDULER_H
@@ -26,7 +26,6 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "esp_system.h"
 #include "esp_log.h"
 
@@ -35,15 +34,17 @@
 #include "resources.h"
 #include "utils.h"
 #include "led.h"
-#include "publish.h"
 #include "owb.h"
 #include "owb_rmt.h"
 #include "ds18b20.h"
 #include "datastore/datastore.h"
 #include "display.h"
+#include "sensor_scheduler.h"
 
 #define MAX_DEVICES          (8)
 #define DS18B20_RESOLUTION   (DS18B20_RESOLUTION_10_BIT)
+#define CONVERSION_DELAY     (200)   // milliseconds, covers the 187.5 ms maximum conversion time at 10-bit resolution
+#define SIM_DELAY            (50)    // milliseconds
 
 #define TAG "sensor_temp"
 
@@ -55,33 +56,6 @@ struct _temp_sensors_t
     int num_ds18b20s;
 };
 
-typedef struct
-{
-    temp_sensors_t * sensors;
-    const datastore_t * datastore;
-} task_inputs_t;
-
-static TaskHandle_t _task_handle = NULL;
-
-static void read_temperatures(DS18B20_Info ** device_infos, float * readings, DS18B20_ERROR * errors, int num_devices)
-{
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
-    assert(readings);
-    assert(errors);
-
-    ds18b20_convert_all(device_infos[0]->bus);
-
-    // in this application all devices use the same resolution,
-    // so use the first device to determine the delay
-    ds18b20_wait_for_conversion(device_infos[0]);
-
-    // read the results immediately after conversion otherwise it may fail
-    // (using printf before reading may take too long)
-    for (int i = 0; i < num_devices; ++i)
-    {
-        errors[i] = ds18b20_read_temp(device_infos[i], &readings[i]);
-    }
-}
 
 /**
  * @brief Find all (or the first N) ROM codes for devices connected to the One Wire Bus.
@@ -230,183 +204,168 @@ void _recalc_assignments_handler(const datastore_t * datastore, datastore_resour
     }
 }
 
-static void sensor_temp_task(void * pvParameter)
+typedef struct
 {
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+    temp_sensors_t * sensors;
+    const datastore_t * datastore;
 
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
+    // Map sensor instances (enumerated in ROM code order as detected) with T1, ..., T5 instances
+    int map[SENSOR_TEMP_INSTANCES];
+    context_t assignments;
 
-    int sample_count = 0;
+    int sample_count;
+    int errors_count[MAX_DEVICES];
+    float readings[MAX_DEVICES];
+    DS18B20_ERROR errors[MAX_DEVICES];
+} temp_context_t;
 
-    // Map sensor instances (enumerated in ROM code order as detected) with T1, ..., T5 instances
-    int map[SENSOR_TEMP_INSTANCES] = { -1, -1, -1, -1, -1 };
-    context_t context = {
-        .map = &map[0],
-        .rom_codes = &task_inputs->sensors->rom_codes[0],
-    };
+static temp_context_t _context = { 0 };
+
+static bool _temp_init(sensor_driver_t * driver)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
 
-    // apply any default or nvs-loaded assignments
     for (size_t i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
     {
-        _recalc_assignments_handler(datastore, RESOURCE_ID_TEMP_ASSIGNMENT, i, &context);
-
-        // Callback if any assignments change
-        datastore_add_set_callback(datastore, RESOURCE_ID_TEMP_ASSIGNMENT, i, _recalc_assignments_handler, &context);
+        context->map[i] = -1;
     }
+    context->assignments.map = &context->map[0];
+    context->assignments.rom_codes = &context->sensors->rom_codes[0];
 
-    int errors_count[MAX_DEVICES] = {0};
-    if (task_inputs->sensors->num_ds18b20s > 0)
+    // apply any default or nvs-loaded assignments
+    for (size_t i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
     {
-        // wait a second before starting commencing sampling
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
+        _recalc_assignments_handler(datastore, RESOURCE_ID_TEMP_ASSIGNMENT, i, &context->assignments);
 
-        TickType_t last_wake_time = xTaskGetTickCount();
+        // Callback if any assignments change
+        datastore_add_set_callback(datastore, RESOURCE_ID_TEMP_ASSIGNMENT, i, _recalc_assignments_handler, &context->assignments);
+    }
+    return true;
+}
 
-        while (1)
-        {
-            last_wake_time = xTaskGetTickCount();
+static void _temp_start(sensor_driver_t * driver)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
+    ds18b20_convert_all(context->sensors->ds18b20_infos[0]->bus);
+}
 
-            bool control_led = display_is_currently(datastore, DISPLAY_PAGE_SENSORS_TEMP) || display_is_currently(datastore, DISPLAY_PAGE_SENSORS_TEMP_2);
-            if (control_led)
-            {
-                led_on();
-            }
+static bool _temp_collect(sensor_driver_t * driver)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
 
-            float readings[MAX_DEVICES] = { 0 };
-            DS18B20_ERROR errors[MAX_DEVICES] = { 0 };
+    // in this application all devices use the same resolution, so the conversion delay
+    // applies to all. Read the results immediately after conversion otherwise it may fail
+    // (using printf before reading may take too long)
+    for (int i = 0; i < context->sensors->num_ds18b20s; ++i)
+    {
+        context->errors[i] = ds18b20_read_temp(context->sensors->ds18b20_infos[i], &context->readings[i]);
+    }
+    ++context->sample_count;
+    return true;
+}
 
-            read_temperatures(task_inputs->sensors->ds18b20_infos, readings, errors, task_inputs->sensors->num_ds18b20s);
-            ++sample_count;
+static void _temp_publish(sensor_driver_t * driver, bool ok)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
+    const int * map = context->map;
 
-            if (control_led)
-            {
-                led_off();
-            }
+    // print results in a separate loop, after all have been read
+    ESP_LOGI(TAG, "Temperature readings (degrees C): sample %d", context->sample_count);
+    for (int i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
+    {
+        float override_value = 0.0f;
+        if (sensor_scheduler_override(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &override_value))
+        {
+            datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, override_value);
+            ESP_LOGI(TAG, "  T%d: %.1f    OVERRIDE", i + 1, override_value);
+        }
+        else if (i < context->sensors->num_ds18b20s)
+        {
+            // map actual sensors to T1, ..., T4 assignments
+            float reading = map[i] >= 0 ? context->readings[map[i]] : -2048.0;
+            int num_errors = map[i] >= 0 ? context->errors_count[map[i]] : 0;
+            DS18B20_ERROR error = map[i] >= 0 ? context->errors[map[i]] : DS18B20_OK;
 
-            // print results in a separate loop, after all have been read
-            ESP_LOGI(TAG, "Temperature readings (degrees C): sample %d", sample_count);
-            for (int i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
+            // filter out unmapped and errored readings
+            if (map[i] >= 0)
             {
-                datastore_age_t override_age = 0;
-                datastore_get_age(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &override_age);
-                if (override_age < (esp_timer_get_time() - 10))
+                if (error == DS18B20_OK)
                 {
-                    float override_value = 0.0f;
-                    datastore_get_float(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &override_value);
-                    datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, override_value);
-                    ESP_LOGI(TAG, "  T%d: %.1f    OVERRIDE", i + 1, override_value);
+                    datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, reading);
+                    ESP_LOGI(TAG, "  T%d: %.1f    %d errors", i + 1, reading, num_errors);
                 }
-                else if (i < task_inputs->sensors->num_ds18b20s)
+                else
                 {
-                    // map actual sensors to T1, ..., T4 assignments
-                    float reading = map[i] >= 0 ? readings[map[i]] : -2048.0;
-                    int num_errors = map[i] >= 0 ? errors_count[map[i]] : 0;
-                    DS18B20_ERROR error = map[i] >= 0 ? errors[map[i]] : DS18B20_OK;
-
-                    // filter out unmapped and errored readings
-                    if (map[i] >= 0)
-                    {
-                        if (error == DS18B20_OK)
-                        {
-                            datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, reading);
-                            ESP_LOGI(TAG, "  T%d: %.1f    %d errors", i + 1, reading, num_errors);
-                        }
-                        else
-                        {
-                            ++errors_count[map[i]];
-                        }
-                    }
+                    ++context->errors_count[map[i]];
                 }
             }
-
-            uint32_t poll_period = 0;
-            datastore_get_uint32(datastore, RESOURCE_ID_TEMP_PERIOD, 0, &poll_period);
-            vTaskDelayUntil(&last_wake_time, poll_period / portTICK_PERIOD_MS);
         }
     }
-    else
-    {
-        ESP_LOGE(TAG, "No devices found");
-    }
-
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
 }
 
-static void sensor_temp_sim_task(void * pvParameter)
+// When no devices are detected, this driver can be used to simulate temperature sensors
+// The override resources are also available.
+static bool _temp_sim_collect(sensor_driver_t * driver)
 {
-    // When no devices are detected, this task can be used to simulate temperature sensors
-    // The override resources are also available.
-
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
-
-    int sample_count = 0;
-
-    // wait a second before starting commencing sampling
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+    temp_context_t * context = (temp_context_t *)driver->context;
+    ++context->sample_count;
+    return true;
+}
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+static void _temp_sim_publish(sensor_driver_t * driver, bool ok)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
+    const datastore_t * datastore = context->datastore;
 
-    while (1)
+    ESP_LOGI(TAG, "Temperature readings (degrees C): sample %d ** SIMULATED **", context->sample_count);
+    for (int i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
     {
-        last_wake_time = xTaskGetTickCount();
-
-        bool control_led = display_is_currently(datastore, DISPLAY_PAGE_SENSORS_TEMP) || display_is_currently(datastore, DISPLAY_PAGE_SENSORS_TEMP_2);
-        if (control_led)
-        {
-            led_on();
-        }
-
-        vTaskDelay(50 / portTICK_PERIOD_MS);
-        ++sample_count;
-
-        if (control_led)
-        {
-            led_off();
-        }
-
-        ESP_LOGI(TAG, "Temperature readings (degrees C): sample %d ** SIMULATED **", sample_count);
-        for (int i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
-        {
-            float reading = -2048.0;
-            int num_errors = -1;  // indicate that something isn't quite right about these measurements
-            datastore_age_t override_age = 0;
-            datastore_get_age(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &override_age);
-            bool override = override_age < (esp_timer_get_time() - 10);
+        float reading = 0.0;
+        int num_errors = -1;  // indicate that something isn't quite right about these measurements
+        bool override = sensor_scheduler_override(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &reading);
 
-            if (override)
-            {
-                datastore_get_float(datastore, RESOURCE_ID_TEMP_OVERRIDE, i, &reading);
-            }
-            else
-            {
-                reading = 0.0;
-            }
-
-            datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, reading);
-            ESP_LOGI(TAG, "  T%d: %.1f    %d errors%s", i + 1, reading, num_errors, override ? " OVERRIDE" : " SIMULATED");
-        }
-
-        uint32_t poll_period = 0;
-        datastore_get_uint32(datastore, RESOURCE_ID_TEMP_PERIOD, 0, &poll_period);
-        vTaskDelayUntil(&last_wake_time, poll_period / portTICK_PERIOD_MS);
+        datastore_set_float(datastore, RESOURCE_ID_TEMP_VALUE, i, reading);
+        ESP_LOGI(TAG, "  T%d: %.1f    %d errors%s", i + 1, reading, num_errors, override ? " OVERRIDE" : " SIMULATED");
     }
+}
 
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
+static uint32_t _temp_period(const sensor_driver_t * driver)
+{
+    temp_context_t * context = (temp_context_t *)driver->context;
+    uint32_t poll_period = 0;
+    datastore_get_uint32(context->datastore, RESOURCE_ID_TEMP_PERIOD, 0, &poll_period);
+    return poll_period;
 }
 
-temp_sensors_t * sensor_temp_init(uint8_t gpio, UBaseType_t priority, const datastore_t * datastore)
+static sensor_driver_t _driver = {
+    .name = "temp",
+    .bus = SENSOR_BUS_ONE_WIRE,
+    .delay = CONVERSION_DELAY,
+    .led_pages = { DISPLAY_PAGE_SENSORS_TEMP, DISPLAY_PAGE_SENSORS_TEMP_2 },
+    .num_led_pages = 2,
+    .init = _temp_init,
+    .start = _temp_start,
+    .collect = _temp_collect,
+    .publish = _temp_publish,
+    .get_period = _temp_period,
+    .context = &_context,
+};
+
+static sensor_driver_t _sim_driver = {
+    .name = "temp sim",
+    .bus = SENSOR_BUS_NONE,
+    .delay = SIM_DELAY,
+    .led_pages = { DISPLAY_PAGE_SENSORS_TEMP, DISPLAY_PAGE_SENSORS_TEMP_2 },
+    .num_led_pages = 2,
+    .collect = _temp_sim_collect,
+    .publish = _temp_sim_publish,
+    .get_period = _temp_period,
+    .context = &_context,
+};
+
+temp_sensors_t * sensor_temp_init(uint8_t gpio, const datastore_t * datastore)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
     // Assume that new devices are not connected during operation.
@@ -427,32 +386,20 @@ temp_sensors_t * sensor_temp_init(uint8_t gpio, UBaseType_t priority, const data
     // Blink the LED to indicate the number of temperature devices detected:
     led_flash(100, 200, sensors->num_ds18b20s);
 
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
+    _context.sensors = sensors;
+    _context.datastore = datastore;
+    if (sensors->num_ds18b20s > 0)
     {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->sensors = sensors;
-        task_inputs->datastore = datastore;
-        if (sensors->num_ds18b20s > 0)
-        {
-            xTaskCreate(&sensor_temp_task, "sensor_temp_task", 4096, task_inputs, priority, &_task_handle);
-        }
-        else
-        {
-            ESP_LOGW(TAG, "No temperature sensors detected - using simulated sensors");
-            xTaskCreate(&sensor_temp_sim_task, "sensor_temp_task", 4096, task_inputs, priority, &_task_handle);
-        }
+        sensor_scheduler_add(&_driver);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "No temperature sensors detected - using simulated sensors");
+        sensor_scheduler_add(&_sim_driver);
     }
     return sensors;
 }
 
-void sensor_temp_delete(void)
-{
-    if (_task_handle)
-        vTaskDelete(_task_handle);
-}
-
 void sensor_temp_close(temp_sensors_t * sensors)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
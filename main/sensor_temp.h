@@ -36,9 +36,9 @@ typedef struct _temp_sensors_t temp_sensors_t;
 #define SENSOR_TEMP_LEN_LABEL      (7 + 1)
 #define SENSOR_TEMP_LEN_ROM_CODE   (16+1)
 
-temp_sensors_t * sensor_temp_init(uint8_t gpio, UBaseType_t priority, const datastore_t * datastore);
-void sensor_temp_delete(void);
-void sensor_temp_close(temp_sensors_t * sensors);  // delete before close
+// Detect sensors and register with the sensor scheduler
+temp_sensors_t * sensor_temp_init(uint8_t gpio, const datastore_t * datastore);
+void sensor_temp_close(temp_sensors_t * sensors);  // delete scheduler before close
 datastore_age_t sensor_temp_expiry(const datastore_t * datastore);
 
 #endif // SENSOR_TEMP_H
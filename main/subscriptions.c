@@ -33,6 +33,8 @@
 #include "avr_support.h"
 #include "resources.h"
 #include "nvs_support.h"
+#include "control.h"
+#include "control_trace.h"
 
 #define TAG "subscriptions"
 
@@ -188,6 +190,48 @@ static void do_control_cp_delta_off(const char * topic, float value, void * cont
     datastore_set_float(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, 0, value);
 }
 
+static void do_control_cp_predict_horizon(const char * topic, uint32_t value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, 0, value);
+}
+
+static void do_control_cp_n_delta_on(const char * topic, float value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/cp/%u/delta_on", &instance);
+    ESP_LOGD(TAG, "instance %u, value %f", instance, value);
+    if (instance > 0 && instance <= CONTROL_CP_INSTANCES)
+    {
+        datastore_set_float(datastore, RESOURCE_ID_CONTROL_CP_ON_DELTA, instance - 1, value);
+    }
+}
+
+static void do_control_cp_n_delta_off(const char * topic, float value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/cp/%u/delta_off", &instance);
+    ESP_LOGD(TAG, "instance %u, value %f", instance, value);
+    if (instance > 0 && instance <= CONTROL_CP_INSTANCES)
+    {
+        datastore_set_float(datastore, RESOURCE_ID_CONTROL_CP_OFF_DELTA, instance - 1, value);
+    }
+}
+
+static void do_control_cp_n_predict_horizon(const char * topic, uint32_t value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/cp/%u/predict_horizon", &instance);
+    ESP_LOGD(TAG, "instance %u, value %u", instance, value);
+    if (instance > 0 && instance <= CONTROL_CP_INSTANCES)
+    {
+        datastore_set_uint32(datastore, RESOURCE_ID_CONTROL_CP_PREDICT_HORIZON, instance - 1, value);
+    }
+}
+
 static void do_control_flow_threshold(const char * topic, float value, void * context)
 {
     datastore_t * datastore = (datastore_t *)context;
@@ -224,12 +268,57 @@ static void do_control_pp_daily_minute(const char * topic, int32_t value, void *
     datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, 0, value);
 }
 
+static void do_control_pp_daily_n_hour(const char * topic, int32_t value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/pp/daily/%u/hour", &instance);
+    ESP_LOGD(TAG, "instance %u, value %d", instance, value);
+    if (instance > 0 && instance <= CONTROL_PP_DAILY_INSTANCES)
+    {
+        datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_HOUR, instance - 1, value);
+    }
+}
+
+static void do_control_pp_daily_n_minute(const char * topic, int32_t value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/pp/daily/%u/minute", &instance);
+    ESP_LOGD(TAG, "instance %u, value %d", instance, value);
+    if (instance > 0 && instance <= CONTROL_PP_DAILY_INSTANCES)
+    {
+        datastore_set_int32(datastore, RESOURCE_ID_CONTROL_PP_DAILY_MINUTE, instance - 1, value);
+    }
+}
+
+static void do_control_pp_daily_n_days(const char * topic, uint8_t value, void * context)
+{
+    datastore_t * datastore = (datastore_t *)context;
+    uint32_t instance = 0;
+    sscanf(topic, ROOT_TOPIC"/control/pp/daily/%u/days", &instance);
+    ESP_LOGD(TAG, "instance %u, value 0x%02x", instance, value);
+    if (instance > 0 && instance <= CONTROL_PP_DAILY_INSTANCES)
+    {
+        datastore_set_uint8(datastore, RESOURCE_ID_CONTROL_PP_DAILY_DAYS, instance - 1, value);
+    }
+}
+
 static void do_control_pp_daily_enable(const char * topic, bool value, void * context)
 {
     datastore_t * datastore = (datastore_t *)context;
     datastore_set_bool(datastore, RESOURCE_ID_CONTROL_PP_DAILY_ENABLE, 0, value);
 }
 
+static void do_control_trace_dump(const char * topic, bool value, void * context)
+{
+    if (value)
+    {
+        ESP_LOGI(TAG, "Control trace dump requested");
+        control_trace_request_dump();
+    }
+}
+
 static void do_control_safe_temp_high(const char * topic, float value, void * context)
 {
     datastore_t * datastore = (datastore_t *)context;
@@ -297,6 +386,7 @@ static subscribe_item_t SUBSCRIPTIONS[] = {
     { ROOT_TOPIC"/sensors/flow/1/override",          MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_sensors_flow_override },
     { ROOT_TOPIC"/control/cp/delta_on",              MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_control_cp_delta_on },
     { ROOT_TOPIC"/control/cp/delta_off",             MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_control_cp_delta_off },
+    { ROOT_TOPIC"/control/cp/predict_horizon",       MQTT_TYPE_UINT32, (mqtt_receive_callback_generic)&do_control_cp_predict_horizon },
     { ROOT_TOPIC"/control/flow/threshold",           MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_control_flow_threshold },
     { ROOT_TOPIC"/control/pp/cycle/count",           MQTT_TYPE_UINT32, (mqtt_receive_callback_generic)&do_control_pp_cycle_count },
     { ROOT_TOPIC"/control/pp/cycle/on_duration",     MQTT_TYPE_UINT32, (mqtt_receive_callback_generic)&do_control_pp_cycle_on_duration },
@@ -304,6 +394,7 @@ static subscribe_item_t SUBSCRIPTIONS[] = {
     { ROOT_TOPIC"/control/pp/daily/hour",            MQTT_TYPE_INT32,  (mqtt_receive_callback_generic)&do_control_pp_daily_hour },
     { ROOT_TOPIC"/control/pp/daily/minute",          MQTT_TYPE_INT32,  (mqtt_receive_callback_generic)&do_control_pp_daily_minute },
     { ROOT_TOPIC"/control/pp/daily/enable",          MQTT_TYPE_BOOL,   (mqtt_receive_callback_generic)&do_control_pp_daily_enable },
+    { ROOT_TOPIC"/control/trace/dump",               MQTT_TYPE_BOOL,   (mqtt_receive_callback_generic)&do_control_trace_dump },
     { ROOT_TOPIC"/control/safe/high",                MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_control_safe_temp_high },
     { ROOT_TOPIC"/control/safe/low",                 MQTT_TYPE_FLOAT,  (mqtt_receive_callback_generic)&do_control_safe_temp_low },
     { ROOT_TOPIC"/display/backlight/timeout",        MQTT_TYPE_UINT32, (mqtt_receive_callback_generic)&do_display_backlight_timeout },
@@ -373,6 +464,52 @@ void subscriptions_init(const datastore_t * datastore, datastore_resource_id_t i
                     ESP_LOGE(TAG, "mqtt_register_topic_as_float failed: %d", mqtt_error);
                 }
             }
+
+            // per-circuit circulation pump parameters
+            for (size_t i = 0; i < CONTROL_CP_INSTANCES; ++i)
+            {
+                char topic[64] = "";
+                snprintf(topic, 64, ROOT_TOPIC"/control/cp/%d/delta_on", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_float(globals->mqtt_info, topic, &do_control_cp_n_delta_on, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_float failed: %d", mqtt_error);
+                }
+
+                snprintf(topic, 64, ROOT_TOPIC"/control/cp/%d/delta_off", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_float(globals->mqtt_info, topic, &do_control_cp_n_delta_off, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_float failed: %d", mqtt_error);
+                }
+
+                snprintf(topic, 64, ROOT_TOPIC"/control/cp/%d/predict_horizon", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_uint32(globals->mqtt_info, topic, &do_control_cp_n_predict_horizon, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_uint32 failed: %d", mqtt_error);
+                }
+            }
+
+            // purge pump schedule entries
+            for (size_t i = 0; i < CONTROL_PP_DAILY_INSTANCES; ++i)
+            {
+                char topic[64] = "";
+                snprintf(topic, 64, ROOT_TOPIC"/control/pp/daily/%d/hour", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_int32(globals->mqtt_info, topic, &do_control_pp_daily_n_hour, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_int32 failed: %d", mqtt_error);
+                }
+
+                snprintf(topic, 64, ROOT_TOPIC"/control/pp/daily/%d/minute", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_int32(globals->mqtt_info, topic, &do_control_pp_daily_n_minute, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_int32 failed: %d", mqtt_error);
+                }
+
+                snprintf(topic, 64, ROOT_TOPIC"/control/pp/daily/%d/days", i + 1);
+                if ((mqtt_error = mqtt_register_topic_as_uint8(globals->mqtt_info, topic, &do_control_pp_daily_n_days, globals->datastore)) != MQTT_OK)
+                {
+                    ESP_LOGE(TAG, "mqtt_register_topic_as_uint8 failed: %d", mqtt_error);
+                }
+            }
         }
     }
 }
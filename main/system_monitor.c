@@ -22,8 +22,6 @@
  * SOFTWARE.
  */
 
-#include <string.h>
-
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -34,6 +32,7 @@
 #include "utils.h"
 #include "system_monitor.h"
 #include "publish.h"
+#include "timer_wheel.h"
 
 #define TAG "system_monitor"
 
@@ -43,64 +42,44 @@ typedef struct
 {
     const datastore_t * datastore;
     const publish_context_t * publish_context;
-} task_inputs_t;
+} job_inputs_t;
 
-static TaskHandle_t _task_handle = NULL;
+static job_inputs_t _job_inputs = { 0 };
+static timer_wheel_job_t _job = TIMER_WHEEL_INVALID_JOB;
 
-static void system_task(void * pvParameter)
+static void _system_job(void * context)
 {
-    ESP_LOGD(TAG, "%s", __FUNCTION__);
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+    job_inputs_t * job_inputs = (job_inputs_t *)context;
+    const datastore_t * datastore = job_inputs->datastore;
 
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
+    uint32_t ram_free = esp_get_free_heap_size();  // byte-addressable heap memory
+    uint32_t iram_free = heap_caps_get_free_size(MALLOC_CAP_32BIT);  // IRAM 32-bit aligned heap
+    uint32_t uptime = microseconds_since_boot() / 1000000;
 
-    TickType_t last_wake_time = xTaskGetTickCount();
+    ESP_LOGI(TAG, "RAM free: %u bytes", ram_free);
+    ESP_LOGI(TAG, "RAM 32bit aligned free: %u bytes", iram_free);
+    ESP_LOGI(TAG, "Uptime: %u seconds", uptime);
 
-    while (1)
+    bool mqtt_connected = false;
+    datastore_get_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, &mqtt_connected);
+    if (mqtt_connected)
     {
-        last_wake_time = xTaskGetTickCount();
-
-        uint32_t ram_free = esp_get_free_heap_size();  // byte-addressable heap memory
-        uint32_t iram_free = heap_caps_get_free_size(MALLOC_CAP_32BIT);  // IRAM 32-bit aligned heap
-        uint32_t uptime = microseconds_since_boot() / 1000000;
-
-        ESP_LOGI(TAG, "RAM free: %u bytes", ram_free);
-        ESP_LOGI(TAG, "RAM 32bit aligned free: %u bytes", iram_free);
-        ESP_LOGI(TAG, "Uptime: %u seconds", uptime);
-
-        bool mqtt_connected = false;
-        datastore_get_bool(datastore, RESOURCE_ID_SYSTEM_TIME_SET, 0, &mqtt_connected);
-        if (mqtt_connected)
-        {
-            datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_RAM_FREE, 0, ram_free);
-            datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_IRAM_FREE, 0, iram_free);
-            datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_UPTIME, 0, uptime);
-        }
-
-        vTaskDelayUntil(&last_wake_time, CHECK_PERIOD / portTICK_PERIOD_MS);
+        datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_RAM_FREE, 0, ram_free);
+        datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_IRAM_FREE, 0, iram_free);
+        datastore_set_uint32(datastore, RESOURCE_ID_SYSTEM_UPTIME, 0, uptime);
     }
-
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
 }
 
-void system_monitor_init(UBaseType_t priority, const datastore_t * datastore, publish_context_t * publish_context)
+void system_monitor_init(const datastore_t * datastore, publish_context_t * publish_context)
 {
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
-    {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->datastore = datastore;
-        task_inputs->publish_context = publish_context;
-        xTaskCreate(&system_task, "system_task", 4096, task_inputs, priority, &_task_handle);
-    }
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    _job_inputs.datastore = datastore;
+    _job_inputs.publish_context = publish_context;
+    _job = timer_wheel_add("system", CHECK_PERIOD, _system_job, &_job_inputs);
 }
 
 void system_monitor_delete(void)
 {
-    if (_task_handle)
-        vTaskDelete(_task_handle);
+    timer_wheel_remove(_job);
+    _job = TIMER_WHEEL_INVALID_JOB;
 }
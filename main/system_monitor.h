@@ -31,7 +31,7 @@
 #include "datastore/datastore.h"
 #include "publish.h"
 
-void system_monitor_init(UBaseType_t priority, const datastore_t * datastore, publish_context_t * publish_context);
+void system_monitor_init(const datastore_t * datastore, publish_context_t * publish_context);
 void system_monitor_delete(void);
 
 #endif // SYSTEM_MONITOR_H
@@ -0,0 +1,225 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "timer_wheel.h"
+#include "utils.h"
+
+#define TAG "timer_wheel"
+
+#define STACK_SIZE     4096
+#define REPORT_PERIOD  (10 * 60 * 1000)   // milliseconds
+
+typedef struct
+{
+    const char * name;            // NULL if slot is unused
+    timer_wheel_func_t func;
+    void * context;
+    uint64_t period;              // microseconds
+    uint64_t due;                 // microseconds since boot
+
+    uint32_t runs;
+    uint32_t overruns;            // number of deadlines skipped entirely
+    uint64_t late_total;          // microseconds
+    uint32_t late_max;            // microseconds
+    uint32_t late_last;           // microseconds
+    uint32_t jitter_max;          // microseconds
+    uint32_t duration_max;        // microseconds
+} job_t;
+
+static job_t _jobs[TIMER_WHEEL_MAX_JOBS] = { 0 };
+static portMUX_TYPE _jobs_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t _task_handle = NULL;
+
+static void _report_job(void * context)
+{
+    timer_wheel_log_stats();
+}
+
+static void _run_job(timer_wheel_job_t i, uint64_t now)
+{
+    portENTER_CRITICAL(&_jobs_mux);
+    timer_wheel_func_t func = _jobs[i].func;
+    void * context = _jobs[i].context;
+    uint32_t late = now - _jobs[i].due;
+    portEXIT_CRITICAL(&_jobs_mux);
+
+    func(context);
+    uint64_t finish = microseconds_since_boot();
+
+    portENTER_CRITICAL(&_jobs_mux);
+    job_t * job = &_jobs[i];
+    if (job->func == func)   // not removed or replaced while running
+    {
+        uint32_t jitter = late > job->late_last ? late - job->late_last : job->late_last - late;
+        if (job->runs > 0 && jitter > job->jitter_max)
+            job->jitter_max = jitter;
+        if (late > job->late_max)
+            job->late_max = late;
+        if (finish - now > job->duration_max)
+            job->duration_max = finish - now;
+        job->late_last = late;
+        job->late_total += late;
+        ++job->runs;
+
+        // keep the original phase, but skip any deadlines that have already passed
+        job->due += job->period;
+        while (job->due <= finish)
+        {
+            job->due += job->period;
+            ++job->overruns;
+        }
+    }
+    portEXIT_CRITICAL(&_jobs_mux);
+}
+
+static void timer_wheel_task(void * pvParameter)
+{
+    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
+
+    while (1)
+    {
+        uint64_t next = UINT64_MAX;
+        for (timer_wheel_job_t i = 0; i < TIMER_WHEEL_MAX_JOBS; ++i)
+        {
+            uint64_t now = microseconds_since_boot();
+
+            portENTER_CRITICAL(&_jobs_mux);
+            bool used = _jobs[i].name != NULL;
+            bool ready = used && _jobs[i].due <= now;
+            portEXIT_CRITICAL(&_jobs_mux);
+
+            if (ready)
+            {
+                _run_job(i, now);
+            }
+
+            portENTER_CRITICAL(&_jobs_mux);
+            if (_jobs[i].name != NULL && _jobs[i].due < next)
+                next = _jobs[i].due;
+            portEXIT_CRITICAL(&_jobs_mux);
+        }
+
+        // sleep until the earliest deadline, or until a job is added
+        TickType_t wait = portMAX_DELAY;
+        if (next != UINT64_MAX)
+        {
+            uint64_t now = microseconds_since_boot();
+            uint64_t tick_us = portTICK_PERIOD_MS * 1000;
+            wait = next > now ? (next - now + tick_us - 1) / tick_us : 0;
+        }
+        if (wait > 0)
+        {
+            ulTaskNotifyTake(pdTRUE, wait);
+        }
+    }
+
+    _task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+void timer_wheel_init(UBaseType_t priority)
+{
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    xTaskCreate(&timer_wheel_task, "timer_wheel_task", STACK_SIZE, NULL, priority, &_task_handle);
+    timer_wheel_add("report", REPORT_PERIOD, _report_job, NULL);
+}
+
+void timer_wheel_delete(void)
+{
+    if (_task_handle)
+        vTaskDelete(_task_handle);
+}
+
+timer_wheel_job_t timer_wheel_add(const char * name, uint32_t period_ms, timer_wheel_func_t func, void * context)
+{
+    assert(name != NULL && func != NULL && period_ms > 0);
+    timer_wheel_job_t job = TIMER_WHEEL_INVALID_JOB;
+    uint64_t now = microseconds_since_boot();
+
+    portENTER_CRITICAL(&_jobs_mux);
+    for (timer_wheel_job_t i = 0; job == TIMER_WHEEL_INVALID_JOB && i < TIMER_WHEEL_MAX_JOBS; ++i)
+    {
+        if (_jobs[i].name == NULL)
+        {
+            memset(&_jobs[i], 0, sizeof(_jobs[i]));
+            _jobs[i].func = func;
+            _jobs[i].context = context;
+            _jobs[i].period = (uint64_t)period_ms * 1000;
+            _jobs[i].due = now;   // run as soon as possible
+            _jobs[i].name = name;
+            job = i;
+        }
+    }
+    portEXIT_CRITICAL(&_jobs_mux);
+
+    if (job == TIMER_WHEEL_INVALID_JOB)
+    {
+        ESP_LOGE(TAG, "no free slot for job %s", name);
+    }
+    else if (_task_handle)
+    {
+        xTaskNotifyGive(_task_handle);
+    }
+    return job;
+}
+
+void timer_wheel_remove(timer_wheel_job_t job)
+{
+    if (job >= 0 && job < TIMER_WHEEL_MAX_JOBS)
+    {
+        portENTER_CRITICAL(&_jobs_mux);
+        _jobs[job].name = NULL;
+        _jobs[job].func = NULL;
+        portEXIT_CRITICAL(&_jobs_mux);
+    }
+}
+
+void timer_wheel_log_stats(void)
+{
+    ESP_LOGI(TAG, "%-10s %8s %8s %10s %10s %10s %10s", "job", "runs", "overrun", "late avg", "late max", "jitter max", "run max");
+    for (timer_wheel_job_t i = 0; i < TIMER_WHEEL_MAX_JOBS; ++i)
+    {
+        portENTER_CRITICAL(&_jobs_mux);
+        job_t job = _jobs[i];
+        portEXIT_CRITICAL(&_jobs_mux);
+
+        if (job.name != NULL)
+        {
+            uint32_t late_avg = job.runs ? job.late_total / job.runs : 0;
+            ESP_LOGI(TAG, "%-10s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 "us %8" PRIu32 "us %8" PRIu32 "us %8" PRIu32 "us",
+                     job.name, job.runs, job.overruns, late_avg, job.late_max, job.jitter_max, job.duration_max);
+        }
+    }
+    if (_task_handle)
+    {
+        ESP_LOGI(TAG, "stack high water mark %u bytes", uxTaskGetStackHighWaterMark(_task_handle));
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+/*
+ * A single task that runs short periodic housekeeping jobs, replacing a dedicated
+ * FreeRTOS task (and stack) per job. Jobs must not block - anything long-running
+ * should be handed off to a transient task.
+ *
+ * For each job the scheduler records how late each run started relative to its
+ * deadline, the jitter between consecutive runs and the longest run time. These
+ * are logged periodically and on demand by timer_wheel_log_stats().
+ */
+
+#define TIMER_WHEEL_MAX_JOBS     (12)
+#define TIMER_WHEEL_INVALID_JOB  (-1)
+
+typedef int timer_wheel_job_t;
+typedef void (*timer_wheel_func_t)(void * context);
+
+void timer_wheel_init(UBaseType_t priority);
+void timer_wheel_delete(void);
+
+// Add a job to be run every period_ms milliseconds, starting as soon as possible.
+timer_wheel_job_t timer_wheel_add(const char * name, uint32_t period_ms, timer_wheel_func_t func, void * context);
+void timer_wheel_remove(timer_wheel_job_t job);
+
+void timer_wheel_log_stats(void);
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <math.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#include "trend.h"
+#include "constants.h"
+#include "resources.h"
+#include "utils.h"
+#include "datastore/datastore.h"
+#include "sensor_temp.h"
+#include "timer_wheel.h"
+
+#define TAG "trend"
+
+#define MEASUREMENT_EXPIRY (15 * 1000000)  // microseconds after which a flow or power measurement is not sampled
+
+// Ring of recent samples for each series, all sampled together so they share one write position
+static float _samples[TREND_SERIES_LAST][TREND_SAMPLES];
+static size_t _next = 0;
+static portMUX_TYPE _samples_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static timer_wheel_job_t _job = TIMER_WHEEL_INVALID_JOB;
+
+static float _sample(const datastore_t * datastore, datastore_resource_id_t id, datastore_instance_id_t instance, datastore_age_t expiry)
+{
+    float value = NAN;
+    datastore_age_t age = DATASTORE_INVALID_AGE;
+    datastore_get_age(datastore, id, instance, &age);
+    if (age < expiry)
+    {
+        datastore_get_float(datastore, id, instance, &value);
+    }
+    return value;
+}
+
+static void _trend_sampling_job(void * context)
+{
+    const datastore_t * datastore = (const datastore_t *)context;
+    ESP_LOGD(TAG, "trend sampling");
+
+    float values[TREND_SERIES_LAST];
+    datastore_age_t temp_expiry = sensor_temp_expiry(datastore);
+    for (datastore_instance_id_t i = 0; i < SENSOR_TEMP_INSTANCES; ++i)
+    {
+        values[TREND_SERIES_TEMP + i] = _sample(datastore, RESOURCE_ID_TEMP_VALUE, i, temp_expiry);
+    }
+    values[TREND_SERIES_FLOW_RATE] = _sample(datastore, RESOURCE_ID_FLOW_RATE, 0, MEASUREMENT_EXPIRY);
+    values[TREND_SERIES_POWER] = _sample(datastore, RESOURCE_ID_POWER_VALUE, 0, MEASUREMENT_EXPIRY);
+
+    portENTER_CRITICAL(&_samples_mux);
+    for (int i = 0; i < TREND_SERIES_LAST; ++i)
+    {
+        _samples[i][_next] = values[i];
+    }
+    _next = (_next + 1) % TREND_SAMPLES;
+    portEXIT_CRITICAL(&_samples_mux);
+}
+
+void trend_init(const datastore_t * datastore)
+{
+    ESP_LOGD(TAG, "%s", __FUNCTION__);
+    for (int i = 0; i < TREND_SERIES_LAST; ++i)
+    {
+        for (int j = 0; j < TREND_SAMPLES; ++j)
+        {
+            _samples[i][j] = NAN;
+        }
+    }
+    _next = 0;
+    _job = timer_wheel_add("trend", TREND_SAMPLING_PERIOD * 1000, _trend_sampling_job, (void *)datastore);
+}
+
+void trend_delete(void)
+{
+    timer_wheel_remove(_job);
+    _job = TIMER_WHEEL_INVALID_JOB;
+}
+
+size_t trend_get(trend_series_t series, float * samples, size_t count)
+{
+    assert(samples);
+    size_t valid = 0;
+    if (series >= 0 && series < TREND_SERIES_LAST)
+    {
+        portENTER_CRITICAL(&_samples_mux);
+        for (size_t i = 0; i < count; ++i)
+        {
+            // count back from the newest sample
+            float value = NAN;
+            if (count - i <= TREND_SAMPLES)
+            {
+                value = _samples[series][(_next + TREND_SAMPLES - (count - i)) % TREND_SAMPLES];
+            }
+            samples[i] = value;
+            valid += isnan(value) ? 0 : 1;
+        }
+        portEXIT_CRITICAL(&_samples_mux);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "invalid series %d", series);
+        for (size_t i = 0; i < count; ++i)
+        {
+            samples[i] = NAN;
+        }
+    }
+    return valid;
+}
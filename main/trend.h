@@ -0,0 +1,51 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 David Antliff
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TREND_H
+#define TREND_H
+
+#include <stddef.h>
+
+#include "freertos/FreeRTOS.h"
+#include "datastore/datastore.h"
+#include "sensor_temp.h"
+
+#define TREND_SAMPLES 20   // history depth per series, sampled every TREND_SAMPLING_PERIOD
+
+typedef enum
+{
+    TREND_SERIES_TEMP = 0,                                           // one per temperature sensor
+    TREND_SERIES_FLOW_RATE = TREND_SERIES_TEMP + SENSOR_TEMP_INSTANCES,
+    TREND_SERIES_POWER,
+    TREND_SERIES_LAST,
+} trend_series_t;
+
+void trend_init(const datastore_t * datastore);
+void trend_delete(void);
+
+// Copy the most recent count samples of a series into samples, oldest first. Samples not yet
+// taken, or taken while the measurement had expired, are NAN. Returns the number of valid samples.
+size_t trend_get(trend_series_t series, float * samples, size_t count);
+
+#endif // TREND_H
@@ -35,17 +35,14 @@
 #include "wifi_support.h"
 #include "resources.h"
 #include "utils.h"
+#include "timer_wheel.h"
 #include "datastore/datastore.h"
 
 #define TAG "wifi_support"
 #define CHECK_PERIOD (1000) // milliseconds
 
-typedef struct
-{
-    const datastore_t * datastore;
-} task_inputs_t;
-
-static TaskHandle_t _task_handle = NULL;
+static timer_wheel_job_t _job = TIMER_WHEEL_INVALID_JOB;
+static bool _new_info = true;
 
 static EventGroupHandle_t wifi_event_group;
 const static int CONNECTED_BIT = BIT0;
@@ -103,68 +100,43 @@ static void wifi_conn_init(const datastore_t * datastore)
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
-static void wifi_monitor_task(void * pvParameter)
+static void _wifi_monitor_job(void * context)
 {
-    assert(pvParameter);
-    ESP_LOGI(TAG, "Core ID %d", xPortGetCoreID());
-    task_inputs_t * task_inputs = (task_inputs_t *)pvParameter;
-    const datastore_t * datastore = task_inputs->datastore;
-
-    bool new_info = true;
-    TickType_t last_wake_time = xTaskGetTickCount();
+    const datastore_t * datastore = (const datastore_t *)context;
 
-    while (1)
+    wifi_ap_record_t ap_info = { 0 };
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK)
     {
-        last_wake_time = xTaskGetTickCount();
-
-        wifi_ap_record_t ap_info = { 0 };
-        if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK)
+        if (_new_info)
         {
-            if (new_info)
-            {
-                ESP_LOGI(TAG, "AP SSID %s", ap_info.ssid);
-                ESP_LOGI(TAG, "AP primary channel %d", ap_info.primary);
-                ESP_LOGI(TAG, "AP secondary channel %d", ap_info.second);
-                ESP_LOGI(TAG, "802.11%s%s%s", ap_info.phy_11b ? "b" : "", ap_info.phy_11g ? "g" : "", ap_info.phy_11n ? "n" : "");
-                ESP_LOGI(TAG, "RSSI %d", ap_info.rssi);
-                new_info = false;
-
-            }
-            else
-            {
-                ESP_LOGD(TAG, "RSSI %d", ap_info.rssi);
-            }
-
-            datastore_set_int8(datastore, RESOURCE_ID_WIFI_RSSI, 0, ap_info.rssi);
+            ESP_LOGI(TAG, "AP SSID %s", ap_info.ssid);
+            ESP_LOGI(TAG, "AP primary channel %d", ap_info.primary);
+            ESP_LOGI(TAG, "AP secondary channel %d", ap_info.second);
+            ESP_LOGI(TAG, "802.11%s%s%s", ap_info.phy_11b ? "b" : "", ap_info.phy_11g ? "g" : "", ap_info.phy_11n ? "n" : "");
+            ESP_LOGI(TAG, "RSSI %d", ap_info.rssi);
+            _new_info = false;
+
         }
         else
         {
-            new_info = true;
-            datastore_set_int8(datastore, RESOURCE_ID_WIFI_RSSI, 0, 0);
+            ESP_LOGD(TAG, "RSSI %d", ap_info.rssi);
         }
 
-        vTaskDelayUntil(&last_wake_time, CHECK_PERIOD / portTICK_PERIOD_MS);
+        datastore_set_int8(datastore, RESOURCE_ID_WIFI_RSSI, 0, ap_info.rssi);
+    }
+    else
+    {
+        _new_info = true;
+        datastore_set_int8(datastore, RESOURCE_ID_WIFI_RSSI, 0, 0);
     }
-
-    free(task_inputs);
-    _task_handle = NULL;
-    vTaskDelete(NULL);
 }
 
-void wifi_support_init(UBaseType_t priority, const datastore_t * datastore)
+void wifi_support_init(const datastore_t * datastore)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
 
     wifi_conn_init(datastore);
-
-    // task will take ownership of this struct
-    task_inputs_t * task_inputs = malloc(sizeof(*task_inputs));
-    if (task_inputs)
-    {
-        memset(task_inputs, 0, sizeof(*task_inputs));
-        task_inputs->datastore = datastore;
-        xTaskCreate(&wifi_monitor_task, "wifi_monitor_task", 4096, task_inputs, priority, &_task_handle);
-    }
+    _job = timer_wheel_add("wifi", CHECK_PERIOD, _wifi_monitor_job, (void *)datastore);
 }
 
 void wifi_support_delete(void)
@@ -172,6 +144,6 @@ void wifi_support_delete(void)
     // disable the event handler
     esp_event_loop_set_cb(NULL, NULL);
 
-    if (_task_handle)
-        vTaskDelete(_task_handle);
+    timer_wheel_remove(_job);
+    _job = TIMER_WHEEL_INVALID_JOB;
 }
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+Decode a control trace dump published on poolmon/control/trace/data.
+
+Capture the dump with, for example:
+
+    mosquitto_sub -h <broker> -t poolmon/control/trace/data > trace.txt &
+    mosquitto_pub -h <broker> -t poolmon/control/trace/dump -m 1
+
+then decode it with:
+
+    control_trace_decode.py trace.txt
+
+The record layout must match control_trace_record_t in main/control_trace.h.
+"""
+
+import argparse
+import struct
+import sys
+
+RECORD_FORMAT = "<HIBBBBBBhhhHHH"
+RECORD_SIZE = struct.calcsize(RECORD_FORMAT)
+
+LOOP_PP = 0x80
+NO_REASON = 0xff
+NO_AGE = 0xffff
+
+CP_STATES = ["OFF", "ON"]
+PP_STATES = ["OFF", "ON", "PAUSE", "EMERGENCY"]
+
+# keep in sync with control_reason_t in main/control_logic.h
+REASONS = [
+    "CP_DELTA_ON",
+    "CP_DELTA_OFF",
+    "CP_REFRESH",
+    "CP_PREDICTED",
+    "PP_SAFE_RESTORED",
+    "PP_EMERGENCY",
+    "PP_TIME_OF_DAY",
+    "PP_LOW_FLOW",
+    "PP_CYCLE_PAUSE",
+    "PP_CYCLE_ON",
+    "PP_CYCLE_DONE",
+    "PP_MANUAL",
+]
+
+FLAGS = [
+    (1 << 0, "pump"),
+    (1 << 1, "temps"),
+    (1 << 2, "flow"),
+    (1 << 3, "auto"),
+    (1 << 4, "cp"),
+    (1 << 5, "daily"),
+]
+
+
+def lookup(table, index):
+    return table[index] if index < len(table) else str(index)
+
+
+def age(tenths):
+    return "-" if tenths == NO_AGE else "{:.1f}s".format(tenths / 10.0)
+
+
+def decode_record(data):
+    (seq, time, loop, prev_state, state, reason, flags, cycle, t_high, t_low, flow,
+     t_high_age, t_low_age, flow_age) = struct.unpack(RECORD_FORMAT, data)
+    is_pp = loop == LOOP_PP
+    states = PP_STATES if is_pp else CP_STATES
+    name = "PP" if is_pp else "CP{}".format(loop + 1)
+    flag_names = ",".join(n for bit, n in FLAGS if flags & bit)
+    events = flags >> 6
+    line = "{:5d} {:8d}s {:4s} {:>9s} -> {:<9s} {:16s} [{}] ev={} T_high={:6.2f}".format(
+        seq, time, name, lookup(states, prev_state), lookup(states, state),
+        lookup(REASONS, reason) if reason != NO_REASON else "-",
+        flag_names, events, t_high / 100.0)
+    line += " ({})".format(age(t_high_age))
+    if is_pp:
+        line += " flow={:6.2f} ({}) n={}".format(flow / 100.0, age(flow_age), cycle)
+    else:
+        line += " T_low={:6.2f} ({}) delta={:6.2f}".format(t_low / 100.0, age(t_low_age), (t_high - t_low) / 100.0)
+    return seq, reason != NO_REASON, line
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?", type=argparse.FileType("r"), default=sys.stdin,
+                        help="captured dump, one MQTT message per line (default: stdin)")
+    parser.add_argument("-t", "--transitions", action="store_true", help="only show iterations with a transition")
+    args = parser.parse_args()
+
+    expected_seq = None
+    for raw in args.input:
+        raw = raw.strip()
+        if raw.startswith("H "):
+            count, size, avg_us, max_us = (int(x) for x in raw.split()[1:5])
+            if size != RECORD_SIZE:
+                sys.exit("record size mismatch: device {}, decoder {}".format(size, RECORD_SIZE))
+            print("# {} records, trace overhead avg {} us, max {} us per iteration".format(count, avg_us, max_us))
+        elif raw.startswith("R "):
+            data = bytes.fromhex(raw[2:])
+            for offset in range(0, len(data) - RECORD_SIZE + 1, RECORD_SIZE):
+                seq, transition, line = decode_record(data[offset:offset + RECORD_SIZE])
+                if expected_seq is not None and seq != expected_seq:
+                    print("# gap: expected seq {}, got {}".format(expected_seq, seq))
+                expected_seq = (seq + 1) & 0xffff
+                if transition or not args.transitions:
+                    print(line)
+        elif raw == "E":
+            print("# end of dump")
+
+
+if __name__ == "__main__":
+    main()